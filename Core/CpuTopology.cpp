@@ -0,0 +1,273 @@
+/**
+ *  Copyright 2020-2021 Zhang QiuLiang (juteman). All rights reserved.
+ *
+ *  This file is a part of Hawl
+ *  see(https://github.com/juteman/Hawl)
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#include "Thread/CpuTopology.h"
+#include "Logger.h"
+#include <algorithm>
+#include <map>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <utility>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#elif defined(__linux__)
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <sched.h>
+#endif
+
+namespace Hawl
+{
+namespace
+{
+#if defined(__linux__)
+/// read a decimal number from a sysfs file, fallback when missing or negative
+uint32 ReadSysfsNumber(const std::string &path, uint32 fallback)
+{
+    FILE *file = std::fopen(path.c_str(), "r");
+    if (file == nullptr)
+        return fallback;
+    long value = -1;
+    const int read = std::fscanf(file, "%ld", &value);
+    std::fclose(file);
+    return read == 1 && value >= 0 ? static_cast<uint32>(value) : fallback;
+}
+
+/// the cpu directory hold a nodeN link to its NUMA node
+uint32 ReadCpuNode(const std::string &cpuPath)
+{
+    DIR *directory = opendir(cpuPath.c_str());
+    if (directory == nullptr)
+        return 0;
+    uint32 node = 0;
+    while (dirent *entry = readdir(directory))
+    {
+        unsigned value;
+        if (std::sscanf(entry->d_name, "node%u", &value) == 1)
+        {
+            node = value;
+            break;
+        }
+    }
+    closedir(directory);
+    return node;
+}
+#endif
+
+uint32 CountDistinct(const std::vector<LogicalCpu> &cpus, uint32 LogicalCpu::*field)
+{
+    std::vector<uint32> values;
+    for (const LogicalCpu &cpu : cpus)
+        values.push_back(cpu.*field);
+    std::sort(values.begin(), values.end());
+    return static_cast<uint32>(std::unique(values.begin(), values.end()) - values.begin());
+}
+} // namespace
+
+const CpuTopology &CpuTopology::Get()
+{
+    static const CpuTopology topology;
+    return topology;
+}
+
+CpuTopology::CpuTopology()
+{
+    Discover();
+    if (m_cpus.empty())
+    {
+        // nothing readable, every processor is its own core
+        const uint32 count = std::max(1u, std::thread::hardware_concurrency());
+        for (uint32 i = 0; i < count; i++)
+            m_cpus.push_back({i, i, 0, 0});
+    }
+
+    std::sort(m_cpus.begin(), m_cpus.end(), [](const LogicalCpu &a, const LogicalCpu &b) {
+        return std::tie(a.package, a.core, a.id) < std::tie(b.package, b.core, b.id);
+    });
+    m_coreCount = CountDistinct(m_cpus, &LogicalCpu::core);
+    m_packageCount = CountDistinct(m_cpus, &LogicalCpu::package);
+    m_nodeCount = CountDistinct(m_cpus, &LogicalCpu::node);
+}
+
+void CpuTopology::Discover()
+{
+#if defined(_WIN32)
+    DWORD_PTR processMask = 0, systemMask = 0;
+    if (!GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask))
+        return;
+
+    DWORD length = 0;
+    GetLogicalProcessorInformationEx(RelationAll, nullptr, &length);
+    std::vector<char> buffer(length);
+    auto *records = reinterpret_cast<SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *>(buffer.data());
+    if (length == 0 || !GetLogicalProcessorInformationEx(RelationAll, records, &length))
+        return;
+
+    // processors are in the group 0 masks only, the others groups are ignored
+    LogicalCpu cpus[sizeof(KAFFINITY) * 8];
+    uint32 coreIndex = 0, packageIndex = 0;
+    for (DWORD offset = 0; offset < length;)
+    {
+        const auto *record = reinterpret_cast<const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *>(buffer.data() + offset);
+        const GROUP_AFFINITY *group = nullptr;
+        uint32 LogicalCpu::*field = nullptr;
+        uint32 value = 0;
+        switch (record->Relationship)
+        {
+        case RelationProcessorCore:
+            group = &record->Processor.GroupMask[0];
+            field = &LogicalCpu::core;
+            value = coreIndex++;
+            break;
+        case RelationProcessorPackage:
+            group = &record->Processor.GroupMask[0];
+            field = &LogicalCpu::package;
+            value = packageIndex++;
+            break;
+        case RelationNumaNode:
+            group = &record->NumaNode.GroupMask;
+            field = &LogicalCpu::node;
+            value = record->NumaNode.NodeNumber;
+            break;
+        default: break;
+        }
+
+        for (uint32 bit = 0; group != nullptr && group->Group == 0 && bit < sizeof(KAFFINITY) * 8; bit++)
+        {
+            if (group->Mask & (KAFFINITY(1) << bit))
+                cpus[bit].*field = value;
+        }
+        offset += record->Size;
+    }
+
+    for (uint32 bit = 0; bit < sizeof(KAFFINITY) * 8; bit++)
+    {
+        if (processMask & (DWORD_PTR(1) << bit))
+        {
+            cpus[bit].id = bit;
+            m_cpus.push_back(cpus[bit]);
+        }
+    }
+#elif defined(__linux__)
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+    {
+        Logger::warn("sched_getaffinity failed: {}.", std::strerror(errno));
+        return;
+    }
+
+    // core_id is only unique inside a package, number the (package, core_id) pairs
+    std::map<std::pair<uint32, uint32>, uint32> cores;
+    for (uint32 id = 0; id < CPU_SETSIZE; id++)
+    {
+        if (!CPU_ISSET(id, &allowed))
+            continue;
+
+        const std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(id);
+        LogicalCpu cpu;
+        cpu.id = id;
+        cpu.package = ReadSysfsNumber(path + "/topology/physical_package_id", 0);
+        const uint32 coreId = ReadSysfsNumber(path + "/topology/core_id", id);
+        cpu.core = cores.emplace(std::make_pair(cpu.package, coreId), static_cast<uint32>(cores.size())).first->second;
+        cpu.node = ReadCpuNode(path);
+        m_cpus.push_back(cpu);
+    }
+#endif
+}
+
+std::vector<uint32> CpuTopology::SelectCpus(uint32 count, AffinityPolicy policy, bool reserveFirstCore) const
+{
+    std::vector<uint32> selected;
+    if (policy == AffinityPolicy::None || count == 0)
+        return selected;
+
+    std::vector<uint32> order;
+    for (uint32 i = 0; i < m_cpus.size(); i++)
+    {
+        if (!reserveFirstCore || m_coreCount < 2 || m_cpus[i].core != m_cpus[0].core)
+            order.push_back(i);
+    }
+
+    if (policy == AffinityPolicy::Scatter)
+    {
+        // rank of every processor in its core and of every core in its package, the
+        // processors are sorted by package then core so the ranks are counted in order
+        std::vector<uint32> smtRank(m_cpus.size()), coreRank(m_cpus.size());
+        for (uint32 i = 1; i < m_cpus.size(); i++)
+        {
+            const LogicalCpu &previous = m_cpus[i - 1];
+            const LogicalCpu &cpu = m_cpus[i];
+            if (cpu.package != previous.package)
+                continue;
+            smtRank[i] = cpu.core == previous.core ? smtRank[i - 1] + 1 : 0;
+            coreRank[i] = cpu.core == previous.core ? coreRank[i - 1] : coreRank[i - 1] + 1;
+        }
+        std::stable_sort(order.begin(), order.end(), [&](uint32 a, uint32 b) {
+            return std::tie(smtRank[a], coreRank[a], m_cpus[a].package) <
+                   std::tie(smtRank[b], coreRank[b], m_cpus[b].package);
+        });
+    }
+
+    for (uint32 i = 0; i < count; i++)
+        selected.push_back(order[i % order.size()]);
+    return selected;
+}
+
+void CpuTopology::Log() const
+{
+    Logger::info("CPU topology: {} logical processors, {} cores, {} packages, {} NUMA nodes.",
+                 m_cpus.size(),
+                 m_coreCount,
+                 m_packageCount,
+                 m_nodeCount);
+    for (const LogicalCpu &cpu : m_cpus)
+        Logger::debug("cpu {}: core {}, package {}, node {}", cpu.id, cpu.core, cpu.package, cpu.node);
+}
+
+bool CpuTopology::PinCurrentThread(uint32 cpu)
+{
+#if defined(_WIN32)
+    if (cpu >= sizeof(DWORD_PTR) * 8 || SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << cpu) == 0)
+    {
+        Logger::warn("SetThreadAffinityMask to cpu {} failed with error {}.", cpu, GetLastError());
+        return false;
+    }
+    return true;
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0)
+    {
+        Logger::warn("sched_setaffinity to cpu {} failed: {}.", cpu, std::strerror(errno));
+        return false;
+    }
+    return true;
+#else
+    UNREF_PARAM(cpu);
+    return false;
+#endif
+}
+} // namespace Hawl
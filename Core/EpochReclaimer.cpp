@@ -0,0 +1,221 @@
+/**
+ *  Copyright 2020-2021 Zhang QiuLiang (juteman). All rights reserved.
+ *
+ *  This file is a part of Hawl
+ *  see(https://github.com/juteman/Hawl)
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#include "Algorithm/EpochReclaimer.h"
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+namespace Hawl::Algorithm
+{
+namespace
+{
+/// try advance the epoch after this count of retire
+constexpr uint64 CollectInterval = 64;
+/// retire list reserved per thread by default, a few stalled epochs fit without growing it
+constexpr size_t DefaultRetiredReserve = CollectInterval * 16;
+
+struct RetiredObject
+{
+    void       *object;
+    ReclaimFunc reclaim;
+    uint64      epoch;
+};
+
+/// per thread announce record, never freed, reused after the owner thread exit
+struct alignas(CacheLineSize) ThreadRecord
+{
+    /// (epoch << 1) | active
+    std::atomic<uint64> state{0};
+    std::atomic<bool>   inUse{true};
+    ThreadRecord       *next = nullptr;
+};
+
+/// global state, intentionally immortal so thread exit during static destruction stay valid
+struct EpochState
+{
+    alignas(CacheLineSize) std::atomic<uint64> epoch{0};
+    alignas(CacheLineSize) std::atomic<ThreadRecord *> records{nullptr};
+
+    /// capacity of the retire lists, raised by Reserve
+    std::atomic<size_t> retiredReserve{DefaultRetiredReserve};
+
+    /// retired objects left by exited threads
+    std::mutex                 orphanMutex;
+    std::vector<RetiredObject> orphans;
+};
+
+EpochState &GetState()
+{
+    static EpochState *state = new EpochState();
+    return *state;
+}
+
+ThreadRecord *AcquireRecord()
+{
+    EpochState &state = GetState();
+    for (ThreadRecord *record = state.records.load(std::memory_order_acquire); record != nullptr;
+         record = record->next)
+    {
+        bool expected = false;
+        if (!record->inUse.load(std::memory_order_relaxed) &&
+            record->inUse.compare_exchange_strong(expected, true, std::memory_order_acquire))
+            return record;
+    }
+
+    ThreadRecord *record = new ThreadRecord();
+    ThreadRecord *head = state.records.load(std::memory_order_relaxed);
+    do
+    {
+        record->next = head;
+    } while (!state.records.compare_exchange_weak(head, record, std::memory_order_release));
+    return record;
+}
+
+/// advance the global epoch if every active thread have observed the current one
+uint64 TryAdvance()
+{
+    EpochState &state = GetState();
+    uint64      epoch = state.epoch.load(std::memory_order_seq_cst);
+    for (ThreadRecord *record = state.records.load(std::memory_order_acquire); record != nullptr;
+         record = record->next)
+    {
+        const uint64 recordState = record->state.load(std::memory_order_seq_cst);
+        if ((recordState & 1) && (recordState >> 1) != epoch)
+            return epoch;
+    }
+
+    if (state.epoch.compare_exchange_strong(epoch, epoch + 1, std::memory_order_seq_cst))
+        return epoch + 1;
+    return epoch;
+}
+
+/// release the objects retired at least two epoch ago, keep the order of the rest
+void ReclaimExpired(std::vector<RetiredObject> &retired, uint64 epoch)
+{
+    size_t kept = 0;
+    for (size_t i = 0; i < retired.size(); ++i)
+    {
+        if (retired[i].epoch + 2 <= epoch)
+            retired[i].reclaim(retired[i].object);
+        else
+            retired[kept++] = retired[i];
+    }
+    retired.resize(kept);
+}
+
+struct ThreadContext
+{
+    ThreadRecord              *record = AcquireRecord();
+    uint32                     nesting = 0;
+    uint64                     retireCount = 0;
+    std::vector<RetiredObject> retired;
+
+    ThreadContext()
+    {
+        retired.reserve(GetState().retiredReserve.load(std::memory_order_relaxed));
+    }
+
+    /// don't reclaim here, the reclaim function may use thread local data that is
+    /// already destroyed, hand the objects to the live threads instead
+    ~ThreadContext()
+    {
+        record->state.store(0, std::memory_order_release);
+        record->inUse.store(false, std::memory_order_release);
+
+        if (retired.empty())
+            return;
+        EpochState                 &state = GetState();
+        std::lock_guard<std::mutex> lock(state.orphanMutex);
+        state.orphans.insert(state.orphans.end(), retired.begin(), retired.end());
+    }
+};
+
+ThreadContext &GetContext()
+{
+    static thread_local ThreadContext context;
+    return context;
+}
+} // namespace
+
+EpochReclaimer::Guard::Guard()
+{
+    ThreadContext &context = GetContext();
+    if (context.nesting++ != 0)
+        return;
+
+    const uint64 epoch = GetState().epoch.load(std::memory_order_seq_cst);
+    context.record->state.store((epoch << 1) | 1, std::memory_order_seq_cst);
+    // pointer loads in the region must not be reordered before the announce
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+EpochReclaimer::Guard::~Guard()
+{
+    ThreadContext &context = GetContext();
+    if (--context.nesting != 0)
+        return;
+    context.record->state.store(context.record->state.load(std::memory_order_relaxed) & ~uint64(1),
+                                std::memory_order_release);
+}
+
+void EpochReclaimer::Retire(void *object, ReclaimFunc reclaim)
+{
+    ThreadContext &context = GetContext();
+    context.retired.push_back({object, reclaim, GetState().epoch.load(std::memory_order_seq_cst)});
+    if (++context.retireCount % CollectInterval == 0)
+        Collect();
+}
+
+void EpochReclaimer::Collect()
+{
+    ThreadContext &context = GetContext();
+    const uint64   epoch = TryAdvance();
+    ReclaimExpired(context.retired, epoch);
+
+    EpochState  &state = GetState();
+    const size_t reserve = state.retiredReserve.load(std::memory_order_relaxed);
+    if (context.retired.capacity() < reserve)
+        context.retired.reserve(reserve);
+
+    // pick up the objects left by exited threads, skip if another thread is on it
+    std::unique_lock<std::mutex> lock(state.orphanMutex, std::try_to_lock);
+    if (lock.owns_lock() && !state.orphans.empty())
+        ReclaimExpired(state.orphans, epoch);
+}
+
+void EpochReclaimer::Reserve(size_t count)
+{
+    std::atomic<size_t> &reserve = GetState().retiredReserve;
+    size_t               current = reserve.load(std::memory_order_relaxed);
+    while (current < count && !reserve.compare_exchange_weak(current, count, std::memory_order_relaxed))
+    {
+    }
+
+    ThreadContext &context = GetContext();
+    if (context.retired.capacity() < count)
+        context.retired.reserve(count);
+}
+
+uint64 EpochReclaimer::CurrentEpoch()
+{
+    return GetState().epoch.load(std::memory_order_relaxed);
+}
+} // namespace Hawl::Algorithm
@@ -0,0 +1,98 @@
+/**
+ *  Copyright 2020-2021 Zhang QiuLiang (juteman). All rights reserved.
+ *
+ *  This file is a part of Hawl
+ *  see(https://github.com/juteman/Hawl)
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#include "Thread/EventCount.h"
+
+#if defined(_WIN32)
+#include <Windows.h>
+#pragma comment(lib, "Synchronization.lib")
+#elif defined(__linux__)
+#include <cerrno>
+#include <climits>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#else
+#include <thread>
+#endif
+
+namespace Hawl
+{
+static_assert(sizeof(std::atomic<uint32>) == sizeof(uint32), "futex word must be a plain 32 bit integer");
+
+#if defined(_WIN32)
+bool FutexWait(std::atomic<uint32> *address, uint32 expected, std::chrono::nanoseconds timeout)
+{
+    const DWORD milliseconds =
+        timeout.count() < 0 ? INFINITE
+                            : static_cast<DWORD>(std::chrono::ceil<std::chrono::milliseconds>(timeout).count());
+    if (WaitOnAddress(address, &expected, sizeof(uint32), milliseconds))
+        return true;
+    return GetLastError() != ERROR_TIMEOUT;
+}
+
+void FutexWake(std::atomic<uint32> *address, uint32 count)
+{
+    if (count == 1)
+        WakeByAddressSingle(address);
+    else
+        WakeByAddressAll(address);
+}
+#elif defined(__linux__)
+bool FutexWait(std::atomic<uint32> *address, uint32 expected, std::chrono::nanoseconds timeout)
+{
+    timespec  relative;
+    timespec *relativePointer = nullptr;
+    if (timeout.count() >= 0)
+    {
+        relative.tv_sec = static_cast<time_t>(timeout.count() / 1000000000);
+        relative.tv_nsec = static_cast<long>(timeout.count() % 1000000000);
+        relativePointer = &relative;
+    }
+
+    const long result = syscall(SYS_futex, address, FUTEX_WAIT_PRIVATE, expected, relativePointer, nullptr, 0);
+    return result == 0 || errno != ETIMEDOUT;
+}
+
+void FutexWake(std::atomic<uint32> *address, uint32 count)
+{
+    syscall(SYS_futex, address, FUTEX_WAKE_PRIVATE, count > INT_MAX ? INT_MAX : static_cast<int>(count), nullptr,
+            nullptr, 0);
+}
+#else
+// no futex on this platform, poll with a short sleep
+bool FutexWait(std::atomic<uint32> *address, uint32 expected, std::chrono::nanoseconds timeout)
+{
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (address->load(std::memory_order_acquire) == expected)
+    {
+        if (timeout.count() >= 0 && std::chrono::steady_clock::now() >= deadline)
+            return false;
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+    return true;
+}
+
+void FutexWake(std::atomic<uint32> *, uint32)
+{
+}
+#endif
+} // namespace Hawl
@@ -0,0 +1,386 @@
+/**
+ *  Copyright 2020-2021 Zhang QiuLiang (juteman). All rights reserved.
+ *
+ *  This file is a part of Hawl
+ *  see(https://github.com/juteman/Hawl)
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#include "Thread/FiberJobSystem.h"
+#include "Logger.h"
+#include <thread>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace Hawl
+{
+namespace
+{
+/// fiber running on the calling thread. Only touched through the NOINLINE
+/// accessors, the compiler must not keep the thread local address across a
+/// switch since the fiber may be resumed on another thread
+thread_local Task *tl_currentFiber = nullptr;
+
+NOINLINE Task *GetCurrentFiberTask()
+{
+    return tl_currentFiber;
+}
+
+NOINLINE void SetCurrentFiberTask(Task *fiber)
+{
+    tl_currentFiber = fiber;
+}
+
+#if defined(HAWL_FIBER_X86_64)
+extern "C" void HawlSwitchFiber(void **fromStackPointer, void *toStackPointer);
+extern "C" void HawlFiberTrampoline();
+
+// System V x86-64: push the callee saved registers, mxcsr and x87 control word,
+// swap the stack pointers and pop the ones of the other context.
+// A new fiber return to the trampoline, that call r13 with r12 as argument
+asm(R"(
+    .text
+    .globl HawlSwitchFiber
+    .type HawlSwitchFiber, @function
+HawlSwitchFiber:
+    pushq %rbp
+    pushq %rbx
+    pushq %r12
+    pushq %r13
+    pushq %r14
+    pushq %r15
+    subq $8, %rsp
+    stmxcsr (%rsp)
+    fnstcw 4(%rsp)
+    movq %rsp, (%rdi)
+    movq %rsi, %rsp
+    ldmxcsr (%rsp)
+    fldcw 4(%rsp)
+    addq $8, %rsp
+    popq %r15
+    popq %r14
+    popq %r13
+    popq %r12
+    popq %rbx
+    popq %rbp
+    ret
+    .size HawlSwitchFiber, .-HawlSwitchFiber
+
+    .globl HawlFiberTrampoline
+    .type HawlFiberTrampoline, @function
+HawlFiberTrampoline:
+    movq %r12, %rdi
+    callq *%r13
+    ud2
+    .size HawlFiberTrampoline, .-HawlFiberTrampoline
+)");
+#endif
+
+/// save the current context into from and resume to
+void SwitchContext(FiberContext &from, FiberContext &to)
+{
+#if defined(_WIN32)
+    UNREF_PARAM(from);
+    SwitchToFiber(to.fiber);
+#elif defined(HAWL_FIBER_X86_64)
+    HawlSwitchFiber(&from.stackPointer, to.stackPointer);
+#else
+    swapcontext(&from.context, &to.context);
+#endif
+}
+} // namespace
+
+void FiberCounter::Decrement()
+{
+    // only the last decrement take the lock
+    uint32 value = m_value.load(std::memory_order_relaxed);
+    while (value > 1)
+    {
+        if (m_value.compare_exchange_weak(value, value - 1, std::memory_order_acq_rel, std::memory_order_relaxed))
+            return;
+    }
+
+    Lock();
+    FiberJobSystem::Fiber *waiter = nullptr;
+    if (m_value.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        waiter = m_waiters;
+        m_waiters = nullptr;
+    }
+    Unlock();
+
+    // the counter may be destroyed now, only touch the detached list
+    while (waiter != nullptr)
+    {
+        FiberJobSystem::Fiber *next = waiter->nextWaiter;
+        waiter->system->m_pool.AddTask(waiter);
+        waiter = next;
+    }
+}
+
+bool FiberCounter::AddWaiter(FiberJobSystem::Fiber *fiber)
+{
+    Lock();
+    const bool parked = m_value.load(std::memory_order_relaxed) != 0;
+    if (parked)
+    {
+        fiber->nextWaiter = m_waiters;
+        m_waiters = fiber;
+    }
+    Unlock();
+    return parked;
+}
+
+FiberJobSystem::FiberJobSystem(ThreadPool &pool, uint32 fiberCount, size_t stackSize)
+    : m_pool{pool}, m_stackSize{stackSize}, m_freeFibers{fiberCount}
+{
+#if !defined(_WIN32)
+    m_pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    m_stackSize = (stackSize + m_pageSize - 1) / m_pageSize * m_pageSize;
+#endif
+
+    for (uint32 i = 0; i < fiberCount; i++)
+    {
+        auto fiber = std::make_unique<Fiber>();
+        fiber->system = this;
+        if (!CreateFiberContext(*fiber))
+            break;
+        m_freeFibers.EnQueue(fiber.get());
+        m_fibers.push_back(std::move(fiber));
+    }
+}
+
+bool FiberJobSystem::CreateFiberContext(Fiber &fiber)
+{
+#if defined(_WIN32)
+    fiber.context.fiber = CreateFiber(m_stackSize, FiberEntry, &fiber);
+    if (fiber.context.fiber == nullptr)
+    {
+        Logger::error("CreateFiber failed with error {}.", GetLastError());
+        return false;
+    }
+#else
+    // one more page below the stack as a guard against overflow
+    void *memory = mmap(nullptr, m_stackSize + m_pageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED)
+    {
+        Logger::error("Allocate fiber stack of {} bytes failed.", m_stackSize);
+        return false;
+    }
+    mprotect(memory, m_pageSize, PROT_NONE);
+    fiber.stack = memory;
+
+    uint8 *stackTop = static_cast<uint8 *>(memory) + m_pageSize + m_stackSize;
+#if defined(HAWL_FIBER_X86_64)
+    // the frame HawlSwitchFiber pop, its ret jump to the trampoline with the
+    // stack 16 bytes aligned, so the trampoline call FiberEntry like any caller
+    uint64 *frame = reinterpret_cast<uint64 *>(stackTop);
+    *--frame = reinterpret_cast<uint64>(&HawlFiberTrampoline);
+    *--frame = 0; // rbp
+    *--frame = 0; // rbx
+    *--frame = reinterpret_cast<uint64>(&fiber); // r12
+    *--frame = reinterpret_cast<uint64>(&FiberEntry); // r13
+    *--frame = 0; // r14
+    *--frame = 0; // r15
+    *--frame = (uint64(0x037F) << 32) | 0x1F80; // default x87 control word and mxcsr
+    fiber.context.stackPointer = frame;
+#else
+    ucontext_t &context = fiber.context.context;
+    getcontext(&context);
+    context.uc_stack.ss_sp = stackTop - m_stackSize;
+    context.uc_stack.ss_size = m_stackSize;
+    context.uc_link = nullptr;
+    // makecontext only pass int arguments, the pointer is split in two halves
+    void (*entry)(uint32, uint32) = [](uint32 low, uint32 high) {
+        FiberEntry(reinterpret_cast<Fiber *>((static_cast<uintptr_t>(high) << 16 << 16) | low));
+    };
+    const uintptr_t address = reinterpret_cast<uintptr_t>(&fiber);
+    makecontext(&context,
+                reinterpret_cast<void (*)()>(entry),
+                2,
+                static_cast<uint32>(address),
+                static_cast<uint32>(address >> 16 >> 16));
+#endif
+#endif
+    return true;
+}
+
+FiberJobSystem::~FiberJobSystem()
+{
+    // the last jobs may have decremented their counters but still be on their
+    // way back to the free list
+    while (m_busyFibers.load(std::memory_order_acquire) != 0)
+        std::this_thread::yield();
+
+    for (auto &fiber : m_fibers)
+    {
+#if defined(_WIN32)
+        DeleteFiber(fiber->context.fiber);
+#else
+        munmap(fiber->stack, m_stackSize + m_pageSize);
+#endif
+    }
+}
+
+bool FiberJobSystem::IsInFiber()
+{
+    return GetCurrentFiberTask() != nullptr;
+}
+
+void FiberJobSystem::RunJob(Task *job, FiberCounter *counter)
+{
+    if (job == nullptr)
+        return;
+    if (counter != nullptr)
+        counter->Add(1);
+
+    JobStart *start = StartPool::Instance().New(this, PendingJob{job, counter});
+    start->taskPriority = job->taskPriority;
+    m_pool.AddTask(start);
+}
+
+void FiberJobSystem::JobStart::run()
+{
+    // give the record back first, the job may end on another thread
+    FiberJobSystem  *owner = system;
+    const PendingJob job = pending;
+    StartPool::Instance().Delete(this);
+    owner->StartJob(job);
+}
+
+void FiberJobSystem::StartJob(const PendingJob &pending)
+{
+    Fiber *fiber;
+    if (!m_freeFibers.DeQueue(fiber))
+    {
+        // every fiber is in use, a wait in the job will help the pool
+        RunPendingJob(pending);
+        return;
+    }
+
+    m_busyFibers.fetch_add(1, std::memory_order_relaxed);
+    fiber->current = pending;
+    fiber->run();
+}
+
+void FiberJobSystem::WaitForCounter(FiberCounter &counter)
+{
+    if (counter.IsReleased())
+        return;
+
+    Fiber *fiber = static_cast<Fiber *>(GetCurrentFiberTask());
+    if (fiber == nullptr)
+    {
+        while (!counter.IsReleased())
+        {
+            if (!m_pool.RunPendingTask())
+                CpuPause();
+        }
+        return;
+    }
+
+    fiber->action = FiberAction::Wait;
+    fiber->waitCounter = &counter;
+    SwitchToCaller(fiber);
+}
+
+void FiberJobSystem::YieldJob()
+{
+    Fiber *fiber = static_cast<Fiber *>(GetCurrentFiberTask());
+    if (fiber == nullptr)
+        return;
+
+    fiber->action = FiberAction::Yield;
+    SwitchToCaller(fiber);
+}
+
+void FiberJobSystem::Fiber::run()
+{
+    FiberContext callerContext;
+#if defined(_WIN32)
+    if (!IsThreadAFiber())
+        ConvertThreadToFiber(nullptr);
+    callerContext.fiber = GetCurrentFiber();
+#endif
+
+    // the priority was lowered by a yield
+    taskPriority = current.job->taskPriority;
+
+    // a job helping the pool may resume a fiber from another fiber
+    Task *previous = GetCurrentFiberTask();
+    caller = &callerContext;
+    SetCurrentFiberTask(this);
+    SwitchContext(callerContext, context);
+
+    // the fiber switched back, the thread is the same one
+    SetCurrentFiberTask(previous);
+    system->AfterSwitch(this);
+}
+
+#if defined(_WIN32)
+void __stdcall FiberJobSystem::FiberEntry(void *parameter)
+#else
+void FiberJobSystem::FiberEntry(void *parameter)
+#endif
+{
+    Fiber *fiber = static_cast<Fiber *>(parameter);
+    while (true)
+    {
+        RunPendingJob(fiber->current);
+        fiber->action = FiberAction::Finish;
+        SwitchToCaller(fiber);
+    }
+}
+
+void FiberJobSystem::RunPendingJob(const PendingJob &pending)
+{
+    pending.job->run();
+    if (pending.counter != nullptr)
+        pending.counter->Decrement();
+}
+
+void FiberJobSystem::SwitchToCaller(Fiber *fiber)
+{
+    SwitchContext(fiber->context, *fiber->caller);
+}
+
+void FiberJobSystem::AfterSwitch(Fiber *fiber)
+{
+    switch (fiber->action)
+    {
+    case FiberAction::Finish:
+        fiber->current = {};
+        m_freeFibers.EnQueue(fiber);
+        // the last access to the system, it may be destroyed after
+        m_busyFibers.fetch_sub(1, std::memory_order_release);
+        break;
+    case FiberAction::Wait:
+        // the fiber is fully switched out, it is safe to resume it from another thread now
+        if (!fiber->waitCounter->AddWaiter(fiber))
+            m_pool.AddTask(fiber);
+        break;
+    case FiberAction::Yield:
+        // below Normal so the pool run the other pending tasks first
+        fiber->taskPriority = Priority::Lowest;
+        m_pool.AddTask(fiber);
+        break;
+    }
+}
+} // namespace Hawl
@@ -0,0 +1,155 @@
+/**
+ *  Copyright 2020-2021 Zhang QiuLiang (juteman). All rights reserved.
+ *
+ *  This file is a part of Hawl
+ *  see(https://github.com/juteman/Hawl)
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#include "Memory/FrameAllocator.h"
+#include "Memory/VirtualMemory.h"
+#include "Logger.h"
+#include <algorithm>
+#include <cstdint>
+
+namespace Hawl
+{
+namespace
+{
+/// the block of a frame a thread bumps
+struct ThreadBlock
+{
+    /// generation of the frame the block belong to
+    uint64    generation = 0;
+    uintptr_t cursor = 0;
+    uintptr_t end = 0;
+};
+
+/// a thread keep one block for this many allocators at once, more share the slots and waste blocks
+constexpr uint32 ThreadSlotCount = 8;
+/// allocations beyond this take their own range, the block of the thread is kept
+constexpr size_t LargeAllocationSize = FrameAllocator::ThreadBlockSize / 4;
+
+thread_local ThreadBlock tl_blocks[ThreadSlotCount];
+
+std::atomic<uint64> g_nextGeneration{1};
+std::atomic<uint32> g_nextSlot{0};
+
+FORCEINLINE uintptr_t AlignUp(uintptr_t address, size_t alignment)
+{
+    return (address + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1);
+}
+} // namespace
+
+FrameAllocator::FrameAllocator(size_t frameCapacity, uint32 frameCount)
+    : m_frames{new Frame[std::max(frameCount, 1u)]},
+      m_frameCapacity{RoundUp64(frameCapacity, VirtualMemory::HugePageSize)},
+      m_frameCount{std::max(frameCount, 1u)},
+      m_slot{g_nextSlot.fetch_add(1, std::memory_order_relaxed) % ThreadSlotCount}
+{
+    m_generation.store(g_nextGeneration.fetch_add(1, std::memory_order_relaxed), std::memory_order_relaxed);
+
+    // the os only align the reservation to its granularity, reserve a huge page more to align the frames on one
+    const size_t framesSize = m_frameCapacity * m_frameCount;
+    m_reservedSize = framesSize + VirtualMemory::HugePageSize;
+    m_reservation = static_cast<char *>(VirtualMemory::Reserve(m_reservedSize));
+    if (m_reservation == nullptr)
+    {
+        // every frame stay empty, Allocate return nullptr
+        m_frameCapacity = 0;
+        m_reservedSize = 0;
+        return;
+    }
+    char *base =
+        reinterpret_cast<char *>(RoundUp64(reinterpret_cast<uintptr_t>(m_reservation), VirtualMemory::HugePageSize));
+    VirtualMemory::AdviseHugePages(base, framesSize);
+    for (uint32 i = 0; i < m_frameCount; ++i)
+        m_frames[i].base = base + m_frameCapacity * i;
+}
+
+FrameAllocator::~FrameAllocator()
+{
+    VirtualMemory::Release(m_reservation, m_reservedSize);
+}
+
+uint32 FrameAllocator::BeginFrame()
+{
+    // the blocks of the threads still point in the frame, the new generation stale them
+    m_frameIndex = (m_frameIndex + 1) % m_frameCount;
+    m_frames[m_frameIndex].used.store(0, std::memory_order_relaxed);
+    m_generation.store(g_nextGeneration.fetch_add(1, std::memory_order_relaxed), std::memory_order_relaxed);
+    return m_frameIndex;
+}
+
+void *FrameAllocator::Allocate(size_t size, size_t alignment)
+{
+    ThreadBlock &block = tl_blocks[m_slot];
+    const uint64 generation = m_generation.load(std::memory_order_relaxed);
+    if (block.generation == generation)
+    {
+        const uintptr_t address = AlignUp(block.cursor, alignment);
+        if (address <= block.end && block.end - address >= size)
+        {
+            block.cursor = address + size;
+            return reinterpret_cast<void *>(address);
+        }
+    }
+
+    if (size + alignment > LargeAllocationSize)
+    {
+        char *range = TakeRange(size + alignment - 1);
+        return range != nullptr ? reinterpret_cast<void *>(AlignUp(reinterpret_cast<uintptr_t>(range), alignment))
+                                : nullptr;
+    }
+
+    // the rest of the full block is lost until the frame is begun again
+    char *range = TakeRange(ThreadBlockSize);
+    if (range == nullptr)
+        return nullptr;
+    const uintptr_t address = AlignUp(reinterpret_cast<uintptr_t>(range), alignment);
+    block.generation = generation;
+    block.cursor = address + size;
+    block.end = reinterpret_cast<uintptr_t>(range) + ThreadBlockSize;
+    return reinterpret_cast<void *>(address);
+}
+
+char *FrameAllocator::TakeRange(size_t size)
+{
+    Frame       &frame = m_frames[m_frameIndex];
+    const size_t offset = frame.used.fetch_add(size, std::memory_order_relaxed);
+    const size_t end = offset + size;
+    if (end > m_frameCapacity)
+    {
+        // the frame stay full until reset, log the first overflow only
+        if (offset <= m_frameCapacity)
+            Logger::error("FrameAllocator: frame {} is full, {} bytes.", m_frameIndex, m_frameCapacity);
+        return nullptr;
+    }
+
+    if (end > frame.committed.load(std::memory_order_acquire))
+    {
+        std::lock_guard<std::mutex> lock(m_commitMutex);
+        const size_t committed = frame.committed.load(std::memory_order_relaxed);
+        if (end > committed)
+        {
+            const size_t commitEnd = std::min<size_t>(RoundUp64(end, CommitSize), m_frameCapacity);
+            if (!VirtualMemory::Commit(frame.base + committed, commitEnd - committed))
+                return nullptr;
+            frame.committed.store(commitEnd, std::memory_order_release);
+        }
+    }
+    return frame.base + offset;
+}
+} // namespace Hawl
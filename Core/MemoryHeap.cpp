@@ -0,0 +1,273 @@
+/**
+ *  Copyright 2020-2021 Zhang QiuLiang (juteman). All rights reserved.
+ *
+ *  This file is a part of Hawl
+ *  see(https://github.com/juteman/Hawl)
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#include "Memory/MemoryHeap.h"
+#include "Logger.h"
+#include <algorithm>
+#include <atomic>
+#include <mimalloc.h>
+#include <mutex>
+#include <shared_mutex>
+#include <utility>
+#include <vector>
+
+namespace Hawl
+{
+namespace
+{
+constexpr uint32 HeapCount = static_cast<uint32>(MemoryTag::Count);
+
+/// live blocks of one thread heap, taken out of the stats at once when the heap is destroyed
+struct alignas(CacheLineSize) HeapRecord
+{
+    /// written under the lock of the tag, read by the owner thread without it
+    mi_heap_t          *heap = nullptr;
+    bool                registered = false;
+    std::atomic<int64>  liveBytes{0};
+    std::atomic<int64>  liveCount{0};
+    std::atomic<uint64> allocationCount{0};
+};
+
+struct HeapCounters
+{
+    /// readers free blocks of another thread heap, writers create, destroy or retire one
+    std::shared_mutex         mutex;
+    std::vector<HeapRecord *> records;
+    /// the blocks of the heaps of exited threads, merged in the default heap
+    std::atomic<int64>        retiredBytes{0};
+    std::atomic<int64>        retiredCount{0};
+    std::atomic<uint64>       retiredAllocationCount{0};
+    std::atomic<uint64>       destroyCount{0};
+};
+
+HeapCounters g_counters[HeapCount];
+
+/// set once the heaps of the thread are gone, a later thread_local destructor allocate from the
+/// default heap and its blocks are counted as retired
+thread_local bool tl_heapsReleased = false;
+
+/// the heaps of a thread, created on first use
+struct ThreadHeaps
+{
+    HeapRecord records[HeapCount];
+
+    /// a heap of an exiting thread is merged in the default heap, its blocks stay valid and its counts are retired
+    ~ThreadHeaps()
+    {
+        for (uint32 i = 0; i < HeapCount; ++i)
+        {
+            HeapRecord &record = records[i];
+            if (!record.registered)
+                continue;
+            HeapCounters &counters = g_counters[i];
+            {
+                std::unique_lock<std::shared_mutex> lock(counters.mutex);
+                counters.records.erase(std::find(counters.records.begin(), counters.records.end(), &record));
+                counters.retiredBytes.fetch_add(record.liveBytes.load(std::memory_order_relaxed),
+                                                std::memory_order_relaxed);
+                counters.retiredCount.fetch_add(record.liveCount.load(std::memory_order_relaxed),
+                                                std::memory_order_relaxed);
+                counters.retiredAllocationCount.fetch_add(record.allocationCount.load(std::memory_order_relaxed),
+                                                          std::memory_order_relaxed);
+            }
+            if (record.heap != nullptr)
+                mi_heap_delete(std::exchange(record.heap, nullptr));
+        }
+        tl_heapsReleased = true;
+    }
+};
+
+thread_local ThreadHeaps tl_heaps;
+
+FORCEINLINE uint32 IndexOf(MemoryTag tag)
+{
+    return static_cast<uint32>(tag);
+}
+
+FORCEINLINE HeapRecord &GetThreadRecord(MemoryTag tag)
+{
+    HeapRecord &record = tl_heaps.records[IndexOf(tag)];
+    if (record.heap == nullptr) [[unlikely]]
+    {
+        mi_heap_t                          *heap = mi_heap_new();
+        HeapCounters                       &counters = g_counters[IndexOf(tag)];
+        std::unique_lock<std::shared_mutex> lock(counters.mutex);
+        record.heap = heap;
+        if (!record.registered)
+        {
+            counters.records.push_back(&record);
+            record.registered = true;
+        }
+    }
+    return record;
+}
+
+FORCEINLINE void CountAllocation(MemoryTag tag, HeapRecord &record, void *block)
+{
+    const size_t size = mi_usable_size(block);
+    record.liveBytes.fetch_add(static_cast<int64>(size), std::memory_order_relaxed);
+    record.liveCount.fetch_add(1, std::memory_order_relaxed);
+    record.allocationCount.fetch_add(1, std::memory_order_relaxed);
+    MemoryTracker::OnAllocate(block, size, tag);
+}
+
+/// a block of the default heap, allocated after the heaps of the thread were released
+NOINLINE void CountRetiredAllocation(MemoryTag tag, void *block)
+{
+    const size_t  size = mi_usable_size(block);
+    HeapCounters &counters = g_counters[IndexOf(tag)];
+    counters.retiredBytes.fetch_add(static_cast<int64>(size), std::memory_order_relaxed);
+    counters.retiredCount.fetch_add(1, std::memory_order_relaxed);
+    counters.retiredAllocationCount.fetch_add(1, std::memory_order_relaxed);
+    MemoryTracker::OnAllocate(block, size, tag);
+}
+
+FORCEINLINE void CountFree(HeapRecord &record, int64 bytes)
+{
+    record.liveBytes.fetch_sub(bytes, std::memory_order_relaxed);
+    record.liveCount.fetch_sub(1, std::memory_order_relaxed);
+}
+
+/// a block of another thread heap, or of an exited thread
+void CountForeignFree(MemoryTag tag, const void *block, int64 bytes)
+{
+    HeapCounters                       &counters = g_counters[IndexOf(tag)];
+    std::shared_lock<std::shared_mutex> lock(counters.mutex);
+    for (HeapRecord *record : counters.records)
+    {
+        if (record->heap != nullptr && mi_heap_contains_block(record->heap, block))
+        {
+            CountFree(*record, bytes);
+            return;
+        }
+    }
+    counters.retiredBytes.fetch_sub(bytes, std::memory_order_relaxed);
+    counters.retiredCount.fetch_sub(1, std::memory_order_relaxed);
+}
+
+bool IsHeapBlock(const void *block, void *heap)
+{
+    return mi_heap_contains_block(static_cast<mi_heap_t *>(heap), block);
+}
+} // namespace
+
+void *MemoryHeap::Allocate(MemoryTag tag, size_t size, size_t alignment, size_t offset)
+{
+    if (tl_heapsReleased) [[unlikely]]
+    {
+        void *block = mi_malloc_aligned_at(size, alignment, offset);
+        if (block != nullptr)
+            CountRetiredAllocation(tag, block);
+        return block;
+    }
+    HeapRecord &record = GetThreadRecord(tag);
+    void       *block = mi_heap_malloc_aligned_at(record.heap, size, alignment, offset);
+    if (block != nullptr) [[likely]]
+        CountAllocation(tag, record, block);
+    return block;
+}
+
+void *MemoryHeap::Calloc(MemoryTag tag, size_t count, size_t size, size_t alignment)
+{
+    if (tl_heapsReleased) [[unlikely]]
+    {
+        void *block = mi_calloc_aligned(count, size, alignment);
+        if (block != nullptr)
+            CountRetiredAllocation(tag, block);
+        return block;
+    }
+    HeapRecord &record = GetThreadRecord(tag);
+    void       *block = mi_heap_calloc_aligned(record.heap, count, size, alignment);
+    if (block != nullptr) [[likely]]
+        CountAllocation(tag, record, block);
+    return block;
+}
+
+void MemoryHeap::Free(MemoryTag tag, void *block)
+{
+    if (block == nullptr)
+        return;
+    const size_t size = mi_usable_size(block);
+    HeapRecord  &record = tl_heaps.records[IndexOf(tag)];
+    if (record.heap != nullptr && mi_heap_contains_block(record.heap, block)) [[likely]]
+        CountFree(record, static_cast<int64>(size));
+    else
+        CountForeignFree(tag, block, static_cast<int64>(size));
+    MemoryTracker::OnFree(block, size, tag);
+    mi_free(block);
+}
+
+void MemoryHeap::Destroy(MemoryTag tag)
+{
+    if (tl_heapsReleased)
+        return;
+    HeapRecord &record = tl_heaps.records[IndexOf(tag)];
+    if (record.heap == nullptr)
+        return;
+
+    // the frees of the other threads already found the record, what is left are the live blocks
+    HeapCounters &counters = g_counters[IndexOf(tag)];
+    mi_heap_t    *heap;
+    int64         liveBytes;
+    int64         liveCount;
+    {
+        std::unique_lock<std::shared_mutex> lock(counters.mutex);
+        heap = std::exchange(record.heap, nullptr);
+        liveBytes = record.liveBytes.exchange(0, std::memory_order_relaxed);
+        liveCount = record.liveCount.exchange(0, std::memory_order_relaxed);
+    }
+    counters.destroyCount.fetch_add(1, std::memory_order_relaxed);
+    MemoryTracker::OnFreeBulk(static_cast<size_t>(liveBytes), static_cast<uint64>(liveCount), tag, &IsHeapBlock, heap);
+    mi_heap_destroy(heap);
+}
+
+HeapStats MemoryHeap::GetStats(MemoryTag tag)
+{
+    HeapCounters                       &counters = g_counters[IndexOf(tag)];
+    HeapStats                           stats;
+    std::shared_lock<std::shared_mutex> lock(counters.mutex);
+    for (const HeapRecord *record : counters.records)
+    {
+        stats.liveBytes += record->liveBytes.load(std::memory_order_relaxed);
+        stats.liveCount += record->liveCount.load(std::memory_order_relaxed);
+        stats.allocationCount += record->allocationCount.load(std::memory_order_relaxed);
+    }
+    stats.liveBytes += counters.retiredBytes.load(std::memory_order_relaxed);
+    stats.liveCount += counters.retiredCount.load(std::memory_order_relaxed);
+    stats.allocationCount += counters.retiredAllocationCount.load(std::memory_order_relaxed);
+    stats.destroyCount = counters.destroyCount.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void MemoryHeap::LogStats()
+{
+    for (uint32 i = 0; i < HeapCount; ++i)
+    {
+        const MemoryTag tag = static_cast<MemoryTag>(i);
+        const HeapStats stats = GetStats(tag);
+        Logger::info("MemoryHeap {}: {} bytes in {} blocks, {} allocations, {} destroys",
+                     MemoryTracker::GetTagName(tag),
+                     stats.liveBytes,
+                     stats.liveCount,
+                     stats.allocationCount,
+                     stats.destroyCount);
+    }
+}
+} // namespace Hawl
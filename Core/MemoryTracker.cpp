@@ -0,0 +1,514 @@
+/**
+ *  Copyright 2020-2021 Zhang QiuLiang (juteman). All rights reserved.
+ *
+ *  This file is a part of Hawl
+ *  see(https://github.com/juteman/Hawl)
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#include "Memory/MemoryTracker.h"
+#include "Logger.h"
+#if HAWL_MEMORY_TRACKING
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#if HAWL_MEMORY_LEAK_REPORT
+#include <unordered_map>
+#if defined(HAWL_STACKTRACE_DUMP)
+#if defined(_WIN32)
+#include <Windows.h>
+#include <DbgHelp.h>
+#pragma comment(lib, "Dbghelp.lib")
+#else
+#include <cstdlib>
+#include <execinfo.h>
+#endif
+#endif
+#endif
+#endif
+
+namespace Hawl
+{
+namespace
+{
+constexpr uint32 TagCount = static_cast<uint32>(MemoryTag::Count);
+} // namespace
+
+const char *MemoryTracker::GetTagName(MemoryTag tag)
+{
+    static constexpr const char *Names[TagCount] = {"Untagged", "Core", "Renderer", "Assets", "Logging"};
+    return static_cast<uint32>(tag) < TagCount ? Names[static_cast<uint32>(tag)] : "Unknown";
+}
+
+#if HAWL_MEMORY_TRACKING
+namespace
+{
+struct TagCounters
+{
+    std::atomic<int64> liveCount{0};
+#if HAWL_MEMORY_LEAK_REPORT
+    /// for the rates, counted in the debug builds only
+    std::atomic<uint64> allocationCount{0};
+    std::atomic<uint64> allocatedBytes{0};
+#endif
+};
+
+/// counters of one thread, written by it alone
+struct alignas(CacheLineSize) ThreadCounters
+{
+    TagCounters tags[TagCount];
+    /// all the counters ever created, push only
+    ThreadCounters   *next = nullptr;
+    /// a thread exiting give its counters to the next thread starting, the sums do not move
+    std::atomic<bool> owned{true};
+};
+
+/// live bytes of a tag, shared so the peak is the exact high-water mark and not a sample
+struct alignas(CacheLineSize) TagLive
+{
+    std::atomic<int64> bytes{0};
+    std::atomic<int64> peakBytes{0};
+};
+
+/// plain values of TagCounters
+struct TagTotal
+{
+    int64 liveCount = 0;
+#if HAWL_MEMORY_LEAK_REPORT
+    uint64 allocationCount = 0;
+    uint64 allocatedBytes = 0;
+#endif
+};
+
+#if HAWL_MEMORY_LEAK_REPORT
+constexpr uint32 RecordShardCount = 64;
+/// leaks listed one by one, the rest is counted
+constexpr uint32 MaxReportedLeaks = 64;
+#if defined(HAWL_STACKTRACE_DUMP)
+constexpr uint32 MaxFrames = 16;
+#if defined(_WIN32)
+constexpr uint32 MaxSymbolName = 256;
+#endif
+#endif
+
+struct Record
+{
+    size_t    size = 0;
+    MemoryTag tag = MemoryTag::Untagged;
+#if defined(HAWL_STACKTRACE_DUMP)
+    uint32 frameCount = 0;
+    void  *frames[MaxFrames];
+#endif
+};
+
+struct alignas(CacheLineSize) RecordShard
+{
+    std::mutex                                mutex;
+    std::unordered_map<const void *, Record> records;
+};
+#endif
+
+struct Tracker
+{
+    std::atomic<ThreadCounters *> counters{nullptr};
+    /// counted with read-modify-write by the threads whose counters are already released
+    ThreadCounters                exited;
+    TagLive                       live[TagCount];
+
+    /// the samples of Update
+    std::mutex                            sampleMutex;
+    TagTotal                              lastTotals[TagCount];
+    double                                allocationsPerSecond[TagCount] = {};
+    double                                bytesPerSecond[TagCount] = {};
+    std::chrono::steady_clock::time_point lastUpdate;
+    bool                                  updated = false;
+
+#if HAWL_MEMORY_LEAK_REPORT
+    RecordShard recordShards[RecordShardCount];
+#endif
+};
+
+/// never destroyed, blocks may be freed during static destruction
+Tracker &GetTracker()
+{
+    static Tracker *tracker = new Tracker();
+    return *tracker;
+}
+
+/// trivially destructible, so reading them costs no initialization check and they stay valid until the thread ends
+thread_local ThreadCounters *tl_counters = nullptr;
+thread_local bool            tl_countersReleased = false;
+thread_local MemoryTag       tl_tag = MemoryTag::Untagged;
+
+/// give the counters of an exiting thread back, created only when the thread take counters
+struct ThreadSlot
+{
+    ~ThreadSlot()
+    {
+        if (tl_counters != nullptr)
+            tl_counters->owned.store(false, std::memory_order_release);
+        tl_counters = nullptr;
+        tl_countersReleased = true;
+    }
+};
+
+thread_local ThreadSlot tl_slot;
+
+ThreadCounters *AcquireCounters()
+{
+    Tracker &tracker = GetTracker();
+    for (ThreadCounters *counters = tracker.counters.load(std::memory_order_acquire); counters != nullptr;
+         counters = counters->next)
+    {
+        bool owned = counters->owned.load(std::memory_order_relaxed);
+        if (!owned && counters->owned.compare_exchange_strong(owned, true, std::memory_order_acquire))
+            return counters;
+    }
+
+    auto           *counters = new ThreadCounters();
+    ThreadCounters *head = tracker.counters.load(std::memory_order_relaxed);
+    do
+        counters->next = head;
+    while (!tracker.counters.compare_exchange_weak(head, counters, std::memory_order_release, std::memory_order_relaxed));
+    return counters;
+}
+
+/// single writer add, the owner thread only
+template <typename T>
+FORCEINLINE void Bump(std::atomic<T> &counter, T delta)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+}
+
+FORCEINLINE void CountLive(MemoryTag tag, int64 bytes)
+{
+    TagLive    &live = GetTracker().live[static_cast<uint32>(tag)];
+    const int64 liveBytes = live.bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    if (bytes <= 0)
+        return;
+    int64 peak = live.peakBytes.load(std::memory_order_relaxed);
+    while (liveBytes > peak &&
+           !live.peakBytes.compare_exchange_weak(peak, liveBytes, std::memory_order_relaxed, std::memory_order_relaxed))
+    {
+    }
+}
+
+/// a thread whose counters are released, count in the shared ones
+NOINLINE void CountExited(MemoryTag tag, [[maybe_unused]] int64 bytes, int64 count)
+{
+    TagCounters &shared = GetTracker().exited.tags[static_cast<uint32>(tag)];
+    shared.liveCount.fetch_add(count, std::memory_order_relaxed);
+#if HAWL_MEMORY_LEAK_REPORT
+    if (count > 0)
+    {
+        shared.allocationCount.fetch_add(1, std::memory_order_relaxed);
+        shared.allocatedBytes.fetch_add(static_cast<uint64>(bytes), std::memory_order_relaxed);
+    }
+#endif
+}
+
+/// the only shared write is the live bytes, the rest goes to the line of the thread
+FORCEINLINE void Count(MemoryTag tag, int64 bytes, int64 count)
+{
+    CountLive(tag, bytes);
+    ThreadCounters *counters = tl_counters;
+    if (counters == nullptr) [[unlikely]]
+    {
+        if (tl_countersReleased)
+        {
+            CountExited(tag, bytes, count);
+            return;
+        }
+        // touching tl_slot register its destructor
+        static_cast<void>(&tl_slot);
+        counters = tl_counters = AcquireCounters();
+    }
+
+    TagCounters &tagCounters = counters->tags[static_cast<uint32>(tag)];
+    Bump(tagCounters.liveCount, count);
+#if HAWL_MEMORY_LEAK_REPORT
+    if (count > 0)
+    {
+        Bump(tagCounters.allocationCount, uint64(1));
+        Bump(tagCounters.allocatedBytes, static_cast<uint64>(bytes));
+    }
+#endif
+}
+
+void AddTotal(TagTotal &total, const TagCounters &counters)
+{
+    total.liveCount += counters.liveCount.load(std::memory_order_relaxed);
+#if HAWL_MEMORY_LEAK_REPORT
+    total.allocationCount += counters.allocationCount.load(std::memory_order_relaxed);
+    total.allocatedBytes += counters.allocatedBytes.load(std::memory_order_relaxed);
+#endif
+}
+
+TagTotal SumTag(MemoryTag tag)
+{
+    Tracker &tracker = GetTracker();
+    TagTotal total;
+    for (ThreadCounters *counters = tracker.counters.load(std::memory_order_acquire); counters != nullptr;
+         counters = counters->next)
+        AddTotal(total, counters->tags[static_cast<uint32>(tag)]);
+    AddTotal(total, tracker.exited.tags[static_cast<uint32>(tag)]);
+    return total;
+}
+
+#if HAWL_MEMORY_LEAK_REPORT
+RecordShard &ShardOf(const void *block)
+{
+    // blocks are at least 8 bytes aligned, mix the bits above
+    const uint64 hash = (reinterpret_cast<uintptr_t>(block) >> 3) * 0x9E3779B97F4A7C15ull;
+    return GetTracker().recordShards[hash >> 58];
+}
+
+void LogStack([[maybe_unused]] const Record &record)
+{
+#if defined(HAWL_STACKTRACE_DUMP)
+#if defined(_WIN32)
+    // DbgHelp is single threaded, the symbols of the process are loaded on the first leak
+    static std::mutex symbolMutex;
+    std::lock_guard<std::mutex> lock(symbolMutex);
+    const HANDLE      process = GetCurrentProcess();
+    static const bool symbolsLoaded = [process] {
+        SymSetOptions(SYMOPT_UNDNAME | SYMOPT_DEFERRED_LOADS | SYMOPT_LOAD_LINES);
+        return SymInitialize(process, nullptr, TRUE) != FALSE;
+    }();
+
+    alignas(SYMBOL_INFO) char buffer[sizeof(SYMBOL_INFO) + MaxSymbolName];
+    auto                     *symbol = reinterpret_cast<SYMBOL_INFO *>(buffer);
+    for (uint32 i = 0; i < record.frameCount; ++i)
+    {
+        const DWORD64 address = reinterpret_cast<DWORD64>(record.frames[i]);
+        DWORD64       displacement = 0;
+        symbol->SizeOfStruct = sizeof(SYMBOL_INFO);
+        symbol->MaxNameLen = MaxSymbolName;
+        if (!symbolsLoaded || !SymFromAddr(process, address, &displacement, symbol))
+        {
+            Logger::warn("        {}", record.frames[i]);
+            continue;
+        }
+        IMAGEHLP_LINE64 line = {};
+        line.SizeOfStruct = sizeof(IMAGEHLP_LINE64);
+        DWORD lineDisplacement = 0;
+        if (SymGetLineFromAddr64(process, address, &lineDisplacement, &line))
+            Logger::warn("        {}+{:#x} {}:{}",
+                         static_cast<const char *>(symbol->Name),
+                         displacement,
+                         line.FileName,
+                         line.LineNumber);
+        else
+            Logger::warn("        {}+{:#x}", static_cast<const char *>(symbol->Name), displacement);
+    }
+#else
+    char **symbols = backtrace_symbols(record.frames, static_cast<int>(record.frameCount));
+    for (uint32 i = 0; i < record.frameCount; ++i)
+        Logger::warn("        {}", symbols != nullptr ? symbols[i] : "?");
+    std::free(symbols);
+#endif
+#endif
+}
+#endif
+} // namespace
+
+void MemoryTracker::OnAllocate(void *block, size_t size)
+{
+    OnAllocate(block, size, tl_tag);
+}
+
+void MemoryTracker::OnAllocate([[maybe_unused]] void *block, size_t size, MemoryTag tag)
+{
+    Count(tag, static_cast<int64>(size), 1);
+
+#if HAWL_MEMORY_LEAK_REPORT
+    Record record;
+    record.size = size;
+    record.tag = tag;
+#if defined(HAWL_STACKTRACE_DUMP)
+#if defined(_WIN32)
+    record.frameCount = CaptureStackBackTrace(1, MaxFrames, record.frames, nullptr);
+#else
+    record.frameCount = static_cast<uint32>(backtrace(record.frames, MaxFrames));
+#endif
+#endif
+    RecordShard &shard = ShardOf(block);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.records[block] = record;
+#endif
+}
+
+void MemoryTracker::OnFree([[maybe_unused]] void *block, size_t size, MemoryTag tag)
+{
+    Count(tag, -static_cast<int64>(size), -1);
+
+#if HAWL_MEMORY_LEAK_REPORT
+    RecordShard &shard = ShardOf(block);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    const auto   found = shard.records.find(block);
+    if (found == shard.records.end())
+    {
+        Logger::error("MemoryTracker: free of {} which is not a tracked allocation", block);
+        return;
+    }
+    if (found->second.size != size || found->second.tag != tag)
+        Logger::error("MemoryTracker: {} allocated as {} bytes of {}, freed as {} bytes of {}",
+                      block,
+                      found->second.size,
+                      GetTagName(found->second.tag),
+                      size,
+                      GetTagName(tag));
+    shard.records.erase(found);
+#endif
+}
+
+void MemoryTracker::OnFreeBulk(size_t size,
+                               uint64 count,
+                               MemoryTag tag,
+                               [[maybe_unused]] bool (*isReleased)(const void *block, void *context),
+                               [[maybe_unused]] void *context)
+{
+    if (count == 0)
+        return;
+    Count(tag, -static_cast<int64>(size), -static_cast<int64>(count));
+
+#if HAWL_MEMORY_LEAK_REPORT
+    for (RecordShard &shard : GetTracker().recordShards)
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (auto it = shard.records.begin(); it != shard.records.end();)
+        {
+            if (it->second.tag == tag && isReleased(it->first, context))
+                it = shard.records.erase(it);
+            else
+                ++it;
+        }
+    }
+#endif
+}
+
+MemoryTag MemoryTracker::GetCurrentTag()
+{
+    return tl_tag;
+}
+
+void MemoryTracker::Update()
+{
+#if HAWL_MEMORY_LEAK_REPORT
+    Tracker                    &tracker = GetTracker();
+    std::lock_guard<std::mutex> lock(tracker.sampleMutex);
+    const auto                  now = std::chrono::steady_clock::now();
+    const double                seconds = std::chrono::duration<double>(now - tracker.lastUpdate).count();
+    for (uint32 i = 0; i < TagCount; ++i)
+    {
+        const TagTotal total = SumTag(static_cast<MemoryTag>(i));
+        if (tracker.updated && seconds > 0.0)
+        {
+            tracker.allocationsPerSecond[i] =
+                double(total.allocationCount - tracker.lastTotals[i].allocationCount) / seconds;
+            tracker.bytesPerSecond[i] = double(total.allocatedBytes - tracker.lastTotals[i].allocatedBytes) / seconds;
+        }
+        tracker.lastTotals[i] = total;
+    }
+    tracker.lastUpdate = now;
+    tracker.updated = true;
+#endif
+}
+
+MemoryTagStats MemoryTracker::GetStats(MemoryTag tag)
+{
+    Tracker                    &tracker = GetTracker();
+    const uint32                index = static_cast<uint32>(tag);
+    const TagTotal              total = SumTag(tag);
+    std::lock_guard<std::mutex> lock(tracker.sampleMutex);
+
+    MemoryTagStats stats;
+    stats.liveBytes = tracker.live[index].bytes.load(std::memory_order_relaxed);
+    stats.liveCount = total.liveCount;
+    stats.peakBytes = tracker.live[index].peakBytes.load(std::memory_order_relaxed);
+#if HAWL_MEMORY_LEAK_REPORT
+    stats.allocationCount = total.allocationCount;
+#endif
+    stats.allocationsPerSecond = tracker.allocationsPerSecond[index];
+    stats.bytesPerSecond = tracker.bytesPerSecond[index];
+    return stats;
+}
+
+void MemoryTracker::LogStats()
+{
+    for (uint32 i = 0; i < TagCount; ++i)
+    {
+        const MemoryTag      tag = static_cast<MemoryTag>(i);
+        const MemoryTagStats stats = GetStats(tag);
+        Logger::info("Memory {}: {} bytes in {} allocations, peak {} bytes, {:.0f} allocations/s, {:.0f} bytes/s",
+                     GetTagName(tag),
+                     stats.liveBytes,
+                     stats.liveCount,
+                     stats.peakBytes,
+                     stats.allocationsPerSecond,
+                     stats.bytesPerSecond);
+    }
+}
+
+uint64 MemoryTracker::ReportLeaks()
+{
+    uint64 leakCount = 0;
+    for (uint32 i = 0; i < TagCount; ++i)
+    {
+        const TagTotal total = SumTag(static_cast<MemoryTag>(i));
+        if (total.liveCount == 0)
+            continue;
+        Logger::warn("MemoryTracker: {} still holds {} bytes in {} allocations",
+                     GetTagName(static_cast<MemoryTag>(i)),
+                     GetTracker().live[i].bytes.load(std::memory_order_relaxed),
+                     total.liveCount);
+        leakCount += static_cast<uint64>(std::max<int64>(total.liveCount, 0));
+    }
+
+#if HAWL_MEMORY_LEAK_REPORT
+    uint32 reported = 0;
+    for (RecordShard &shard : GetTracker().recordShards)
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (const auto &[block, record] : shard.records)
+        {
+            if (reported++ >= MaxReportedLeaks)
+                continue;
+            Logger::warn("    leak of {} bytes at {}, {}", record.size, block, GetTagName(record.tag));
+            LogStack(record);
+        }
+    }
+    if (reported > MaxReportedLeaks)
+        Logger::warn("    and {} more", reported - MaxReportedLeaks);
+#endif
+
+    if (leakCount == 0)
+        Logger::info("MemoryTracker: no leak");
+    return leakCount;
+}
+
+MemoryTagScope::MemoryTagScope(MemoryTag tag) : m_previous{tl_tag}
+{
+    tl_tag = tag;
+}
+
+MemoryTagScope::~MemoryTagScope()
+{
+    tl_tag = m_previous;
+}
+#endif
+} // namespace Hawl
@@ -0,0 +1,284 @@
+/**
+ *  Copyright 2020-2021 Zhang QiuLiang (juteman). All rights reserved.
+ *
+ *  This file is a part of Hawl
+ *  see(https://github.com/juteman/Hawl)
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#include "Memory/OffsetAllocator.h"
+#include <algorithm>
+#include <bit>
+
+namespace Hawl
+{
+namespace
+{
+/// sizes as a small float of 3 bits of mantissa, the bin index
+constexpr uint32 MantissaBits = 3;
+constexpr uint32 MantissaValue = 1 << MantissaBits;
+constexpr uint32 MantissaMask = MantissaValue - 1;
+
+/// smallest bin whose ranges all hold size
+uint32 BinRoundUp(uint32 size)
+{
+    if (size < MantissaValue)
+        return size;
+
+    const uint32 highestBit = 31 - static_cast<uint32>(std::countl_zero(size));
+    const uint32 mantissaStart = highestBit - MantissaBits;
+    const uint32 exponent = mantissaStart + 1;
+    uint32       mantissa = (size >> mantissaStart) & MantissaMask;
+    if ((size & ((1u << mantissaStart) - 1)) != 0)
+        ++mantissa;
+    // a mantissa overflow carry into the exponent
+    return (exponent << MantissaBits) + mantissa;
+}
+
+/// bin a range of size belong to
+uint32 BinRoundDown(uint32 size)
+{
+    if (size < MantissaValue)
+        return size;
+
+    const uint32 highestBit = 31 - static_cast<uint32>(std::countl_zero(size));
+    const uint32 mantissaStart = highestBit - MantissaBits;
+    const uint32 exponent = mantissaStart + 1;
+    const uint32 mantissa = (size >> mantissaStart) & MantissaMask;
+    return (exponent << MantissaBits) | mantissa;
+}
+
+/// lowest set bit of mask at or above start, NoSpace if none
+uint32 LowestBitFrom(uint32 mask, uint32 start)
+{
+    const uint32 masked = start < 32 ? mask & ~((1u << start) - 1) : 0;
+    return masked == 0 ? OffsetAllocator::NoSpace : static_cast<uint32>(std::countr_zero(masked));
+}
+} // namespace
+
+OffsetAllocator::OffsetAllocator(uint32 size, uint32 maxAllocations)
+    : m_size{size}, m_maxAllocations{maxAllocations < 2 ? 2 : maxAllocations}
+{
+    Reset();
+}
+
+void OffsetAllocator::Reset()
+{
+    m_freeStorage = 0;
+    m_freeRegionCount = 0;
+    m_allocationCount = 0;
+    m_usedBinsTop = 0;
+    for (auto &usedBins : m_usedBins)
+        usedBins = 0;
+    for (auto &head : m_binHeads)
+        head = Unused;
+
+    m_nodes = std::make_unique<Node[]>(m_maxAllocations);
+    m_freeNodes = std::make_unique<uint32[]>(m_maxAllocations);
+    // popped from the top, node 0 first
+    for (uint32 i = 0; i < m_maxAllocations; ++i)
+        m_freeNodes[i] = m_maxAllocations - i - 1;
+    m_freeNodeCount = m_maxAllocations;
+
+    if (m_size > 0)
+        InsertFree(0, m_size);
+}
+
+OffsetAllocator::Allocation OffsetAllocator::Allocate(uint32 size, uint32 alignment)
+{
+    // the remainder and the alignment padding may each take a node
+    if (m_freeNodeCount < 2 || size == 0)
+        return {};
+
+    // room for the worst padding
+    const uint64 searchSize = uint64(size) + (alignment > 1 ? alignment - 1 : 0);
+    if (searchSize > m_freeStorage)
+        return {};
+
+    const uint32 minBin = BinRoundUp(static_cast<uint32>(searchSize));
+    const uint32 minTopBin = minBin >> TopBinShift;
+    uint32       topBin = minTopBin;
+    uint32       leafBin = NoSpace;
+    if (m_usedBinsTop & (1u << topBin))
+        leafBin = LowestBitFrom(m_usedBins[topBin], minBin & LeafBinMask);
+    if (leafBin == NoSpace)
+    {
+        topBin = LowestBitFrom(m_usedBinsTop, minTopBin + 1);
+        if (topBin == NoSpace)
+            return {};
+        leafBin = static_cast<uint32>(std::countr_zero(uint32(m_usedBins[topBin])));
+    }
+
+    // the node of the free range become the allocation, the padding and the rest new free ranges around it
+    const uint32 nodeIndex = m_binHeads[(topBin << TopBinShift) | leafBin];
+    UnlinkFree(nodeIndex);
+    Node        &node = m_nodes[nodeIndex];
+    const uint32 rangeOffset = node.offset;
+    const uint32 rangeSize = node.size;
+    const uint32 alignedOffset = alignment > 1 ? static_cast<uint32>(RoundUp64(rangeOffset, alignment)) : rangeOffset;
+    const uint32 padding = alignedOffset - rangeOffset;
+    const uint32 remainder = rangeSize - padding - size;
+    node.offset = alignedOffset;
+    node.size = size;
+    node.used = true;
+
+    if (padding > 0)
+    {
+        const uint32 paddingIndex = InsertFree(rangeOffset, padding);
+        Node        &paddingNode = m_nodes[paddingIndex];
+        paddingNode.neighborPrevious = node.neighborPrevious;
+        paddingNode.neighborNext = nodeIndex;
+        if (node.neighborPrevious != Unused)
+            m_nodes[node.neighborPrevious].neighborNext = paddingIndex;
+        node.neighborPrevious = paddingIndex;
+    }
+    if (remainder > 0)
+    {
+        const uint32 remainderIndex = InsertFree(alignedOffset + size, remainder);
+        Node        &remainderNode = m_nodes[remainderIndex];
+        remainderNode.neighborPrevious = nodeIndex;
+        remainderNode.neighborNext = node.neighborNext;
+        if (node.neighborNext != Unused)
+            m_nodes[node.neighborNext].neighborPrevious = remainderIndex;
+        node.neighborNext = remainderIndex;
+    }
+
+    ++m_allocationCount;
+    return {alignedOffset, nodeIndex};
+}
+
+void OffsetAllocator::Free(Allocation allocation)
+{
+    if (allocation.metadata == NoSpace)
+        return;
+
+    // the node of the allocation become the free range, merged with its free neighbors
+    const uint32 nodeIndex = allocation.metadata;
+    Node        &node = m_nodes[nodeIndex];
+    uint32       previous = node.neighborPrevious;
+    uint32       next = node.neighborNext;
+    if (previous != Unused && !m_nodes[previous].used)
+    {
+        UnlinkFree(previous);
+        node.offset = m_nodes[previous].offset;
+        node.size += m_nodes[previous].size;
+        const uint32 beforePrevious = m_nodes[previous].neighborPrevious;
+        ReleaseNode(previous);
+        previous = beforePrevious;
+    }
+    if (next != Unused && !m_nodes[next].used)
+    {
+        UnlinkFree(next);
+        node.size += m_nodes[next].size;
+        const uint32 afterNext = m_nodes[next].neighborNext;
+        ReleaseNode(next);
+        next = afterNext;
+    }
+
+    node.used = false;
+    node.neighborPrevious = previous;
+    node.neighborNext = next;
+    if (previous != Unused)
+        m_nodes[previous].neighborNext = nodeIndex;
+    if (next != Unused)
+        m_nodes[next].neighborPrevious = nodeIndex;
+    LinkFree(nodeIndex);
+    --m_allocationCount;
+}
+
+uint32 OffsetAllocator::GetAllocationSize(Allocation allocation) const
+{
+    return allocation.metadata == NoSpace ? 0 : m_nodes[allocation.metadata].size;
+}
+
+OffsetAllocatorStats OffsetAllocator::GetStats() const
+{
+    OffsetAllocatorStats stats;
+    stats.totalFree = m_freeStorage;
+    stats.freeRegionCount = m_freeRegionCount;
+    stats.allocationCount = m_allocationCount;
+    if (m_usedBinsTop != 0)
+    {
+        // the ranges of the highest bin differ by up to 12.5%, look at all of them
+        const uint32 topBin = 31 - static_cast<uint32>(std::countl_zero(m_usedBinsTop));
+        const uint32 leafBin = 31 - static_cast<uint32>(std::countl_zero(uint32(m_usedBins[topBin])));
+        for (uint32 i = m_binHeads[(topBin << TopBinShift) | leafBin]; i != Unused; i = m_nodes[i].binNext)
+            stats.largestFree = std::max(stats.largestFree, m_nodes[i].size);
+    }
+    return stats;
+}
+
+uint32 OffsetAllocator::NewNode()
+{
+    return m_freeNodes[--m_freeNodeCount];
+}
+
+void OffsetAllocator::ReleaseNode(uint32 nodeIndex)
+{
+    m_freeNodes[m_freeNodeCount++] = nodeIndex;
+}
+
+uint32 OffsetAllocator::InsertFree(uint32 offset, uint32 size)
+{
+    const uint32 nodeIndex = NewNode();
+    Node        &node = m_nodes[nodeIndex];
+    node = Node();
+    node.offset = offset;
+    node.size = size;
+    LinkFree(nodeIndex);
+    return nodeIndex;
+}
+
+void OffsetAllocator::LinkFree(uint32 nodeIndex)
+{
+    Node        &node = m_nodes[nodeIndex];
+    const uint32 bin = BinRoundDown(node.size);
+    const uint32 topBin = bin >> TopBinShift;
+    m_usedBinsTop |= 1u << topBin;
+    m_usedBins[topBin] |= static_cast<uint8>(1u << (bin & LeafBinMask));
+
+    node.binPrevious = Unused;
+    node.binNext = m_binHeads[bin];
+    if (node.binNext != Unused)
+        m_nodes[node.binNext].binPrevious = nodeIndex;
+    m_binHeads[bin] = nodeIndex;
+    m_freeStorage += node.size;
+    ++m_freeRegionCount;
+}
+
+void OffsetAllocator::UnlinkFree(uint32 nodeIndex)
+{
+    Node &node = m_nodes[nodeIndex];
+    if (node.binPrevious != Unused)
+        m_nodes[node.binPrevious].binNext = node.binNext;
+    else
+    {
+        const uint32 bin = BinRoundDown(node.size);
+        m_binHeads[bin] = node.binNext;
+        if (node.binNext == Unused)
+        {
+            const uint32 topBin = bin >> TopBinShift;
+            m_usedBins[topBin] &= static_cast<uint8>(~(1u << (bin & LeafBinMask)));
+            if (m_usedBins[topBin] == 0)
+                m_usedBinsTop &= ~(1u << topBin);
+        }
+    }
+    if (node.binNext != Unused)
+        m_nodes[node.binNext].binPrevious = node.binPrevious;
+    node.binPrevious = node.binNext = Unused;
+    m_freeStorage -= node.size;
+    --m_freeRegionCount;
+}
+} // namespace Hawl
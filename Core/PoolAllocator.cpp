@@ -0,0 +1,300 @@
+/**
+ *  Copyright 2020-2021 Zhang QiuLiang (juteman). All rights reserved.
+ *
+ *  This file is a part of Hawl
+ *  see(https://github.com/juteman/Hawl)
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#include "Memory/PoolAllocator.h"
+#include "Algorithm/TaggedStack.h"
+#include "Common.h"
+#include "Logger.h"
+#include <atomic>
+#include <bit>
+#include <cstring>
+#include <utility>
+
+namespace Hawl
+{
+namespace
+{
+struct Magazine
+{
+    /// link in the depot
+    std::atomic<Magazine *> next{nullptr};
+    uint32                  count = 0;
+    void                   *blocks[PoolAllocator::MagazineSize];
+    /// all the magazines ever created, linked only to keep them reachable
+    Magazine *allocatedNext = nullptr;
+};
+
+/// system memory carved into blocks of one size class
+struct Slab
+{
+    static constexpr size_t Size = 64 * 1024 - 64;
+
+    Slab()
+    {
+    }
+
+    Slab *next = nullptr;
+    alignas(PoolAllocator::Granularity) unsigned char bytes[Size];
+};
+
+struct Depot
+{
+    /// magazines holding at least one block
+    Algorithm::TaggedStack<Magazine> full;
+    Algorithm::TaggedStack<Magazine> empty;
+};
+
+/// the magazines and the slabs are never freed, the depot stacks need immortal nodes
+struct Pools
+{
+    Depot depots[PoolAllocator::SizeClassCount];
+
+    /// push only lists, only to keep the memory reachable
+    std::atomic<Slab *>     slabs{nullptr};
+    std::atomic<Magazine *> magazines{nullptr};
+    std::atomic<uint64>     systemAllocations{0};
+};
+
+Pools &GetPools()
+{
+    static Pools *pools = new Pools();
+    return *pools;
+}
+
+struct ThreadCache
+{
+    Magazine *loaded[PoolAllocator::SizeClassCount] = {};
+    Magazine *previous[PoolAllocator::SizeClassCount] = {};
+
+    /// give the magazines back to the depot on thread exit, a later destructor
+    /// of the thread using the pools again only take new magazines
+    ~ThreadCache()
+    {
+        for (uint32 sizeClass = 0; sizeClass < PoolAllocator::SizeClassCount; ++sizeClass)
+        {
+            Return(sizeClass, std::exchange(loaded[sizeClass], nullptr));
+            Return(sizeClass, std::exchange(previous[sizeClass], nullptr));
+        }
+    }
+
+    static void Return(uint32 sizeClass, Magazine *magazine)
+    {
+        if (magazine == nullptr)
+            return;
+        Depot &depot = GetPools().depots[sizeClass];
+        if (magazine->count > 0)
+            depot.full.Push(magazine);
+        else
+            depot.empty.Push(magazine);
+    }
+};
+
+thread_local ThreadCache tl_cache;
+
+#if HAWL_POOL_POISON
+constexpr unsigned char PoisonByte = 0xDD;
+#endif
+
+constexpr uint32 SmallClassCount = PoolAllocator::SmallPooledSize / PoolAllocator::Granularity;
+
+FORCEINLINE uint32 SizeClassOf(size_t size)
+{
+    if (size <= PoolAllocator::Granularity)
+        return 0;
+    if (size <= PoolAllocator::SmallPooledSize)
+        return static_cast<uint32>((size - 1) / PoolAllocator::Granularity);
+    // 512 is the first power of two class
+    return SmallClassCount + static_cast<uint32>(std::bit_width(size - 1)) - 9;
+}
+
+FORCEINLINE size_t BlockSizeOf(uint32 sizeClass)
+{
+    if (sizeClass < SmallClassCount)
+        return (sizeClass + 1) * PoolAllocator::Granularity;
+    return PoolAllocator::SmallPooledSize << (sizeClass - SmallClassCount + 1);
+}
+
+/// push only list of system memory, never popped so it is free of ABA
+template <typename U>
+void PushAllocated(std::atomic<U *> &head, U *object, U *U::*next)
+{
+    Pools &pools = GetPools();
+    pools.systemAllocations.fetch_add(1, std::memory_order_relaxed);
+    U *oldHead = head.load(std::memory_order_relaxed);
+    do
+    {
+        object->*next = oldHead;
+    } while (!head.compare_exchange_weak(oldHead, object, std::memory_order_release, std::memory_order_relaxed));
+}
+
+Magazine *NewMagazine()
+{
+    Magazine *magazine = new Magazine();
+    PushAllocated(GetPools().magazines, magazine, &Magazine::allocatedNext);
+    return magazine;
+}
+
+/// cut a new slab in full magazines, return one and put the others in the depot
+Magazine *Carve(uint32 sizeClass)
+{
+    Pools &pools = GetPools();
+    Depot &depot = pools.depots[sizeClass];
+    Slab  *slab = new Slab();
+    PushAllocated(pools.slabs, slab, &Slab::next);
+#if HAWL_POOL_POISON
+    std::memset(slab->bytes, PoisonByte, Slab::Size);
+#endif
+
+    const size_t blockSize = BlockSizeOf(sizeClass);
+    const size_t blockCount = Slab::Size / blockSize;
+    Magazine    *first = nullptr;
+    for (size_t i = 0; i < blockCount;)
+    {
+        Magazine *magazine = depot.empty.Pop();
+        if (magazine == nullptr)
+            magazine = NewMagazine();
+        for (magazine->count = 0; magazine->count < PoolAllocator::MagazineSize && i < blockCount; ++i)
+            magazine->blocks[magazine->count++] = slab->bytes + i * blockSize;
+
+        if (first == nullptr)
+            first = magazine;
+        else
+            depot.full.Push(magazine);
+    }
+    return first;
+}
+
+/// the loaded magazine is empty, swap with the previous one or exchange an empty one with the depot
+NOINLINE Magazine *ReloadForAllocate(ThreadCache &cache, uint32 sizeClass)
+{
+    Magazine *&loaded = cache.loaded[sizeClass];
+    Magazine *&previous = cache.previous[sizeClass];
+    if (previous != nullptr && previous->count > 0)
+    {
+        std::swap(loaded, previous);
+        return loaded;
+    }
+
+    Depot    &depot = GetPools().depots[sizeClass];
+    Magazine *full = depot.full.Pop();
+    if (full == nullptr)
+        full = Carve(sizeClass);
+    if (previous != nullptr)
+        depot.empty.Push(previous);
+    previous = loaded;
+    loaded = full;
+    return loaded;
+}
+
+/// the loaded magazine is full, swap with the previous one or exchange a full one with the depot
+NOINLINE Magazine *ReloadForFree(ThreadCache &cache, uint32 sizeClass)
+{
+    Magazine *&loaded = cache.loaded[sizeClass];
+    Magazine *&previous = cache.previous[sizeClass];
+    if (previous != nullptr && previous->count == 0)
+    {
+        std::swap(loaded, previous);
+        return loaded;
+    }
+
+    Depot    &depot = GetPools().depots[sizeClass];
+    Magazine *empty = depot.empty.Pop();
+    if (empty == nullptr)
+        empty = NewMagazine();
+    if (previous != nullptr)
+        depot.full.Push(previous);
+    previous = loaded;
+    loaded = empty;
+    return loaded;
+}
+} // namespace
+
+void *PoolAllocator::Allocate(size_t size)
+{
+    if (size > MaxPooledSize)
+        return ::operator new(size);
+
+    const uint32 sizeClass = SizeClassOf(size);
+    ThreadCache &cache = tl_cache;
+    Magazine    *magazine = cache.loaded[sizeClass];
+    if (magazine == nullptr || magazine->count == 0)
+        magazine = ReloadForAllocate(cache, sizeClass);
+    void *block = magazine->blocks[--magazine->count];
+
+#if HAWL_POOL_POISON
+    const unsigned char *bytes = static_cast<const unsigned char *>(block);
+    const size_t         blockSize = BlockSizeOf(sizeClass);
+    for (size_t i = 0; i < blockSize; ++i)
+    {
+        if (bytes[i] != PoisonByte)
+        {
+            Logger::error("PoolAllocator: block {} of {} bytes written after free, at offset {}.",
+                          block,
+                          blockSize,
+                          i);
+            DEBUG_BREAK();
+            break;
+        }
+    }
+#endif
+    return block;
+}
+
+void PoolAllocator::Free(void *block, size_t size)
+{
+    if (block == nullptr)
+        return;
+    if (size > MaxPooledSize)
+    {
+        ::operator delete(block);
+        return;
+    }
+
+    const uint32 sizeClass = SizeClassOf(size);
+#if HAWL_POOL_POISON
+    std::memset(block, PoisonByte, BlockSizeOf(sizeClass));
+#endif
+    ThreadCache &cache = tl_cache;
+    Magazine    *magazine = cache.loaded[sizeClass];
+    if (magazine == nullptr || magazine->count == MagazineSize)
+        magazine = ReloadForFree(cache, sizeClass);
+    magazine->blocks[magazine->count++] = block;
+}
+
+void PoolAllocator::Reserve(size_t size, uint32 count)
+{
+    if (size > MaxPooledSize)
+        return;
+
+    const uint32 sizeClass = SizeClassOf(size);
+    Depot       &depot = GetPools().depots[sizeClass];
+    const size_t slabBlockCount = Slab::Size / BlockSizeOf(sizeClass);
+    for (size_t reserved = 0; reserved < count; reserved += slabBlockCount)
+        depot.full.Push(Carve(sizeClass));
+    // a thread freeing blocks it did not allocate fill magazines, it swaps them for empty ones
+    for (uint32 i = 0; i < (count + MagazineSize - 1) / MagazineSize; ++i)
+        depot.empty.Push(NewMagazine());
+}
+
+uint64 PoolAllocator::GetSystemAllocationCount()
+{
+    return GetPools().systemAllocations.load(std::memory_order_relaxed);
+}
+} // namespace Hawl
@@ -0,0 +1,140 @@
+/**
+ *  Copyright 2020-2021 Zhang QiuLiang (juteman). All rights reserved.
+ *
+ *  This file is a part of Hawl
+ *  see(https://github.com/juteman/Hawl)
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#include "Thread/TaskGraph.h"
+#include "Logger.h"
+
+namespace Hawl
+{
+TaskGraph::NodeHandle TaskGraph::AddNode(std::function<void()> work, Priority taskPriority)
+{
+    auto node = std::make_unique<Node>();
+    node->graph = this;
+    node->work = std::move(work);
+    node->taskPriority = taskPriority;
+    m_nodes.push_back(std::move(node));
+    m_validated = false;
+    return static_cast<NodeHandle>(m_nodes.size() - 1);
+}
+
+void TaskGraph::AddDependency(NodeHandle before, NodeHandle after)
+{
+    m_nodes[before]->successors.push_back(after);
+    m_nodes[after]->predecessorCount++;
+    m_validated = false;
+}
+
+bool TaskGraph::Validate()
+{
+    m_roots.clear();
+    std::vector<uint32> pending(m_nodes.size());
+    std::vector<NodeHandle> ready;
+    for (NodeHandle i = 0; i < m_nodes.size(); i++)
+    {
+        pending[i] = m_nodes[i]->predecessorCount;
+        if (pending[i] == 0)
+        {
+            m_roots.push_back(i);
+            ready.push_back(i);
+        }
+    }
+
+    size_t visited = 0;
+    while (!ready.empty())
+    {
+        const NodeHandle node = ready.back();
+        ready.pop_back();
+        visited++;
+        for (NodeHandle successor : m_nodes[node]->successors)
+            if (--pending[successor] == 0)
+                ready.push_back(successor);
+    }
+
+    if (visited != m_nodes.size())
+    {
+        Logger::error("TaskGraph has a cycle, {} of {} nodes are reachable.", visited, m_nodes.size());
+        return false;
+    }
+    m_validated = true;
+    return true;
+}
+
+bool TaskGraph::Launch()
+{
+    if (!IsDone())
+    {
+        Logger::error("TaskGraph launched while the last launch is running.");
+        return false;
+    }
+    if (!m_validated && !Validate())
+        return false;
+
+    for (auto &node : m_nodes)
+    {
+        node->pending.store(node->predecessorCount, std::memory_order_relaxed);
+        node->done.store(false, std::memory_order_relaxed);
+    }
+    m_remaining.store(static_cast<uint32>(m_nodes.size()), std::memory_order_relaxed);
+
+    // AddTask publish the reset counters to the workers
+    for (NodeHandle root : m_roots)
+        m_pool.AddTask(m_nodes[root].get());
+    return true;
+}
+
+template <typename Predicate>
+void TaskGraph::HelpUntil(Predicate &&predicate)
+{
+    while (!predicate())
+    {
+        if (!m_pool.RunPendingTask())
+            CpuPause();
+    }
+}
+
+void TaskGraph::Wait(NodeHandle node)
+{
+    const Node &waited = *m_nodes[node];
+    HelpUntil([&] { return waited.done.load(std::memory_order_acquire); });
+}
+
+void TaskGraph::Wait()
+{
+    HelpUntil([this] { return IsDone(); });
+}
+
+void TaskGraph::Node::run()
+{
+    work();
+
+    TaskGraph *owner = graph;
+    for (NodeHandle successor : successors)
+    {
+        Node &next = *owner->m_nodes[successor];
+        // the last predecessor done release the successor
+        if (next.pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            owner->m_pool.AddTask(&next);
+    }
+
+    done.store(true, std::memory_order_release);
+    // the graph may be destroyed by a waiter once the counter drop to zero
+    owner->m_remaining.fetch_sub(1, std::memory_order_acq_rel);
+}
+} // namespace Hawl
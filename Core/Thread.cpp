@@ -20,9 +20,279 @@
 
 #include "Thread.h"
 #include "Logger.h"
+#include "Algorithm/TaggedStack.h"
+#include <algorithm>
+#include <cstdlib>
+#include <mutex>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#elif defined(__linux__)
+#include <cerrno>
+#include <cstring>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 namespace Hawl
 {
+namespace
+{
+/// pool and worker index of the calling thread, set by the worker threads
+thread_local const ThreadPool *tl_currentPool = nullptr;
+thread_local int32             tl_workerIndex = -1;
+
+int64 SteadyNanoseconds()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+constexpr bool StatsEnabled = HAWL_THREAD_STATS != 0;
+
+constexpr uint32 StateMask = 3;
+/// the generation of a slot is in the bits above its TaskState
+constexpr uint32 GenerationStep = StateMask + 1;
+
+/// one AddTask of a task, the slot is recycled once the run is Done
+struct TaskSlot
+{
+    /// generation and TaskState
+    std::atomic<uint32> state{0};
+    /// next free slot, in a batch or in the cache of a thread
+    uint32              nextFree = TaskHandle::InvalidSlot;
+    /// read by the worker claiming the slot, never dereferenced for a cancelled run
+    std::atomic<Task *> task{nullptr};
+};
+
+/**
+ * \brief Slots of the queued and running tasks, addressed by index
+ *
+ * Slots are recycled through per thread caches and a lock free stack of
+ * batches, like NodePool, but never freed: a stale TaskHandle reads a newer
+ * generation, not freed memory.
+ */
+class TaskSlotTable
+{
+public:
+    static TaskSlotTable &Instance()
+    {
+        static TaskSlotTable *table = new TaskSlotTable();
+        return *table;
+    }
+
+    TaskSlot &operator[](uint32 index)
+    {
+        return m_chunks[index >> ChunkBits].load(std::memory_order_acquire)[index & (ChunkSize - 1)];
+    }
+
+    uint32 Acquire()
+    {
+        LocalCache &cache = GetCache();
+        if (cache.head == TaskHandle::InvalidSlot)
+            Refill(cache);
+        const uint32 index = cache.head;
+        cache.head = (*this)[index].nextFree;
+        --cache.count;
+        return index;
+    }
+
+    /// put at least count more free slots in the global stack
+    void Reserve(uint32 count)
+    {
+        for (uint32 reserved = 0; reserved < count; reserved += ChunkSize)
+        {
+            LocalCache chunk;
+            NewChunk(chunk);
+            while (chunk.count > 0)
+                Flush(chunk);
+        }
+    }
+
+    void Release(uint32 index)
+    {
+        LocalCache &cache = GetCache();
+        (*this)[index].nextFree = cache.head;
+        cache.head = index;
+        if (++cache.count >= BatchSize * 2)
+            Flush(cache);
+    }
+
+private:
+    static constexpr uint32 ChunkBits = 12;
+    static constexpr uint32 ChunkSize = 1u << ChunkBits;
+    /// 16M tasks queued or running at once
+    static constexpr uint32 MaxChunks = 4096;
+    static constexpr uint32 BatchSize = 64;
+
+    /// header of a batch of free slots, never freed as TaggedStack need
+    struct Batch
+    {
+        std::atomic<Batch *> next{nullptr};
+        uint32               head = TaskHandle::InvalidSlot;
+        uint32               count = 0;
+        /// all the headers ever created, linked only to keep them reachable
+        Batch               *allocatedNext = nullptr;
+    };
+
+    struct LocalCache
+    {
+        uint32 head = TaskHandle::InvalidSlot;
+        uint32 count = 0;
+
+        /// give the cached slots back on thread exit
+        ~LocalCache()
+        {
+            while (count > 0)
+                Instance().Flush(*this);
+        }
+    };
+
+    TaskSlotTable() = default;
+
+    static LocalCache &GetCache()
+    {
+        static thread_local LocalCache cache;
+        return cache;
+    }
+
+    /// move up to one batch from the local cache to the global stack
+    void Flush(LocalCache &cache)
+    {
+        Batch *batch = m_emptyBatches.Pop();
+        if (batch == nullptr)
+        {
+            batch = new Batch();
+            Batch *oldHead = m_allocatedBatches.load(std::memory_order_relaxed);
+            do
+            {
+                batch->allocatedNext = oldHead;
+            } while (!m_allocatedBatches.compare_exchange_weak(
+                oldHead, batch, std::memory_order_release, std::memory_order_relaxed));
+        }
+
+        uint32 last = cache.head;
+        uint32 count = 1;
+        while (count < BatchSize && (*this)[last].nextFree != TaskHandle::InvalidSlot)
+        {
+            last = (*this)[last].nextFree;
+            ++count;
+        }
+        batch->head = cache.head;
+        batch->count = count;
+        cache.head = (*this)[last].nextFree;
+        cache.count -= count;
+        (*this)[last].nextFree = TaskHandle::InvalidSlot;
+        m_fullBatches.Push(batch);
+    }
+
+    /// take one batch from the global stack, or a new chunk of slots if it is empty
+    void Refill(LocalCache &cache)
+    {
+        if (Batch *batch = m_fullBatches.Pop())
+        {
+            cache.head = batch->head;
+            cache.count = batch->count;
+            m_emptyBatches.Push(batch);
+            return;
+        }
+        NewChunk(cache);
+    }
+
+    /// allocate a chunk of slots in an empty cache
+    void NewChunk(LocalCache &cache)
+    {
+        std::lock_guard<std::mutex> lock(m_growMutex);
+        const uint32                chunk = m_chunkCount;
+        if (chunk == MaxChunks)
+        {
+            Logger::error("ThreadPool: more than {} tasks queued or running.", MaxChunks * ChunkSize);
+            std::abort();
+        }
+        TaskSlot *slots = new TaskSlot[ChunkSize];
+        for (uint32 i = 0; i < ChunkSize; ++i)
+            slots[i].nextFree = i + 1 < ChunkSize ? (chunk << ChunkBits) + i + 1 : TaskHandle::InvalidSlot;
+        m_chunks[chunk].store(slots, std::memory_order_release);
+        ++m_chunkCount;
+        cache.head = chunk << ChunkBits;
+        cache.count = ChunkSize;
+    }
+
+    Algorithm::TaggedStack<Batch> m_fullBatches;
+    Algorithm::TaggedStack<Batch> m_emptyBatches;
+    std::atomic<Batch *>          m_allocatedBatches{nullptr};
+    std::atomic<TaskSlot *>       m_chunks[MaxChunks] = {};
+    uint32                        m_chunkCount = 0;
+    std::mutex                    m_growMutex;
+
+    HAWL_DISABLE_COPY(TaskSlotTable)
+};
+
+/// counters have a single writer, a plain store is enough
+FORCEINLINE void CounterAdd(std::atomic<uint64> &counter, uint64 value)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+FORCEINLINE void CounterMax(std::atomic<uint64> &counter, uint64 value)
+{
+    if (value > counter.load(std::memory_order_relaxed))
+        counter.store(value, std::memory_order_relaxed);
+}
+
+/// set the os priority of the calling thread
+void ApplyThreadPriority(Priority threadPriority)
+{
+    if (threadPriority == Priority::Normal)
+        return;
+
+#if defined(_WIN32)
+    static const int WindowsPriorities[] = {THREAD_PRIORITY_LOWEST,
+                                            THREAD_PRIORITY_BELOW_NORMAL,
+                                            THREAD_PRIORITY_NORMAL,
+                                            THREAD_PRIORITY_ABOVE_NORMAL,
+                                            THREAD_PRIORITY_HIGHEST};
+    if (!SetThreadPriority(GetCurrentThread(), WindowsPriorities[static_cast<int>(threadPriority)]))
+        Logger::warn("SetThreadPriority failed with error {}.", GetLastError());
+#elif defined(__linux__)
+    // the threads of SCHED_OTHER only differ by nice value, and linux apply it per thread id
+    static const int NiceValues[] = {10, 5, 0, -5, -10};
+    const pid_t tid = static_cast<pid_t>(syscall(SYS_gettid));
+    if (setpriority(PRIO_PROCESS, static_cast<id_t>(tid), NiceValues[static_cast<int>(threadPriority)]) != 0)
+        Logger::warn("setpriority of thread {} failed: {}.", tid, std::strerror(errno));
+#endif
+}
+
+const char *AffinityPolicyName(AffinityPolicy policy)
+{
+    switch (policy)
+    {
+    case AffinityPolicy::Compact: return "compact";
+    case AffinityPolicy::Scatter: return "scatter";
+    default: return "none";
+    }
+}
+
+/// log the processor chosen for every worker
+void LogPlacement(const CpuTopology &topology, const std::vector<uint32> &cpus, AffinityPolicy policy, uint32 count)
+{
+    if (cpus.empty())
+    {
+        Logger::info("ThreadPool: {} workers, not pinned.", count);
+        return;
+    }
+
+    std::string placement;
+    for (uint32 i = 0; i < cpus.size(); i++)
+    {
+        const LogicalCpu &cpu = topology.GetCpus()[cpus[i]];
+        placement += fmt::format("{}{}(node {})", i == 0 ? "" : ", ", cpu.id, cpu.node);
+    }
+    Logger::info("ThreadPool: {} workers, {} affinity on cpus {}.", count, AffinityPolicyName(policy), placement);
+}
+} // namespace
+
 bool ThreadPool::Create(uint32 numOfThreads, Priority threadPriority)
 {
     if (numOfThreads > MaxThreadCount)
@@ -30,11 +300,493 @@ bool ThreadPool::Create(uint32 numOfThreads, Priority threadPriority)
         Logger::warn("Create to many thread in thread pool {}.", __FILE__);
     }
 
-    for (int i; i < numOfThreads; i++)
-        m_threads.push_back(std::thread([this]
+    m_stopping.store(false, std::memory_order_relaxed);
+    m_readyWorkers.store(0, std::memory_order_relaxed);
+    m_threadPriority = threadPriority;
+
+    const CpuTopology &topology = CpuTopology::Get();
+    const std::vector<uint32> cpus = topology.SelectCpus(numOfThreads, m_affinityPolicy, m_reserveFirstCore);
+    topology.Log();
+    LogPlacement(topology, cpus, m_affinityPolicy, numOfThreads);
+
+    // the workers fill their slot, all the slots exist before any thread start
+    m_workers.resize(numOfThreads);
+    for (uint32 i = 0; i < numOfThreads; i++)
+    {
+        const int32 cpu = cpus.empty() ? -1 : static_cast<int32>(topology.GetCpus()[cpus[i]].id);
+        m_threads.emplace_back([this, i, cpu]
         {
-            this->TaskRunner();
-        }));
+            this->TaskRunner(i, cpu);
+        });
+    }
+
+    // AddTask from this thread need the deques of all the workers
+    while (m_readyWorkers.load(std::memory_order_acquire) != numOfThreads)
+        std::this_thread::yield();
     return true;
 }
+
+void ThreadPool::Destroy()
+{
+    m_stopping.store(true, std::memory_order_seq_cst);
+    m_wakeup.NotifyAll();
+
+    for (auto &thread : m_threads)
+        thread.join();
+    m_threads.clear();
+    m_workers.clear();
+}
+
+TaskHandle ThreadPool::AddTask(Task *task)
+{
+    if (task == nullptr)
+        return {};
+
+    // a new generation of the slot stale the handles of its previous runs. The queue publish it with the slot
+    TaskSlotTable &table = TaskSlotTable::Instance();
+    const uint32   slot = table.Acquire();
+    TaskSlot      &entry = table[slot];
+    const uint32   queued = ((entry.state.load(std::memory_order_relaxed) & ~StateMask) + GenerationStep) |
+                          static_cast<uint32>(TaskState::Queued);
+    entry.task.store(task, std::memory_order_relaxed);
+    entry.state.store(queued, std::memory_order_relaxed);
+    task->taskSlot.store(slot, std::memory_order_relaxed);
+
+    // Normal task spawned from a task stay on the local deque, it is likely hot in
+    // cache. The others go to the queue of their level so every worker see them
+    const int32 index = GetCurrentWorkerIndex();
+    if (index >= 0 && task->taskPriority == Priority::Normal)
+    {
+        Worker &worker = *m_workers[index];
+        worker.deque.Push(slot);
+        if constexpr (StatsEnabled)
+            CounterMax(worker.counters.queueHighWater, static_cast<uint64>(worker.deque.Size()));
+    }
+    else
+        TaskQueues[static_cast<uint32>(task->taskPriority)].EnQueue({slot, SteadyNanoseconds()});
+
+    // cheap when no worker is parked
+    m_wakeup.Notify();
+    return {slot, queued};
+}
+
+void ThreadPool::Reserve(uint32 taskCount)
+{
+    Queue::ReserveNodes(taskCount);
+    TaskSlotTable::Instance().Reserve(taskCount);
+    Algorithm::NodePool<InlineTask>::Instance().Reserve(taskCount);
+    Algorithm::EpochReclaimer::Reserve(taskCount);
+}
+
+void ThreadPool::RetractTask(Task *task)
+{
+    const uint32 slot = task->taskSlot.load(std::memory_order_relaxed);
+    if (slot == TaskHandle::InvalidSlot)
+        return;
+
+    // the slot may run another task since, the CAS of CancelTask fail if it changed after the check
+    TaskSlot    &entry = TaskSlotTable::Instance()[slot];
+    const uint32 state = entry.state.load(std::memory_order_acquire);
+    if ((state & StateMask) == static_cast<uint32>(TaskState::Queued) &&
+        entry.task.load(std::memory_order_relaxed) == task)
+        CancelTask({slot, state});
+}
+
+bool ThreadPool::CancelTask(const TaskHandle &handle)
+{
+    if (handle.slot == TaskHandle::InvalidSlot)
+        return false;
+
+    // only the queued state of this generation can be cancelled, a worker claim it with the same CAS
+    uint32       expected = handle.generation;
+    const uint32 cancelled = (expected & ~StateMask) | static_cast<uint32>(TaskState::Cancelled);
+    return TaskSlotTable::Instance()[handle.slot].state.compare_exchange_strong(
+        expected, cancelled, std::memory_order_acq_rel, std::memory_order_relaxed);
+}
+
+TaskState ThreadPool::GetTaskState(const TaskHandle &handle)
+{
+    if (handle.slot == TaskHandle::InvalidSlot)
+        return TaskState::Done;
+
+    // a newer generation means this run is over and the slot was recycled
+    const uint32 state = TaskSlotTable::Instance()[handle.slot].state.load(std::memory_order_acquire);
+    if ((state & ~StateMask) != (handle.generation & ~StateMask))
+        return TaskState::Done;
+    return static_cast<TaskState>(state & StateMask);
+}
+
+bool ThreadPool::RunPendingTask()
+{
+    const int32 index = GetCurrentWorkerIndex();
+    uint32      slot;
+    if (!FindTask(index, slot))
+        return false;
+
+    // the time is already counted busy by the task waiting here
+    if constexpr (StatsEnabled)
+    {
+        if (index >= 0)
+            CounterAdd(m_workers[index]->counters.tasksExecuted, 1);
+    }
+    RunTask(slot);
+    return true;
+}
+
+int32 ThreadPool::GetCurrentWorkerIndex() const
+{
+    return tl_currentPool == this ? tl_workerIndex : -1;
+}
+
+int32 ThreadPool::SelectQueue(int64 now, int64 &outScore)
+{
+    const int64 agingStep = m_agingStep.load(std::memory_order_relaxed);
+    int32       selected = -1;
+
+    for (int32 level = PriorityCount - 1; level >= 0; level--)
+    {
+        QueuedTask head;
+        if (TaskQueues[level].IsEmpty() || !TaskQueues[level].Peek(head))
+            continue;
+
+        // the head is the oldest task of the level, it ages the level
+        const int64 score = level * agingStep + (now - head.submitTime);
+        if (selected < 0 || score > outScore)
+        {
+            selected = level;
+            outScore = score;
+        }
+    }
+    return selected;
+}
+
+bool ThreadPool::FindTask(int32 index, uint32 &slot)
+{
+    // the retracted tasks are dropped on the way, for one atomic each
+    while (PopTask(index, slot))
+    {
+        if (ClaimTask(slot))
+            return true;
+    }
+    return false;
+}
+
+bool ThreadPool::ClaimTask(uint32 slot)
+{
+    TaskSlot &entry = TaskSlotTable::Instance()[slot];
+    uint32    state = entry.state.load(std::memory_order_acquire);
+    while ((state & StateMask) == static_cast<uint32>(TaskState::Queued))
+    {
+        const uint32 running = (state & ~StateMask) | static_cast<uint32>(TaskState::Running);
+        if (entry.state.compare_exchange_weak(state, running, std::memory_order_acquire, std::memory_order_acquire))
+            return true;
+    }
+
+    // cancelled, the task may already be destroyed, only the slot is touched
+    entry.state.store(state & ~StateMask, std::memory_order_release);
+    TaskSlotTable::Instance().Release(slot);
+    return false;
+}
+
+void ThreadPool::RunTask(uint32 slot)
+{
+    TaskSlotTable &table = TaskSlotTable::Instance();
+    TaskSlot      &entry = table[slot];
+    entry.task.load(std::memory_order_relaxed)->run();
+
+    // the task may have deleted itself in run(), Done is published through the slot only
+    entry.state.store(entry.state.load(std::memory_order_relaxed) & ~StateMask, std::memory_order_release);
+    table.Release(slot);
+}
+
+bool ThreadPool::PopTask(int32 index, uint32 &slot)
+{
+    const int64 now = SteadyNanoseconds();
+    if (index >= 0)
+        m_workers[index]->searchNanoseconds = now;
+
+    int64       score = 0;
+    const int32 level = SelectQueue(now, score);
+    const int64 agingStep = m_agingStep.load(std::memory_order_relaxed);
+    const int64 normalScore = static_cast<int64>(Priority::Normal) * agingStep;
+    QueuedTask  queued;
+
+    // above Normal, or aged above it
+    if (level >= 0 && score >= normalScore + agingStep && TaskQueues[level].DeQueue(queued))
+    {
+        slot = queued.slot;
+        return true;
+    }
+
+    if (index >= 0 && m_workers[index]->deque.Pop(slot))
+        return true;
+
+    if (level >= 0 && score >= normalScore && TaskQueues[level].DeQueue(queued))
+    {
+        slot = queued.slot;
+        return true;
+    }
+
+    if (StealTask(index, slot))
+        return true;
+
+    // below Normal, or anything added since the selection
+    for (int32 lower = PriorityCount - 1; lower >= 0; lower--)
+    {
+        if (TaskQueues[lower].DeQueue(queued))
+        {
+            slot = queued.slot;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ThreadPool::StealTask(int32 index, uint32 &slot)
+{
+    // start at a random peer so thieves spread out
+    const uint32 workerCount = static_cast<uint32>(m_workers.size());
+    if (workerCount == 0)
+        return false;
+
+    uint32 start;
+    if (index >= 0)
+    {
+        uint32 &seed = m_workers[index]->seed;
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        start = seed % workerCount;
+    }
+    else
+        start = static_cast<uint32>(std::hash<std::thread::id>()(std::this_thread::get_id())) % workerCount;
+
+    for (uint32 i = 0; i < workerCount; i++)
+    {
+        const uint32 victim = (start + i) % workerCount;
+        if (static_cast<int32>(victim) == index)
+            continue;
+
+        const bool stolen = m_workers[victim]->deque.Steal(slot);
+        if constexpr (StatsEnabled)
+        {
+            if (index >= 0)
+            {
+                WorkerCounters &counters = m_workers[index]->counters;
+                CounterAdd(counters.stealsAttempted, 1);
+                CounterAdd(counters.stealsSucceeded, stolen ? 1 : 0);
+            }
+        }
+        if (stolen)
+            return true;
+    }
+    return false;
+}
+
+void ThreadPool::Worker::EnterPhase(WorkerPhase next)
+{
+    const uint64 duration = static_cast<uint64>(searchNanoseconds - phaseStartNanoseconds);
+    switch (phase)
+    {
+    case WorkerPhase::Busy:
+        CounterAdd(counters.busyNanoseconds, duration);
+        CounterMax(counters.longestTaskNanoseconds, duration);
+        break;
+    case WorkerPhase::Spin:
+        CounterAdd(counters.spinNanoseconds, duration);
+        break;
+    case WorkerPhase::Idle:
+        CounterAdd(counters.idleNanoseconds, duration);
+        break;
+    }
+    if (next == WorkerPhase::Busy)
+        CounterAdd(counters.tasksExecuted, 1);
+    phase = next;
+    phaseStartNanoseconds = searchNanoseconds;
+}
+
+bool ThreadPool::SearchTask(int32 index, uint32 &slot)
+{
+    // the clock read of every FindTask time the phases, the counters need no read of their own
+    const bool found = FindTask(index, slot);
+    if constexpr (StatsEnabled)
+        m_workers[index]->EnterPhase(found ? WorkerPhase::Busy : WorkerPhase::Spin);
+    return found;
+}
+
+bool ThreadPool::WaitForTask(int32 index, uint32 &slot)
+{
+    if (SearchTask(index, slot))
+        return true;
+
+    Worker     &worker = *m_workers[index];
+    const int64 waitStart = worker.searchNanoseconds;
+    const bool  found = IdleUntilTask(index, slot);
+    if (found && m_idlePolicy.adaptive)
+    {
+        // a wait longer than maxSpin would mostly be spun for nothing, park early for those
+        const int64 minSpin = m_idlePolicy.minSpin.count();
+        const int64 maxSpin = m_idlePolicy.maxSpin.count();
+        worker.averageWaitNanoseconds += (worker.searchNanoseconds - waitStart - worker.averageWaitNanoseconds) / 8;
+        const int64 budget = worker.averageWaitNanoseconds * 2;
+        worker.spinBudgetNanoseconds = budget <= maxSpin ? std::max(budget, minSpin) : minSpin;
+    }
+    return found;
+}
+
+bool ThreadPool::IdleUntilTask(int32 index, uint32 &slot)
+{
+    Worker           &worker = *m_workers[index];
+    const IdlePolicy &policy = m_idlePolicy;
+    const int64       spinStart = worker.searchNanoseconds;
+
+    // the pause between two searches double, fewer searches hammer the queues of a long wait
+    uint32 pauseCount = 1;
+    while (worker.searchNanoseconds - spinStart < worker.spinBudgetNanoseconds)
+    {
+        if (m_stopping.load(std::memory_order_acquire))
+            return SearchTask(index, slot);
+        for (uint32 i = 0; i < pauseCount; ++i)
+            CpuPause();
+        pauseCount = std::min(pauseCount * 2, policy.maxPauseCount);
+        if (SearchTask(index, slot))
+            return true;
+    }
+
+    // the thread about to add a task may be waiting for this cpu
+    for (uint32 i = 0; i < policy.yieldCount; ++i)
+    {
+        if (m_stopping.load(std::memory_order_acquire))
+            return SearchTask(index, slot);
+        std::this_thread::yield();
+        if (SearchTask(index, slot))
+            return true;
+    }
+
+    while (true)
+    {
+        const uint32 key = m_wakeup.PrepareWait();
+        if (SearchTask(index, slot))
+        {
+            m_wakeup.CancelWait();
+            return true;
+        }
+        if (m_stopping.load(std::memory_order_acquire))
+        {
+            m_wakeup.CancelWait();
+            return SearchTask(index, slot);
+        }
+        if constexpr (StatsEnabled)
+            worker.EnterPhase(WorkerPhase::Idle);
+        m_wakeup.CommitWait(key);
+    }
+}
+
+void ThreadPool::TaskRunner(uint32 index, int32 cpu)
+{
+    tl_currentPool = this;
+    tl_workerIndex = static_cast<int32>(index);
+    ApplyThreadPriority(m_threadPriority);
+
+    // pin before allocating, the first touch place the deque on the node of the cpu
+    if (cpu >= 0)
+        CpuTopology::PinCurrentThread(static_cast<uint32>(cpu));
+    m_workers[index] = std::make_unique<Worker>();
+    m_workers[index]->seed = index * 2654435761u + 1;
+
+    // the first guard of a thread allocate its retire list, take it before any task is found
+    {
+        Algorithm::EpochReclaimer::Guard guard;
+    }
+
+    // peers are stolen from, wait for all of them to exist
+    const uint32 workerCount = static_cast<uint32>(m_workers.size());
+    m_readyWorkers.fetch_add(1, std::memory_order_acq_rel);
+    while (m_readyWorkers.load(std::memory_order_acquire) != workerCount)
+        std::this_thread::yield();
+
+    Worker &worker = *m_workers[index];
+    worker.searchNanoseconds = worker.phaseStartNanoseconds = SteadyNanoseconds();
+    worker.spinBudgetNanoseconds = m_idlePolicy.maxSpin.count();
+
+    // idle until a task is found or Destroy is called, then run what is left before exit
+    uint32 slot = TaskHandle::InvalidSlot;
+    while (WaitForTask(static_cast<int32>(index), slot))
+        RunTask(slot);
+
+    if constexpr (StatsEnabled)
+    {
+        worker.searchNanoseconds = SteadyNanoseconds();
+        worker.EnterPhase(WorkerPhase::Spin);
+    }
+    tl_currentPool = nullptr;
+    tl_workerIndex = -1;
+}
+
+ThreadPoolStats ThreadPool::GetStats() const
+{
+    ThreadPoolStats stats;
+    stats.workers.reserve(m_workers.size());
+    for (const auto &worker : m_workers)
+    {
+        const WorkerCounters &counters = worker->counters;
+        WorkerStats           current;
+        current.tasksExecuted = counters.tasksExecuted.load(std::memory_order_relaxed);
+        current.stealsAttempted = counters.stealsAttempted.load(std::memory_order_relaxed);
+        current.stealsSucceeded = counters.stealsSucceeded.load(std::memory_order_relaxed);
+        current.queueHighWater = counters.queueHighWater.load(std::memory_order_relaxed);
+        current.busyNanoseconds = counters.busyNanoseconds.load(std::memory_order_relaxed);
+        current.spinNanoseconds = counters.spinNanoseconds.load(std::memory_order_relaxed);
+        current.idleNanoseconds = counters.idleNanoseconds.load(std::memory_order_relaxed);
+        current.longestTaskNanoseconds = counters.longestTaskNanoseconds.load(std::memory_order_relaxed);
+        stats.workers.push_back(current);
+
+        WorkerStats &total = stats.total;
+        total.tasksExecuted += current.tasksExecuted;
+        total.stealsAttempted += current.stealsAttempted;
+        total.stealsSucceeded += current.stealsSucceeded;
+        total.queueHighWater = std::max(total.queueHighWater, current.queueHighWater);
+        total.busyNanoseconds += current.busyNanoseconds;
+        total.spinNanoseconds += current.spinNanoseconds;
+        total.idleNanoseconds += current.idleNanoseconds;
+        total.longestTaskNanoseconds = std::max(total.longestTaskNanoseconds, current.longestTaskNanoseconds);
+    }
+    return stats;
+}
+
+void ThreadPool::LogStats() const
+{
+    const ThreadPoolStats stats = GetStats();
+    Logger::info("ThreadPool stats: {}", stats.ToString());
+    for (uint32 i = 0; i < stats.workers.size(); i++)
+    {
+        const WorkerStats &worker = stats.workers[i];
+        Logger::debug("  worker {}: {} tasks, {} of {} steals, queue high-water {}, busy {} us, spin {} us, idle {} us",
+                      i,
+                      worker.tasksExecuted,
+                      worker.stealsSucceeded,
+                      worker.stealsAttempted,
+                      worker.queueHighWater,
+                      worker.busyNanoseconds / 1000,
+                      worker.spinNanoseconds / 1000,
+                      worker.idleNanoseconds / 1000);
+    }
+}
+
+std::string ThreadPoolStats::ToString() const
+{
+    const uint64 timeSum = total.busyNanoseconds + total.spinNanoseconds + total.idleNanoseconds;
+    const double percent = timeSum > 0 ? 100.0 / double(timeSum) : 0.0;
+    return fmt::format("{} workers, {} tasks, {} of {} steals, queue high-water {}, busy {:.1f}% spin {:.1f}% "
+                       "idle {:.1f}%, longest task {:.3f} ms",
+                       workers.size(),
+                       total.tasksExecuted,
+                       total.stealsSucceeded,
+                       total.stealsAttempted,
+                       total.queueHighWater,
+                       double(total.busyNanoseconds) * percent,
+                       double(total.spinNanoseconds) * percent,
+                       double(total.idleNanoseconds) * percent,
+                       double(total.longestTaskNanoseconds) / 1e6);
+}
 } // namespace Hawl
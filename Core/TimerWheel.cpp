@@ -0,0 +1,330 @@
+/**
+ *  Copyright 2020-2021 Zhang QiuLiang (juteman). All rights reserved.
+ *
+ *  This file is a part of Hawl
+ *  see(https://github.com/juteman/Hawl)
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#include "Thread/TimerWheel.h"
+#include <algorithm>
+#include <bit>
+
+namespace Hawl
+{
+TimerWheel::TimerWheel(ThreadPool &pool, std::chrono::nanoseconds tickDuration)
+    : m_pool{pool}, m_tickDuration{std::max(tickDuration, std::chrono::nanoseconds(1))}, m_start{Clock::now()}
+{
+    m_thread = std::thread(&TimerWheel::TimerThread, this);
+}
+
+TimerWheel::~TimerWheel()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wakeup.notify_one();
+    m_thread.join();
+
+    // the firing timers still reference the wheel, help the pool to bring them back
+    while (m_firingCount.load(std::memory_order_acquire) != 0)
+    {
+        if (!m_pool.RunPendingTask())
+            std::this_thread::yield();
+    }
+}
+
+TimerWheel::Handle TimerWheel::AddDelayed(std::chrono::nanoseconds delay, std::function<void()> callback,
+                                          Priority taskPriority)
+{
+    return Add(ToTicks(delay), 0, std::move(callback), taskPriority);
+}
+
+TimerWheel::Handle TimerWheel::AddPeriodic(std::chrono::nanoseconds period, std::function<void()> callback,
+                                           Priority taskPriority)
+{
+    const uint64 ticks = std::max<uint64>(ToTicks(period), 1);
+    return Add(ticks, ticks, std::move(callback), taskPriority);
+}
+
+bool TimerWheel::Cancel(const Handle &handle)
+{
+    if (handle.timer == nullptr)
+        return false;
+
+    // destroyed after the unlock, the captures may do anything
+    std::function<void()>       released;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Timer                      *timer = handle.timer;
+    if (timer->id != handle.id)
+        return false;
+
+    switch (timer->state)
+    {
+    case TimerState::Pending:
+        Remove(timer);
+        m_pendingCount.fetch_sub(1, std::memory_order_relaxed);
+        released = std::move(timer->callback);
+        Free(timer);
+        return true;
+    case TimerState::Queued:
+        // the task is still in the pool queues, it frees the timer without calling back
+        timer->state = TimerState::Cancelled;
+        return true;
+    case TimerState::Running:
+        // a periodic timer is freed by its task once the callback returned, a delayed one is too late
+        if (timer->period == 0)
+            return false;
+        timer->state = TimerState::Cancelled;
+        return true;
+    default:
+        return false;
+    }
+}
+
+void TimerWheel::Timer::run()
+{
+    TimerWheel           &owner = *wheel;
+    std::function<void()> released;
+    bool                  cancelled;
+    {
+        std::lock_guard<std::mutex> lock(owner.m_mutex);
+        cancelled = state == TimerState::Cancelled;
+        if (!cancelled)
+            state = TimerState::Running;
+    }
+
+    // nothing else touch the callback while the timer is running, a timer cancelled while queued never call back
+    if (!cancelled)
+        callback();
+
+    {
+        std::lock_guard<std::mutex> lock(owner.m_mutex);
+        if (period != 0 && state == TimerState::Running && !owner.m_stopping)
+        {
+            // next multiple of the period in the future, the missed ones are skipped
+            const uint64 now = owner.CurrentTick();
+            expiry += period;
+            if (expiry <= now)
+                expiry += ((now - expiry) / period + 1) * period;
+            state = TimerState::Pending;
+            owner.Insert(this);
+            owner.m_pendingCount.fetch_add(1, std::memory_order_relaxed);
+            if (expiry < owner.m_sleepTick)
+                owner.m_wakeup.notify_one();
+        }
+        else
+        {
+            released = std::move(callback);
+            owner.Free(this);
+        }
+    }
+    // last access to the wheel, it may be destroyed right after
+    owner.m_firingCount.fetch_sub(1, std::memory_order_release);
+}
+
+void TimerWheel::PushBack(Link &list, Link *link)
+{
+    link->previous = list.previous;
+    link->next = &list;
+    list.previous->next = link;
+    list.previous = link;
+}
+
+void TimerWheel::Unlink(Link *link)
+{
+    link->previous->next = link->next;
+    link->next->previous = link->previous;
+    link->previous = link;
+    link->next = link;
+}
+
+TimerWheel::Handle TimerWheel::Add(uint64 delay, uint64 period, std::function<void()> callback, Priority taskPriority)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Timer                      *timer = Allocate();
+    timer->wheel = this;
+    timer->callback = std::move(callback);
+    timer->taskPriority = taskPriority;
+    timer->period = period;
+    timer->id = m_nextId++;
+    timer->state = TimerState::Pending;
+    // the current tick is partly elapsed, one more keep the timer from firing early
+    timer->expiry = CurrentTick() + delay + 1;
+    Insert(timer);
+    m_pendingCount.fetch_add(1, std::memory_order_relaxed);
+
+    if (timer->expiry < m_sleepTick)
+        m_wakeup.notify_one();
+    return {timer, timer->id};
+}
+
+uint64 TimerWheel::ToTicks(std::chrono::nanoseconds duration) const
+{
+    if (duration.count() <= 0)
+        return 0;
+    return static_cast<uint64>((duration.count() + m_tickDuration.count() - 1) / m_tickDuration.count());
+}
+
+uint64 TimerWheel::CurrentTick() const
+{
+    return static_cast<uint64>((Clock::now() - m_start) / m_tickDuration);
+}
+
+TimerWheel::Timer *TimerWheel::Allocate()
+{
+    if (m_freeTimers.next == &m_freeTimers)
+    {
+        m_chunks.emplace_back(new Timer[TimerChunkSize]);
+        Timer *chunk = m_chunks.back().get();
+        for (uint32 i = 0; i < TimerChunkSize; ++i)
+            PushBack(m_freeTimers, &chunk[i]);
+    }
+
+    Timer *timer = static_cast<Timer *>(m_freeTimers.next);
+    Unlink(timer);
+    return timer;
+}
+
+void TimerWheel::Free(Timer *timer)
+{
+    // the handles of the timer are stale from now
+    timer->id = 0;
+    PushBack(m_freeTimers, timer);
+}
+
+void TimerWheel::Insert(Timer *timer)
+{
+    // the highest tick digit that differ from the current tick select the wheel
+    const uint64 difference = timer->expiry ^ m_currentTick;
+    const uint32 level = difference < SlotCount ? 0 : static_cast<uint32>(std::bit_width(difference) - 1) / SlotBits;
+    if (level >= LevelCount)
+    {
+        timer->level = LevelCount;
+        PushBack(m_overflow, timer);
+        return;
+    }
+
+    const uint32 slot = static_cast<uint32>(timer->expiry >> (level * SlotBits)) & SlotMask;
+    timer->level = static_cast<uint8>(level);
+    timer->slot = static_cast<uint8>(slot);
+    PushBack(m_slots[level][slot], timer);
+    if (level == 0)
+        m_occupied[slot / 64] |= uint64(1) << (slot % 64);
+}
+
+void TimerWheel::Remove(Timer *timer)
+{
+    Unlink(timer);
+    if (timer->level == 0)
+    {
+        const Link &list = m_slots[0][timer->slot];
+        if (list.next == &list)
+            m_occupied[timer->slot / 64] &= ~(uint64(1) << (timer->slot % 64));
+    }
+}
+
+uint32 TimerWheel::FindOccupied(uint32 slot) const
+{
+    for (uint32 word = slot / 64; word < SlotCount / 64; ++word)
+    {
+        uint64 bits = m_occupied[word];
+        if (word == slot / 64)
+            bits &= ~uint64(0) << (slot % 64);
+        if (bits != 0)
+            return word * 64 + static_cast<uint32>(std::countr_zero(bits));
+    }
+    return SlotCount;
+}
+
+void TimerWheel::Advance(uint64 now)
+{
+    while (m_currentTick <= now)
+    {
+        const uint64 tick = m_currentTick;
+        if ((tick & SlotMask) == 0)
+        {
+            // the lower wheels wrapped, bring the timers of this tick down, the highest wheel first
+            if ((tick & ((uint64(1) << (LevelCount * SlotBits)) - 1)) == 0)
+                Cascade(m_overflow);
+            for (uint32 level = LevelCount - 1; level > 0; --level)
+            {
+                const uint32 shift = level * SlotBits;
+                if ((tick & ((uint64(1) << shift) - 1)) == 0)
+                    Cascade(m_slots[level][(tick >> shift) & SlotMask]);
+            }
+        }
+
+        const uint32 slot = static_cast<uint32>(tick & SlotMask);
+        Link        &list = m_slots[0][slot];
+        while (list.next != &list)
+            Fire(static_cast<Timer *>(list.next));
+        m_occupied[slot / 64] &= ~(uint64(1) << (slot % 64));
+
+        // jump over the empty ticks, up to the next occupied slot or the next wrap
+        const uint32 next = slot + 1 < SlotCount ? FindOccupied(slot + 1) : SlotCount;
+        m_currentTick = std::min(now + 1, (tick & ~SlotMask) + next);
+    }
+}
+
+void TimerWheel::Cascade(Link &list)
+{
+    Link *link = list.next;
+    list.previous = &list;
+    list.next = &list;
+    while (link != &list)
+    {
+        Link *next = link->next;
+        Insert(static_cast<Timer *>(link));
+        link = next;
+    }
+}
+
+void TimerWheel::Fire(Timer *timer)
+{
+    Unlink(timer);
+    timer->state = TimerState::Queued;
+    m_pendingCount.fetch_sub(1, std::memory_order_relaxed);
+    m_firingCount.fetch_add(1, std::memory_order_relaxed);
+    m_pool.AddTask(timer);
+}
+
+uint64 TimerWheel::NextWakeTick() const
+{
+    // the other wheels are brought down at the next wrap, which may be the current tick
+    const uint64 wrap = (m_currentTick + SlotMask) & ~SlotMask;
+    // the first wheel only holds timers of the current round
+    const uint32 slot = FindOccupied(static_cast<uint32>(m_currentTick & SlotMask));
+    if (slot < SlotCount)
+        return std::min(wrap, (m_currentTick & ~SlotMask) + slot);
+    if (m_pendingCount.load(std::memory_order_relaxed) != 0)
+        return wrap;
+    return UINT64_MAX;
+}
+
+void TimerWheel::TimerThread()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (!m_stopping)
+    {
+        Advance(CurrentTick());
+        m_sleepTick = NextWakeTick();
+        if (m_sleepTick == UINT64_MAX)
+            m_wakeup.wait(lock);
+        else
+            m_wakeup.wait_until(lock, m_start + m_tickDuration * static_cast<int64>(m_sleepTick));
+    }
+}
+} // namespace Hawl
@@ -0,0 +1,110 @@
+/**
+ *  Copyright 2020-2021 Zhang QiuLiang (juteman). All rights reserved.
+ *
+ *  This file is a part of Hawl
+ *  see(https://github.com/juteman/Hawl)
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#include "Memory/VirtualArray.h"
+#include "Memory/VirtualMemory.h"
+#include "Logger.h"
+#include <algorithm>
+#include <cstdint>
+
+namespace Hawl
+{
+VirtualArrayStorage::VirtualArrayStorage(size_t maxBytes, bool hugePages)
+    : m_granularity{hugePages ? VirtualMemory::HugePageSize : std::max(CommitGranularity, VirtualMemory::GetPageSize())}
+{
+    if (maxBytes == 0)
+        return;
+
+    // one more huge page of addresses to align the data on one
+    const size_t capacity = RoundUp64(maxBytes, m_granularity);
+    const size_t reservedBytes = hugePages ? capacity + VirtualMemory::HugePageSize : capacity;
+    m_reservation = static_cast<char *>(VirtualMemory::Reserve(reservedBytes));
+    if (m_reservation == nullptr)
+        return;
+    m_reservedBytes = reservedBytes;
+    m_data = m_reservation;
+    if (hugePages)
+    {
+        m_data = reinterpret_cast<char *>(RoundUp64(reinterpret_cast<uintptr_t>(m_reservation), m_granularity));
+        VirtualMemory::AdviseHugePages(m_data, capacity);
+    }
+    m_maxBytes = capacity;
+}
+
+VirtualArrayStorage::~VirtualArrayStorage()
+{
+    Release();
+}
+
+VirtualArrayStorage::VirtualArrayStorage(VirtualArrayStorage &&other) noexcept
+    : m_reservation{std::exchange(other.m_reservation, nullptr)},
+      m_reservedBytes{std::exchange(other.m_reservedBytes, 0)},
+      m_data{std::exchange(other.m_data, nullptr)},
+      m_maxBytes{std::exchange(other.m_maxBytes, 0)},
+      m_committedBytes{std::exchange(other.m_committedBytes, 0)},
+      m_granularity{other.m_granularity}
+{
+}
+
+VirtualArrayStorage &VirtualArrayStorage::operator=(VirtualArrayStorage &&other) noexcept
+{
+    if (this != &other)
+    {
+        Release();
+        m_reservation = std::exchange(other.m_reservation, nullptr);
+        m_reservedBytes = std::exchange(other.m_reservedBytes, 0);
+        m_data = std::exchange(other.m_data, nullptr);
+        m_maxBytes = std::exchange(other.m_maxBytes, 0);
+        m_committedBytes = std::exchange(other.m_committedBytes, 0);
+        m_granularity = other.m_granularity;
+    }
+    return *this;
+}
+
+bool VirtualArrayStorage::Grow(size_t bytes)
+{
+    if (bytes > m_maxBytes)
+    {
+        Logger::error("VirtualArray: {} bytes asked, {} bytes reserved.", bytes, m_maxBytes);
+        return false;
+    }
+    const size_t commitEnd = std::min<size_t>(RoundUp64(bytes, m_granularity), m_maxBytes);
+    if (!VirtualMemory::Commit(m_data + m_committedBytes, commitEnd - m_committedBytes))
+        return false;
+    m_committedBytes = commitEnd;
+    return true;
+}
+
+void VirtualArrayStorage::DecommitFrom(size_t bytes)
+{
+    const size_t keep = RoundUp64(bytes, m_granularity);
+    if (keep >= m_committedBytes)
+        return;
+    VirtualMemory::Decommit(m_data + keep, m_committedBytes - keep);
+    m_committedBytes = keep;
+}
+
+void VirtualArrayStorage::Release()
+{
+    VirtualMemory::Release(m_reservation, m_reservedBytes);
+    m_reservation = m_data = nullptr;
+    m_reservedBytes = m_maxBytes = m_committedBytes = 0;
+}
+} // namespace Hawl
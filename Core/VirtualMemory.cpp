@@ -0,0 +1,115 @@
+/**
+ *  Copyright 2020-2021 Zhang QiuLiang (juteman). All rights reserved.
+ *
+ *  This file is a part of Hawl
+ *  see(https://github.com/juteman/Hawl)
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#include "Memory/VirtualMemory.h"
+#include "Logger.h"
+
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <cerrno>
+#include <cstring>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace Hawl
+{
+size_t VirtualMemory::GetPageSize()
+{
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwPageSize;
+#else
+    static const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    return pageSize;
+#endif
+}
+
+void *VirtualMemory::Reserve(size_t size)
+{
+#if defined(_WIN32)
+    void *address = VirtualAlloc(nullptr, size, MEM_RESERVE, PAGE_NOACCESS);
+    if (address == nullptr)
+        Logger::error("VirtualMemory: reserve {} bytes failed, error {}.", size, GetLastError());
+    return address;
+#else
+    void *address = mmap(nullptr, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (address == MAP_FAILED)
+    {
+        Logger::error("VirtualMemory: reserve {} bytes failed, {}.", size, std::strerror(errno));
+        return nullptr;
+    }
+    return address;
+#endif
+}
+
+void VirtualMemory::Release(void *address, size_t size)
+{
+    if (address == nullptr)
+        return;
+#if defined(_WIN32)
+    UNREF_PARAM(size);
+    VirtualFree(address, 0, MEM_RELEASE);
+#else
+    munmap(address, size);
+#endif
+}
+
+bool VirtualMemory::Commit(void *address, size_t size)
+{
+#if defined(_WIN32)
+    if (VirtualAlloc(address, size, MEM_COMMIT, PAGE_READWRITE) == nullptr)
+    {
+        Logger::error("VirtualMemory: commit {} bytes failed, error {}.", size, GetLastError());
+        return false;
+    }
+#else
+    if (mprotect(address, size, PROT_READ | PROT_WRITE) != 0)
+    {
+        Logger::error("VirtualMemory: commit {} bytes failed, {}.", size, std::strerror(errno));
+        return false;
+    }
+#endif
+    return true;
+}
+
+void VirtualMemory::Decommit(void *address, size_t size)
+{
+#if defined(_WIN32)
+    VirtualFree(address, size, MEM_DECOMMIT);
+#else
+    // drop the pages first, a range committed again read zeroes like on Windows
+    madvise(address, size, MADV_DONTNEED);
+    mprotect(address, size, PROT_NONE);
+#endif
+}
+
+void VirtualMemory::AdviseHugePages(void *address, size_t size)
+{
+#if defined(MADV_HUGEPAGE)
+    madvise(address, size, MADV_HUGEPAGE);
+#else
+    UNREF_PARAM(address);
+    UNREF_PARAM(size);
+#endif
+}
+} // namespace Hawl
@@ -0,0 +1,73 @@
+/**
+ *  Copyright 2020-2021 Zhang QiuLiang (juteman). All rights reserved.
+ *
+ *  This file is a part of Hawl
+ *  see(https://github.com/juteman/Hawl)
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#pragma once
+#include "Common.h"
+
+namespace Hawl::Algorithm
+{
+/// function to release a retired object, e.g. delete it or return it to a pool
+using ReclaimFunc = void (*)(void *object);
+
+/// Epoch based memory reclamation shared by all Core lock-free containers.
+///
+/// A thread must hold a Guard while it reads pointers out of a lock-free
+/// structure. An object unlinked from the structure is passed to Retire
+/// instead of being freed, and it is only reclaimed after every thread that
+/// could still see it has left its Guard (the global epoch advanced twice).
+/// Each thread keep its own retire list, so Retire never contend.
+class EpochReclaimer
+{
+public:
+    /// Critical region of the calling thread, can be nested
+    class Guard
+    {
+    public:
+        Guard();
+        ~Guard();
+
+        HAWL_DISABLE_COPY(Guard)
+    };
+
+    /// Defer the release of an object unlinked from a lock-free structure
+    /// @param object pointer to the retired object
+    /// @param reclaim function call when no thread can reference the object
+    static void Retire(void *object, ReclaimFunc reclaim);
+
+    /// Defer the delete of an object unlinked from a lock-free structure
+    /// @param object pointer to the retired object
+    template <typename T>
+    static void Retire(T *object)
+    {
+        Retire(object, [](void *pointer) { delete static_cast<T *>(pointer); });
+    }
+
+    /// Try advance the global epoch and reclaim objects retired by the calling
+    /// thread which are safe to release now. Retire call it periodically.
+    static void Collect();
+
+    /// Grow the retire list of every thread to hold count objects, the calling
+    /// thread at once and the others at their next Collect, so a stalled epoch
+    /// does not allocate. The lists never shrink.
+    static void Reserve(size_t count);
+
+    /// @return the current global epoch, for debug and statistics
+    static uint64 CurrentEpoch();
+};
+} // namespace Hawl::Algorithm
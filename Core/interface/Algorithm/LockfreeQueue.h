@@ -19,18 +19,28 @@
  */
 #pragma once
 #include "Common.h"
+#include "Algorithm/EpochReclaimer.h"
+#include "Algorithm/NodePool.h"
+#include "Thread/EventCount.h"
 #include <atomic>
+#include <chrono>
+#include <new>
+#include <span>
 #include <utility>
 
 namespace Hawl::Algorithm
 {
+/// producer and consumer model of the queue
 enum class QueueModel
 {
+    /// single producer single consumer
     SPSC,
+    /// multiple producer multiple consumer
     MPMC
 };
 
-/// lock free queue implement
+/// lock free queue implement, removed nodes are released through EpochReclaimer
+/// and recycled by NodePool, steady state EnQueue and DeQueue never call malloc
 template <typename T>
 class LockFreeQueue
 {
@@ -61,11 +71,13 @@ private:
         T data;
     };
 
+    using Pool = NodePool<QueueNode>;
+
 public:
     /// Initialize with dummy node
     LockFreeQueue()
     {
-        QueueNode *dummyNode = new QueueNode();
+        QueueNode *dummyNode = Pool::Instance().New();
         m_head.store(dummyNode, std::memory_order_relaxed);
         m_tail.store(dummyNode, std::memory_order_relaxed);
         std::atomic_thread_fence(std::memory_order_seq_cst);
@@ -78,48 +90,42 @@ public:
         {
             QueueNode *temp = m_head.load(std::memory_order_relaxed);
             m_head = temp->next.load();
-            delete temp;
+            Pool::Instance().Delete(temp);
         }
     }
 
     /// Adds an node to the tail of the queue.
     /// @param InData The item to add.
-    /// @return true if the node was added, false for some thread race
-    /// condition
+    /// @return always true, the queue is unbounded and a failed node allocation throws std::bad_alloc
     bool EnQueue(T const &InData)
     {
-        // Create new Node and check if create success
-        QueueNode *newNode = new QueueNode(InData);
+        QueueNode *newNode = Pool::Instance().New(InData);
+        LinkChain(newNode, newNode);
+        m_notEmpty.Notify();
+        return true;
+    }
 
-        if (nullptr == newNode)
-            return false;
+    /// Adds a range of items to the tail of the queue. The nodes are linked
+    /// to each other first, then the whole chain is published with one CAS.
+    /// @param InData The items to add, keep the order in the queue.
+    /// @return always true, like EnQueue
+    bool EnQueueBulk(std::span<const T> InData)
+    {
+        if (InData.empty())
+            return true;
 
-        // concurrent link queue
-        while (true)
+        QueueNode *first = Pool::Instance().New(InData[0]);
+        QueueNode *last = first;
+        for (size_t i = 1; i < InData.size(); ++i)
         {
-            QueueNode *tail = m_tail.load(std::memory_order_acquire);
-
-            QueueNode *tailNext = tail->next.load(std::memory_order_acquire);
-
-            if (tail == m_tail.load(std::memory_order_acquire)) [[likely]]
-            {
-                if (tailNext == nullptr)
-                {
-                    // insert node
-                    if (tail->next.compare_exchange_weak(tailNext, newNode))
-                    {
-                        // set the tail node
-                        return m_tail.compare_exchange_strong(tail, newNode);
-                    }
-                }
-
-                    // if tailNext is not nullptr, fetch the LockFreeQueue tails to next
-                else
-                {
-                    m_tail.compare_exchange_strong(tail, tailNext);
-                }
-            }
+            QueueNode *newNode = Pool::Instance().New(InData[i]);
+            last->next.store(newNode, std::memory_order_relaxed);
+            last = newNode;
         }
+
+        LinkChain(first, last);
+        m_notEmpty.Notify(static_cast<uint32>(InData.size()));
+        return true;
     }
 
     /// pop the element from the queue head
@@ -127,6 +133,7 @@ public:
     /// @return true dequeue success, else the queue is empty
     bool DeQueue(T &outData)
     {
+        EpochReclaimer::Guard guard;
         while (true)
         {
             QueueNode *head = m_head.load(std::memory_order_acquire);
@@ -142,7 +149,7 @@ public:
 
                     // if the head next is not null. must be another
                     // thread EnQueue the element. So fetch tail pointer to the next
-                    m_head.compare_exchange_strong(tail, headNext);
+                    m_tail.compare_exchange_strong(tail, headNext);
                 }
                 else
                 {
@@ -155,7 +162,8 @@ public:
                     outData = headNext->data;
                     if (m_head.compare_exchange_weak(head, headNext))
                     {
-                        free(head);
+                        // other thread may still read head->next, delay the release
+                        EpochReclaimer::Retire(head, &Pool::Reclaim);
                         return true;
                     }
                 }
@@ -163,22 +171,96 @@ public:
         }
     }
 
+    /// pop the element from the queue head, spin a while and then park the
+    /// calling thread if the queue is empty, until an EnQueue wake it
+    /// @param outData get the queue head element
+    /// @param timeout max time to wait, negative for infinite
+    /// @return true dequeue success, false if the timeout expire
+    bool WaitDeQueue(T &outData, std::chrono::nanoseconds timeout = std::chrono::nanoseconds(-1))
+    {
+        return m_notEmpty.Await([&] { return DeQueue(outData); }, timeout);
+    }
+
+    /// pop up to outData.size() elements from the queue head with one CAS
+    /// @param outData span to receive the elements, in queue order
+    /// @return the count of elements written in outData, 0 if the queue is empty
+    size_t DeQueueBulk(std::span<T> outData)
+    {
+        if (outData.empty())
+            return 0;
+
+        EpochReclaimer::Guard guard;
+        while (true)
+        {
+            QueueNode *head = m_head.load(std::memory_order_acquire);
+            QueueNode *tail = m_tail.load(std::memory_order_acquire);
+            QueueNode *headNext = head->next.load(std::memory_order_acquire);
+
+            if (head != m_head.load(std::memory_order_acquire)) [[unlikely]]
+                continue;
+
+            if (headNext == nullptr)
+                return 0;
+
+            if (head == tail)
+            {
+                // tail is lagging, help it before take the element
+                m_tail.compare_exchange_strong(tail, headNext);
+                continue;
+            }
+
+            // walk the chain but never pass the tail, the last taken node become the new dummy head
+            QueueNode *last = head;
+            size_t     count = 0;
+            while (count < outData.size() && last != tail)
+            {
+                QueueNode *next = last->next.load(std::memory_order_acquire);
+                if (next == nullptr)
+                    break;
+                outData[count++] = next->data;
+                last = next;
+            }
+
+            if (m_head.compare_exchange_weak(head, last))
+            {
+                for (QueueNode *node = head; node != last;)
+                {
+                    QueueNode *next = node->next.load(std::memory_order_relaxed);
+                    EpochReclaimer::Retire(node, &Pool::Reclaim);
+                    node = next;
+                }
+                return count;
+            }
+        }
+    }
+
     /// Get the  head  data not remove from LockFreeQueue
     /// @param outData get the data of head
     /// @return if queue empty get false, else get true
     bool Peek(T &outData)
     {
-        /// if head is change by other thread use deque, fetch head to m_head again
-        /// because Peek don't change the head. it will be thread safe
-        for (auto head = m_head.load(std::memory_order_acquire); head != nullptr;
-             head = m_head.load(std::memory_order_acquire))
-        {
-            outData = head->next.load();
-            if (outData)
-                return true;
-        }
+        /// head can't be released while the guard is alive, and the data of
+        /// head next is never changed after EnQueue. it will be thread safe
+        EpochReclaimer::Guard guard;
+        QueueNode *headNext = m_head.load(std::memory_order_acquire)->next.load(std::memory_order_acquire);
+        if (headNext == nullptr)
+            return false;
+
+        outData = headNext->data;
+        return true;
+    }
+
+    /// Preallocate nodes in the node pool of this queue type
+    /// @param count nodes the queues of this type are expected to hold at once
+    static void ReserveNodes(uint32 count)
+    {
+        Pool::Instance().Reserve(count);
+    }
 
-        return false;
+    /// @return how many times the node pool of this queue type request memory from the system
+    static uint64 GetNodeAllocationCount()
+    {
+        return Pool::Instance().GetSystemAllocationCount();
     }
 
     /// check is lock free queue
@@ -196,11 +278,436 @@ public:
     }
 
 private:
+    /// link a chain of nodes already linked with each other to the tail
+    /// @param first the first node of the chain
+    /// @param last the last node of the chain, its next must be null
+    void LinkChain(QueueNode *first, QueueNode *last)
+    {
+        // tail may be dequeued and retired by other thread while we read it
+        EpochReclaimer::Guard guard;
+
+        // concurrent link queue
+        while (true)
+        {
+            QueueNode *tail = m_tail.load(std::memory_order_acquire);
+
+            QueueNode *tailNext = tail->next.load(std::memory_order_acquire);
+
+            if (tail == m_tail.load(std::memory_order_acquire)) [[likely]]
+            {
+                if (tailNext == nullptr)
+                {
+                    // insert chain
+                    if (tail->next.compare_exchange_weak(tailNext, first))
+                    {
+                        // set the tail node, if it fails another thread already help us
+                        m_tail.compare_exchange_strong(tail, last);
+                        return;
+                    }
+                }
+
+                    // if tailNext is not nullptr, fetch the LockFreeQueue tails to next
+                else
+                {
+                    m_tail.compare_exchange_strong(tail, tailNext);
+                }
+            }
+        }
+    }
+
     /// atomic head and  tail
     std::atomic<QueueNode *> m_head;
     std::atomic<QueueNode *> m_tail;
 
+    /// park consumers of WaitDeQueue
+    EventCount m_notEmpty;
+
     /// delete copy constructor and  assign operator
     HAWL_DISABLE_COPY(LockFreeQueue)
 };
+
+/// fixed capacity ring buffer queue, the implement is selected by QueueModel.
+/// All the slot memory is allocated in the constructor, EnQueue and DeQueue
+/// never allocate.
+template <typename T, QueueModel Model>
+class BoundedQueue;
+
+/// single producer single consumer ring buffer.
+/// Only one thread may EnQueue and only one thread may DeQueue at the same time.
+template <typename T>
+class BoundedQueue<T, QueueModel::SPSC>
+{
+private:
+    static constexpr size_t BufferAlignment = alignof(T) > CacheLineSize ? alignof(T) : CacheLineSize;
+
+public:
+    /// Allocate the ring buffer
+    /// @param capacity max element count, round up to power of two
+    explicit BoundedQueue(uint64 capacity)
+        : m_mask{NextPowerOfTwo(capacity < 2 ? 2 : capacity) - 1}
+    {
+        m_buffer = static_cast<T *>(::operator new(sizeof(T) * (m_mask + 1), std::align_val_t{BufferAlignment}));
+    }
+
+    /// Destroy the elements remain in the queue and release the buffer
+    ~BoundedQueue()
+    {
+        for (uint64 i = m_head.load(std::memory_order_relaxed); i != m_tail.load(std::memory_order_relaxed); ++i)
+            m_buffer[i & m_mask].~T();
+        ::operator delete(m_buffer, std::align_val_t{BufferAlignment});
+    }
+
+    /// Adds an element to the tail of the queue, only call from the producer thread
+    /// @param InData The item to add.
+    /// @return true if the element was added, false if the queue is full
+    template <typename U>
+    bool EnQueue(U &&InData)
+    {
+        const uint64 tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_cachedHead > m_mask)
+        {
+            // only read the consumer cache line when our view say full
+            m_cachedHead = m_head.load(std::memory_order_acquire);
+            if (tail - m_cachedHead > m_mask)
+                return false;
+        }
+
+        new (&m_buffer[tail & m_mask]) T(std::forward<U>(InData));
+        m_tail.store(tail + 1, std::memory_order_release);
+        m_notEmpty.Notify();
+        return true;
+    }
+
+    /// pop the element from the queue head, only call from the consumer thread
+    /// @param outData get the queue head element
+    /// @return true dequeue success, else the queue is empty
+    bool DeQueue(T &outData)
+    {
+        const uint64 head = m_head.load(std::memory_order_relaxed);
+        if (head == m_cachedTail)
+        {
+            // only read the producer cache line when our view say empty
+            m_cachedTail = m_tail.load(std::memory_order_acquire);
+            if (head == m_cachedTail)
+                return false;
+        }
+
+        T &slot = m_buffer[head & m_mask];
+        outData = std::move(slot);
+        slot.~T();
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// pop the element from the queue head, spin a while and then park the
+    /// calling thread if the queue is empty, until an EnQueue wake it
+    /// @param outData get the queue head element
+    /// @param timeout max time to wait, negative for infinite
+    /// @return true dequeue success, false if the timeout expire
+    bool WaitDeQueue(T &outData, std::chrono::nanoseconds timeout = std::chrono::nanoseconds(-1))
+    {
+        return m_notEmpty.Await([&] { return DeQueue(outData); }, timeout);
+    }
+
+    /// Adds as many items as fit in the free slots, publish them with one store
+    /// @param InData The items to add, keep the order in the queue.
+    /// @return the count of items added from the front of InData
+    size_t EnQueueBulk(std::span<const T> InData)
+    {
+        const uint64 tail = m_tail.load(std::memory_order_relaxed);
+        if (tail + InData.size() - m_cachedHead > m_mask + 1)
+            m_cachedHead = m_head.load(std::memory_order_acquire);
+
+        const uint64 freeCount = m_mask + 1 - (tail - m_cachedHead);
+        const size_t count = InData.size() < freeCount ? InData.size() : static_cast<size_t>(freeCount);
+        for (size_t i = 0; i < count; ++i)
+            new (&m_buffer[(tail + i) & m_mask]) T(InData[i]);
+        m_tail.store(tail + count, std::memory_order_release);
+        if (count != 0)
+            m_notEmpty.Notify(static_cast<uint32>(count));
+        return count;
+    }
+
+    /// pop up to outData.size() elements, release the slots with one store
+    /// @param outData span to receive the elements, in queue order
+    /// @return the count of elements written in outData, 0 if the queue is empty
+    size_t DeQueueBulk(std::span<T> outData)
+    {
+        const uint64 head = m_head.load(std::memory_order_relaxed);
+        if (head + outData.size() > m_cachedTail)
+            m_cachedTail = m_tail.load(std::memory_order_acquire);
+
+        const uint64 readyCount = m_cachedTail - head;
+        const size_t count = outData.size() < readyCount ? outData.size() : static_cast<size_t>(readyCount);
+        for (size_t i = 0; i < count; ++i)
+        {
+            T &slot = m_buffer[(head + i) & m_mask];
+            outData[i] = std::move(slot);
+            slot.~T();
+        }
+        m_head.store(head + count, std::memory_order_release);
+        return count;
+    }
+
+    /// check the queue is empty
+    /// @return true if empty, false for no empty
+    bool IsEmpty() const
+    {
+        return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+    }
+
+    /// @return max element count the queue can hold
+    uint64 Capacity() const
+    {
+        return m_mask + 1;
+    }
+
+private:
+    /// consumer owned cache line
+    alignas(CacheLineSize) std::atomic<uint64> m_head{0};
+    uint64 m_cachedTail = 0;
+
+    /// producer owned cache line
+    alignas(CacheLineSize) std::atomic<uint64> m_tail{0};
+    uint64 m_cachedHead = 0;
+
+    /// read only after construct
+    alignas(CacheLineSize) T *m_buffer;
+    const uint64 m_mask;
+
+    /// park the consumer of WaitDeQueue
+    EventCount m_notEmpty;
+
+    HAWL_DISABLE_COPY(BoundedQueue)
+};
+
+/// multiple producer multiple consumer ring buffer.
+/// Each slot carry a sequence number, so producer and consumer claim a slot
+/// with a single CAS on the tail or head index (Dmitry Vyukov's bounded queue).
+template <typename T>
+class BoundedQueue<T, QueueModel::MPMC>
+{
+private:
+    struct Slot
+    {
+        /// equal to the index when the slot is writable,
+        /// index + 1 when the slot hold data ready to read
+        std::atomic<uint64> sequence;
+
+        /// raw storage of the element
+        alignas(T) unsigned char storage[sizeof(T)];
+
+        T *Data()
+        {
+            return std::launder(reinterpret_cast<T *>(storage));
+        }
+    };
+
+public:
+    /// Allocate the ring buffer
+    /// @param capacity max element count, round up to power of two
+    explicit BoundedQueue(uint64 capacity)
+        : m_mask{NextPowerOfTwo(capacity < 2 ? 2 : capacity) - 1}
+    {
+        m_slots = static_cast<Slot *>(::operator new(sizeof(Slot) * (m_mask + 1), std::align_val_t{CacheLineSize}));
+        for (uint64 i = 0; i <= m_mask; ++i)
+            new (&m_slots[i].sequence) std::atomic<uint64>(i);
+    }
+
+    /// Destroy the elements remain in the queue and release the buffer
+    ~BoundedQueue()
+    {
+        for (uint64 i = m_head.load(std::memory_order_relaxed); i != m_tail.load(std::memory_order_relaxed); ++i)
+            m_slots[i & m_mask].Data()->~T();
+        ::operator delete(m_slots, std::align_val_t{CacheLineSize});
+    }
+
+    /// Adds an element to the tail of the queue
+    /// @param InData The item to add.
+    /// @return true if the element was added, false if the queue is full
+    template <typename U>
+    bool EnQueue(U &&InData)
+    {
+        uint64 pos = m_tail.load(std::memory_order_relaxed);
+        Slot  *slot;
+        while (true)
+        {
+            slot = &m_slots[pos & m_mask];
+            const uint64 seq = slot->sequence.load(std::memory_order_acquire);
+            const int64  diff = static_cast<int64>(seq - pos);
+            if (diff == 0)
+            {
+                if (m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            // the slot still hold the element of last round, queue is full
+            else if (diff < 0)
+                return false;
+            // another producer take this slot, fetch the tail again
+            else
+                pos = m_tail.load(std::memory_order_relaxed);
+        }
+
+        new (slot->storage) T(std::forward<U>(InData));
+        slot->sequence.store(pos + 1, std::memory_order_release);
+        m_notEmpty.Notify();
+        return true;
+    }
+
+    /// pop the element from the queue head
+    /// @param outData get the queue head element
+    /// @return true dequeue success, else the queue is empty
+    bool DeQueue(T &outData)
+    {
+        uint64 pos = m_head.load(std::memory_order_relaxed);
+        Slot  *slot;
+        while (true)
+        {
+            slot = &m_slots[pos & m_mask];
+            const uint64 seq = slot->sequence.load(std::memory_order_acquire);
+            const int64  diff = static_cast<int64>(seq - (pos + 1));
+            if (diff == 0)
+            {
+                if (m_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            // producer have not publish this slot yet, queue is empty
+            else if (diff < 0)
+                return false;
+            // another consumer take this slot, fetch the head again
+            else
+                pos = m_head.load(std::memory_order_relaxed);
+        }
+
+        T *data = slot->Data();
+        outData = std::move(*data);
+        data->~T();
+        // mark the slot writable for the producer of next round
+        slot->sequence.store(pos + m_mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// pop the element from the queue head, spin a while and then park the
+    /// calling thread if the queue is empty, until an EnQueue wake it
+    /// @param outData get the queue head element
+    /// @param timeout max time to wait, negative for infinite
+    /// @return true dequeue success, false if the timeout expire
+    bool WaitDeQueue(T &outData, std::chrono::nanoseconds timeout = std::chrono::nanoseconds(-1))
+    {
+        return m_notEmpty.Await([&] { return DeQueue(outData); }, timeout);
+    }
+
+    /// Claim a contiguous range of free slots with one CAS and fill it
+    /// @param InData The items to add, keep the order in the queue.
+    /// @return the count of items added from the front of InData, 0 if the queue is full
+    size_t EnQueueBulk(std::span<const T> InData)
+    {
+        if (InData.empty())
+            return 0;
+
+        uint64 pos = m_tail.load(std::memory_order_relaxed);
+        size_t count;
+        while (true)
+        {
+            // slot sequence only move forward, so a slot seen writable stay ours once the CAS succeed
+            count = 0;
+            while (count < InData.size() && count <= m_mask &&
+                   m_slots[(pos + count) & m_mask].sequence.load(std::memory_order_acquire) == pos + count)
+                ++count;
+
+            if (count == 0)
+            {
+                const int64 diff =
+                    static_cast<int64>(m_slots[pos & m_mask].sequence.load(std::memory_order_acquire) - pos);
+                if (diff < 0)
+                    return 0;
+                pos = m_tail.load(std::memory_order_relaxed);
+                continue;
+            }
+
+            if (m_tail.compare_exchange_weak(pos, pos + count, std::memory_order_relaxed))
+                break;
+        }
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            Slot &slot = m_slots[(pos + i) & m_mask];
+            new (slot.storage) T(InData[i]);
+            slot.sequence.store(pos + i + 1, std::memory_order_release);
+        }
+        m_notEmpty.Notify(static_cast<uint32>(count));
+        return count;
+    }
+
+    /// Claim a contiguous range of ready slots with one CAS and drain it
+    /// @param outData span to receive the elements, in queue order
+    /// @return the count of elements written in outData, 0 if the queue is empty
+    size_t DeQueueBulk(std::span<T> outData)
+    {
+        if (outData.empty())
+            return 0;
+
+        uint64 pos = m_head.load(std::memory_order_relaxed);
+        size_t count;
+        while (true)
+        {
+            count = 0;
+            while (count < outData.size() && count <= m_mask &&
+                   m_slots[(pos + count) & m_mask].sequence.load(std::memory_order_acquire) == pos + count + 1)
+                ++count;
+
+            if (count == 0)
+            {
+                const int64 diff =
+                    static_cast<int64>(m_slots[pos & m_mask].sequence.load(std::memory_order_acquire) - (pos + 1));
+                if (diff < 0)
+                    return 0;
+                pos = m_head.load(std::memory_order_relaxed);
+                continue;
+            }
+
+            if (m_head.compare_exchange_weak(pos, pos + count, std::memory_order_relaxed))
+                break;
+        }
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            Slot &slot = m_slots[(pos + i) & m_mask];
+            T    *data = slot.Data();
+            outData[i] = std::move(*data);
+            data->~T();
+            slot.sequence.store(pos + i + m_mask + 1, std::memory_order_release);
+        }
+        return count;
+    }
+
+    /// check the queue is empty, the result may be stale under concurrency
+    /// @return true if empty, false for no empty
+    bool IsEmpty() const
+    {
+        return m_head.load(std::memory_order_acquire) >= m_tail.load(std::memory_order_acquire);
+    }
+
+    /// @return max element count the queue can hold
+    uint64 Capacity() const
+    {
+        return m_mask + 1;
+    }
+
+private:
+    /// consumer claim index
+    alignas(CacheLineSize) std::atomic<uint64> m_head{0};
+
+    /// producer claim index
+    alignas(CacheLineSize) std::atomic<uint64> m_tail{0};
+
+    /// read only after construct
+    alignas(CacheLineSize) Slot *m_slots;
+    const uint64 m_mask;
+
+    /// park consumers of WaitDeQueue
+    EventCount m_notEmpty;
+
+    HAWL_DISABLE_COPY(BoundedQueue)
+};
 } // namespace Hawl::Algorithm
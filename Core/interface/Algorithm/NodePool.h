@@ -0,0 +1,232 @@
+/**
+ *  Copyright 2020-2021 Zhang QiuLiang (juteman). All rights reserved.
+ *
+ *  This file is a part of Hawl
+ *  see(https://github.com/juteman/Hawl)
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#pragma once
+#include "Common.h"
+#include "Algorithm/TaggedStack.h"
+#include <atomic>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+namespace Hawl::Algorithm
+{
+/// Lock free pool recycling fixed size nodes of lock-free containers.
+///
+/// Each thread keep a local free list, New and Delete only touch it. When the
+/// local list run empty (or grow too long) a whole batch of nodes move from (to)
+/// a global lock free stack with a single CAS. Memory is only requested from the
+/// system when the global stack is empty too, so steady state never call malloc.
+/// The pool is immortal, memory is kept for reuse until process exit.
+template <typename Node>
+class NodePool
+{
+private:
+    /// nodes move between the thread cache and the global stack by this count
+    static constexpr uint32 BatchSize = 64;
+
+    struct Block
+    {
+        union
+        {
+            /// next free block while the block is not used
+            Block *next;
+            alignas(Node) unsigned char storage[sizeof(Node)];
+        };
+    };
+
+    /// system memory chunk, linked only to keep it reachable
+    struct Slab
+    {
+        Slab *next;
+        Block blocks[BatchSize];
+    };
+
+    /// header of a batch in the global stack. Headers are never freed and only
+    /// link through an atomic, so a thread reading a stale header is harmless
+    struct Batch
+    {
+        std::atomic<Batch *> next{nullptr};
+        Block *blocks = nullptr;
+        uint32 count = 0;
+        /// all the headers ever created, linked only to keep them reachable
+        Batch *allocatedNext = nullptr;
+    };
+
+    /// stack of batch headers, the headers are immortal as TaggedStack need
+    using BatchStack = TaggedStack<Batch>;
+
+    struct LocalCache
+    {
+        Block *head = nullptr;
+        uint32 count = 0;
+
+        /// give the cached nodes back to the global stack on thread exit
+        ~LocalCache()
+        {
+            while (head != nullptr)
+                Instance().Flush(*this);
+        }
+    };
+
+public:
+    /// @return the pool shared by all the containers of this node type
+    static NodePool &Instance()
+    {
+        static NodePool *pool = new NodePool();
+        return *pool;
+    }
+
+    /// Construct a node in a recycled block
+    template <typename... Args>
+    Node *New(Args &&...args)
+    {
+        LocalCache &cache = GetCache();
+        if (cache.head == nullptr)
+            Refill(cache);
+
+        Block *block = cache.head;
+        cache.head = block->next;
+        --cache.count;
+        return new (block->storage) Node(std::forward<Args>(args)...);
+    }
+
+    /// Destroy a node and keep its block in the calling thread cache
+    void Delete(Node *node)
+    {
+        node->~Node();
+        Block *block = reinterpret_cast<Block *>(node);
+
+        LocalCache &cache = GetCache();
+        block->next = cache.head;
+        cache.head = block;
+        if (++cache.count >= BatchSize * 2)
+            Flush(cache);
+    }
+
+    /// Put at least count more nodes in the global stack, so a workload needing
+    /// them later take them from the stack instead of the system
+    void Reserve(uint32 count)
+    {
+        for (uint32 reserved = 0; reserved < count; reserved += BatchSize)
+        {
+            LocalCache slab;
+            NewSlab(slab);
+            Flush(slab);
+        }
+    }
+
+    /// ReclaimFunc for EpochReclaimer, return a retired node to the pool
+    static void Reclaim(void *node)
+    {
+        Instance().Delete(static_cast<Node *>(node));
+    }
+
+    /// @return how many times the pool request memory from the system
+    uint64 GetSystemAllocationCount() const
+    {
+        return m_systemAllocations.load(std::memory_order_relaxed);
+    }
+
+private:
+    NodePool() = default;
+
+    static LocalCache &GetCache()
+    {
+        static thread_local LocalCache cache;
+        return cache;
+    }
+
+    /// push only list of system memory, never popped so it is free of ABA
+    template <typename U>
+    static void PushAllocated(std::atomic<U *> &head, U *object, U *U::*next)
+    {
+        U *oldHead = head.load(std::memory_order_relaxed);
+        do
+        {
+            object->*next = oldHead;
+        } while (!head.compare_exchange_weak(oldHead, object, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    /// move up to one batch from the local cache to the global stack
+    void Flush(LocalCache &cache)
+    {
+        Batch *batch = m_emptyBatches.Pop();
+        if (batch == nullptr)
+        {
+            batch = new Batch();
+            m_systemAllocations.fetch_add(1, std::memory_order_relaxed);
+            PushAllocated(m_allocatedBatches, batch, &Batch::allocatedNext);
+        }
+
+        Block *last = cache.head;
+        uint32 count = 1;
+        while (count < BatchSize && last->next != nullptr)
+        {
+            last = last->next;
+            ++count;
+        }
+        batch->blocks = cache.head;
+        batch->count = count;
+        cache.head = last->next;
+        cache.count -= count;
+        last->next = nullptr;
+
+        m_fullBatches.Push(batch);
+    }
+
+    /// take one batch from the global stack, or carve a new slab if it is empty
+    void Refill(LocalCache &cache)
+    {
+        if (Batch *batch = m_fullBatches.Pop())
+        {
+            cache.head = batch->blocks;
+            cache.count = batch->count;
+            m_emptyBatches.Push(batch);
+            return;
+        }
+
+        NewSlab(cache);
+    }
+
+    /// carve a slab from the system in an empty cache
+    void NewSlab(LocalCache &cache)
+    {
+        Slab *slab = new Slab();
+        m_systemAllocations.fetch_add(1, std::memory_order_relaxed);
+        PushAllocated(m_slabs, slab, &Slab::next);
+
+        for (uint32 i = 0; i < BatchSize; ++i)
+            slab->blocks[i].next = i + 1 < BatchSize ? &slab->blocks[i + 1] : nullptr;
+        cache.head = &slab->blocks[0];
+        cache.count = BatchSize;
+    }
+
+    /// batches of free nodes
+    BatchStack m_fullBatches;
+    /// recycled headers, kept apart from node memory so they are never overwritten
+    BatchStack m_emptyBatches;
+
+    alignas(CacheLineSize) std::atomic<Slab *> m_slabs{nullptr};
+    std::atomic<Batch *> m_allocatedBatches{nullptr};
+    std::atomic<uint64> m_systemAllocations{0};
+
+    HAWL_DISABLE_COPY(NodePool)
+};
+} // namespace Hawl::Algorithm
@@ -0,0 +1,77 @@
+/**
+ *  Copyright 2020-2021 Zhang QiuLiang (juteman). All rights reserved.
+ *
+ *  This file is a part of Hawl
+ *  see(https://github.com/juteman/Hawl)
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#pragma once
+#include "Common.h"
+#include <atomic>
+#include <cstdint>
+
+namespace Hawl::Algorithm
+{
+/// Treiber stack of immortal nodes, the head pointer is packed with an ABA tag
+///
+/// Node must have a std::atomic<Node *> next member. A node may be popped and
+/// pushed again while another thread read its next link, then the tag make the
+/// CAS of that thread fail and the stale link is discarded, so the nodes must
+/// never be freed while the stack is in use.
+template <typename Node>
+class TaggedStack
+{
+public:
+    void Push(Node *node)
+    {
+        uint64 oldValue = m_head.load(std::memory_order_relaxed);
+        do
+        {
+            node->next.store(Unpack(oldValue), std::memory_order_relaxed);
+        } while (!m_head.compare_exchange_weak(
+            oldValue, Pack(node, oldValue), std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    Node *Pop()
+    {
+        uint64 oldValue = m_head.load(std::memory_order_acquire);
+        while (Node *node = Unpack(oldValue))
+        {
+            Node *next = node->next.load(std::memory_order_relaxed);
+            if (m_head.compare_exchange_weak(
+                    oldValue, Pack(next, oldValue), std::memory_order_acquire, std::memory_order_acquire))
+                return node;
+        }
+        return nullptr;
+    }
+
+private:
+    /// pointer in the low bits, tag in the high bits
+    static constexpr uint32 PointerBits = PTR_SIZE == 8 ? 48 : 32;
+
+    static Node *Unpack(uint64 value)
+    {
+        return reinterpret_cast<Node *>(static_cast<uintptr_t>(value & ((uint64(1) << PointerBits) - 1)));
+    }
+
+    static uint64 Pack(Node *node, uint64 oldValue)
+    {
+        const uint64 tag = (oldValue >> PointerBits) + 1;
+        return (tag << PointerBits) | static_cast<uint64>(reinterpret_cast<uintptr_t>(node));
+    }
+
+    alignas(CacheLineSize) std::atomic<uint64> m_head{0};
+};
+} // namespace Hawl::Algorithm
@@ -0,0 +1,185 @@
+/**
+ *  Copyright 2020-2021 Zhang QiuLiang (juteman). All rights reserved.
+ *
+ *  This file is a part of Hawl
+ *  see(https://github.com/juteman/Hawl)
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#pragma once
+#include "Common.h"
+#include "Algorithm/EpochReclaimer.h"
+#include <atomic>
+#include <type_traits>
+
+namespace Hawl::Algorithm
+{
+/// Chase-Lev work stealing deque (the C11 memory model version of Le et al.)
+///
+/// Only the owner thread may Push and Pop, at the bottom end. Any thread may
+/// Steal from the top end. The buffer grows when full, the old buffer is
+/// released through EpochReclaimer since thieves may still read it.
+template <typename T>
+class WorkStealingDeque
+{
+    static_assert(std::is_trivially_copyable<T>::value, "WorkStealingDeque element must be trivially copyable");
+
+private:
+    /// circular buffer, the capacity is power of two
+    struct Array
+    {
+        explicit Array(int64 InCapacity)
+            : capacity{InCapacity}, mask{InCapacity - 1}, slots{new std::atomic<T>[InCapacity]}
+        {
+        }
+
+        ~Array()
+        {
+            delete[] slots;
+        }
+
+        T Get(int64 index) const
+        {
+            return slots[index & mask].load(std::memory_order_relaxed);
+        }
+
+        void Put(int64 index, T value)
+        {
+            slots[index & mask].store(value, std::memory_order_relaxed);
+        }
+
+        const int64     capacity;
+        const int64     mask;
+        std::atomic<T> *slots;
+
+        HAWL_DISABLE_COPY(Array)
+    };
+
+public:
+    /// @param capacity initial capacity, round up to power of two
+    explicit WorkStealingDeque(uint32 capacity = 256)
+    {
+        m_array.store(new Array(static_cast<int64>(NextPowerOfTwo(capacity < 2 ? 2 : capacity))),
+                      std::memory_order_relaxed);
+    }
+
+    ~WorkStealingDeque()
+    {
+        delete m_array.load(std::memory_order_relaxed);
+    }
+
+    /// Push an element at the bottom, owner thread only
+    /// @param InData The item to push
+    void Push(T InData)
+    {
+        const int64 bottom = m_bottom.load(std::memory_order_relaxed);
+        const int64 top = m_top.load(std::memory_order_acquire);
+        Array      *array = m_array.load(std::memory_order_relaxed);
+        if (bottom - top > array->capacity - 1)
+            array = Grow(array, top, bottom);
+
+        array->Put(bottom, InData);
+        // publish the slot (and everything the owner wrote before) to the thieves
+        m_bottom.store(bottom + 1, std::memory_order_release);
+    }
+
+    /// Pop the latest pushed element from the bottom, owner thread only
+    /// @param outData get the element
+    /// @return false if the deque is empty
+    bool Pop(T &outData)
+    {
+        const int64 bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+        Array      *array = m_array.load(std::memory_order_relaxed);
+        m_bottom.store(bottom, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64 top = m_top.load(std::memory_order_relaxed);
+
+        if (top > bottom)
+        {
+            // empty, restore the bottom
+            m_bottom.store(bottom + 1, std::memory_order_relaxed);
+            return false;
+        }
+
+        outData = array->Get(bottom);
+        if (top == bottom)
+        {
+            // last element, race against thieves for it
+            const bool won =
+                m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+            m_bottom.store(bottom + 1, std::memory_order_relaxed);
+            return won;
+        }
+        return true;
+    }
+
+    /// Steal the oldest element from the top, any thread
+    /// @param outData get the element
+    /// @return false if the deque is empty or another thread win the element
+    bool Steal(T &outData)
+    {
+        // the owner may replace and retire the array while we read it
+        EpochReclaimer::Guard guard;
+
+        int64 top = m_top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const int64 bottom = m_bottom.load(std::memory_order_acquire);
+        if (top >= bottom)
+            return false;
+
+        Array *array = m_array.load(std::memory_order_acquire);
+        T      value = array->Get(top);
+        if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            return false;
+
+        outData = value;
+        return true;
+    }
+
+    /// @return element count, may be stale when called out of the owner thread
+    int64 Size() const
+    {
+        const int64 bottom = m_bottom.load(std::memory_order_relaxed);
+        const int64 top = m_top.load(std::memory_order_relaxed);
+        return bottom > top ? bottom - top : 0;
+    }
+
+    /// check the deque is empty, may be stale when called out of the owner thread
+    bool IsEmpty() const
+    {
+        return Size() == 0;
+    }
+
+private:
+    /// double the buffer, owner thread only
+    Array *Grow(Array *array, int64 top, int64 bottom)
+    {
+        Array *newArray = new Array(array->capacity * 2);
+        for (int64 i = top; i < bottom; ++i)
+            newArray->Put(i, array->Get(i));
+        m_array.store(newArray, std::memory_order_release);
+        EpochReclaimer::Retire(array);
+        return newArray;
+    }
+
+    /// thieves side
+    alignas(CacheLineSize) std::atomic<int64> m_top{0};
+
+    /// owner side
+    alignas(CacheLineSize) std::atomic<int64> m_bottom{0};
+    std::atomic<Array *> m_array{nullptr};
+
+    HAWL_DISABLE_COPY(WorkStealingDeque)
+};
+} // namespace Hawl::Algorithm
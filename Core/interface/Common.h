@@ -54,6 +54,16 @@
 #endif
 #endif
 
+#ifndef NOINLINE
+#if defined(__GNUC__)
+#define NOINLINE __attribute__((noinline))
+#elif defined(_MSC_VER)
+#define NOINLINE __declspec(noinline)
+#else
+#define NOINLINE
+#endif
+#endif
+
 #ifdef __cplusplus
 #define HAWL_C_API extern "C"
 #endif
@@ -88,6 +98,11 @@
 
 namespace Hawl
 {
+/**
+ * \brief size of a cpu cache line, use to pad shared atomic data apart and avoid false sharing
+ */
+constexpr uint32 CacheLineSize = 64;
+
 /**
  * \brief aligned a number to up to near multiple
  *
@@ -108,4 +123,17 @@ static inline uint64 RoundUp64(uint64 value, uint64 multiple)
 {
     return ((value + multiple - 1) / multiple) * multiple;
 }
+
+/**
+ * \brief round a number up to the next power of two
+ *
+ * For example NextPowerOfTwo(5) => 8 , NextPowerOfTwo(16) => 16 , NextPowerOfTwo(0) => 1
+ */
+static inline uint64 NextPowerOfTwo(uint64 value)
+{
+    uint64 result = 1;
+    while (result < value)
+        result <<= 1;
+    return result;
+}
 } // namespace Hawl
@@ -0,0 +1,212 @@
+/**
+ *  Copyright 2020-2021 Zhang QiuLiang (juteman). All rights reserved.
+ *
+ *  This file is a part of Hawl
+ *  see(https://github.com/juteman/Hawl)
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#pragma once
+#include "BaseType.h"
+#include "Common.h"
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace Hawl
+{
+/**
+ * \brief Linear allocator of the transient data of a frame, N frames in flight
+ *
+ * The address space of all the frames is reserved once and committed as the
+ * frames grow, the pages stay committed from then. Every thread bump its own
+ * block of the current frame without atomics, and take a new block from the
+ * frame with one fetch_add when it is full. Nothing is freed one by one,
+ * BeginFrame reset the whole region of the frame it reuse in O(1).
+ *
+ * A frame is reused frameCount frames later, BeginFrame must only be called
+ * once the gpu is done with it, after waiting the fence of its swapchain image,
+ * and while no thread allocate. Destructors of the allocated objects never run.
+ */
+class FrameAllocator
+{
+public:
+    /// MAX_SWAPCHAIN_IMAGES of the renderer
+    static constexpr uint32 DefaultFrameCount = 3;
+    /// what a thread take from the frame at a time
+    static constexpr size_t ThreadBlockSize = 64 * 1024;
+
+    /**
+     * \param frameCapacity bytes of every frame, rounded up to the huge page size
+     * \param frameCount frames in flight
+     */
+    explicit FrameAllocator(size_t frameCapacity, uint32 frameCount = DefaultFrameCount);
+    ~FrameAllocator();
+
+    /**
+     * \brief Move to the next frame and reset its region
+     * \return index of the new current frame
+     */
+    uint32 BeginFrame();
+
+    /**
+     * \brief Allocate from the current frame, valid until the frame is begun again
+     * \param alignment power of two
+     * \return nullptr when the frame is full
+     */
+    void *Allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+    /**
+     * \brief Construct a T in the current frame, its destructor is never called
+     */
+    template <typename T, typename... Args>
+    T *New(Args &&...args)
+    {
+        static_assert(std::is_trivially_destructible<T>::value, "frame objects are never destroyed");
+        void *memory = Allocate(sizeof(T), alignof(T));
+        return memory != nullptr ? new (memory) T(std::forward<Args>(args)...) : nullptr;
+    }
+
+    uint32 GetFrameIndex() const
+    {
+        return m_frameIndex;
+    }
+
+    uint32 GetFrameCount() const
+    {
+        return m_frameCount;
+    }
+
+    size_t GetFrameCapacity() const
+    {
+        return m_frameCapacity;
+    }
+
+    /**
+     * \return bytes taken from the current frame, the blocks of the threads count whole
+     */
+    size_t GetUsedSize() const
+    {
+        const size_t used = m_frames[m_frameIndex].used.load(std::memory_order_relaxed);
+        return used < m_frameCapacity ? used : m_frameCapacity;
+    }
+
+private:
+    struct alignas(CacheLineSize) Frame
+    {
+        /// bump offset of the blocks taken by the threads
+        std::atomic<size_t> used{0};
+        /// bytes backed by pages from the start of the frame
+        std::atomic<size_t> committed{0};
+        char               *base = nullptr;
+    };
+
+    /// pages are committed by this much
+    static constexpr size_t CommitSize = 2 * 1024 * 1024;
+
+    /// take a range of the current frame, commit its pages if needed
+    char *TakeRange(size_t size);
+
+    std::unique_ptr<Frame[]> m_frames;
+    /// the frames start at the first huge page boundary of the reservation
+    char                    *m_reservation = nullptr;
+    size_t                   m_reservedSize = 0;
+    size_t                   m_frameCapacity = 0;
+    const uint32             m_frameCount;
+    uint32                   m_frameIndex = 0;
+    /// unique over every allocator, a block of a previous frame or of a dead allocator never match
+    std::atomic<uint64> m_generation{0};
+    /// block of the threads used for this allocator
+    const uint32        m_slot;
+    std::mutex          m_commitMutex;
+
+    HAWL_DISABLE_COPY(FrameAllocator)
+};
+
+/**
+ * \brief EASTL allocator over a FrameAllocator, eastl::vector<T, FrameEastlAllocator>
+ *
+ * deallocate does nothing, the memory goes back with the frame. A container
+ * must not outlive its frame. There is no constructor from a name only, so a
+ * container built without a FrameAllocator does not compile.
+ */
+class FrameEastlAllocator
+{
+public:
+    explicit FrameEastlAllocator(FrameAllocator &allocator, const char *name = "FrameEastlAllocator")
+        : m_allocator{&allocator}
+    {
+        set_name(name);
+    }
+
+    void *allocate(size_t n, int = 0)
+    {
+        return m_allocator->Allocate(n);
+    }
+
+    void *allocate(size_t n, size_t alignment, size_t offset, int = 0)
+    {
+        // EASTL want the address past offset aligned, take offset more and shift the block
+        if (offset % alignment == 0)
+            return m_allocator->Allocate(n, alignment);
+        char *memory = static_cast<char *>(m_allocator->Allocate(n + alignment, alignment));
+        return memory != nullptr ? memory + alignment - offset % alignment : nullptr;
+    }
+
+    void deallocate(void *, size_t)
+    {
+    }
+
+    const char *get_name() const
+    {
+#if EASTL_NAME_ENABLED
+        return m_name;
+#else
+        return "FrameEastlAllocator";
+#endif
+    }
+
+    void set_name([[maybe_unused]] const char *name)
+    {
+#if EASTL_NAME_ENABLED
+        m_name = name;
+#endif
+    }
+
+    FrameAllocator *GetFrameAllocator() const
+    {
+        return m_allocator;
+    }
+
+private:
+    FrameAllocator *m_allocator = nullptr;
+#if EASTL_NAME_ENABLED
+    const char *m_name = nullptr;
+#endif
+};
+
+inline bool operator==(const FrameEastlAllocator &a, const FrameEastlAllocator &b)
+{
+    return a.GetFrameAllocator() == b.GetFrameAllocator();
+}
+
+inline bool operator!=(const FrameEastlAllocator &a, const FrameEastlAllocator &b)
+{
+    return !(a == b);
+}
+} // namespace Hawl
@@ -0,0 +1,149 @@
+/**
+ *  Copyright 2020-2021 Zhang QiuLiang (juteman). All rights reserved.
+ *
+ *  This file is a part of Hawl
+ *  see(https://github.com/juteman/Hawl)
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#pragma once
+#include "BaseType.h"
+#include "Common.h"
+#include "Memory/MemoryTracker.h"
+#include <cstddef>
+
+namespace Hawl
+{
+/**
+ * \brief Live blocks of a MemoryHeap, summed over all the threads
+ */
+struct HeapStats
+{
+    /// usable size of the live blocks
+    int64  liveBytes = 0;
+    int64  liveCount = 0;
+    /// allocations since start
+    uint64 allocationCount = 0;
+    /// Destroy calls since start
+    uint64 destroyCount = 0;
+};
+
+/**
+ * \brief One mimalloc heap per subsystem, so the blocks of a subsystem share their pages
+ *
+ * The heaps are keyed by MemoryTag and report every block to MemoryTracker
+ * under their tag, so the memory of a subsystem is counted there with the
+ * allocations of the other allocators.
+ *
+ * A mimalloc heap allocates on its own thread only, so every thread get its
+ * own heap of a tag on its first allocation. A block may be freed from any
+ * thread, with the tag it was allocated with. Every thread heap counts its
+ * live blocks, a block freed by another thread finds its heap among the heaps
+ * of the tag, and GetStats sums them, cheap enough to poll every frame.
+ *
+ * Destroy free all the blocks the calling thread allocated from a tag at
+ * once, e.g. the Assets heap of the loading thread when a level unload, and
+ * drops the counts of its heap without walking the blocks. The containers
+ * over those blocks must then be dropped without freeing them,
+ * eastl::vector::reset_lose_memory, and no other thread may free a block of
+ * the heap meanwhile. The heaps of an exiting thread are merged in the
+ * default mimalloc heap, their blocks stay valid. A thread_local destructor
+ * running after that allocate from the default heap, and Destroy does nothing.
+ */
+class MemoryHeap
+{
+public:
+    static constexpr size_t DefaultAlignment = 16;
+
+    /// \param offset the address offset bytes past the block is aligned
+    static void *Allocate(MemoryTag tag, size_t size, size_t alignment = DefaultAlignment, size_t offset = 0);
+    /// zeroed count * size bytes
+    static void *Calloc(MemoryTag tag, size_t count, size_t size, size_t alignment = DefaultAlignment);
+    static void Free(MemoryTag tag, void *block);
+
+    /// free every block the calling thread allocated from the heap of tag
+    static void Destroy(MemoryTag tag);
+
+    static HeapStats GetStats(MemoryTag tag);
+    /// one line per heap in the log
+    static void LogStats();
+};
+
+/**
+ * \brief EASTL allocator over the MemoryHeap of a tag, eastl::vector<T, HeapEastlAllocator<MemoryTag::Assets>>
+ */
+template <MemoryTag Tag>
+class HeapEastlAllocator
+{
+public:
+    explicit HeapEastlAllocator(const char *name = MemoryTracker::GetTagName(Tag))
+    {
+        set_name(name);
+    }
+
+    void *allocate(size_t n, int = 0)
+    {
+        return MemoryHeap::Allocate(Tag, n);
+    }
+
+    void *allocate(size_t n, size_t alignment, size_t offset, int = 0)
+    {
+        return MemoryHeap::Allocate(Tag, n, alignment, offset);
+    }
+
+    void deallocate(void *block, size_t)
+    {
+        MemoryHeap::Free(Tag, block);
+    }
+
+    const char *get_name() const
+    {
+#if EASTL_NAME_ENABLED
+        return m_name;
+#else
+        return MemoryTracker::GetTagName(Tag);
+#endif
+    }
+
+    void set_name([[maybe_unused]] const char *name)
+    {
+#if EASTL_NAME_ENABLED
+        m_name = name;
+#endif
+    }
+
+private:
+#if EASTL_NAME_ENABLED
+    const char *m_name = nullptr;
+#endif
+};
+
+/// all the allocators of a tag share the heap
+template <MemoryTag Tag>
+inline bool operator==(const HeapEastlAllocator<Tag> &, const HeapEastlAllocator<Tag> &)
+{
+    return true;
+}
+
+template <MemoryTag Tag>
+inline bool operator!=(const HeapEastlAllocator<Tag> &, const HeapEastlAllocator<Tag> &)
+{
+    return false;
+}
+
+using CoreEastlAllocator = HeapEastlAllocator<MemoryTag::Core>;
+using RendererEastlAllocator = HeapEastlAllocator<MemoryTag::Renderer>;
+using AssetsEastlAllocator = HeapEastlAllocator<MemoryTag::Assets>;
+using LoggingEastlAllocator = HeapEastlAllocator<MemoryTag::Logging>;
+} // namespace Hawl
@@ -0,0 +1,267 @@
+/**
+ *  Copyright 2020-2021 Zhang QiuLiang (juteman). All rights reserved.
+ *
+ *  This file is a part of Hawl
+ *  see(https://github.com/juteman/Hawl)
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#pragma once
+#include "BaseType.h"
+#include "Common.h"
+#include <cstddef>
+
+/// per tag memory counters, 0 compiles the tracking out and the hooks are empty
+#ifndef HAWL_MEMORY_TRACKING
+#define HAWL_MEMORY_TRACKING 1
+#endif
+
+/// record every live allocation for the leak report, on by default in debug builds
+#ifndef HAWL_MEMORY_LEAK_REPORT
+#if defined(_DEBUG) && HAWL_MEMORY_TRACKING
+#define HAWL_MEMORY_LEAK_REPORT 1
+#else
+#define HAWL_MEMORY_LEAK_REPORT 0
+#endif
+#endif
+
+namespace Hawl
+{
+/// category of an allocation
+enum class MemoryTag : uint8
+{
+    Untagged,
+    Core,
+    Renderer,
+    Assets,
+    Logging,
+    Count,
+};
+
+/**
+ * \brief Memory of a tag, summed over all the threads
+ */
+struct MemoryTagStats
+{
+    int64  liveBytes = 0;
+    int64  liveCount = 0;
+    /// highest liveBytes ever reached
+    int64  peakBytes = 0;
+    /// counted with HAWL_MEMORY_LEAK_REPORT only, 0 without as the rates
+    uint64 allocationCount = 0;
+    /// over the interval between the last two Update
+    double allocationsPerSecond = 0.0;
+    double bytesPerSecond = 0.0;
+};
+
+/**
+ * \brief Per tag accounting of the allocations of the allocators that report to it
+ *
+ * MemoryHeap and ObjectPool report every block under their tag, other
+ * allocators through OnAllocate and OnFree or TrackedEastlAllocator.
+ *
+ * The live bytes of a tag are one shared atomic add per allocation and free,
+ * raised into the peak by a CAS when they pass it, so the peak is the exact
+ * high-water mark, a spike between two frames included. The live count of a
+ * thread is in its own cache line with plain stores, and GetStats sum the
+ * threads on demand. A block freed by another thread is subtracted from the
+ * line of that thread, only the sums are meaningful. The allocation count and
+ * the rates cost two more stores per allocation, they are counted with
+ * HAWL_MEMORY_LEAK_REPORT only. The rates are sampled, Update once a frame
+ * keeps them current.
+ *
+ * With HAWL_MEMORY_LEAK_REPORT every live block is also recorded with its tag,
+ * and with HAWL_STACKTRACE_DUMP with the call stack that allocated it, so
+ * ReportLeaks can list them at shutdown. Without, ReportLeaks only log the
+ * tags still holding memory.
+ */
+class MemoryTracker
+{
+public:
+#if HAWL_MEMORY_TRACKING
+    /// count an allocation, under the tag of the innermost MemoryTagScope of the thread
+    static void OnAllocate(void *block, size_t size);
+
+    static void OnAllocate(void *block, size_t size, MemoryTag tag);
+    /// size and tag must be the ones the block was allocated with
+    static void OnFree(void *block, size_t size, MemoryTag tag);
+
+    /**
+     * \brief Count blocks released at once without freeing them one by one, e.g. a destroyed heap
+     * \param isReleased tells the released blocks among the recorded blocks of tag with the leak report
+     */
+    static void OnFreeBulk(size_t size,
+                           uint64 count,
+                           MemoryTag tag,
+                           bool (*isReleased)(const void *block, void *context),
+                           void *context);
+
+    static MemoryTag GetCurrentTag();
+
+    /// sample the rates, once a frame
+    static void Update();
+    static MemoryTagStats GetStats(MemoryTag tag);
+    /// one line per tag in the log
+    static void LogStats();
+
+    /**
+     * \brief Log the memory still allocated, called at shutdown
+     * \return allocations not freed
+     */
+    static uint64 ReportLeaks();
+#else
+    static void OnAllocate(void *, size_t)
+    {
+    }
+
+    static void OnAllocate(void *, size_t, MemoryTag)
+    {
+    }
+
+    static void OnFree(void *, size_t, MemoryTag)
+    {
+    }
+
+    static void OnFreeBulk(size_t, uint64, MemoryTag, bool (*)(const void *, void *), void *)
+    {
+    }
+
+    static MemoryTag GetCurrentTag()
+    {
+        return MemoryTag::Untagged;
+    }
+
+    static void Update()
+    {
+    }
+
+    static MemoryTagStats GetStats(MemoryTag)
+    {
+        return {};
+    }
+
+    static void LogStats()
+    {
+    }
+
+    static uint64 ReportLeaks()
+    {
+        return 0;
+    }
+#endif
+
+    static const char *GetTagName(MemoryTag tag);
+};
+
+/**
+ * \brief Tag the allocations of the thread until the end of the scope, scopes nest
+ */
+class MemoryTagScope
+{
+public:
+#if HAWL_MEMORY_TRACKING
+    explicit MemoryTagScope(MemoryTag tag);
+    ~MemoryTagScope();
+
+private:
+    MemoryTag m_previous;
+#else
+    explicit MemoryTagScope(MemoryTag)
+    {
+    }
+#endif
+
+    HAWL_DISABLE_COPY(MemoryTagScope)
+};
+
+/**
+ * \brief EASTL allocator reporting the allocations of another to MemoryTracker
+ *
+ * The tag is the one of the scope the allocator is created in, or given.
+ * eastl::vector<T, TrackedEastlAllocator<eastl::allocator>>
+ */
+template <typename Allocator>
+class TrackedEastlAllocator
+{
+public:
+    explicit TrackedEastlAllocator(const char *name = "TrackedEastlAllocator")
+        : m_allocator(name), m_tag{MemoryTracker::GetCurrentTag()}
+    {
+    }
+
+    TrackedEastlAllocator(MemoryTag tag, const Allocator &allocator) : m_allocator(allocator), m_tag{tag}
+    {
+    }
+
+    void *allocate(size_t n, int flags = 0)
+    {
+        void *block = m_allocator.allocate(n, flags);
+        if (block != nullptr)
+            MemoryTracker::OnAllocate(block, n, m_tag);
+        return block;
+    }
+
+    void *allocate(size_t n, size_t alignment, size_t offset, int flags = 0)
+    {
+        void *block = m_allocator.allocate(n, alignment, offset, flags);
+        if (block != nullptr)
+            MemoryTracker::OnAllocate(block, n, m_tag);
+        return block;
+    }
+
+    void deallocate(void *block, size_t n)
+    {
+        if (block != nullptr)
+            MemoryTracker::OnFree(block, n, m_tag);
+        m_allocator.deallocate(block, n);
+    }
+
+    const char *get_name() const
+    {
+        return m_allocator.get_name();
+    }
+
+    void set_name(const char *name)
+    {
+        m_allocator.set_name(name);
+    }
+
+    const Allocator &GetAllocator() const
+    {
+        return m_allocator;
+    }
+
+    MemoryTag GetTag() const
+    {
+        return m_tag;
+    }
+
+private:
+    Allocator m_allocator;
+    MemoryTag m_tag;
+};
+
+/// the blocks of one may be freed by the other only when they have the same tag
+template <typename Allocator>
+inline bool operator==(const TrackedEastlAllocator<Allocator> &a, const TrackedEastlAllocator<Allocator> &b)
+{
+    return a.GetTag() == b.GetTag() && a.GetAllocator() == b.GetAllocator();
+}
+
+template <typename Allocator>
+inline bool operator!=(const TrackedEastlAllocator<Allocator> &a, const TrackedEastlAllocator<Allocator> &b)
+{
+    return !(a == b);
+}
+} // namespace Hawl
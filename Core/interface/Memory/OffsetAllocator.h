@@ -0,0 +1,146 @@
+/**
+ *  Copyright 2020-2021 Zhang QiuLiang (juteman). All rights reserved.
+ *
+ *  This file is a part of Hawl
+ *  see(https://github.com/juteman/Hawl)
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#pragma once
+#include "BaseType.h"
+#include "Common.h"
+#include <memory>
+
+namespace Hawl
+{
+/**
+ * \brief Free space of an OffsetAllocator
+ */
+struct OffsetAllocatorStats
+{
+    uint32 totalFree = 0;
+    uint32 largestFree = 0;
+    /// disjoint free ranges, a fully coalesced allocator with free space has 1
+    uint32 freeRegionCount = 0;
+    uint32 allocationCount = 0;
+
+    /// 0 when all the free space is one range, toward 1 as it is scattered
+    float GetFragmentation() const
+    {
+        return totalFree == 0 ? 0.0f : 1.0f - float(largestFree) / float(totalFree);
+    }
+};
+
+/**
+ * \brief Two-Level Segregated Fit allocator of offsets in an external range
+ *
+ * Manages [0, size) of something it never touches, a gpu heap, a buffer or a
+ * descriptor heap, in any unit. Free ranges are kept in 256 bins, 32 power of
+ * two levels split in 8 linear steps, a bitmap per level and one over the
+ * levels find the first bin big enough with two bit scans, so Allocate and
+ * Free are O(1). A freed range is merged with its free neighbors at once.
+ *
+ * Ranges are searched in the bin of their size rounded up, so a range is
+ * never more than 12.5% bigger than asked before the rest is split off. The
+ * nodes are preallocated, maxAllocations bound the allocations plus the free
+ * ranges. Not thread safe, the owner lock it if needed.
+ */
+class OffsetAllocator
+{
+public:
+    static constexpr uint32 NoSpace = 0xFFFFFFFF;
+
+    struct Allocation
+    {
+        uint32 offset = NoSpace;
+        /// node of the allocation, for Free
+        uint32 metadata = NoSpace;
+
+        bool IsValid() const
+        {
+            return offset != NoSpace;
+        }
+    };
+
+    explicit OffsetAllocator(uint32 size, uint32 maxAllocations = 128 * 1024);
+
+    /**
+     * \param alignment power of two, the offset is a multiple of it
+     * \return an invalid allocation if no free range fit, or the nodes are exhausted
+     */
+    Allocation Allocate(uint32 size, uint32 alignment = 1);
+
+    void Free(Allocation allocation);
+
+    /// free everything
+    void Reset();
+
+    /// size of an allocation, as asked
+    uint32 GetAllocationSize(Allocation allocation) const;
+
+    OffsetAllocatorStats GetStats() const;
+
+    uint32 GetSize() const
+    {
+        return m_size;
+    }
+
+private:
+    static constexpr uint32 TopBinCount = 32;
+    static constexpr uint32 BinsPerLeaf = 8;
+    static constexpr uint32 TopBinShift = 3;
+    static constexpr uint32 LeafBinMask = BinsPerLeaf - 1;
+    static constexpr uint32 LeafBinCount = TopBinCount * BinsPerLeaf;
+    static constexpr uint32 Unused = 0xFFFFFFFF;
+
+    struct Node
+    {
+        uint32 offset = 0;
+        uint32 size = 0;
+        /// list of the bin of a free node
+        uint32 binPrevious = Unused;
+        uint32 binNext = Unused;
+        /// nodes of the adjacent ranges, free or not
+        uint32 neighborPrevious = Unused;
+        uint32 neighborNext = Unused;
+        bool   used = false;
+    };
+
+    uint32 NewNode();
+    void ReleaseNode(uint32 nodeIndex);
+    /// put a new node for a free range in its bin, the neighbors are left to the caller
+    uint32 InsertFree(uint32 offset, uint32 size);
+    /// put a free node in the bin of its size
+    void LinkFree(uint32 nodeIndex);
+    /// take a free node out of its bin, the node is kept
+    void UnlinkFree(uint32 nodeIndex);
+
+    uint32 m_size;
+    uint32 m_maxAllocations;
+    uint32 m_freeStorage = 0;
+    uint32 m_freeRegionCount = 0;
+    uint32 m_allocationCount = 0;
+
+    uint32 m_usedBinsTop = 0;
+    uint8  m_usedBins[TopBinCount] = {};
+    uint32 m_binHeads[LeafBinCount];
+
+    std::unique_ptr<Node[]>   m_nodes;
+    /// stack of the unused nodes, m_freeNodeCount on it
+    std::unique_ptr<uint32[]> m_freeNodes;
+    uint32                    m_freeNodeCount = 0;
+
+    HAWL_DISABLE_COPY(OffsetAllocator)
+};
+} // namespace Hawl
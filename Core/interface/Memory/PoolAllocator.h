@@ -0,0 +1,126 @@
+/**
+ *  Copyright 2020-2021 Zhang QiuLiang (juteman). All rights reserved.
+ *
+ *  This file is a part of Hawl
+ *  see(https://github.com/juteman/Hawl)
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#pragma once
+#include "BaseType.h"
+#include "Memory/MemoryTracker.h"
+#include <cstddef>
+#include <new>
+#include <utility>
+
+/// fill the freed blocks of PoolAllocator and check them on reuse, on by default in debug builds
+#ifndef HAWL_POOL_POISON
+#if defined(_DEBUG)
+#define HAWL_POOL_POISON 1
+#else
+#define HAWL_POOL_POISON 0
+#endif
+#endif
+
+namespace Hawl
+{
+/**
+ * \brief Allocator of small objects, one pool per 16 bytes size class up to 256
+ * and per power of two up to 4096
+ *
+ * Every thread keep two magazines of free blocks per size class, Allocate pop
+ * from the loaded one and Free push to it, swapping with the other one when it
+ * runs empty or full, so a thread churning objects around a magazine boundary
+ * does not go to the depot every time. The depot is a pair of lock-free stacks
+ * of full and empty magazines per size class, a thread exchange a whole
+ * magazine with it in one CAS. A block may be freed by any thread.
+ *
+ * Blocks are aligned on 16 bytes, the size given to Free must be the size given
+ * to Allocate. Bigger blocks go to the global operator new. The memory of the
+ * pools is kept for reuse until process exit. The ObjectPools, coroutine frames,
+ * Future states and the captures spilled by InlineTask all come from here.
+ *
+ * With HAWL_POOL_POISON a freed block is filled with a pattern checked when it
+ * is allocated again, a write after free is logged and break in the debugger.
+ */
+class PoolAllocator
+{
+public:
+    static constexpr size_t Granularity = 16;
+    /// 16 bytes size classes up to this size, power of two above
+    static constexpr size_t SmallPooledSize = 256;
+    static constexpr size_t MaxPooledSize = 4096;
+    static constexpr uint32 SizeClassCount = SmallPooledSize / Granularity + 4;
+    /// blocks a magazine hold
+    static constexpr uint32 MagazineSize = 64;
+
+    static void *Allocate(size_t size);
+    static void Free(void *block, size_t size);
+
+    /**
+     * \brief Preallocate count blocks of size in the depot, with as many empty
+     * magazines, so the threads allocating and freeing them never reach the system
+     */
+    static void Reserve(size_t size, uint32 count);
+
+    /// \return how many times the pools requested memory from the system
+    static uint64 GetSystemAllocationCount();
+};
+
+/**
+ * \brief Typed front of PoolAllocator, reporting its objects to MemoryTracker under Tag
+ */
+template <typename T, MemoryTag Tag = MemoryTag::Untagged>
+class ObjectPool
+{
+    static_assert(alignof(T) <= PoolAllocator::Granularity, "ObjectPool type is over aligned");
+
+public:
+    /// deleter of std::unique_ptr returning the object to the pool
+    struct Deleter
+    {
+        void operator()(T *object) const
+        {
+            Delete(object);
+        }
+    };
+
+    template <typename... Args>
+    static T *New(Args &&...args)
+    {
+        void *block = PoolAllocator::Allocate(sizeof(T));
+        MemoryTracker::OnAllocate(block, sizeof(T), Tag);
+        try
+        {
+            return new (block) T(std::forward<Args>(args)...);
+        }
+        catch (...)
+        {
+            // the block goes back as if the object was deleted
+            MemoryTracker::OnFree(block, sizeof(T), Tag);
+            PoolAllocator::Free(block, sizeof(T));
+            throw;
+        }
+    }
+
+    static void Delete(T *object)
+    {
+        if (object == nullptr)
+            return;
+        object->~T();
+        MemoryTracker::OnFree(object, sizeof(T), Tag);
+        PoolAllocator::Free(object, sizeof(T));
+    }
+};
+} // namespace Hawl
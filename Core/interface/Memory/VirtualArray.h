@@ -0,0 +1,284 @@
+/**
+ *  Copyright 2020-2021 Zhang QiuLiang (juteman). All rights reserved.
+ *
+ *  This file is a part of Hawl
+ *  see(https://github.com/juteman/Hawl)
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#pragma once
+#include "BaseType.h"
+#include "Common.h"
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace Hawl
+{
+/**
+ * \brief Untyped address range of a VirtualArray, committed from its start
+ */
+class VirtualArrayStorage
+{
+public:
+    /// pages are committed and decommitted by this much, or by huge pages
+    static constexpr size_t CommitGranularity = 64 * 1024;
+
+    VirtualArrayStorage(size_t maxBytes, bool hugePages);
+    ~VirtualArrayStorage();
+
+    VirtualArrayStorage(VirtualArrayStorage &&other) noexcept;
+    VirtualArrayStorage &operator=(VirtualArrayStorage &&other) noexcept;
+
+    /**
+     * \brief make [0, bytes) readable and writable
+     * \return false past the reservation or when the os is out of memory
+     */
+    FORCEINLINE bool CommitTo(size_t bytes)
+    {
+        return bytes <= m_committedBytes || Grow(bytes);
+    }
+
+    /// give back the pages wholly past bytes, their content is lost
+    void DecommitFrom(size_t bytes);
+
+    char *GetData() const
+    {
+        return m_data;
+    }
+
+    size_t GetCommittedBytes() const
+    {
+        return m_committedBytes;
+    }
+
+    size_t GetMaxBytes() const
+    {
+        return m_maxBytes;
+    }
+
+private:
+    bool Grow(size_t bytes);
+    void Release();
+
+    /// the data start at a huge page boundary inside the reservation when huge pages are asked
+    char  *m_reservation = nullptr;
+    size_t m_reservedBytes = 0;
+    char  *m_data = nullptr;
+    size_t m_maxBytes = 0;
+    size_t m_committedBytes = 0;
+    size_t m_granularity = CommitGranularity;
+
+    HAWL_DISABLE_COPY(VirtualArrayStorage)
+};
+
+/**
+ * \brief Array growing in place in an address range reserved for its maximum size
+ *
+ * The constructor reserves the addresses of maxCount elements without memory,
+ * pages are committed as the array grows, so growing never copy and the
+ * address of an element stays valid until it is removed. Memory is only taken
+ * for the committed pages, 64 KiB at a time, or 2 MiB with huge pages where
+ * Linux may back the range with transparent huge pages.
+ *
+ * Resize to a smaller size and ShrinkToFit decommit the pages past the end,
+ * PopBack and Clear keep them for the next growth. Adding past maxCount, or
+ * when the os is out of memory, fail and return nullptr or false.
+ */
+template <typename T>
+class VirtualArray
+{
+    static_assert(alignof(T) <= VirtualArrayStorage::CommitGranularity, "VirtualArray element is over aligned");
+
+public:
+    using value_type = T;
+    using iterator = T *;
+    using const_iterator = const T *;
+
+    /**
+     * \param maxCount elements the array can ever hold, only address space is taken for them
+     * \param hugePages align the range on huge pages and advise the os to use them
+     */
+    explicit VirtualArray(size_t maxCount, bool hugePages = false) : m_storage(maxCount * sizeof(T), hugePages)
+    {
+    }
+
+    ~VirtualArray()
+    {
+        Clear();
+    }
+
+    VirtualArray(VirtualArray &&other) noexcept
+        : m_storage(std::move(other.m_storage)), m_size{std::exchange(other.m_size, 0)}
+    {
+    }
+
+    VirtualArray &operator=(VirtualArray &&other) noexcept
+    {
+        if (this != &other)
+        {
+            Clear();
+            m_storage = std::move(other.m_storage);
+            m_size = std::exchange(other.m_size, 0);
+        }
+        return *this;
+    }
+
+    /// \return the new element, nullptr if the array is full
+    template <typename... Args>
+    T *EmplaceBack(Args &&...args)
+    {
+        if (!m_storage.CommitTo((m_size + 1) * sizeof(T))) [[unlikely]]
+            return nullptr;
+        T *element = new (Data() + m_size) T(std::forward<Args>(args)...);
+        ++m_size;
+        return element;
+    }
+
+    T *PushBack(const T &value)
+    {
+        return EmplaceBack(value);
+    }
+
+    T *PushBack(T &&value)
+    {
+        return EmplaceBack(std::move(value));
+    }
+
+    void PopBack()
+    {
+        Data()[--m_size].~T();
+    }
+
+    /**
+     * \brief Value initialize the new elements, or destroy the removed ones and decommit their pages
+     * \return false if count is past the maximum or the os is out of memory
+     */
+    bool Resize(size_t count)
+    {
+        if (count > m_size)
+        {
+            if (!m_storage.CommitTo(count * sizeof(T)))
+                return false;
+            for (size_t i = m_size; i < count; ++i)
+                new (Data() + i) T();
+        }
+        else
+        {
+            DestroyFrom(count);
+            m_storage.DecommitFrom(count * sizeof(T));
+        }
+        m_size = count;
+        return true;
+    }
+
+    /// commit the pages of count elements ahead
+    bool Reserve(size_t count)
+    {
+        return m_storage.CommitTo(count * sizeof(T));
+    }
+
+    /// destroy the elements, the pages stay committed
+    void Clear()
+    {
+        DestroyFrom(0);
+        m_size = 0;
+    }
+
+    void ShrinkToFit()
+    {
+        m_storage.DecommitFrom(m_size * sizeof(T));
+    }
+
+    T &operator[](size_t index)
+    {
+        return Data()[index];
+    }
+
+    const T &operator[](size_t index) const
+    {
+        return Data()[index];
+    }
+
+    T &Back()
+    {
+        return Data()[m_size - 1];
+    }
+
+    T *Data()
+    {
+        return reinterpret_cast<T *>(m_storage.GetData());
+    }
+
+    const T *Data() const
+    {
+        return reinterpret_cast<const T *>(m_storage.GetData());
+    }
+
+    size_t Size() const
+    {
+        return m_size;
+    }
+
+    bool IsEmpty() const
+    {
+        return m_size == 0;
+    }
+
+    /// elements the committed pages hold
+    size_t GetCapacity() const
+    {
+        return m_storage.GetCommittedBytes() / sizeof(T);
+    }
+
+    size_t GetMaxSize() const
+    {
+        return m_storage.GetMaxBytes() / sizeof(T);
+    }
+
+    T *begin()
+    {
+        return Data();
+    }
+
+    T *end()
+    {
+        return Data() + m_size;
+    }
+
+    const T *begin() const
+    {
+        return Data();
+    }
+
+    const T *end() const
+    {
+        return Data() + m_size;
+    }
+
+private:
+    void DestroyFrom(size_t index)
+    {
+        if constexpr (!std::is_trivially_destructible_v<T>)
+            for (size_t i = index; i < m_size; ++i)
+                Data()[i].~T();
+    }
+
+    VirtualArrayStorage m_storage;
+    size_t              m_size = 0;
+
+    HAWL_DISABLE_COPY(VirtualArray)
+};
+} // namespace Hawl
@@ -0,0 +1,66 @@
+/**
+ *  Copyright 2020-2021 Zhang QiuLiang (juteman). All rights reserved.
+ *
+ *  This file is a part of Hawl
+ *  see(https://github.com/juteman/Hawl)
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#pragma once
+#include "BaseType.h"
+#include <cstddef>
+
+namespace Hawl
+{
+/**
+ * \brief Address space reserved up front and backed by pages on demand
+ *
+ * Reserve only take a range of addresses, no memory, Commit back a part of it
+ * with zeroed pages and Decommit give them back to the os while keeping the
+ * addresses, so a structure can grow in place without moving. Addresses and
+ * sizes given to Commit and Decommit must be multiples of GetPageSize.
+ */
+class VirtualMemory
+{
+public:
+    /// size of a huge page where the os support them
+    static constexpr size_t HugePageSize = 2 * 1024 * 1024;
+
+    static size_t GetPageSize();
+
+    /**
+     * \return the base of the range, nullptr if the address space is exhausted
+     */
+    static void *Reserve(size_t size);
+
+    /**
+     * \brief Release a whole range returned by Reserve
+     */
+    static void Release(void *address, size_t size);
+
+    /**
+     * \brief back a part of a reserved range with read write pages
+     * \return false if the os is out of memory
+     */
+    static bool Commit(void *address, size_t size);
+
+    static void Decommit(void *address, size_t size);
+
+    /**
+     * \brief ask the os to back the range with huge pages, transparent huge pages on
+     * Linux, nothing where the os need them at reservation
+     */
+    static void AdviseHugePages(void *address, size_t size);
+};
+} // namespace Hawl
@@ -20,12 +20,29 @@
 
 #pragma once
 #include "Algorithm/LockfreeQueue.h"
+#include "Algorithm/NodePool.h"
+#include "Algorithm/WorkStealingDeque.h"
 #include "BaseType.h"
 #include "Common.h"
+#include "Memory/PoolAllocator.h"
+#include "Thread/CpuTopology.h"
+#include "Thread/EventCount.h"
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <memory>
+#include <new>
 #include <string>
 #include <thread>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+/// per worker counters of ThreadPool, 0 compiles them out, the layout does not change
+#ifndef HAWL_THREAD_STATS
+#define HAWL_THREAD_STATS 1
+#endif
+
 namespace Hawl
 {
 enum class Priority : int
@@ -38,65 +55,556 @@ enum class Priority : int
 };
 
 
+/**
+ * \brief Where one AddTask of a Task is in the ThreadPool
+ */
+enum class TaskState : uint32
+{
+    /// ran, or dropped by the pool after a cancel
+    Done = 0,
+    /// in a queue of the pool
+    Queued,
+    /// taken by a worker, run() has not returned yet
+    Running,
+    /// cancelled while queued, the pool drops the entry without touching the task
+    Cancelled,
+};
+
+
+/**
+ * \brief One AddTask of a Task, it goes stale once the run is Done
+ *
+ * The state of the run lives in a slot of the pool and not in the task, so a
+ * worker drops a cancelled entry without reading the task, and marks a run
+ * Done after run() even when the task deleted itself.
+ */
+struct TaskHandle
+{
+    static constexpr uint32 InvalidSlot = 0xFFFFFFFF;
+
+    uint32 slot = InvalidSlot;
+    /// generation of the slot for this run, with TaskState::Queued in the low bits
+    uint32 generation = 0;
+};
+
+
 struct Task
 {
     HAWL_DISABLE_COPY(Task)
     Task() = default;
     virtual ~Task() = default;
     virtual void run() = 0;
+
     Priority taskPriority = Priority::Normal;
+    /// slot of the last AddTask, only read by RetractTask, in the padding after taskPriority
+    std::atomic<uint32> taskSlot{TaskHandle::InvalidSlot};
 };
 
 
-class ThreadPool
+/**
+ * \brief Task holding a callable in place, one cache line
+ *
+ * Callables up to InlineSize bytes are stored in the task itself, bigger ones
+ * spill to the PoolAllocator. The task slots are recycled by a NodePool: the task
+ * run its callable once and release itself, so submitting a job through
+ * ThreadPool::Submit does no global allocation once the pools are warm.
+ */
+class alignas(CacheLineSize) InlineTask final : public Task
 {
+public:
+    static constexpr size_t InlineSize = CacheLineSize - sizeof(Task) - sizeof(void *);
+
+    /**
+     * \brief take a task slot from the pool for the callable
+     * \param function callable taking no argument, it must not throw
+     */
+    template <typename Function>
+    static InlineTask *Create(Function &&function, Priority InPriority = Priority::Normal)
+    {
+        InlineTask *task = Algorithm::NodePool<InlineTask>::Instance().New();
+        task->taskPriority = InPriority;
+        task->Store(std::forward<Function>(function));
+        return task;
+    }
+
+    /// run the callable, destroy it and give the slot back to the pool
+    void run() override
+    {
+        m_run(m_storage);
+        Algorithm::NodePool<InlineTask>::Instance().Delete(this);
+    }
+
 private:
-    using Queue = Algorithm::LockFreeQueue<Task *>;
+    friend class Algorithm::NodePool<InlineTask>;
 
-protected:
-    const uint MaxThreadCount = std::thread::hardware_concurrency() / 2;
-    Queue TaskQueue;
-    std::vector<std::thread> m_threads;
+    InlineTask() = default;
 
-    void TaskRunner()
+    template <typename Function>
+    void Store(Function &&function)
     {
-        while (!TaskQueue.IsEmpty())
+        using Callable = std::decay_t<Function>;
+        static_assert(alignof(Callable) <= alignof(std::max_align_t), "InlineTask callable is over aligned");
+        if constexpr (sizeof(Callable) <= InlineSize && alignof(Callable) <= alignof(void *))
+        {
+            new (m_storage) Callable(std::forward<Function>(function));
+            m_run = [](void *storage) {
+                Callable &callable = *std::launder(reinterpret_cast<Callable *>(storage));
+                callable();
+                callable.~Callable();
+            };
+        }
+        else
         {
-            Task *realTask;
-            // If DeQueue return error here, the task queue is empty
-            if (!TaskQueue.DeQueue(realTask))
-                break;
-            realTask->run();
-            //TODO notify on thread here
+            void *spill = PoolAllocator::Allocate(sizeof(Callable));
+            new (spill) Callable(std::forward<Function>(function));
+            *reinterpret_cast<void **>(m_storage) = spill;
+            m_run = [](void *storage) {
+                Callable *callable = static_cast<Callable *>(*reinterpret_cast<void **>(storage));
+                (*callable)();
+                callable->~Callable();
+                PoolAllocator::Free(callable, sizeof(Callable));
+            };
         }
     }
 
+    /// run then destroy the callable in the storage
+    void (*m_run)(void *storage) = nullptr;
+    alignas(void *) unsigned char m_storage[InlineSize];
+};
+
+static_assert(sizeof(InlineTask) == CacheLineSize, "InlineTask must fill one cache line");
+
+/**
+ * \brief Counters of one worker, or their aggregate, see ThreadPool::GetStats
+ */
+struct WorkerStats
+{
+    uint64 tasksExecuted = 0;
+    uint64 stealsAttempted = 0;
+    uint64 stealsSucceeded = 0;
+    /// deepest the local deque has been
+    uint64 queueHighWater = 0;
+    /// running tasks
+    uint64 busyNanoseconds = 0;
+    /// looking for a task without sleeping
+    uint64 spinNanoseconds = 0;
+    /// parked
+    uint64 idleNanoseconds = 0;
+    uint64 longestTaskNanoseconds = 0;
+};
+
+/**
+ * \brief Snapshot of the counters of a ThreadPool, cumulative since Create
+ */
+struct ThreadPoolStats
+{
+    std::vector<WorkerStats> workers;
+    /// sums, and the max for queueHighWater and longestTaskNanoseconds
+    WorkerStats total;
+
+    /// one line summary for the log
+    std::string ToString() const;
+};
+
+/**
+ * \brief How an idle worker of a ThreadPool wait for the next task
+ *
+ * The worker spins first, the pause instructions between two searches doubling
+ * up to maxPauseCount, then yields its time slice a few times, then parks on the
+ * futex of the pool until a task is added. A parked worker costs no cpu but a
+ * wakeup costs tens of microseconds, a spinning worker start the task at once.
+ *
+ * With adaptive on, every worker average its recent waits and spins for twice
+ * that, between minSpin and maxSpin: a worker fed in bursts keeps spinning
+ * through the gaps, a worker whose tasks come further apart than maxSpin parks
+ * after minSpin. Without adaptive, the worker always spins maxSpin.
+ */
+struct IdlePolicy
+{
+    std::chrono::nanoseconds minSpin = std::chrono::microseconds(2);
+    std::chrono::nanoseconds maxSpin = std::chrono::microseconds(50);
+    uint32 maxPauseCount = 64;
+    /// sched_yield before parking
+    uint32 yieldCount = 2;
+    bool adaptive = true;
+
+    /// spin long whatever the load, for the pools feeding a frame
+    static IdlePolicy LowLatency()
+    {
+        IdlePolicy policy;
+        policy.maxSpin = std::chrono::microseconds(200);
+        policy.yieldCount = 8;
+        policy.adaptive = false;
+        return policy;
+    }
+
+    /// park almost at once, for background pools on battery
+    static IdlePolicy PowerSaving()
+    {
+        IdlePolicy policy;
+        policy.minSpin = std::chrono::nanoseconds(0);
+        policy.maxSpin = std::chrono::microseconds(5);
+        policy.maxPauseCount = 16;
+        policy.yieldCount = 0;
+        return policy;
+    }
+};
+
+/**
+ * \brief Work stealing thread pool
+ *
+ * Every worker own a WorkStealingDeque. Normal tasks added from inside a task go
+ * to the deque of the current worker, every other task goes to the injection
+ * queue of its Priority. An idle worker take the tasks above Normal first, then
+ * from its own deque, the Normal injection queue, its peers, and at last the
+ * tasks below Normal, and when all are empty it spins, yields and parks as the
+ * IdlePolicy of the pool says.
+ *
+ * A queued task gains one priority level every aging step it waits, so a flood
+ * of high priority work can delay the low priority tasks but never starve them.
+ *
+ * With an AffinityPolicy the workers are pinned to the processors of the
+ * CpuTopology. Every worker allocate its own Worker after pinning, so the deque
+ * is placed on its NUMA node by the first touch policy of the os.
+ *
+ * Every AddTask takes a slot holding the generation and TaskState of the run,
+ * and the queues carry the slot. A queued task is cancelled by flipping the
+ * state of its slot, the queues are not searched: the worker popping a
+ * cancelled entry drop it after reading the slot only, and the task itself may
+ * be destroyed as soon as CancelTask returns true.
+ *
+ * With HAWL_THREAD_STATS every worker count its activity in its own cache line
+ * with plain stores, timed by the clock read FindTask already does for the
+ * aging, and GetStats sum them on demand.
+ */
+class ThreadPool
+{
+private:
+    /// slot of a task waiting in an injection queue, with the time it was added for aging
+    struct QueuedTask
+    {
+        uint32 slot = TaskHandle::InvalidSlot;
+        int64  submitTime = 0;
+    };
+
+    using Queue = Algorithm::LockFreeQueue<QueuedTask>;
+    /// slots of the queued tasks
+    using Deque = Algorithm::WorkStealingDeque<uint32>;
+
+protected:
+    static constexpr uint32 PriorityCount = static_cast<uint32>(Priority::Highest) + 1;
+
+    /// what the time of a worker is counted as
+    enum class WorkerPhase : uint8
+    {
+        /// running a task, until the next search
+        Busy,
+        /// searching for a task
+        Spin,
+        /// parked
+        Idle,
+    };
+
+    /// WorkerStats written by the owner worker only, read by GetStats at any time
+    struct alignas(CacheLineSize) WorkerCounters
+    {
+        std::atomic<uint64> tasksExecuted{0};
+        std::atomic<uint64> stealsAttempted{0};
+        std::atomic<uint64> stealsSucceeded{0};
+        std::atomic<uint64> queueHighWater{0};
+        std::atomic<uint64> busyNanoseconds{0};
+        std::atomic<uint64> spinNanoseconds{0};
+        std::atomic<uint64> idleNanoseconds{0};
+        std::atomic<uint64> longestTaskNanoseconds{0};
+    };
+
+    struct alignas(CacheLineSize) Worker
+    {
+        Deque deque;
+        /// state of the random victim selection
+        uint32 seed = 0;
+        /// time of the last search for a task, from the clock read of the aging
+        int64 searchNanoseconds = 0;
+        /// learned by WaitForTask under an adaptive IdlePolicy
+        int64 averageWaitNanoseconds = 0;
+        int64 spinBudgetNanoseconds = 0;
+        int64 phaseStartNanoseconds = 0;
+        WorkerPhase phase = WorkerPhase::Spin;
+        WorkerCounters counters;
+
+        /// count the time since the previous change to the current phase, as of the last search
+        void EnterPhase(WorkerPhase next);
+    };
+
+    /// physical cores, more workers only compete for the same execution units
+    const uint MaxThreadCount = CpuTopology::Get().GetCoreCount();
+    /// injection queues indexed by Priority
+    Queue TaskQueues[PriorityCount];
+    /// allocated by the worker threads themselves, all set once Create return
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    std::vector<std::thread> m_threads;
+    /// workers done with their allocation, they start looking for tasks when all are
+    std::atomic<uint32> m_readyWorkers{0};
+    AffinityPolicy m_affinityPolicy = AffinityPolicy::None;
+    bool m_reserveFirstCore = false;
+    /// waiting time in nanoseconds for a queued task to gain one priority level
+    std::atomic<int64> m_agingStep{std::chrono::nanoseconds(std::chrono::milliseconds(20)).count()};
+    /// os priority of the worker threads
+    Priority m_threadPriority = Priority::Normal;
+    /// how the workers wait for tasks
+    IdlePolicy m_idlePolicy;
+    /// idle workers park here
+    EventCount m_wakeup;
+    std::atomic<bool> m_stopping{false};
+
+    /**
+     * \brief worker loop, run tasks until Destroy is called and no task is left
+     * \param index index of the worker in m_workers
+     * \param cpu os index of the processor to pin the thread to, -1 to leave it free
+     */
+    void TaskRunner(uint32 index, int32 cpu);
+
+    /**
+     * \brief find the next task of a worker, idling as m_idlePolicy says when there is none
+     * \param slot get the slot of the claimed task
+     * \return false when stopping with no task left
+     */
+    bool WaitForTask(int32 index, uint32 &slot);
+
+    /**
+     * \brief spin, yield then park until a task is found, WaitForTask found none at once
+     * \return false when stopping with no task left
+     */
+    bool IdleUntilTask(int32 index, uint32 &slot);
+
+    /**
+     * \brief FindTask from the worker loop, counting the phase of the worker
+     */
+    bool SearchTask(int32 index, uint32 &slot);
+
+    /**
+     * \brief find the injection queue with the highest aged priority
+     * \param now steady clock in nanoseconds
+     * \param outScore get the priority of the queue head, in nanoseconds, level * aging step + waiting time
+     * \return the priority level of the queue, -1 if all the queues are empty
+     */
+    int32 SelectQueue(int64 now, int64 &outScore);
+
+    /**
+     * \brief look for a task in the order of high priority queues, local deque,
+     * Normal queue, peers and low priority queues, and drop the retracted tasks on the way
+     * \param index index of the calling worker, or -1 for a thread out of the pool
+     * \param slot get the slot of the claimed task, Running
+     * \return false if no task is found
+     */
+    bool FindTask(int32 index, uint32 &slot);
+
+    /**
+     * \brief pop the slot of the next task in the order of FindTask, retracted or not
+     */
+    bool PopTask(int32 index, uint32 &slot);
+
+    /**
+     * \brief take a popped slot for running, only the slot is read
+     * \return false if the task was retracted, the slot is Done and released
+     */
+    static bool ClaimTask(uint32 slot);
+
+    /**
+     * \brief run the task of a claimed slot, then mark the slot Done and release it
+     */
+    static void RunTask(uint32 slot);
+
+    /**
+     * \brief steal a task from the deque of a random peer
+     * \param index index of the calling worker, or -1 for a thread out of the pool
+     * \param slot get the slot of the stolen task
+     * \return false if all the peers are empty
+     */
+    bool StealTask(int32 index, uint32 &slot);
+
 public:
     virtual ~ThreadPool() = default;
 
     /**
      * \brief Specify the thread number size and priority of thread the create thread pool
      * \param numOfThreads the number of thread to use in the pool
-     * \param threadPriority priority in the pool thread
+     * \param threadPriority os priority of the pool threads, raising it above Normal
+     * may need privilege, a failure is logged and the thread keep the default priority
      * \return true for success create thread pool
      */
     virtual bool Create(uint32 numOfThreads, Priority threadPriority);
 
+    /**
+     * \brief Choose how the next Create pin the workers to the processors
+     * \param policy Compact or Scatter over the CpuTopology, None leave the threads to the os
+     * \param reserveFirstCore keep the first core free for the main thread
+     */
+    void SetAffinity(AffinityPolicy policy, bool reserveFirstCore = false)
+    {
+        m_affinityPolicy = policy;
+        m_reserveFirstCore = reserveFirstCore;
+    }
+
+    /**
+     * \brief Choose how the workers of the next Create wait for tasks
+     */
+    void SetIdlePolicy(const IdlePolicy &policy)
+    {
+        m_idlePolicy = policy;
+    }
+
+    const IdlePolicy &GetIdlePolicy() const
+    {
+        return m_idlePolicy;
+    }
+
     /**
      * \brief Clean all the thread in pool and destroy the pool
+     *
+     * Tasks added before Destroy are still executed
      */
-    virtual void Destroy() = 0;
+    virtual void Destroy();
 
     /**
      * \brief If have free thread, dispatch task to thread
-     * \param task work need to be done
+     * \param task work need to be done, its taskPriority select the queue
+     * \return handle to cancel this run of the task
+     */
+    virtual TaskHandle AddTask(Task *task);
+
+    /**
+     * \brief Run a callable on the pool without allocating, see InlineTask
+     * \param function callable taking no argument, moved or copied in the task
+     * \param taskPriority select the queue like the taskPriority of a Task
+     */
+    template <typename Function>
+    void Submit(Function &&function, Priority taskPriority = Priority::Normal)
+    {
+        AddTask(InlineTask::Create(std::forward<Function>(function), taskPriority));
+    }
+
+    /**
+     * \brief Set how long a queued task wait before it is raised by one priority level
+     * \param step the aging step, a Lowest task outrank a fresh Highest one after 4 steps
+     */
+    void SetAgingStep(std::chrono::nanoseconds step)
+    {
+        m_agingStep.store(step.count(), std::memory_order_relaxed);
+    }
+
+    /**
+     * \brief Awaitable moving the awaiting coroutine to a worker of the pool
      */
-    virtual void AddTask(Task *task) = 0;
+    class ScheduleOperation : public Task
+    {
+    public:
+        ScheduleOperation(ThreadPool &InPool, Priority InPriority) : m_pool{InPool}
+        {
+            taskPriority = InPriority;
+        }
+
+        bool await_ready() const noexcept
+        {
+            return false;
+        }
+
+        void await_suspend(std::coroutine_handle<> handle)
+        {
+            // a worker may resume the coroutine, and destroy this, before AddTask return
+            m_handle = handle;
+            m_pool.AddTask(this);
+        }
+
+        void await_resume() const noexcept
+        {
+        }
+
+        void run() override
+        {
+            m_handle.resume();
+        }
+
+    private:
+        ThreadPool &m_pool;
+        std::coroutine_handle<> m_handle;
+    };
+
+    /**
+     * \brief co_await pool.Schedule() suspend the coroutine and resume it on a worker
+     * \param taskPriority priority of the resumption in the pool
+     */
+    ScheduleOperation Schedule(Priority taskPriority = Priority::Normal)
+    {
+        return ScheduleOperation(*this, taskPriority);
+    }
+
+    /**
+     * \brief Preallocate the queue nodes, task slots and Submit tasks of the
+     * pools, and the epoch retire lists, so a steady workload never reach the
+     * system allocator
+     *
+     * The threads keep a few batches each in their caches, reserve some
+     * thousands above the tasks in flight at once. The retire list of every
+     * thread grows to taskCount entries, a stalled epoch retire that many.
+     * The callables Submit spills are reserved with PoolAllocator::Reserve.
+     * \param taskCount tasks expected queued or running at once
+     */
+    static void Reserve(uint32 taskCount);
 
     /**
      * \brief Retract the previously task
-     * \param task try to retract
+     * \param task try to retract, ignored if it is not queued
      */
-    virtual void RetractTask(Task *task) = 0;
+    virtual void RetractTask(Task *task);
+
+    /**
+     * \brief Cancel a queued task, O(1) and lock free
+     *
+     * The entry stays in its queue, the worker popping it only read the slot
+     * and drop it. The pool never touches the task again, it may be destroyed
+     * or added again as soon as this return true.
+     * \param handle returned by the AddTask to cancel
+     * \return false if the run already started or is over
+     */
+    static bool CancelTask(const TaskHandle &handle);
+
+    /**
+     * \return the state of the run of handle, Done once the run is over or the handle is stale
+     */
+    static TaskState GetTaskState(const TaskHandle &handle);
+
+    /**
+     * \brief Run one pending task on the calling thread, use it to help the
+     * pool while waiting for sub tasks instead of blocking a worker
+     * \return false if no task is pending
+     */
+    bool RunPendingTask();
+
+    /**
+     * \return index of the calling thread in this pool, -1 if it is not a worker of this pool
+     */
+    int32 GetCurrentWorkerIndex() const;
+
+    /**
+     * \brief Sum the counters of the workers, zero when HAWL_THREAD_STATS is 0
+     *
+     * The time of a phase is counted when it ends, a task still running or a
+     * worker still parked is not in the snapshot yet.
+     */
+    ThreadPoolStats GetStats() const;
+
+    /**
+     * \brief Log the summary of GetStats, and every worker at debug level
+     */
+    void LogStats() const;
+
+    /**
+     * \return the number of worker threads
+     */
+    uint32 GetWorkerCount() const
+    {
+        return static_cast<uint32>(m_workers.size());
+    }
 };
 } // namespace Hawl
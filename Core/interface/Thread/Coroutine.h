@@ -0,0 +1,496 @@
+/**
+ *  Copyright 2020-2021 Zhang QiuLiang (juteman). All rights reserved.
+ *
+ *  This file is a part of Hawl
+ *  see(https://github.com/juteman/Hawl)
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#pragma once
+#include "BaseType.h"
+#include "Common.h"
+#include "Memory/PoolAllocator.h"
+#include "Thread.h"
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <new>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace Hawl::Coroutine
+{
+namespace Detail
+{
+/// frames of every coroutine type of this file come from the PoolAllocator, so the
+/// steady state never call malloc
+struct PooledFrame
+{
+    static void *operator new(size_t size)
+    {
+        return PoolAllocator::Allocate(size);
+    }
+
+    static void operator delete(void *frame, size_t size)
+    {
+        PoolAllocator::Free(frame, size);
+    }
+};
+
+class PromiseBase : public PooledFrame
+{
+public:
+    /// resume the awaiting coroutine, if any, when the task is done
+    struct FinalAwaiter
+    {
+        bool await_ready() const noexcept
+        {
+            return false;
+        }
+
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+        {
+            std::coroutine_handle<> continuation = handle.promise().m_continuation;
+            return continuation ? continuation : std::noop_coroutine();
+        }
+
+        void await_resume() const noexcept
+        {
+        }
+    };
+
+    /// tasks are lazy, they start when awaited
+    std::suspend_always initial_suspend() const noexcept
+    {
+        return {};
+    }
+
+    FinalAwaiter final_suspend() const noexcept
+    {
+        return {};
+    }
+
+    void unhandled_exception() noexcept
+    {
+        m_exception = std::current_exception();
+    }
+
+    void SetContinuation(std::coroutine_handle<> continuation)
+    {
+        m_continuation = continuation;
+    }
+
+protected:
+    void RethrowIfFailed() const
+    {
+        if (m_exception)
+            std::rethrow_exception(m_exception);
+    }
+
+private:
+    std::coroutine_handle<> m_continuation;
+    std::exception_ptr m_exception;
+};
+
+template <typename T>
+class TaskPromise;
+} // namespace Detail
+
+/**
+ * \brief Lazy coroutine returning a T
+ *
+ * The coroutine start when the task is awaited and resume the awaiting
+ * coroutine with symmetric transfer when it is done, so a chain of tasks never
+ * grow the stack. The task own the frame.
+ */
+template <typename T = void>
+class [[nodiscard]] Task
+{
+public:
+    using promise_type = Detail::TaskPromise<T>;
+    using Handle = std::coroutine_handle<promise_type>;
+
+    Task() = default;
+
+    explicit Task(Handle handle) : m_handle{handle}
+    {
+    }
+
+    Task(Task &&other) noexcept : m_handle{std::exchange(other.m_handle, nullptr)}
+    {
+    }
+
+    Task &operator=(Task &&other) noexcept
+    {
+        if (this != &other)
+        {
+            if (m_handle)
+                m_handle.destroy();
+            m_handle = std::exchange(other.m_handle, nullptr);
+        }
+        return *this;
+    }
+
+    ~Task()
+    {
+        if (m_handle)
+            m_handle.destroy();
+    }
+
+    Task(const Task &) = delete;
+    Task &operator=(const Task &) = delete;
+
+    /// start the task if needed and get its result
+    auto operator co_await() noexcept
+    {
+        struct Awaiter : ReadyAwaiter
+        {
+            T await_resume()
+            {
+                return this->handle.promise().Result();
+            }
+        };
+        return Awaiter{{m_handle}};
+    }
+
+    /// start the task if needed and wait for it, without getting the result
+    auto WhenReady() noexcept
+    {
+        return ReadyAwaiter{m_handle};
+    }
+
+    bool IsReady() const
+    {
+        return !m_handle || m_handle.done();
+    }
+
+    /// the result of a finished task, rethrow its exception
+    T Result()
+    {
+        return m_handle.promise().Result();
+    }
+
+private:
+    struct ReadyAwaiter
+    {
+        bool await_ready() const noexcept
+        {
+            return !handle || handle.done();
+        }
+
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+        {
+            handle.promise().SetContinuation(awaiting);
+            return handle;
+        }
+
+        void await_resume() const noexcept
+        {
+        }
+
+        Handle handle;
+    };
+
+    Handle m_handle;
+};
+
+namespace Detail
+{
+template <typename T>
+class TaskPromise : public PromiseBase
+{
+public:
+    Task<T> get_return_object() noexcept
+    {
+        return Task<T>(std::coroutine_handle<TaskPromise>::from_promise(*this));
+    }
+
+    template <typename U>
+    void return_value(U &&value)
+    {
+        m_value.emplace(std::forward<U>(value));
+    }
+
+    T Result()
+    {
+        RethrowIfFailed();
+        return std::move(*m_value);
+    }
+
+private:
+    std::optional<T> m_value;
+};
+
+template <>
+class TaskPromise<void> : public PromiseBase
+{
+public:
+    Task<void> get_return_object() noexcept
+    {
+        return Task<void>(std::coroutine_handle<TaskPromise>::from_promise(*this));
+    }
+
+    void return_void() const noexcept
+    {
+    }
+
+    void Result() const
+    {
+        RethrowIfFailed();
+    }
+};
+
+/// eager coroutine destroying itself when done, drive the tasks of the combinators
+struct DetachedTask
+{
+    struct promise_type : PooledFrame
+    {
+        DetachedTask get_return_object() const noexcept
+        {
+            return {};
+        }
+
+        std::suspend_never initial_suspend() const noexcept
+        {
+            return {};
+        }
+
+        std::suspend_never final_suspend() const noexcept
+        {
+            return {};
+        }
+
+        void return_void() const noexcept
+        {
+        }
+
+        void unhandled_exception() const noexcept
+        {
+            std::terminate();
+        }
+    };
+};
+
+/// resume the waiter when the count drop to zero
+struct Latch
+{
+    void Signal()
+    {
+        if (count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            waiter.resume();
+    }
+
+    std::atomic<size_t> count{0};
+    std::coroutine_handle<> waiter;
+};
+
+template <typename T>
+DetachedTask SignalWhenReady(Task<T> &task, Latch &latch)
+{
+    co_await task.WhenReady();
+    latch.Signal();
+}
+
+/// start every task and suspend until all of them are done
+template <typename T>
+struct WhenAllAwaiter
+{
+    bool await_ready() const noexcept
+    {
+        return tasks.empty();
+    }
+
+    bool await_suspend(std::coroutine_handle<> awaiting)
+    {
+        // one more count for this thread, the waiter can't be resumed before the
+        // loop end. Suspend only if some task is still running
+        latch.count.store(tasks.size() + 1, std::memory_order_relaxed);
+        latch.waiter = awaiting;
+        for (auto &task : tasks)
+            SignalWhenReady(task, latch);
+        return latch.count.fetch_sub(1, std::memory_order_acq_rel) != 1;
+    }
+
+    void await_resume() const noexcept
+    {
+    }
+
+    std::vector<Task<T>> &tasks;
+    Latch latch;
+};
+
+/// state shared by WhenAny and the tasks still running after the first one is done
+template <typename T>
+struct WhenAnyState : PooledFrame
+{
+    explicit WhenAnyState(uint32 references) : refCount{references}
+    {
+    }
+
+    void Release()
+    {
+        if (refCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            delete this;
+    }
+
+    /// the first task done and the awaiting coroutine both pass the gate, the second resume
+    bool PassGate()
+    {
+        return gate.fetch_add(1, std::memory_order_acq_rel) == 1;
+    }
+
+    std::atomic<uint32> refCount;
+    std::atomic<bool> finished{false};
+    std::atomic<uint32> gate{0};
+    std::coroutine_handle<> waiter;
+    size_t index = 0;
+    std::exception_ptr exception;
+    std::optional<std::conditional_t<std::is_void_v<T>, bool, T>> value;
+};
+
+template <typename T>
+DetachedTask RunAny(Task<T> task, size_t index, WhenAnyState<T> *state)
+{
+    co_await task.WhenReady();
+    if (!state->finished.exchange(true, std::memory_order_acq_rel))
+    {
+        state->index = index;
+        try
+        {
+            if constexpr (std::is_void_v<T>)
+            {
+                task.Result();
+                state->value.emplace(true);
+            }
+            else
+                state->value.emplace(task.Result());
+        }
+        catch (...)
+        {
+            state->exception = std::current_exception();
+        }
+        if (state->PassGate())
+            state->waiter.resume();
+    }
+    state->Release();
+}
+
+template <typename T>
+struct WhenAnyAwaiter
+{
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+
+    bool await_suspend(std::coroutine_handle<> awaiting)
+    {
+        state->waiter = awaiting;
+        for (size_t i = 0; i < tasks.size(); i++)
+            RunAny(std::move(tasks[i]), i, state);
+        return !state->PassGate();
+    }
+
+    void await_resume() const noexcept
+    {
+    }
+
+    std::vector<Task<T>> &tasks;
+    WhenAnyState<T> *state;
+};
+} // namespace Detail
+
+/**
+ * \brief Wait for all the tasks
+ *
+ * The tasks are started one after the other on the calling thread, a task
+ * run in parallel once it co_await pool.Schedule().
+ * \return the results in the order of the tasks, the first exception is rethrown
+ */
+template <typename T>
+Task<std::vector<T>> WhenAll(std::vector<Task<T>> tasks)
+{
+    co_await Detail::WhenAllAwaiter<T>{tasks, {}};
+    std::vector<T> results;
+    results.reserve(tasks.size());
+    for (auto &task : tasks)
+        results.push_back(task.Result());
+    co_return results;
+}
+
+inline Task<void> WhenAll(std::vector<Task<void>> tasks)
+{
+    co_await Detail::WhenAllAwaiter<void>{tasks, {}};
+    for (auto &task : tasks)
+        task.Result();
+}
+
+/**
+ * \brief Wait for the first task done, the others keep running and own their frames
+ * \param tasks must not be empty
+ * \return index and result of the first task done, its exception is rethrown
+ */
+template <typename T>
+Task<std::pair<size_t, T>> WhenAny(std::vector<Task<T>> tasks)
+{
+    auto *state = new Detail::WhenAnyState<T>(static_cast<uint32>(tasks.size() + 1));
+    co_await Detail::WhenAnyAwaiter<T>{tasks, state};
+
+    const size_t             index = state->index;
+    const std::exception_ptr exception = state->exception;
+    std::optional<T>         value = std::move(state->value);
+    state->Release();
+    if (exception)
+        std::rethrow_exception(exception);
+    co_return std::pair<size_t, T>(index, std::move(*value));
+}
+
+/**
+ * \return index of the first task done, its exception is rethrown
+ */
+inline Task<size_t> WhenAny(std::vector<Task<void>> tasks)
+{
+    auto *state = new Detail::WhenAnyState<void>(static_cast<uint32>(tasks.size() + 1));
+    co_await Detail::WhenAnyAwaiter<void>{tasks, state};
+
+    const size_t             index = state->index;
+    const std::exception_ptr exception = state->exception;
+    state->Release();
+    if (exception)
+        std::rethrow_exception(exception);
+    co_return index;
+}
+
+/**
+ * \brief Block a thread out of the coroutines until the task is done, helping the pool meanwhile
+ */
+template <typename T>
+T SyncWait(ThreadPool &pool, Task<T> task)
+{
+    std::atomic<bool> done{false};
+    [](Task<T> &waited, std::atomic<bool> &flag) -> Detail::DetachedTask {
+        co_await waited.WhenReady();
+        flag.store(true, std::memory_order_release);
+    }(task, done);
+
+    while (!done.load(std::memory_order_acquire))
+    {
+        if (!pool.RunPendingTask())
+            CpuPause();
+    }
+    return task.Result();
+}
+} // namespace Hawl::Coroutine
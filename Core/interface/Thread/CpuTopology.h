@@ -0,0 +1,124 @@
+/**
+ *  Copyright 2020-2021 Zhang QiuLiang (juteman). All rights reserved.
+ *
+ *  This file is a part of Hawl
+ *  see(https://github.com/juteman/Hawl)
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#pragma once
+#include "BaseType.h"
+#include <vector>
+
+namespace Hawl
+{
+/// one logical processor the process is allowed to run on
+struct LogicalCpu
+{
+    /// os index of the processor
+    uint32 id = 0;
+    /// physical core, unique over the packages
+    uint32 core = 0;
+    /// socket holding the core
+    uint32 package = 0;
+    /// NUMA node of the processor memory
+    uint32 node = 0;
+};
+
+/**
+ * \brief How the workers of a pool are pinned to the logical processors
+ */
+enum class AffinityPolicy : int
+{
+    /// no pinning, the os scheduler move the threads freely
+    None = 0,
+    /// fill the SMT siblings of a core, then the cores of a package, then the next package.
+    /// Workers share caches, for fine grained tasks stealing from each other
+    Compact,
+    /// one worker per physical core spread over the packages first, the SMT siblings
+    /// come last. Workers get the most cache and memory bandwidth
+    Scatter,
+};
+
+/**
+ * \brief Processors, cores, packages and NUMA nodes of the machine
+ *
+ * Only the processors in the affinity mask of the process are listed. On linux
+ * the topology come from sched_getaffinity and /sys/devices/system/cpu, on
+ * windows from GetLogicalProcessorInformationEx, limited to the first processor
+ * group. When nothing can be read every processor is its own core on node 0.
+ */
+class CpuTopology
+{
+public:
+    /**
+     * \return the topology of the machine, discovered at the first call
+     */
+    static const CpuTopology &Get();
+
+    /**
+     * \return the usable processors, sorted by package, core then id
+     */
+    const std::vector<LogicalCpu> &GetCpus() const
+    {
+        return m_cpus;
+    }
+
+    uint32 GetCoreCount() const
+    {
+        return m_coreCount;
+    }
+
+    uint32 GetPackageCount() const
+    {
+        return m_packageCount;
+    }
+
+    uint32 GetNodeCount() const
+    {
+        return m_nodeCount;
+    }
+
+    /**
+     * \brief choose the processor of every worker
+     * \param count number of workers, the processors are reused when count is above their number
+     * \param policy order of the processors, None give an empty list
+     * \param reserveFirstCore keep the core of the first processor for the main thread
+     * \return index in GetCpus() of the processor of every worker
+     */
+    std::vector<uint32> SelectCpus(uint32 count, AffinityPolicy policy, bool reserveFirstCore) const;
+
+    /**
+     * \brief log the processors, cores, packages and nodes
+     */
+    void Log() const;
+
+    /**
+     * \brief pin the calling thread to one processor
+     * \param cpu os index of the processor
+     * \return false if the os refuse, the failure is logged
+     */
+    static bool PinCurrentThread(uint32 cpu);
+
+private:
+    CpuTopology();
+
+    void Discover();
+
+    std::vector<LogicalCpu> m_cpus;
+    uint32 m_coreCount = 0;
+    uint32 m_packageCount = 0;
+    uint32 m_nodeCount = 0;
+};
+} // namespace Hawl
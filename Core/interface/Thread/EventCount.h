@@ -0,0 +1,199 @@
+/**
+ *  Copyright 2020-2021 Zhang QiuLiang (juteman). All rights reserved.
+ *
+ *  This file is a part of Hawl
+ *  see(https://github.com/juteman/Hawl)
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#pragma once
+#include "BaseType.h"
+#include "Common.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace Hawl
+{
+/**
+ * \brief hint the cpu we are in a spin wait loop
+ */
+FORCEINLINE void CpuPause()
+{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    _mm_pause();
+#elif defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+/**
+ * \brief block on the address until it is woken or the value is no longer expected
+ * \param address 32 bit word to wait on
+ * \param expected the thread only sleep if *address still equal to expected
+ * \param timeout relative timeout, negative for infinite
+ * \return false if the timeout expire
+ */
+bool FutexWait(std::atomic<uint32> *address, uint32 expected, std::chrono::nanoseconds timeout);
+
+/**
+ * \brief wake the threads waiting on the address
+ * \param address 32 bit word threads wait on
+ * \param count max number of thread to wake
+ */
+void FutexWake(std::atomic<uint32> *address, uint32 count);
+
+/**
+ * \brief Event count, a condition variable for lock-free data structures.
+ *
+ * A consumer that find the structure empty call PrepareWait, check the
+ * structure again, then either CancelWait or CommitWait to sleep on a futex.
+ * A producer call Notify after publishing, which cost one fence and one load
+ * when no thread is parked, and never wake more threads than are waiting.
+ */
+class EventCount
+{
+public:
+    /// how many times Await poll the condition before parking the thread
+    static constexpr uint32 DefaultSpinCount = 128;
+
+    EventCount() = default;
+
+    /**
+     * \brief announce the calling thread is going to wait
+     * \return key to pass to CommitWait
+     */
+    uint32 PrepareWait()
+    {
+        m_waiters.fetch_add(1, std::memory_order_seq_cst);
+        return m_epoch.load(std::memory_order_seq_cst);
+    }
+
+    /**
+     * \brief the condition became true after PrepareWait, don't wait
+     */
+    void CancelWait()
+    {
+        m_waiters.fetch_sub(1, std::memory_order_seq_cst);
+    }
+
+    /**
+     * \brief sleep until a Notify after the matching PrepareWait
+     * \param key value returned by PrepareWait
+     * \param timeout relative timeout, negative for infinite
+     * \return false if the timeout expire
+     */
+    bool CommitWait(uint32 key, std::chrono::nanoseconds timeout = std::chrono::nanoseconds(-1))
+    {
+        // a spurious wake only wait the time left to the deadline
+        const bool infinite = timeout.count() < 0;
+        const auto deadline = infinite ? std::chrono::steady_clock::time_point::max()
+                                       : std::chrono::steady_clock::now() + timeout;
+        bool       woken = true;
+        while (m_epoch.load(std::memory_order_acquire) == key)
+        {
+            std::chrono::nanoseconds remaining = timeout;
+            if (!infinite)
+                remaining = std::max<std::chrono::nanoseconds>(deadline - std::chrono::steady_clock::now(), {});
+            if (!FutexWait(&m_epoch, key, remaining))
+            {
+                woken = m_epoch.load(std::memory_order_acquire) != key;
+                break;
+            }
+        }
+        m_waiters.fetch_sub(1, std::memory_order_seq_cst);
+        return woken;
+    }
+
+    /**
+     * \brief wake up to count waiting threads, nothing if no thread is waiting
+     */
+    void Notify(uint32 count = 1)
+    {
+        // pair with the seq_cst increment in PrepareWait, either the waiter see the
+        // published data on its recheck or we see the waiter here
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_waiters.load(std::memory_order_relaxed) == 0)
+            return;
+
+        m_epoch.fetch_add(1, std::memory_order_seq_cst);
+        FutexWake(&m_epoch, count);
+    }
+
+    /**
+     * \brief wake all waiting threads
+     */
+    void NotifyAll()
+    {
+        Notify(~uint32(0) >> 1);
+    }
+
+    /**
+     * \brief spin on tryFunc for a while, then park until notified and try again
+     * \param tryFunc return true when the condition is satisfied
+     * \param timeout relative timeout, negative for infinite
+     * \return false if tryFunc still fail when the timeout expire
+     */
+    template <typename TryFunc>
+    bool Await(TryFunc &&tryFunc, std::chrono::nanoseconds timeout = std::chrono::nanoseconds(-1))
+    {
+        for (uint32 i = 0; i < DefaultSpinCount; ++i)
+        {
+            if (tryFunc())
+                return true;
+            CpuPause();
+        }
+
+        const bool infinite = timeout.count() < 0;
+        const auto deadline = std::chrono::steady_clock::now() + (infinite ? std::chrono::nanoseconds(0) : timeout);
+        while (true)
+        {
+            const uint32 key = PrepareWait();
+            if (tryFunc())
+            {
+                CancelWait();
+                return true;
+            }
+
+            std::chrono::nanoseconds remaining(-1);
+            if (!infinite)
+            {
+                remaining = deadline - std::chrono::steady_clock::now();
+                if (remaining.count() <= 0)
+                {
+                    CancelWait();
+                    return false;
+                }
+            }
+            CommitWait(key, remaining);
+        }
+    }
+
+private:
+    /// futex word, bumped by every Notify that find a waiter
+    alignas(CacheLineSize) std::atomic<uint32> m_epoch{0};
+    /// number of threads between PrepareWait and CommitWait or CancelWait
+    std::atomic<uint32> m_waiters{0};
+
+    HAWL_DISABLE_COPY(EventCount)
+};
+} // namespace Hawl
@@ -0,0 +1,264 @@
+/**
+ *  Copyright 2020-2021 Zhang QiuLiang (juteman). All rights reserved.
+ *
+ *  This file is a part of Hawl
+ *  see(https://github.com/juteman/Hawl)
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#pragma once
+#include "Algorithm/LockfreeQueue.h"
+#include "Algorithm/NodePool.h"
+#include "BaseType.h"
+#include "Common.h"
+#include "Thread.h"
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#if defined(_WIN32)
+#elif defined(__x86_64__)
+/// hand written switch, ucontext save the signal mask with a syscall on every switch
+#define HAWL_FIBER_X86_64 1
+#else
+#include <ucontext.h>
+#endif
+
+namespace Hawl
+{
+class FiberCounter;
+
+/**
+ * \brief saved execution context of a fiber or of the thread that switched to it
+ */
+struct FiberContext
+{
+#if defined(_WIN32)
+    void *fiber = nullptr;
+#elif defined(HAWL_FIBER_X86_64)
+    /// the callee saved registers are pushed on the stack
+    void *stackPointer = nullptr;
+#else
+    ucontext_t context;
+#endif
+};
+
+/**
+ * \brief Run jobs on a fixed pool of fibers on top of a ThreadPool
+ *
+ * A job run on its own fiber stack, so WaitForCounter can switch back to the
+ * worker thread and let it run other tasks instead of blocking it. The parked
+ * fiber is added to the pool again when the counter drop to zero, and may be
+ * resumed by any worker.
+ *
+ * RunJob add a small start task to the pool, the job only take a fiber when a
+ * worker start it, so the fibers in use are the jobs started and not finished.
+ * When every fiber is in use the job run on the stack of the worker, and a
+ * WaitForCounter in it help the pool instead of parking. Thread local variables
+ * must not be cached across a WaitForCounter, the job may come back on another thread.
+ */
+class FiberJobSystem
+{
+public:
+    static constexpr uint32 DefaultFiberCount = 128;
+    static constexpr size_t DefaultStackSize = 64 * 1024;
+
+    /**
+     * \param pool the worker threads running the fibers
+     * \param fiberCount number of fibers, the number of jobs started and not finished
+     * above it run on the worker stacks
+     * \param stackSize stack size of every fiber
+     */
+    explicit FiberJobSystem(ThreadPool &pool,
+                            uint32 fiberCount = DefaultFiberCount,
+                            size_t stackSize = DefaultStackSize);
+
+    /**
+     * \brief all the jobs must be finished, wait for the fibers to get back to the free list
+     */
+    ~FiberJobSystem();
+
+    /**
+     * \brief Run the job on a fiber, return without waiting
+     * \param job the job, must outlive its execution, its taskPriority is used in the pool
+     * \param counter incremented now and decremented when the job is done, can be null
+     */
+    void RunJob(Task *job, FiberCounter *counter = nullptr);
+
+    /**
+     * \brief Wait until the counter drop to zero
+     *
+     * From a job the fiber is parked and the worker run other tasks, from any
+     * other thread the caller help the pool until the counter drop to zero.
+     */
+    void WaitForCounter(FiberCounter &counter);
+
+    /**
+     * \brief Park the calling job behind the other pending tasks of the pool,
+     * nothing happen when it is not called from a job
+     */
+    void YieldJob();
+
+    /**
+     * \return true if the calling thread is running a job of a fiber
+     */
+    static bool IsInFiber();
+
+private:
+    friend class FiberCounter;
+
+    struct PendingJob
+    {
+        Task *job = nullptr;
+        FiberCounter *counter = nullptr;
+    };
+
+    /// task added to the pool by RunJob, give the job a fiber when it is run
+    struct JobStart : Task
+    {
+        JobStart(FiberJobSystem *InSystem, const PendingJob &InPending) : system{InSystem}, pending{InPending}
+        {
+        }
+
+        void run() override;
+
+        FiberJobSystem *system;
+        PendingJob pending;
+    };
+
+    using StartPool = Algorithm::NodePool<JobStart>;
+
+    /// what the thread should do with the fiber once it switch out
+    enum class FiberAction
+    {
+        Finish,
+        Wait,
+        Yield,
+    };
+
+    struct Fiber : Task
+    {
+        void run() override;
+
+        FiberJobSystem *system = nullptr;
+        FiberContext context;
+        /// context of the thread currently running the fiber
+        FiberContext *caller = nullptr;
+        void *stack = nullptr;
+
+        PendingJob current;
+        FiberAction action = FiberAction::Finish;
+        FiberCounter *waitCounter = nullptr;
+        /// next fiber parked on the same counter
+        Fiber *nextWaiter = nullptr;
+    };
+
+    /// entry point of every fiber, run the jobs given to the fiber forever
+#if defined(_WIN32)
+    static void __stdcall FiberEntry(void *parameter);
+#else
+    static void FiberEntry(void *parameter);
+#endif
+
+    /// allocate the stack and the initial context of the fiber
+    bool CreateFiberContext(Fiber &fiber);
+
+    /// run the job on the calling stack and decrement its counter
+    static void RunPendingJob(const PendingJob &pending);
+
+    /// switch from the job back to the thread running the fiber
+    static void SwitchToCaller(Fiber *fiber);
+
+    /// run the job on a free fiber, or on the calling stack if there is none
+    void StartJob(const PendingJob &pending);
+
+    /// the thread switched out of the fiber, do what the fiber asked
+    void AfterSwitch(Fiber *fiber);
+
+    ThreadPool &m_pool;
+    size_t m_stackSize;
+    size_t m_pageSize = 0;
+    std::vector<std::unique_ptr<Fiber>> m_fibers;
+    Algorithm::BoundedQueue<Fiber *, Algorithm::QueueModel::MPMC> m_freeFibers;
+    /// fibers given a job and not back to the free list
+    std::atomic<uint32> m_busyFibers{0};
+
+    HAWL_DISABLE_COPY(FiberJobSystem)
+};
+
+/**
+ * \brief Counter of unfinished jobs that fibers can wait on
+ *
+ * The fibers waiting on the counter are added to the pool again when it drop
+ * to zero. The counter can be destroyed as soon as WaitForCounter return.
+ */
+class FiberCounter
+{
+public:
+    explicit FiberCounter(uint32 initial = 0) : m_value{initial}
+    {
+    }
+
+    void Add(uint32 count)
+    {
+        m_value.fetch_add(count, std::memory_order_relaxed);
+    }
+
+    /**
+     * \brief decrement the counter, resume the waiting fibers when it reach zero
+     */
+    void Decrement();
+
+    uint32 Get() const
+    {
+        return m_value.load(std::memory_order_acquire);
+    }
+
+private:
+    friend class FiberJobSystem;
+
+    /**
+     * \return true once the counter is zero and the last Decrement no longer touch it
+     */
+    bool IsReleased() const
+    {
+        return m_value.load(std::memory_order_acquire) == 0 && !m_lock.load(std::memory_order_acquire);
+    }
+
+    /**
+     * \brief park the fiber until the counter reach zero
+     * \return false if the counter is already zero, the fiber is not parked
+     */
+    bool AddWaiter(FiberJobSystem::Fiber *fiber);
+
+    void Lock()
+    {
+        while (m_lock.exchange(true, std::memory_order_acquire))
+            CpuPause();
+    }
+
+    void Unlock()
+    {
+        m_lock.store(false, std::memory_order_release);
+    }
+
+    std::atomic<uint32> m_value;
+    /// the value only drop to zero and the waiters only change under this lock
+    std::atomic<bool> m_lock{false};
+    /// intrusive list of the parked fibers
+    FiberJobSystem::Fiber *m_waiters = nullptr;
+
+    HAWL_DISABLE_COPY(FiberCounter)
+};
+} // namespace Hawl
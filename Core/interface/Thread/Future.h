@@ -0,0 +1,642 @@
+/**
+ *  Copyright 2020-2021 Zhang QiuLiang (juteman). All rights reserved.
+ *
+ *  This file is a part of Hawl
+ *  see(https://github.com/juteman/Hawl)
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#pragma once
+#include "BaseType.h"
+#include "Common.h"
+#include "Memory/PoolAllocator.h"
+#include "Thread.h"
+#include <atomic>
+#include <exception>
+#include <future>
+#include <new>
+#include <optional>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace Hawl
+{
+template <typename T>
+class Future;
+
+template <typename T>
+class Promise;
+
+namespace Detail
+{
+template <typename T>
+class FutureState;
+
+/// lets the producers of this file build and consume Futures from their state
+struct FutureAccess
+{
+    template <typename T>
+    static Future<T> Make(FutureState<T> *state)
+    {
+        return Future<T>(state);
+    }
+
+    template <typename T>
+    static FutureState<T> *Detach(Future<T> &future)
+    {
+        return future.Detach();
+    }
+};
+
+/// value of a Future<void>
+struct FutureEmpty
+{
+};
+
+/// notified once by the thread making a shared state ready
+struct FutureContinuation
+{
+    virtual void OnReady() = 0;
+
+protected:
+    ~FutureContinuation() = default;
+};
+
+/**
+ * \brief Reference counted part of the shared state of a Future, lock free
+ *
+ * One word hold the whole synchronization: empty, ready, or the continuation
+ * waiting for the value. The producer publish the value with one exchange and
+ * run the continuation it took out, so a continuation is never missed nor run
+ * twice. The states come from the PoolAllocator.
+ */
+class FutureStateBase
+{
+public:
+    FutureStateBase() = default;
+    virtual ~FutureStateBase() = default;
+
+    static void *operator new(size_t size)
+    {
+        return PoolAllocator::Allocate(size);
+    }
+
+    static void operator delete(void *state, size_t size)
+    {
+        PoolAllocator::Free(state, size);
+    }
+
+    void AddRef()
+    {
+        m_refCount.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void Release()
+    {
+        if (m_refCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            delete this;
+    }
+
+    bool IsReady() const
+    {
+        return m_word.load(std::memory_order_acquire) == ReadyWord;
+    }
+
+    /// block the calling thread until ready
+    void Wait() const
+    {
+        uintptr_t word;
+        while ((word = m_word.load(std::memory_order_acquire)) != ReadyWord)
+            m_word.wait(word, std::memory_order_acquire);
+    }
+
+    /// run the pending tasks of the pool until ready, a worker may wait this way
+    void Wait(ThreadPool &pool) const
+    {
+        while (!IsReady())
+        {
+            if (!pool.RunPendingTask())
+                CpuPause();
+        }
+    }
+
+    /// notify the continuation when ready, at once if it is already
+    void SetContinuation(FutureContinuation *continuation)
+    {
+        uintptr_t expected = EmptyWord;
+        if (!m_word.compare_exchange_strong(expected,
+                                            reinterpret_cast<uintptr_t>(continuation),
+                                            std::memory_order_acq_rel,
+                                            std::memory_order_acquire))
+            continuation->OnReady();
+    }
+
+    /// the producer must hold a reference, the state is touched after the waiters are released
+    void SetException(std::exception_ptr exception)
+    {
+        m_exception = std::move(exception);
+        MarkReady();
+    }
+
+    const std::exception_ptr &GetException() const
+    {
+        return m_exception;
+    }
+
+protected:
+    void MarkReady()
+    {
+        const uintptr_t previous = m_word.exchange(ReadyWord, std::memory_order_acq_rel);
+        if (previous != EmptyWord)
+            reinterpret_cast<FutureContinuation *>(previous)->OnReady();
+        else
+            m_word.notify_all();
+    }
+
+private:
+    static constexpr uintptr_t EmptyWord = 0;
+    static constexpr uintptr_t ReadyWord = 1;
+
+    mutable std::atomic<uintptr_t> m_word{EmptyWord};
+    /// the producer and the consumer, a continuation take the reference of the consumed Future
+    std::atomic<uint32> m_refCount{2};
+    std::exception_ptr  m_exception;
+
+    HAWL_DISABLE_COPY(FutureStateBase)
+};
+
+template <typename T>
+class FutureState : public FutureStateBase
+{
+public:
+    using Stored = std::conditional_t<std::is_void_v<T>, FutureEmpty, T>;
+
+    ~FutureState() override
+    {
+        if (m_hasValue)
+            GetValue().~Stored();
+    }
+
+    template <typename... Args>
+    void SetValue(Args &&...args)
+    {
+        new (m_storage) Stored(std::forward<Args>(args)...);
+        m_hasValue = true;
+        MarkReady();
+    }
+
+    /// once ready, rethrow the exception of the producer
+    Stored &GetValue()
+    {
+        if (GetException())
+            std::rethrow_exception(GetException());
+        return *std::launder(reinterpret_cast<Stored *>(m_storage));
+    }
+
+private:
+    alignas(Stored) unsigned char m_storage[sizeof(Stored)];
+    bool m_hasValue = false;
+};
+
+/// set the result of the function into the state, or the exception it threw
+template <typename R, typename Function, typename... Args>
+void InvokeInto(FutureState<R> &state, Function &function, Args &&...args)
+{
+    try
+    {
+        if constexpr (std::is_void_v<R>)
+        {
+            function(std::forward<Args>(args)...);
+            state.SetValue();
+        }
+        else
+            state.SetValue(function(std::forward<Args>(args)...));
+    }
+    catch (...)
+    {
+        state.SetException(std::current_exception());
+    }
+}
+
+/// result of a function taking the value of a Future<T>
+template <typename Function, typename T>
+struct ThenResult
+{
+    using Type = std::invoke_result_t<Function, T>;
+};
+
+template <typename Function>
+struct ThenResult<Function, void>
+{
+    using Type = std::invoke_result_t<Function>;
+};
+
+/**
+ * \brief State of the Future returned by Then, it is also the Task running the function
+ *
+ * The function, the result and the task share the one allocation.
+ */
+template <typename R, typename T, typename Function>
+class ThenState final : public FutureState<R>, public FutureContinuation, public Task
+{
+public:
+    ThenState(ThreadPool &InPool, FutureState<T> *InSource, Function &&InFunction, Priority InPriority)
+        : m_pool{InPool}, m_source{InSource}, m_function{std::move(InFunction)}
+    {
+        taskPriority = InPriority;
+    }
+
+    void OnReady() override
+    {
+        m_pool.AddTask(this);
+    }
+
+    void run() override
+    {
+        if (m_source->GetException())
+            this->SetException(m_source->GetException());
+        else if constexpr (std::is_void_v<T>)
+            InvokeInto(*this, *m_function);
+        else
+            InvokeInto(*this, *m_function, std::move(m_source->GetValue()));
+
+        // the captures are released now, not with the result
+        m_function.reset();
+        m_source->Release();
+        this->Release();
+    }
+
+private:
+    ThreadPool             &m_pool;
+    FutureState<T>         *m_source;
+    std::optional<Function> m_function;
+};
+
+/// State of the Future returned by Async
+template <typename R, typename Function>
+class AsyncState final : public FutureState<R>, public Task
+{
+public:
+    AsyncState(Function &&InFunction, Priority InPriority) : m_function{std::move(InFunction)}
+    {
+        taskPriority = InPriority;
+    }
+
+    void run() override
+    {
+        InvokeInto(*this, *m_function);
+        m_function.reset();
+        this->Release();
+    }
+
+private:
+    std::optional<Function> m_function;
+};
+
+template <typename T>
+using WhenAllResult = std::conditional_t<std::is_void_v<T>, void, std::vector<T>>;
+
+/**
+ * \brief State of the Future returned by WhenAll
+ *
+ * Every input notify it on the thread of its producer, the last one collect
+ * the values in input order, or the first exception in input order.
+ */
+template <typename T>
+class WhenAllState final : public FutureState<WhenAllResult<T>>
+{
+public:
+    explicit WhenAllState(std::span<Future<T>> futures) : m_remaining{static_cast<uint32>(futures.size()) + 1}
+    {
+        m_inputs.reserve(futures.size());
+        for (Future<T> &future : futures)
+            m_inputs.emplace_back(this, FutureAccess::Detach(future));
+    }
+
+    /// register on the inputs, the extra count keep the collection after the last registration
+    void Start()
+    {
+        for (Input &input : m_inputs)
+            input.source->SetContinuation(&input);
+        Arrive();
+    }
+
+private:
+    struct Input final : FutureContinuation
+    {
+        Input(WhenAllState *InJoin, FutureState<T> *InSource) : join{InJoin}, source{InSource}
+        {
+        }
+
+        void OnReady() override
+        {
+            join->Arrive();
+        }
+
+        WhenAllState   *join;
+        FutureState<T> *source;
+    };
+
+    void Arrive()
+    {
+        if (m_remaining.fetch_sub(1, std::memory_order_acq_rel) != 1)
+            return;
+
+        std::exception_ptr exception;
+        for (Input &input : m_inputs)
+        {
+            if (input.source->GetException())
+            {
+                exception = input.source->GetException();
+                break;
+            }
+        }
+
+        if (exception)
+            this->SetException(exception);
+        else if constexpr (std::is_void_v<T>)
+            this->SetValue();
+        else
+        {
+            std::vector<T> values;
+            values.reserve(m_inputs.size());
+            for (Input &input : m_inputs)
+                values.push_back(std::move(input.source->GetValue()));
+            this->SetValue(std::move(values));
+        }
+
+        for (Input &input : m_inputs)
+            input.source->Release();
+        m_inputs.clear();
+        this->Release();
+    }
+
+    std::vector<Input>  m_inputs;
+    std::atomic<uint32> m_remaining;
+};
+} // namespace Detail
+
+
+/**
+ * \brief Value computed asynchronously, move only, lighter than std::future
+ *
+ * The shared state is one PoolAllocator allocation without mutex nor condition
+ * variable. Then chain a function on the ThreadPool instead of blocking a
+ * thread per stage, it consume the Future. Get and Wait block the calling
+ * thread, a worker of the pool should wait with the pool version to help it.
+ */
+template <typename T>
+class Future
+{
+    static_assert(!std::is_reference_v<T>, "Future of reference is not supported");
+
+public:
+    Future() = default;
+
+    Future(Future &&other) noexcept : m_state{std::exchange(other.m_state, nullptr)}
+    {
+    }
+
+    Future &operator=(Future &&other) noexcept
+    {
+        if (this != &other)
+        {
+            Reset();
+            m_state = std::exchange(other.m_state, nullptr);
+        }
+        return *this;
+    }
+
+    ~Future()
+    {
+        Reset();
+    }
+
+    /// false once consumed by Get, Then or WhenAll
+    bool IsValid() const
+    {
+        return m_state != nullptr;
+    }
+
+    bool IsReady() const
+    {
+        return m_state->IsReady();
+    }
+
+    void Wait() const
+    {
+        m_state->Wait();
+    }
+
+    void Wait(ThreadPool &pool) const
+    {
+        m_state->Wait(pool);
+    }
+
+    /**
+     * \brief Wait then take the value, or rethrow the exception of the producer
+     */
+    T Get()
+    {
+        m_state->Wait();
+        return Take();
+    }
+
+    /**
+     * \brief Like Get, but run the tasks of the pool while waiting
+     */
+    T Get(ThreadPool &pool)
+    {
+        m_state->Wait(pool);
+        return Take();
+    }
+
+    /**
+     * \brief Run the function on the pool with the value once ready
+     *
+     * An exception of the producer skip the function and pass to the returned Future.
+     * \param function take the value, or nothing for a Future<void>
+     * \param taskPriority priority of the function in the pool
+     */
+    template <typename Function>
+    auto Then(ThreadPool &pool, Function &&function, Priority taskPriority = Priority::Normal)
+    {
+        using Callable = std::decay_t<Function>;
+        using R = typename Detail::ThenResult<Callable &, T>::Type;
+        // the reference of this Future now belongs to the continuation
+        Detail::FutureState<T> *source = Detach();
+        auto *state = new Detail::ThenState<R, T, Callable>(pool, source, Callable(std::forward<Function>(function)),
+                                                           taskPriority);
+        source->SetContinuation(state);
+        return Future<R>(state);
+    }
+
+private:
+    template <typename>
+    friend class Future;
+    friend struct Detail::FutureAccess;
+
+    explicit Future(Detail::FutureState<T> *state) : m_state{state}
+    {
+    }
+
+    Detail::FutureState<T> *Detach()
+    {
+        return std::exchange(m_state, nullptr);
+    }
+
+    T Take()
+    {
+        Detail::FutureState<T> *state = Detach();
+        struct Releaser
+        {
+            ~Releaser()
+            {
+                state->Release();
+            }
+            Detail::FutureState<T> *state;
+        } releaser{state};
+
+        if constexpr (std::is_void_v<T>)
+            state->GetValue();
+        else
+            return std::move(state->GetValue());
+    }
+
+    void Reset()
+    {
+        if (m_state != nullptr)
+            Detach()->Release();
+    }
+
+    Detail::FutureState<T> *m_state = nullptr;
+};
+
+
+/**
+ * \brief Producer side of a Future, set once, move only
+ *
+ * A Promise destroyed unset break its Future with std::future_errc::broken_promise.
+ */
+template <typename T>
+class Promise
+{
+public:
+    Promise() : m_state{new Detail::FutureState<T>()}
+    {
+    }
+
+    Promise(Promise &&other) noexcept
+        : m_state{std::exchange(other.m_state, nullptr)}, m_retrieved{other.m_retrieved}
+    {
+    }
+
+    Promise &operator=(Promise &&other) noexcept
+    {
+        if (this != &other)
+        {
+            Abandon();
+            m_state = std::exchange(other.m_state, nullptr);
+            m_retrieved = other.m_retrieved;
+        }
+        return *this;
+    }
+
+    ~Promise()
+    {
+        Abandon();
+    }
+
+    /// call it once
+    Future<T> GetFuture()
+    {
+        m_retrieved = true;
+        return Detail::FutureAccess::Make(m_state);
+    }
+
+    template <typename U = T>
+    void SetValue(U &&value)
+        requires(!std::is_void_v<T>)
+    {
+        Detail::FutureState<T> *state = TakeState();
+        state->SetValue(std::forward<U>(value));
+        state->Release();
+    }
+
+    void SetValue()
+        requires std::is_void_v<T>
+    {
+        Detail::FutureState<T> *state = TakeState();
+        state->SetValue();
+        state->Release();
+    }
+
+    void SetException(std::exception_ptr exception)
+    {
+        Detail::FutureState<T> *state = TakeState();
+        state->SetException(std::move(exception));
+        state->Release();
+    }
+
+private:
+    /// the state of a Future never retrieved lose its consumer reference here
+    Detail::FutureState<T> *TakeState()
+    {
+        Detail::FutureState<T> *state = std::exchange(m_state, nullptr);
+        if (!m_retrieved)
+            state->Release();
+        return state;
+    }
+
+    void Abandon()
+    {
+        if (m_state != nullptr)
+            SetException(std::make_exception_ptr(std::future_error(std::future_errc::broken_promise)));
+    }
+
+    Detail::FutureState<T> *m_state = nullptr;
+    bool                    m_retrieved = false;
+
+    HAWL_DISABLE_COPY(Promise)
+};
+
+
+/**
+ * \brief Run the function on the pool, the Future get its result
+ */
+template <typename Function>
+auto Async(ThreadPool &pool, Function &&function, Priority taskPriority = Priority::Normal)
+{
+    using Callable = std::decay_t<Function>;
+    using R = std::invoke_result_t<Callable &>;
+    auto *state = new Detail::AsyncState<R, Callable>(Callable(std::forward<Function>(function)), taskPriority);
+    pool.AddTask(state);
+    return Detail::FutureAccess::Make<R>(state);
+}
+
+/**
+ * \brief Future ready when all the futures of the span are, they are consumed
+ * \return the values in the order of the span, or the first exception in that order
+ */
+template <typename T>
+Future<Detail::WhenAllResult<T>> WhenAll(std::span<Future<T>> futures)
+{
+    auto *state = new Detail::WhenAllState<T>(futures);
+    Future<Detail::WhenAllResult<T>> result = Detail::FutureAccess::Make<Detail::WhenAllResult<T>>(state);
+    state->Start();
+    return result;
+}
+} // namespace Hawl
@@ -0,0 +1,501 @@
+/**
+ *  Copyright 2020-2021 Zhang QiuLiang (juteman). All rights reserved.
+ *
+ *  This file is a part of Hawl
+ *  see(https://github.com/juteman/Hawl)
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#pragma once
+#include "Algorithm/NodePool.h"
+#include "BaseType.h"
+#include "Common.h"
+#include "Thread.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace Hawl
+{
+namespace Detail
+{
+/// a chunk run this long between two split checks, long enough to hide the clock reads
+constexpr int64 ParallelChunkNanoseconds = 5000;
+/// a range is split only if the half given away hold at least this much work
+constexpr int64 ParallelSplitNanoseconds = 2 * ParallelChunkNanoseconds;
+
+inline int64 ParallelClock()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+/// cost learnt while running a range, handed down to the ranges split from it
+struct ChunkEstimate
+{
+    /// items run between two split checks
+    uint64 chunk = 1;
+    /// picoseconds per item, 0 until measured
+    uint64 itemCost = 0;
+};
+
+/// help the pool until the spawned tasks are all done
+inline void HelpUntilZero(ThreadPool &pool, std::atomic<uint32> &pending)
+{
+    while (pending.load(std::memory_order_acquire) != 0)
+    {
+        if (!pool.RunPendingTask())
+            CpuPause();
+    }
+}
+
+/// counters of one parallel loop, shared by all its tasks
+struct LoopState
+{
+    explicit LoopState(ThreadPool &InPool) : pool{InPool}
+    {
+    }
+
+    ThreadPool &pool;
+    /// spawned tasks not finished yet
+    std::atomic<uint32> pending{0};
+    /// spawned tasks no thread has started yet, a range is only split when it is 0
+    std::atomic<uint32> queued{0};
+};
+
+/**
+ * \brief Run [begin, end) chunk by chunk with lazy binary splitting
+ *
+ * Half of the rest is given to spawn only when every range split before has
+ * been picked by a thread and the half hold enough work by the measured cost,
+ * so a loop of cheap items stay on one thread and an expensive one spread over
+ * the idle workers. The chunk grow until it takes ParallelChunkNanoseconds.
+ */
+template <typename Index, typename Process, typename Spawn>
+void RunAdaptive(LoopState &loop, Index begin, Index end, ChunkEstimate &estimate, Process &&process, Spawn &&spawn)
+{
+    while (begin < end)
+    {
+        const uint64 remaining = static_cast<uint64>(end - begin);
+        if (remaining > 1 && estimate.itemCost != 0 &&
+            remaining / 2 * estimate.itemCost >= static_cast<uint64>(ParallelSplitNanoseconds) * 1000 &&
+            loop.queued.load(std::memory_order_relaxed) == 0)
+        {
+            const Index middle = begin + static_cast<Index>(remaining / 2);
+            loop.pending.fetch_add(1, std::memory_order_relaxed);
+            loop.queued.fetch_add(1, std::memory_order_relaxed);
+            spawn(middle, end, estimate);
+            end = middle;
+            continue;
+        }
+
+        const uint64 count = std::min(estimate.chunk, remaining);
+        const Index  last = begin + static_cast<Index>(count);
+        const int64  start = ParallelClock();
+        process(begin, last);
+        const int64 elapsed = std::max<int64>(ParallelClock() - start, 1);
+        begin = last;
+
+        // at most double the chunk, the first measures are noisy
+        estimate.itemCost = static_cast<uint64>(elapsed) * 1000 / count;
+        const uint64 target = static_cast<uint64>(ParallelChunkNanoseconds) * 1000 / std::max<uint64>(estimate.itemCost, 1);
+        estimate.chunk = std::clamp<uint64>(target, 1, estimate.chunk * 2);
+    }
+}
+
+/// call body with a range, or item by item when it only take an index
+template <typename Index, typename Body>
+FORCEINLINE void InvokeRange(Body &body, Index first, Index last)
+{
+    if constexpr (std::is_invocable_v<Body &, Index, Index>)
+        body(first, last);
+    else
+    {
+        for (Index i = first; i < last; ++i)
+            body(i);
+    }
+}
+
+template <typename Index, typename Body>
+struct ForTask : Task
+{
+    using Pool = Algorithm::NodePool<ForTask>;
+
+    ForTask(LoopState &InLoop, Body &InBody, Index InBegin, Index InEnd, ChunkEstimate InEstimate)
+        : loop{InLoop}, body{InBody}, begin{InBegin}, end{InEnd}, estimate{InEstimate}
+    {
+    }
+
+    /// run [begin, end) on the calling thread, spawning ForTasks for the split ranges
+    static void Run(LoopState &loop, Body &body, Index begin, Index end, ChunkEstimate &estimate)
+    {
+        RunAdaptive(
+            loop, begin, end, estimate, [&](Index first, Index last) { InvokeRange(body, first, last); },
+            [&](Index first, Index last, const ChunkEstimate &split) {
+                loop.pool.AddTask(Pool::Instance().New(loop, body, first, last, split));
+            });
+    }
+
+    void run() override
+    {
+        LoopState &taskLoop = loop;
+        taskLoop.queued.fetch_sub(1, std::memory_order_relaxed);
+        Run(taskLoop, body, begin, end, estimate);
+
+        // the caller return once pending drop to zero, nothing is touched after
+        Pool::Instance().Delete(this);
+        taskLoop.pending.fetch_sub(1, std::memory_order_release);
+    }
+
+    LoopState    &loop;
+    Body         &body;
+    Index         begin;
+    Index         end;
+    ChunkEstimate estimate;
+};
+
+/// partial result of the range starting at begin
+template <typename Index, typename T>
+struct ReducePart
+{
+    Index       begin;
+    T           value;
+    ReducePart *next = nullptr;
+};
+
+template <typename Index, typename T, typename Reduce>
+struct ReduceState : LoopState
+{
+    ReduceState(ThreadPool &InPool, Reduce &InReduce, const T &InIdentity)
+        : LoopState{InPool}, reduce{InReduce}, identity{InIdentity}
+    {
+    }
+
+    Reduce  &reduce;
+    const T &identity;
+    /// finished parts, pushed by the tasks and folded by the caller
+    std::atomic<ReducePart<Index, T> *> parts{nullptr};
+};
+
+template <typename Index, typename T, typename Reduce>
+struct ReduceTask : Task
+{
+    using State = ReduceState<Index, T, Reduce>;
+    using Pool = Algorithm::NodePool<ReduceTask>;
+    using PartPool = Algorithm::NodePool<ReducePart<Index, T>>;
+
+    ReduceTask(State &InState, Index InBegin, Index InEnd, ChunkEstimate InEstimate)
+        : state{InState}, begin{InBegin}, end{InEnd}, estimate{InEstimate}
+    {
+    }
+
+    /// reduce [begin, end), the range only shrink from the end when split
+    static T Run(State &state, Index begin, Index end, ChunkEstimate &estimate)
+    {
+        T value = state.identity;
+        RunAdaptive(
+            state, begin, end, estimate,
+            [&](Index first, Index last) { value = state.reduce(first, last, std::move(value)); },
+            [&](Index first, Index last, const ChunkEstimate &split) {
+                state.pool.AddTask(Pool::Instance().New(state, first, last, split));
+            });
+        return value;
+    }
+
+    void run() override
+    {
+        State &taskState = state;
+        taskState.queued.fetch_sub(1, std::memory_order_relaxed);
+        auto *part = PartPool::Instance().New(ReducePart<Index, T>{begin, Run(state, begin, end, estimate)});
+        Pool::Instance().Delete(this);
+
+        ReducePart<Index, T> *head = taskState.parts.load(std::memory_order_relaxed);
+        do
+            part->next = head;
+        while (!taskState.parts.compare_exchange_weak(head, part, std::memory_order_release, std::memory_order_relaxed));
+        taskState.pending.fetch_sub(1, std::memory_order_release);
+    }
+
+    State        &state;
+    Index         begin;
+    Index         end;
+    ChunkEstimate estimate;
+};
+
+/// a quicksort partition, the left part is spawned and the right part kept
+template <typename RandomIt, typename Compare>
+struct SortTask : Task
+{
+    using Pool = Algorithm::NodePool<SortTask>;
+    /// below this size a part is sorted by std::sort
+    static constexpr ptrdiff_t Cutoff = 2048;
+
+    SortTask(ThreadPool &InPool, Compare &InComp, std::atomic<uint32> &InPending, RandomIt InFirst, RandomIt InLast)
+        : pool{InPool}, comp{InComp}, pending{InPending}, first{InFirst}, last{InLast}
+    {
+    }
+
+    static void Sort(ThreadPool &pool, Compare &comp, std::atomic<uint32> &pending, RandomIt first, RandomIt last)
+    {
+        while (last - first > Cutoff)
+        {
+            // median of three pivot, copied since the partition move the elements
+            RandomIt middle = first + (last - first) / 2;
+            if (comp(*middle, *first))
+                std::iter_swap(middle, first);
+            if (comp(*(last - 1), *middle))
+            {
+                std::iter_swap(last - 1, middle);
+                if (comp(*middle, *first))
+                    std::iter_swap(middle, first);
+            }
+            const auto pivot = *middle;
+            RandomIt   lower = std::partition(first, last, [&](const auto &value) { return comp(value, pivot); });
+            RandomIt   upper = std::partition(lower, last, [&](const auto &value) { return !comp(pivot, value); });
+
+            pending.fetch_add(1, std::memory_order_relaxed);
+            pool.AddTask(Pool::Instance().New(pool, comp, pending, first, lower));
+            first = upper;
+        }
+        std::sort(first, last, comp);
+    }
+
+    void run() override
+    {
+        std::atomic<uint32> &taskPending = pending;
+        Sort(pool, comp, pending, first, last);
+        Pool::Instance().Delete(this);
+        taskPending.fetch_sub(1, std::memory_order_release);
+    }
+
+    ThreadPool          &pool;
+    Compare             &comp;
+    std::atomic<uint32> &pending;
+    RandomIt             first;
+    RandomIt             last;
+};
+} // namespace Detail
+
+/**
+ * \brief Run body over [begin, end) on the pool, the calling thread take part
+ *
+ * No grain size is needed, the range is split lazily by the measured cost of
+ * the items and the demand of the idle workers. Body must not throw.
+ * \param body called as body(first, last) with a sub range, or body(i) for every index
+ */
+template <typename Index, typename Body>
+void ParallelFor(ThreadPool &pool, Index begin, Index end, Body &&body)
+{
+    static_assert(std::is_integral_v<Index>, "ParallelFor index must be integral");
+    using Task = Detail::ForTask<Index, std::remove_reference_t<Body>>;
+
+    Detail::LoopState     loop(pool);
+    Detail::ChunkEstimate estimate;
+    Task::Run(loop, body, begin, end, estimate);
+    Detail::HelpUntilZero(pool, loop.pending);
+}
+
+/**
+ * \brief Reduce [begin, end) on the pool
+ * \param identity neutral value of combine, start of every partial result
+ * \param reduce called as reduce(first, last, T accumulated) and return the accumulated value
+ * \param combine associative, called as combine(T left, T right) in the order of the ranges
+ * \return the reduction of the whole range, identity for an empty range
+ */
+template <typename Index, typename T, typename Reduce, typename Combine>
+T ParallelReduce(ThreadPool &pool, Index begin, Index end, T identity, Reduce &&reduce, Combine &&combine)
+{
+    static_assert(std::is_integral_v<Index>, "ParallelReduce index must be integral");
+    using ReduceType = std::remove_reference_t<Reduce>;
+    using Task = Detail::ReduceTask<Index, T, ReduceType>;
+    using Part = Detail::ReducePart<Index, T>;
+
+    Detail::ReduceState<Index, T, ReduceType> state(pool, reduce, identity);
+    Detail::ChunkEstimate estimate;
+    T value = Task::Run(state, begin, end, estimate);
+    Detail::HelpUntilZero(pool, state.pending);
+
+    // the caller part is the leftmost, fold the others by their begin
+    std::vector<Part *> parts;
+    for (Part *part = state.parts.load(std::memory_order_acquire); part != nullptr; part = part->next)
+        parts.push_back(part);
+    std::sort(parts.begin(), parts.end(), [](const Part *a, const Part *b) { return a->begin < b->begin; });
+    for (Part *part : parts)
+    {
+        value = combine(std::move(value), std::move(part->value));
+        Task::PartPool::Instance().Delete(part);
+    }
+    return value;
+}
+
+/**
+ * \brief Inclusive scan of [first, last) into out, out may be first
+ *
+ * The input is cut in blocks, the block sums are reduced in parallel, scanned
+ * on the calling thread, then every block is scanned from its offset in parallel.
+ * \param identity neutral value of op
+ * \param op associative, called as op(T accumulated, value)
+ */
+template <typename RandomIt, typename RandomOutIt, typename T, typename Op>
+    requires std::random_access_iterator<RandomIt> && std::random_access_iterator<RandomOutIt>
+void ParallelScan(ThreadPool &pool, RandomIt first, RandomIt last, RandomOutIt out, T identity, Op &&op)
+{
+    /// smaller blocks cost more in the two passes than they gain
+    constexpr size_t MinBlockSize = 16384;
+
+    const size_t count = static_cast<size_t>(std::distance(first, last));
+    const size_t blockCount =
+        std::min<size_t>(count / MinBlockSize, static_cast<size_t>(pool.GetWorkerCount() + 1) * 4);
+    if (blockCount <= 1)
+    {
+        T running = identity;
+        for (; first != last; ++first, ++out)
+            *out = running = op(std::move(running), *first);
+        return;
+    }
+
+    auto blockBegin = [&](size_t block) { return count * block / blockCount; };
+    std::vector<T> offsets(blockCount, identity);
+    // the last block sum is never used
+    ParallelFor(pool, size_t(0), blockCount - 1, [&](size_t block) {
+        T            sum = identity;
+        const size_t blockEnd = blockBegin(block + 1);
+        for (size_t i = blockBegin(block); i < blockEnd; i++)
+            sum = op(std::move(sum), first[i]);
+        offsets[block + 1] = std::move(sum);
+    });
+    // the offsets are read again by the second pass, accumulate apart so none is left moved from
+    T running = identity;
+    for (size_t block = 1; block < blockCount; block++)
+    {
+        running = op(std::move(running), offsets[block]);
+        offsets[block] = running;
+    }
+
+    ParallelFor(pool, size_t(0), blockCount, [&](size_t block) {
+        T            running = offsets[block];
+        const size_t blockEnd = blockBegin(block + 1);
+        for (size_t i = blockBegin(block); i < blockEnd; i++)
+            out[i] = running = op(std::move(running), first[i]);
+    });
+}
+
+/**
+ * \brief Sort [first, last) on the pool by a parallel quicksort, not stable
+ */
+template <typename RandomIt, typename Compare>
+void ParallelSort(ThreadPool &pool, RandomIt first, RandomIt last, Compare comp)
+{
+    using Task = Detail::SortTask<RandomIt, Compare>;
+    std::atomic<uint32> pending{0};
+    Task::Sort(pool, comp, pending, first, last);
+    Detail::HelpUntilZero(pool, pending);
+}
+
+/**
+ * \brief Sort integer keys on the pool by a parallel LSD radix sort, 8 bits per pass
+ *
+ * Every pass count the digits of the blocks in parallel, then scatter the
+ * blocks in parallel to their offsets. A pass where all the keys share the
+ * digit is skipped. Use a temporary buffer of count keys.
+ */
+template <typename T>
+void ParallelRadixSort(ThreadPool &pool, T *data, size_t count)
+{
+    static_assert(std::is_integral_v<T> && !std::is_same_v<T, bool>, "ParallelRadixSort key must be integral");
+    using Key = std::make_unsigned_t<T>;
+    constexpr uint32 DigitBits = 8;
+    constexpr uint32 DigitCount = 1 << DigitBits;
+    constexpr size_t MinBlockSize = 16384;
+    // flip the sign bit so the negative keys come first
+    constexpr Key SignFlip = std::is_signed_v<T> ? Key(Key(1) << (sizeof(T) * 8 - 1)) : Key(0);
+
+    const size_t blockCount =
+        std::min<size_t>(count / MinBlockSize, static_cast<size_t>(pool.GetWorkerCount() + 1) * 4);
+    if (blockCount <= 1)
+    {
+        std::sort(data, data + count);
+        return;
+    }
+
+    std::unique_ptr<T[]>   buffer(new T[count]);
+    std::vector<size_t>    offsets(blockCount * DigitCount);
+    T                     *source = data;
+    T                     *target = buffer.get();
+    auto blockBegin = [&](size_t block) { return count * block / blockCount; };
+
+    for (uint32 shift = 0; shift < sizeof(T) * 8; shift += DigitBits)
+    {
+        auto digit = [&](T value) { return ((static_cast<Key>(value) ^ SignFlip) >> shift) & (DigitCount - 1); };
+        ParallelFor(pool, size_t(0), blockCount, [&](size_t block) {
+            size_t      *histogram = &offsets[block * DigitCount];
+            const size_t blockEnd = blockBegin(block + 1);
+            std::fill(histogram, histogram + DigitCount, 0);
+            for (size_t i = blockBegin(block); i < blockEnd; i++)
+                histogram[digit(source[i])]++;
+        });
+
+        // offsets in digit major order, so every block write after the previous blocks of its digit
+        size_t running = 0;
+        bool   single = false;
+        for (uint32 d = 0; d < DigitCount && !single; d++)
+        {
+            const size_t digitStart = running;
+            for (size_t block = 0; block < blockCount; block++)
+            {
+                const size_t size = offsets[block * DigitCount + d];
+                offsets[block * DigitCount + d] = running;
+                running += size;
+            }
+            single = running - digitStart == count;
+        }
+        if (single)
+            continue;
+
+        ParallelFor(pool, size_t(0), blockCount, [&](size_t block) {
+            size_t      *offset = &offsets[block * DigitCount];
+            const size_t blockEnd = blockBegin(block + 1);
+            for (size_t i = blockBegin(block); i < blockEnd; i++)
+                target[offset[digit(source[i])]++] = source[i];
+        });
+        std::swap(source, target);
+    }
+
+    if (source != data)
+    {
+        ParallelFor(pool, size_t(0), count, [&](size_t first, size_t last) {
+            std::copy(source + first, source + last, data + first);
+        });
+    }
+}
+
+/**
+ * \brief Sort with the default order, integer keys but bool go to ParallelRadixSort
+ */
+template <typename RandomIt>
+void ParallelSort(ThreadPool &pool, RandomIt first, RandomIt last)
+{
+    using Value = typename std::iterator_traits<RandomIt>::value_type;
+    if constexpr (std::is_integral_v<Value> && !std::is_same_v<Value, bool> && std::contiguous_iterator<RandomIt>)
+        ParallelRadixSort(pool, std::to_address(first), static_cast<size_t>(last - first));
+    else
+        ParallelSort(pool, first, last, std::less<Value>());
+}
+} // namespace Hawl
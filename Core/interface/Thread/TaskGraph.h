@@ -0,0 +1,122 @@
+/**
+ *  Copyright 2020-2021 Zhang QiuLiang (juteman). All rights reserved.
+ *
+ *  This file is a part of Hawl
+ *  see(https://github.com/juteman/Hawl)
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#pragma once
+#include "BaseType.h"
+#include "Common.h"
+#include "Thread.h"
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace Hawl
+{
+/**
+ * \brief A graph of jobs run on a ThreadPool
+ *
+ * Nodes declare their predecessors once, every Launch reset the atomic
+ * dependency counters and add the root nodes to the pool. A node is added to
+ * the pool by the predecessor that drop its counter to zero, so the graph can
+ * be launched every frame without any allocation.
+ *
+ * The graph must not be changed or launched again before the last launch is
+ * done, and must outlive it.
+ */
+class TaskGraph
+{
+public:
+    using NodeHandle = uint32;
+
+    explicit TaskGraph(ThreadPool &pool) : m_pool{pool}
+    {
+    }
+
+    /**
+     * \brief Add a job to the graph
+     * \param work the job, run once per launch
+     * \param taskPriority priority of the job in the pool
+     * \return handle of the node
+     */
+    NodeHandle AddNode(std::function<void()> work, Priority taskPriority = Priority::Normal);
+
+    /**
+     * \brief Declare that before must be done before after start
+     */
+    void AddDependency(NodeHandle before, NodeHandle after);
+
+    /**
+     * \brief Run the graph on the pool, return without waiting
+     * \return false if the graph is still running or has a cycle
+     */
+    bool Launch();
+
+    /**
+     * \brief Help the pool until the node of the last launch is done
+     */
+    void Wait(NodeHandle node);
+
+    /**
+     * \brief Help the pool until every node of the last launch is done
+     */
+    void Wait();
+
+    /**
+     * \return true if the last launch is done
+     */
+    bool IsDone() const
+    {
+        return m_remaining.load(std::memory_order_acquire) == 0;
+    }
+
+    uint32 GetNodeCount() const
+    {
+        return static_cast<uint32>(m_nodes.size());
+    }
+
+private:
+    struct Node : Task
+    {
+        void run() override;
+
+        TaskGraph *graph = nullptr;
+        std::function<void()> work;
+        std::vector<NodeHandle> successors;
+        uint32 predecessorCount = 0;
+        /// predecessors not done yet in this launch
+        std::atomic<uint32> pending{0};
+        std::atomic<bool> done{true};
+    };
+
+    /// check the graph has no cycle, Kahn's algorithm
+    bool Validate();
+
+    template <typename Predicate>
+    void HelpUntil(Predicate &&predicate);
+
+    ThreadPool &m_pool;
+    std::vector<std::unique_ptr<Node>> m_nodes;
+    std::vector<NodeHandle> m_roots;
+    /// nodes not done yet in this launch
+    std::atomic<uint32> m_remaining{0};
+    bool m_validated = false;
+
+    HAWL_DISABLE_COPY(TaskGraph)
+};
+} // namespace Hawl
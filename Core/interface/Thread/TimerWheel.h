@@ -0,0 +1,205 @@
+/**
+ *  Copyright 2020-2021 Zhang QiuLiang (juteman). All rights reserved.
+ *
+ *  This file is a part of Hawl
+ *  see(https://github.com/juteman/Hawl)
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#pragma once
+#include "BaseType.h"
+#include "Common.h"
+#include "Thread.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Hawl
+{
+/**
+ * \brief Hierarchical timing wheel firing delayed and periodic tasks on a ThreadPool
+ *
+ * Four wheels of 256 slots cover 2^32 ticks, a timer is linked in the slot of
+ * the highest tick digit where its expiry differ from the current tick, and
+ * moves down one wheel every time the lower wheel wrap, so insert and cancel
+ * are O(1) and a tick only touch the timers it expires. Farther timers wait in
+ * an overflow list checked when the top wheel wrap.
+ *
+ * A thread of the wheel sleeps until the next occupied slot and adds the due
+ * timers to the pool, they run there as Tasks. A periodic timer is added again
+ * after its callback returned, at the next multiple of its period, so one timer
+ * never run concurrently with itself and missed periods are skipped.
+ */
+class TimerWheel
+{
+private:
+    struct Timer;
+
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /// identify a timer, a handle of a timer already done is simply ignored
+    struct Handle
+    {
+        Timer *timer = nullptr;
+        uint64 id = 0;
+    };
+
+    /**
+     * \param pool run the callbacks
+     * \param tickDuration resolution of the timers, a timer never fire before its time
+     * and usually less than one tick after
+     */
+    explicit TimerWheel(ThreadPool &pool, std::chrono::nanoseconds tickDuration = std::chrono::milliseconds(1));
+
+    /// drop the pending timers and wait for the firing ones to finish
+    ~TimerWheel();
+
+    /**
+     * \brief Run the callback once after the delay
+     * \param callback run on the pool, it must not throw
+     * \param taskPriority priority of the callback in the pool
+     */
+    Handle AddDelayed(std::chrono::nanoseconds delay, std::function<void()> callback,
+                      Priority taskPriority = Priority::Normal);
+
+    /**
+     * \brief Run the callback every period, the first time after one period
+     */
+    Handle AddPeriodic(std::chrono::nanoseconds period, std::function<void()> callback,
+                       Priority taskPriority = Priority::Normal);
+
+    /**
+     * \brief Cancel a timer, O(1). May be called from its own callback
+     * \return false if the timer is done, or is a delayed timer whose callback already started
+     */
+    bool Cancel(const Handle &handle);
+
+    /**
+     * \return timers waiting in the wheel
+     */
+    uint32 GetPendingCount() const
+    {
+        return m_pendingCount.load(std::memory_order_relaxed);
+    }
+
+private:
+    static constexpr uint32 SlotBits = 8;
+    static constexpr uint32 SlotCount = 1 << SlotBits;
+    static constexpr uint32 LevelCount = 4;
+    static constexpr uint64 SlotMask = SlotCount - 1;
+
+    enum class TimerState : uint8
+    {
+        /// linked in a slot of the wheel
+        Pending,
+        /// in the pool queues, the callback has not started
+        Queued,
+        /// the callback is running
+        Running,
+        /// cancelled while queued or running, freed by its task without calling back again
+        Cancelled,
+    };
+
+    /// intrusive circular list node, the slots hold a sentinel
+    struct Link
+    {
+        Link *previous = this;
+        Link *next = this;
+    };
+
+    /// the Link base chain the timer in its slot
+    struct Timer : Task, Link
+    {
+        void run() override;
+
+        TimerWheel           *wheel = nullptr;
+        std::function<void()> callback;
+        /// tick of the next expiry
+        uint64     expiry = 0;
+        /// ticks between two expiries, 0 for a delayed timer
+        uint64     period = 0;
+        /// unique over the life of the wheel, 0 while the timer is free
+        uint64     id = 0;
+        TimerState state = TimerState::Pending;
+        /// where the timer is linked, level LevelCount for the overflow list
+        uint8      level = 0;
+        uint8      slot = 0;
+    };
+
+    /// timers are allocated by chunk and never released before the wheel, so a stale handle is safe to check
+    static constexpr uint32 TimerChunkSize = 256;
+
+    static void PushBack(Link &list, Link *link);
+    static void Unlink(Link *link);
+
+    Handle Add(uint64 delay, uint64 period, std::function<void()> callback, Priority taskPriority);
+    uint64 ToTicks(std::chrono::nanoseconds duration) const;
+    uint64 CurrentTick() const;
+
+    /// lock held for all the functions below
+    Timer *Allocate();
+    void Free(Timer *timer);
+    /// link the timer in the slot of its expiry
+    void Insert(Timer *timer);
+    /// unlink a pending timer
+    void Remove(Timer *timer);
+    /// first occupied slot of the first level at or after slot, SlotCount if none
+    uint32 FindOccupied(uint32 slot) const;
+    /// expire every tick up to now
+    void Advance(uint64 now);
+    /// move the timers of a slot down to the lower levels
+    void Cascade(Link &list);
+    /// hand a due timer to the pool
+    void Fire(Timer *timer);
+    /// tick the thread must wake at, UINT64_MAX when nothing is pending
+    uint64 NextWakeTick() const;
+
+    void TimerThread();
+
+    ThreadPool                    &m_pool;
+    const std::chrono::nanoseconds m_tickDuration;
+    const Clock::time_point        m_start;
+
+    std::mutex              m_mutex;
+    std::condition_variable m_wakeup;
+    /// every tick below is expired
+    uint64 m_currentTick = 0;
+    /// tick the timer thread sleep until
+    uint64 m_sleepTick = 0;
+    uint64 m_nextId = 1;
+    bool   m_stopping = false;
+
+    Link   m_slots[LevelCount][SlotCount];
+    /// occupied slots of the first level
+    uint64 m_occupied[SlotCount / 64] = {};
+    /// timers beyond the last level
+    Link   m_overflow;
+
+    std::vector<std::unique_ptr<Timer[]>> m_chunks;
+    Link                                  m_freeTimers;
+
+    std::atomic<uint32> m_pendingCount{0};
+    /// timers handed to the pool and not back yet, the destructor wait for them
+    std::atomic<uint32> m_firingCount{0};
+    std::thread         m_thread;
+
+    HAWL_DISABLE_COPY(TimerWheel)
+};
+} // namespace Hawl
@@ -22,7 +22,7 @@
 */
 #include "BaseType.h"
 #include "IRenderer.h"
-#include "mimalloc.h"
+#include "Memory/MemoryHeap.h"
 #include "EAAssert/eaassert.h"
 #include "d3d12.h"
 #include "DX12Handle.h"
@@ -56,7 +56,8 @@ void Init(Renderer **ppRenderer, RendererDesc *pRendererDesc)
     EA_ASSERT(pRendererDesc);
 
     // Allocate renderer memory space
-    auto *pRenderer = static_cast<Renderer *>(mi_calloc_aligned(
+    auto *pRenderer = static_cast<Renderer *>(Hawl::MemoryHeap::Calloc(
+        Hawl::MemoryTag::Renderer,
         1,
         sizeof(Renderer),
         alignof(Renderer)));
@@ -4,7 +4,7 @@
 #include "DX12Helper.h"
 
 
-#include <mimalloc.h>
+#include "Memory/MemoryHeap.h"
 
 
 namespace Hawl
@@ -31,7 +31,7 @@ void AddDescriptorHeap(ID3D12Device *&                   pDevice,
 {
     uint32 numDescriptors = desc.NumDescriptors;
 
-    descHeap.pMutex = static_cast<tbb::mutex *>(mi_calloc(1, sizeof(tbb::mutex)));
+    descHeap.pMutex = static_cast<tbb::mutex *>(MemoryHeap::Calloc(MemoryTag::Renderer, 1, sizeof(tbb::mutex)));
     descHeap.pMutex->set_state(tbb::mutex::INITIALIZED);
     descHeap.pDevice = pDevice;
 
@@ -51,7 +51,8 @@ void AddDescriptorHeap(ID3D12Device *&                   pDevice,
     descHeap.mDescriptorSize = pDevice->GetDescriptorHandleIncrementSize(descHeap.mDesc.Type);
     if (descAfterRoundUp.Flags & D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE)
     {
-        descHeap.pHandles = static_cast<D3D12_CPU_DESCRIPTOR_HANDLE *>(mi_calloc(
+        descHeap.pHandles = static_cast<D3D12_CPU_DESCRIPTOR_HANDLE *>(MemoryHeap::Calloc(
+            MemoryTag::Renderer,
             descAfterRoundUp.NumDescriptors,
             sizeof(D3D12_CPU_DESCRIPTOR_HANDLE)));
     }
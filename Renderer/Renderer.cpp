@@ -1,6 +1,6 @@
 #include "GPUHelper.h"
 #include "DX12Helper.h"
-#include "mimalloc.h"
+#include "Memory/MemoryHeap.h"
 #include "nvapi.h"
 #include <combaseapi.h>
 
@@ -209,7 +209,7 @@ Renderer::Renderer(const RendererDesc &desc)
     pRenderer->mBuiltinShaderDefinesCount =
         sizeof(rendererShaderDefines) / sizeof(rendererShaderDefines[0]);
     pRenderer->pBuiltinShaderDefines =
-        (ShaderMacro *)mi_calloc(pRenderer->mBuiltinShaderDefinesCount, sizeof(ShaderMacro));
+        (ShaderMacro *)MemoryHeap::Calloc(MemoryTag::Renderer, pRenderer->mBuiltinShaderDefinesCount, sizeof(ShaderMacro));
     for (uint32_t i = 0; i < pRenderer->mBuiltinShaderDefinesCount; ++i)
     {
         pRenderer->pBuiltinShaderDefines[i] = rendererShaderDefines[i];
@@ -0,0 +1,96 @@
+// Replacement of every global operator new and delete counting the allocations
+// in gAllocCount, for the tests and benches checking a path does not allocate.
+// Include it in one translation unit of the program only, the operators are not
+// inline. They are kept out of line so the compiler never pairs the free below
+// with a new it sees, which -Wmismatched-new-delete reports.
+#pragma once
+#include "BaseType.h"
+#include "Common.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<uint64> gAllocCount{0};
+
+NOINLINE void *CountedAllocate(size_t size)
+{
+    gAllocCount.fetch_add(1, std::memory_order_relaxed);
+    if (void *pointer = std::malloc(size == 0 ? 1 : size))
+        return pointer;
+    throw std::bad_alloc();
+}
+
+NOINLINE void *CountedAllocate(size_t size, std::align_val_t alignment)
+{
+    gAllocCount.fetch_add(1, std::memory_order_relaxed);
+    // aligned_alloc want a size multiple of the alignment
+    const size_t align = static_cast<size_t>(alignment);
+    if (void *pointer = std::aligned_alloc(align, (size + align - 1) / align * align))
+        return pointer;
+    throw std::bad_alloc();
+}
+
+NOINLINE void CountedFree(void *pointer) noexcept
+{
+    std::free(pointer);
+}
+
+NOINLINE void *operator new(size_t size)
+{
+    return CountedAllocate(size);
+}
+
+NOINLINE void *operator new[](size_t size)
+{
+    return CountedAllocate(size);
+}
+
+NOINLINE void *operator new(size_t size, std::align_val_t alignment)
+{
+    return CountedAllocate(size, alignment);
+}
+
+NOINLINE void *operator new[](size_t size, std::align_val_t alignment)
+{
+    return CountedAllocate(size, alignment);
+}
+
+NOINLINE void operator delete(void *pointer) noexcept
+{
+    CountedFree(pointer);
+}
+
+NOINLINE void operator delete[](void *pointer) noexcept
+{
+    CountedFree(pointer);
+}
+
+NOINLINE void operator delete(void *pointer, size_t) noexcept
+{
+    CountedFree(pointer);
+}
+
+NOINLINE void operator delete[](void *pointer, size_t) noexcept
+{
+    CountedFree(pointer);
+}
+
+NOINLINE void operator delete(void *pointer, std::align_val_t) noexcept
+{
+    CountedFree(pointer);
+}
+
+NOINLINE void operator delete[](void *pointer, std::align_val_t) noexcept
+{
+    CountedFree(pointer);
+}
+
+NOINLINE void operator delete(void *pointer, size_t, std::align_val_t) noexcept
+{
+    CountedFree(pointer);
+}
+
+NOINLINE void operator delete[](void *pointer, size_t, std::align_val_t) noexcept
+{
+    CountedFree(pointer);
+}
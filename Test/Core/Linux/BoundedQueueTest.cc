@@ -0,0 +1,179 @@
+#include "Algorithm/LockfreeQueue.h"
+#include "Logger.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace Hawl;
+using namespace Hawl::Algorithm;
+
+constexpr uint64 ItemCount = 1000000;
+
+bool TestSPSC()
+{
+    BoundedQueue<uint64, QueueModel::SPSC> queue(1024);
+    uint64 sum = 0;
+    bool   ordered = true;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    std::thread consumer([&] {
+        uint64 expect = 0;
+        uint64 value;
+        while (expect < ItemCount)
+        {
+            if (!queue.DeQueue(value))
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            ordered &= value == expect;
+            sum += value;
+            ++expect;
+        }
+    });
+
+    for (uint64 i = 0; i < ItemCount; ++i)
+        while (!queue.EnQueue(i))
+            std::this_thread::yield();
+    consumer.join();
+    auto end = std::chrono::high_resolution_clock::now();
+
+    Logger::info("SPSC ring {} items, time cost {} ns",
+                 ItemCount,
+                 std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+    return ordered && sum == ItemCount * (ItemCount - 1) / 2 && queue.IsEmpty();
+}
+
+bool TestMPMC()
+{
+    const uint32 producerCount = 4;
+    const uint32 consumerCount = 4;
+    const uint64 perProducer = ItemCount / producerCount;
+
+    BoundedQueue<uint64, QueueModel::MPMC> queue(1024);
+    std::atomic<uint64> sum{0};
+    std::atomic<uint64> popped{0};
+    std::vector<std::thread> threads;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (uint32 p = 0; p < producerCount; ++p)
+        threads.emplace_back([&, p] {
+            for (uint64 i = p * perProducer; i < (p + 1) * perProducer; ++i)
+                while (!queue.EnQueue(i))
+                    std::this_thread::yield();
+        });
+    for (uint32 c = 0; c < consumerCount; ++c)
+        threads.emplace_back([&] {
+            uint64 value;
+            while (popped.load(std::memory_order_relaxed) < perProducer * producerCount)
+            {
+                if (!queue.DeQueue(value))
+                {
+                    std::this_thread::yield();
+                    continue;
+                }
+                sum.fetch_add(value, std::memory_order_relaxed);
+                popped.fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+    for (auto &thread : threads)
+        thread.join();
+    auto end = std::chrono::high_resolution_clock::now();
+
+    const uint64 total = perProducer * producerCount;
+    Logger::info("MPMC ring {} items, time cost {} ns",
+                 total,
+                 std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+    return sum == total * (total - 1) / 2 && queue.IsEmpty();
+}
+
+bool TestFull()
+{
+    BoundedQueue<uint64, QueueModel::MPMC> queue(4);
+    for (uint64 i = 0; i < queue.Capacity(); ++i)
+        if (!queue.EnQueue(i))
+            return false;
+    uint64 value;
+    return !queue.EnQueue(100) && queue.DeQueue(value) && value == 0 && queue.EnQueue(100);
+}
+
+template <QueueModel Model>
+bool TestBulk()
+{
+    const uint32 producerCount = Model == QueueModel::SPSC ? 1 : 4;
+    const uint32 consumerCount = producerCount;
+    const uint64 perProducer = ItemCount / producerCount;
+    const uint64 total = perProducer * producerCount;
+
+    BoundedQueue<uint64, Model> queue(1024);
+    std::atomic<uint64> sum{0};
+    std::atomic<uint64> popped{0};
+    std::atomic<bool>   ordered{true};
+    std::vector<std::thread> threads;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (uint32 p = 0; p < producerCount; ++p)
+        threads.emplace_back([&, p] {
+            uint64 burst[100];
+            for (uint64 i = p * perProducer; i < (p + 1) * perProducer;)
+            {
+                uint64 count = 0;
+                while (count < 100 && i + count < (p + 1) * perProducer)
+                {
+                    burst[count] = i + count;
+                    ++count;
+                }
+                size_t pushed = 0;
+                while (pushed < count)
+                {
+                    size_t n = queue.EnQueueBulk(std::span<const uint64>(burst + pushed, count - pushed));
+                    if (n == 0)
+                        std::this_thread::yield();
+                    pushed += n;
+                }
+                i += count;
+            }
+        });
+    for (uint32 c = 0; c < consumerCount; ++c)
+        threads.emplace_back([&] {
+            uint64 drain[64];
+            uint64 expect = 0;
+            while (popped.load(std::memory_order_relaxed) < total)
+            {
+                size_t n = queue.DeQueueBulk(drain);
+                if (n == 0)
+                {
+                    std::this_thread::yield();
+                    continue;
+                }
+                for (size_t i = 0; i < n; ++i)
+                {
+                    if (Model == QueueModel::SPSC && drain[i] != expect++)
+                        ordered = false;
+                    sum.fetch_add(drain[i], std::memory_order_relaxed);
+                }
+                popped.fetch_add(n, std::memory_order_relaxed);
+            }
+        });
+    for (auto &thread : threads)
+        thread.join();
+    auto end = std::chrono::high_resolution_clock::now();
+
+    Logger::info("{} ring bulk {} items, time cost {} ns",
+                 Model == QueueModel::SPSC ? "SPSC" : "MPMC",
+                 total,
+                 std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+    return ordered && sum == total * (total - 1) / 2 && queue.IsEmpty();
+}
+
+int main()
+{
+    if (!TestFull() || !TestSPSC() || !TestMPMC() || !TestBulk<QueueModel::SPSC>() || !TestBulk<QueueModel::MPMC>())
+    {
+        Logger::error("BoundedQueue test failed");
+        return 1;
+    }
+    Logger::info("BoundedQueue test passed");
+    return 0;
+}
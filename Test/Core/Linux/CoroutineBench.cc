@@ -0,0 +1,105 @@
+// Cost of a coroutine hop through co_await pool.Schedule() against a Task
+// adding itself again with AddTask, on one worker helped by the waiting thread
+// so only the suspend and resume overhead is measured. Also check the frames of
+// nested co_await come from the PoolAllocator once warm, without global allocation.
+#include "AllocationCounter.h"
+#include "Logger.h"
+#include "Thread/Coroutine.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace Hawl;
+using Clock = std::chrono::high_resolution_clock;
+
+constexpr uint32 HopCount = 2000000;
+
+/// callback baseline, the task add itself back to the pool count times
+struct HopTask : Task
+{
+    void run() override
+    {
+        if (--remaining != 0)
+            pool->AddTask(this);
+        else
+            done.store(true, std::memory_order_release);
+    }
+
+    ThreadPool       *pool = nullptr;
+    uint32            remaining = 0;
+    std::atomic<bool> done{false};
+};
+
+Coroutine::Task<void> Hop(ThreadPool &pool, uint32 count)
+{
+    for (uint32 i = 0; i < count; ++i)
+        co_await pool.Schedule();
+}
+
+Coroutine::Task<uint32> Leaf(uint32 value)
+{
+    co_return value + 1;
+}
+
+Coroutine::Task<uint32> Nested(uint32 depth)
+{
+    uint32 sum = 0;
+    for (uint32 i = 0; i < depth; ++i)
+        sum += co_await Leaf(i);
+    co_return sum;
+}
+
+Coroutine::Task<void> Noop(ThreadPool &pool)
+{
+    co_await pool.Schedule();
+}
+
+/// help the pool until done, the same way SyncWait does
+void Wait(ThreadPool &pool, std::atomic<bool> &done)
+{
+    while (!done.load(std::memory_order_acquire))
+    {
+        if (!pool.RunPendingTask())
+            CpuPause();
+    }
+}
+
+int main()
+{
+    ThreadPool pool;
+    pool.Create(1, Priority::Normal);
+
+    HopTask hopTask;
+    hopTask.pool = &pool;
+    hopTask.remaining = HopCount;
+    auto start = Clock::now();
+    pool.AddTask(&hopTask);
+    Wait(pool, hopTask.done);
+    const double taskTime = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+    start = Clock::now();
+    Coroutine::SyncWait(pool, Hop(pool, HopCount));
+    const double coroutineTime = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+    // warm the frame pool then count the allocations of a nested chain
+    Coroutine::SyncWait(pool, Nested(1000));
+    const uint64 before = gAllocCount.load();
+    const uint32 sum = Coroutine::SyncWait(pool, Nested(100000));
+    const uint64 nestedAllocations = gAllocCount.load() - before;
+
+    std::vector<Coroutine::Task<void>> tasks;
+    tasks.reserve(10000);
+    for (uint32 i = 0; i < 10000; ++i)
+        tasks.push_back(Noop(pool));
+    start = Clock::now();
+    Coroutine::SyncWait(pool, Coroutine::WhenAll(std::move(tasks)));
+    const double whenAllTime = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    pool.Destroy();
+
+    Logger::info("AddTask hop {:.1f} ns, co_await Schedule hop {:.1f} ns", taskTime / HopCount,
+                 coroutineTime / HopCount);
+    Logger::info("100000 nested co_await (sum {}): {} global allocations", sum, nestedAllocations);
+    Logger::info("WhenAll over 10000 scheduled tasks: {:.1f} ns per task", whenAllTime / 10000);
+    return nestedAllocations == 0 ? 0 : 1;
+}
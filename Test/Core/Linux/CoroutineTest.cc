@@ -0,0 +1,128 @@
+// Coroutine tasks on the ThreadPool: chains of co_await hopping between the
+// workers, exception propagation, WhenAll fan out and WhenAny first result.
+#include "Logger.h"
+#include "Thread/Coroutine.h"
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace Hawl;
+
+Coroutine::Task<uint64> Fib(ThreadPool &pool, uint32 n)
+{
+    if (n < 2)
+        co_return n;
+    co_await pool.Schedule();
+    std::vector<Coroutine::Task<uint64>> children;
+    children.push_back(Fib(pool, n - 1));
+    children.push_back(Fib(pool, n - 2));
+    std::vector<uint64> results = co_await Coroutine::WhenAll(std::move(children));
+    co_return results[0] + results[1];
+}
+
+Coroutine::Task<uint32> Chain(ThreadPool &pool, uint32 depth)
+{
+    co_await pool.Schedule();
+    if (depth == 0)
+        co_return 0;
+    co_return co_await Chain(pool, depth - 1) + 1;
+}
+
+Coroutine::Task<void> Throw(ThreadPool &pool)
+{
+    co_await pool.Schedule();
+    throw std::runtime_error("expected");
+}
+
+Coroutine::Task<bool> CatchChild(ThreadPool &pool)
+{
+    try
+    {
+        co_await Throw(pool);
+    }
+    catch (const std::runtime_error &)
+    {
+        co_return true;
+    }
+    co_return false;
+}
+
+Coroutine::Task<uint32> Delayed(ThreadPool &pool, uint32 value, std::atomic<bool> *release,
+                                std::atomic<uint32> &finished)
+{
+    co_await pool.Schedule(Priority::Lowest);
+    while (release != nullptr && !release->load(std::memory_order_acquire))
+    {
+        // yield to the pool until released, keep the worker useful
+        co_await pool.Schedule(Priority::Lowest);
+    }
+    finished.fetch_add(1, std::memory_order_release);
+    co_return value;
+}
+
+Coroutine::Task<void> Count(ThreadPool &pool, std::atomic<uint32> &counter)
+{
+    co_await pool.Schedule();
+    counter.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool TestChain(ThreadPool &pool)
+{
+    return Coroutine::SyncWait(pool, Chain(pool, 10000)) == 10000;
+}
+
+bool TestException(ThreadPool &pool)
+{
+    return Coroutine::SyncWait(pool, CatchChild(pool));
+}
+
+bool TestWhenAll(ThreadPool &pool)
+{
+    if (Coroutine::SyncWait(pool, Fib(pool, 18)) != 2584)
+        return false;
+
+    std::atomic<uint32> counter{0};
+    std::vector<Coroutine::Task<void>> tasks;
+    for (uint32 i = 0; i < 1000; ++i)
+        tasks.push_back(Count(pool, counter));
+    Coroutine::SyncWait(pool, Coroutine::WhenAll(std::move(tasks)));
+    return counter.load() == 1000;
+}
+
+bool TestWhenAny(ThreadPool &pool)
+{
+    std::atomic<bool>   release{false};
+    std::atomic<uint32> finished{0};
+    std::vector<Coroutine::Task<uint32>> tasks;
+    tasks.push_back(Delayed(pool, 1, &release, finished));
+    tasks.push_back(Delayed(pool, 2, nullptr, finished));
+    tasks.push_back(Delayed(pool, 3, &release, finished));
+    auto [index, value] = Coroutine::SyncWait(pool, Coroutine::WhenAny(std::move(tasks)));
+
+    // the losers still run to the end and free their frames
+    release.store(true, std::memory_order_release);
+    while (finished.load(std::memory_order_acquire) != 3)
+    {
+        if (!pool.RunPendingTask())
+            CpuPause();
+    }
+    return index == 1 && value == 2;
+}
+
+int main()
+{
+    const uint32 threads = std::max(2u, std::thread::hardware_concurrency());
+    ThreadPool pool;
+    pool.Create(threads, Priority::Normal);
+
+    const bool passed = TestChain(pool) && TestException(pool) && TestWhenAll(pool) && TestWhenAny(pool);
+    pool.Destroy();
+    if (!passed)
+    {
+        Logger::error("Coroutine test failed");
+        return 1;
+    }
+    Logger::info("Coroutine test passed");
+    return 0;
+}
@@ -0,0 +1,104 @@
+// CpuTopology discovery and the worker placement policies: every policy only
+// pick allowed processors, Scatter use all the cores before any SMT sibling,
+// reserving the first core keep it free, and pinned workers run where placed.
+#include "Logger.h"
+#include "Thread.h"
+#include <algorithm>
+#include <atomic>
+#include <sched.h>
+#include <set>
+#include <vector>
+
+using namespace Hawl;
+
+/// record the processor the worker run on
+struct WhereTask : Task
+{
+    void run() override
+    {
+        cpu.store(sched_getcpu(), std::memory_order_relaxed);
+        done.store(true, std::memory_order_release);
+    }
+
+    std::atomic<int>  cpu{-1};
+    std::atomic<bool> done{false};
+};
+
+bool TestSelect(const CpuTopology &topology)
+{
+    const auto &cpus = topology.GetCpus();
+    const uint32 count = static_cast<uint32>(cpus.size()) * 2;
+    if (!topology.SelectCpus(count, AffinityPolicy::None, false).empty())
+        return false;
+
+    for (AffinityPolicy policy : {AffinityPolicy::Compact, AffinityPolicy::Scatter})
+    {
+        const std::vector<uint32> selected = topology.SelectCpus(count, policy, false);
+        if (selected.size() != count)
+            return false;
+        // every processor is used once before any is reused
+        std::set<uint32> first(selected.begin(), selected.begin() + cpus.size());
+        if (first.size() != cpus.size())
+            return false;
+    }
+
+    // scatter take one processor per core first
+    const std::vector<uint32> scatter = topology.SelectCpus(topology.GetCoreCount(), AffinityPolicy::Scatter, false);
+    std::set<uint32> cores;
+    for (uint32 index : scatter)
+        cores.insert(cpus[index].core);
+    if (cores.size() != topology.GetCoreCount())
+        return false;
+
+    if (topology.GetCoreCount() > 1)
+    {
+        for (uint32 index : topology.SelectCpus(count, AffinityPolicy::Compact, true))
+        {
+            if (cpus[index].core == cpus[0].core)
+                return false;
+        }
+    }
+    return true;
+}
+
+bool TestPinnedPool(const CpuTopology &topology)
+{
+    const uint32 threads = topology.GetCoreCount();
+    const std::vector<uint32> selected = topology.SelectCpus(threads, AffinityPolicy::Scatter, false);
+    std::set<int> allowed;
+    for (uint32 index : selected)
+        allowed.insert(static_cast<int>(topology.GetCpus()[index].id));
+
+    ThreadPool pool;
+    pool.SetAffinity(AffinityPolicy::Scatter);
+    pool.Create(threads, Priority::Normal);
+    std::vector<WhereTask> tasks(64);
+    for (auto &task : tasks)
+    {
+        task.taskPriority = Priority::High;
+        pool.AddTask(&task);
+    }
+    for (auto &task : tasks)
+    {
+        while (!task.done.load(std::memory_order_acquire))
+            CpuPause();
+    }
+    pool.Destroy();
+
+    return std::all_of(tasks.begin(), tasks.end(), [&](const WhereTask &task) {
+        return allowed.count(task.cpu.load()) != 0;
+    });
+}
+
+int main()
+{
+    const CpuTopology &topology = CpuTopology::Get();
+    topology.Log();
+    if (topology.GetCpus().empty() || !TestSelect(topology) || !TestPinnedPool(topology))
+    {
+        Logger::error("CpuTopology test failed");
+        return 1;
+    }
+    Logger::info("CpuTopology test passed");
+    return 0;
+}
@@ -0,0 +1,131 @@
+#include "Algorithm/LockfreeQueue.h"
+#include "Logger.h"
+#include "Thread.h"
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <ctime>
+#include <pthread.h>
+#include <thread>
+
+using namespace Hawl;
+using namespace Hawl::Algorithm;
+using Clock = std::chrono::steady_clock;
+
+static int64 ThreadCpuNanoseconds()
+{
+    timespec time;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+    return int64(time.tv_sec) * 1000000000 + time.tv_nsec;
+}
+
+/// an empty queue must time out without burning the core
+bool TestTimeout()
+{
+    BoundedQueue<uint32, QueueModel::MPMC> queue(16);
+    uint32 value;
+
+    const int64 cpuStart = ThreadCpuNanoseconds();
+    const auto  start = Clock::now();
+    const bool  result = queue.WaitDeQueue(value, std::chrono::milliseconds(100));
+    const auto  wall = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count();
+    const int64 cpu = (ThreadCpuNanoseconds() - cpuStart) / 1000000;
+
+    Logger::info("WaitDeQueue timeout after {} ms wall, {} ms cpu", wall, cpu);
+    return !result && wall >= 100 && cpu < 10;
+}
+
+/// signals interrupt the futex, the wait must still end at its deadline
+bool TestInterruptedTimeout()
+{
+    struct sigaction action = {};
+    action.sa_handler = [](int) {};
+    sigaction(SIGUSR1, &action, nullptr);
+
+    EventCount        event;
+    std::atomic<bool> waiting{true};
+    int64             wall = 0;
+    bool              result = true;
+    std::thread       waiter([&] {
+        const auto start = Clock::now();
+        result = event.CommitWait(event.PrepareWait(), std::chrono::milliseconds(100));
+        wall = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count();
+        waiting.store(false);
+    });
+
+    // keep interrupting well past the timeout, a wait restarted in full would outlast them
+    const auto start = Clock::now();
+    while (waiting.load() && Clock::now() - start < std::chrono::milliseconds(500))
+    {
+        pthread_kill(waiter.native_handle(), SIGUSR1);
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    waiter.join();
+
+    Logger::info("CommitWait interrupted timeout after {} ms wall", wall);
+    return !result && wall >= 100 && wall < 400;
+}
+
+/// a parked consumer must be woken by EnQueue
+bool TestWake()
+{
+    LockFreeQueue<uint32> queue;
+    std::atomic<uint32>   received{0};
+    const uint32          count = 10000;
+
+    std::thread consumer([&] {
+        uint32 value;
+        for (uint32 i = 0; i < count; ++i)
+            if (queue.WaitDeQueue(value))
+                received.fetch_add(1, std::memory_order_relaxed);
+    });
+
+    for (uint32 i = 0; i < count; ++i)
+    {
+        queue.EnQueue(i);
+        // let the consumer park now and then
+        if (i % 1000 == 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    consumer.join();
+    return received == count;
+}
+
+struct CountTask : Task
+{
+    std::atomic<uint32> *counter = nullptr;
+
+    void run() override
+    {
+        counter->fetch_add(1, std::memory_order_relaxed);
+    }
+};
+
+/// idle workers park, every task added is executed before Destroy return
+bool TestThreadPoolRunner()
+{
+    ThreadPool pool;
+    pool.Create(4, Priority::Normal);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    std::atomic<uint32> counter{0};
+    CountTask           tasks[1000];
+    for (auto &task : tasks)
+    {
+        task.counter = &counter;
+        pool.AddTask(&task);
+    }
+    pool.Destroy();
+    return counter == ArraySize(tasks);
+}
+
+int main()
+{
+    if (!TestTimeout() || !TestInterruptedTimeout() || !TestWake() || !TestThreadPoolRunner())
+    {
+        Logger::error("EventCount test failed");
+        return 1;
+    }
+    Logger::info("EventCount test passed");
+    return 0;
+}
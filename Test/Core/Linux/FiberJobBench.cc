@@ -0,0 +1,195 @@
+// Cost of a fiber switch (a yield is a switch out, a pass through the pool and
+// a switch in) and throughput of recursive fiber jobs waiting on counters,
+// against the plain ThreadPool helping with RunPendingTask while it waits.
+#include "Logger.h"
+#include "Thread.h"
+#include "Thread/FiberJobSystem.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+using namespace Hawl;
+using Clock = std::chrono::high_resolution_clock;
+
+constexpr uint32 YieldCount = 200000;
+constexpr uint32 SpawnCount = 200000;
+constexpr uint32 FibN = 34;
+constexpr uint32 FibCutoff = 16;
+
+static uint64 SerialFib(uint32 n)
+{
+    return n < 2 ? n : SerialFib(n - 1) + SerialFib(n - 2);
+}
+
+/// wait without helping, so only the workers run the jobs
+static void SleepUntilZero(FiberCounter &counter)
+{
+    while (counter.Get() != 0)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+struct YieldJob : Task
+{
+    void run() override
+    {
+        for (uint32 i = 0; i < YieldCount; ++i)
+            system->YieldJob();
+    }
+
+    FiberJobSystem *system = nullptr;
+};
+
+struct EmptyJob : Task
+{
+    void run() override
+    {
+    }
+};
+
+/// start an empty sub job and wait for it, one after the other
+struct SpawnJob : Task
+{
+    void run() override
+    {
+        EmptyJob child;
+        for (uint32 i = 0; i < SpawnCount; ++i)
+        {
+            FiberCounter counter;
+            system->RunJob(&child, &counter);
+            system->WaitForCounter(counter);
+        }
+    }
+
+    FiberJobSystem *system = nullptr;
+};
+
+struct FiberFibJob : Task
+{
+    void run() override
+    {
+        if (n < FibCutoff)
+        {
+            result = SerialFib(n);
+            return;
+        }
+        FiberFibJob  left, right;
+        FiberCounter counter;
+        left.system = right.system = system;
+        left.n = n - 1;
+        right.n = n - 2;
+        system->RunJob(&left, &counter);
+        system->RunJob(&right, &counter);
+        system->WaitForCounter(counter);
+        result = left.result + right.result;
+    }
+
+    FiberJobSystem *system = nullptr;
+    uint32          n = 0;
+    uint64          result = 0;
+};
+
+struct PoolFibTask : Task
+{
+    void run() override
+    {
+        if (n < FibCutoff)
+            result = SerialFib(n);
+        else
+        {
+            std::atomic<uint32> pending{2};
+            PoolFibTask         left, right;
+            left.pool = right.pool = pool;
+            left.done = right.done = &pending;
+            left.n = n - 1;
+            right.n = n - 2;
+            pool->AddTask(&left);
+            pool->AddTask(&right);
+            while (pending.load(std::memory_order_acquire) != 0)
+            {
+                if (!pool->RunPendingTask())
+                    CpuPause();
+            }
+            result = left.result + right.result;
+        }
+        done->fetch_sub(1, std::memory_order_release);
+    }
+
+    ThreadPool          *pool = nullptr;
+    std::atomic<uint32> *done = nullptr;
+    uint32               n = 0;
+    uint64               result = 0;
+};
+
+int main()
+{
+    {
+        ThreadPool pool;
+        pool.Create(1, Priority::Normal);
+        FiberJobSystem system(pool);
+
+        YieldJob     yieldJob;
+        FiberCounter counter;
+        yieldJob.system = &system;
+        auto start = Clock::now();
+        system.RunJob(&yieldJob, &counter);
+        SleepUntilZero(counter);
+        const double yieldTime = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+        SpawnJob spawnJob;
+        spawnJob.system = &system;
+        start = Clock::now();
+        system.RunJob(&spawnJob, &counter);
+        SleepUntilZero(counter);
+        const double spawnTime = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+        pool.Destroy();
+
+        Logger::info("1 worker: yield round trip {:.0f} ns, run and wait an empty job {:.0f} ns",
+                     yieldTime / YieldCount,
+                     spawnTime / SpawnCount);
+    }
+
+    const uint32 threads = std::max(1u, std::thread::hardware_concurrency());
+    ThreadPool pool;
+    pool.Create(threads, Priority::Normal);
+    double fiberTime, poolTime;
+    uint64 fiberResult, poolResult;
+    {
+        FiberJobSystem system(pool);
+        FiberFibJob    root;
+        FiberCounter   counter;
+        root.system = &system;
+        root.n = FibN;
+        const auto start = Clock::now();
+        system.RunJob(&root, &counter);
+        system.WaitForCounter(counter);
+        fiberTime = std::chrono::duration<double>(Clock::now() - start).count();
+        fiberResult = root.result;
+    }
+    {
+        std::atomic<uint32> done{1};
+        PoolFibTask         root;
+        root.pool = &pool;
+        root.done = &done;
+        root.n = FibN;
+        const auto start = Clock::now();
+        pool.AddTask(&root);
+        while (done.load(std::memory_order_acquire) != 0)
+        {
+            if (!pool.RunPendingTask())
+                CpuPause();
+        }
+        poolTime = std::chrono::duration<double>(Clock::now() - start).count();
+        poolResult = root.result;
+    }
+    pool.Destroy();
+
+    Logger::info("{} workers: fib({}) fiber jobs {:.3f} s ({}), thread pool {:.3f} s ({})",
+                 threads,
+                 FibN,
+                 fiberTime,
+                 fiberResult,
+                 poolTime,
+                 poolResult);
+    return fiberResult == poolResult ? 0 : 1;
+}
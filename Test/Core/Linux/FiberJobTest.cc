@@ -0,0 +1,124 @@
+// FiberJobSystem: jobs wait on counters of sub jobs and are resumed on any
+// worker, with more jobs than fibers so some of them run on the worker stacks.
+#include "Logger.h"
+#include "Thread.h"
+#include "Thread/FiberJobSystem.h"
+#include <atomic>
+#include <thread>
+
+using namespace Hawl;
+
+constexpr uint32 FanOut = 4;
+constexpr uint32 RootCount = 2000;
+
+struct LeafJob : Task
+{
+    void run() override
+    {
+        executed->fetch_add(1, std::memory_order_relaxed);
+    }
+
+    std::atomic<uint32> *executed = nullptr;
+};
+
+/// start FanOut leaves, wait for them on its fiber, check they are all done
+struct ParentJob : Task
+{
+    void run() override
+    {
+        LeafJob      leaves[FanOut];
+        FiberCounter counter;
+        for (auto &leaf : leaves)
+        {
+            leaf.executed = executed;
+            system->RunJob(&leaf, &counter);
+        }
+        system->WaitForCounter(counter);
+        if (counter.Get() != 0)
+            failed->store(true);
+        // come back to the pool a few times on the way
+        system->YieldJob();
+        executed->fetch_add(1, std::memory_order_relaxed);
+    }
+
+    FiberJobSystem      *system = nullptr;
+    std::atomic<uint32> *executed = nullptr;
+    std::atomic<bool>   *failed = nullptr;
+};
+
+uint64 FiberFib(FiberJobSystem &system, uint32 n);
+
+struct FibJob : Task
+{
+    void run() override
+    {
+        result = FiberFib(*system, n);
+    }
+
+    FiberJobSystem *system = nullptr;
+    uint32          n = 0;
+    uint64          result = 0;
+};
+
+/// recursive jobs, every level park its fiber while the children run
+uint64 FiberFib(FiberJobSystem &system, uint32 n)
+{
+    if (n < 2)
+        return n;
+    FibJob       left, right;
+    FiberCounter counter;
+    left.system = right.system = &system;
+    left.n = n - 1;
+    right.n = n - 2;
+    system.RunJob(&left, &counter);
+    system.RunJob(&right, &counter);
+    system.WaitForCounter(counter);
+    return left.result + right.result;
+}
+
+bool TestFanOut(ThreadPool &pool)
+{
+    FiberJobSystem      system(pool, 64);
+    std::atomic<uint32> executed{0};
+    std::atomic<bool>   failed{false};
+    static ParentJob    parents[RootCount];
+    FiberCounter        counter;
+    for (auto &parent : parents)
+    {
+        parent.system = &system;
+        parent.executed = &executed;
+        parent.failed = &failed;
+        system.RunJob(&parent, &counter);
+    }
+    system.WaitForCounter(counter);
+    Logger::info("{} jobs executed", executed.load());
+    return !failed && executed == RootCount * (FanOut + 1) && !FiberJobSystem::IsInFiber();
+}
+
+bool TestRecursive(ThreadPool &pool)
+{
+    FiberJobSystem system(pool, 256);
+    FibJob         root;
+    FiberCounter   counter;
+    root.system = &system;
+    root.n = 16;
+    system.RunJob(&root, &counter);
+    system.WaitForCounter(counter);
+    Logger::info("fiber fib({}) = {}", root.n, root.result);
+    return root.result == 987;
+}
+
+int main()
+{
+    ThreadPool pool;
+    pool.Create(std::max(2u, std::thread::hardware_concurrency()), Priority::Normal);
+    const bool passed = TestFanOut(pool) && TestRecursive(pool);
+    pool.Destroy();
+    if (!passed)
+    {
+        Logger::error("FiberJob test failed");
+        return 1;
+    }
+    Logger::info("FiberJob test passed");
+    return 0;
+}
@@ -0,0 +1,63 @@
+// Transient per frame allocations, FrameAllocator against new and delete:
+// every worker allocates small blocks of mixed sizes through a frame, with
+// new they are all deleted at the end of the frame, with the FrameAllocator
+// the next BeginFrame drops them at once.
+#include "Logger.h"
+#include "Memory/FrameAllocator.h"
+#include "Thread.h"
+#include "Thread/Parallel.h"
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace Hawl;
+using Clock = std::chrono::high_resolution_clock;
+
+constexpr uint32 FrameCount = 100;
+constexpr uint32 AllocationsPerFrame = 100000;
+
+static size_t AllocationSize(uint32 i)
+{
+    return 16 + (i * 2654435761u >> 24) % 240;
+}
+
+int main()
+{
+    const uint32    threads = std::max(1u, std::thread::hardware_concurrency());
+    ThreadPool pool;
+    pool.Create(threads, Priority::Normal);
+    std::vector<void *> blocks(AllocationsPerFrame);
+
+    FrameAllocator allocator(64 * 1024 * 1024);
+    auto           start = Clock::now();
+    for (uint32 frame = 0; frame < FrameCount; ++frame)
+    {
+        allocator.BeginFrame();
+        ParallelFor(pool, uint32(0), AllocationsPerFrame, [&](uint32 i) {
+            blocks[i] = allocator.Allocate(AllocationSize(i));
+            *static_cast<uint32 *>(blocks[i]) = i;
+        });
+    }
+    const double frameTime = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / FrameCount;
+
+    start = Clock::now();
+    for (uint32 frame = 0; frame < FrameCount; ++frame)
+    {
+        ParallelFor(pool, uint32(0), AllocationsPerFrame, [&](uint32 i) {
+            blocks[i] = ::operator new(AllocationSize(i));
+            *static_cast<uint32 *>(blocks[i]) = i;
+        });
+        ParallelFor(pool, uint32(0), AllocationsPerFrame, [&](uint32 i) { ::operator delete(blocks[i]); });
+    }
+    const double newTime = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / FrameCount;
+    pool.Destroy();
+
+    Logger::info("{} workers, {} allocations of 16 to 256 bytes per frame: FrameAllocator {:.3f} ms, new and "
+                 "delete {:.3f} ms",
+                 threads,
+                 AllocationsPerFrame,
+                 frameTime,
+                 newTime);
+    return 0;
+}
@@ -0,0 +1,117 @@
+// FrameAllocator: allocations are aligned and disjoint, also from the workers
+// of a pool at once, big allocations bypass the thread blocks, a full frame
+// return nullptr, and every frame is reset and reused after frameCount frames.
+// Every frame starts on a huge page boundary.
+// The EASTL adapter honors the alignment and offset of aligned allocate.
+#include "Logger.h"
+#include "Memory/FrameAllocator.h"
+#include "Memory/VirtualMemory.h"
+#include "Thread.h"
+#include "Thread/Parallel.h"
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+using namespace Hawl;
+
+constexpr size_t FrameCapacity = 4 * 1024 * 1024;
+constexpr uint32 AllocationCount = 20000;
+
+struct Record
+{
+    uint32 frame;
+    uint32 index;
+};
+
+static bool IsAligned(const void *address, size_t alignment)
+{
+    return reinterpret_cast<uintptr_t>(address) % alignment == 0;
+}
+
+int main()
+{
+    bool           passed = true;
+    FrameAllocator allocator(FrameCapacity);
+    passed = passed && allocator.GetFrameCount() == FrameAllocator::DefaultFrameCount &&
+             allocator.GetFrameCapacity() >= FrameCapacity;
+
+    // alignment and no overlap, every allocation is filled and checked after
+    std::vector<std::pair<unsigned char *, size_t>> blocks;
+    for (uint32 i = 0; i < 1000; ++i)
+    {
+        const size_t size = 1 + i % 200;
+        const size_t alignment = size_t(1) << (i % 8);
+        auto        *memory = static_cast<unsigned char *>(allocator.Allocate(size, alignment));
+        passed = passed && memory != nullptr && IsAligned(memory, alignment);
+        std::memset(memory, static_cast<int>(i & 0xff), size);
+        blocks.emplace_back(memory, size);
+    }
+    for (uint32 i = 0; i < blocks.size(); ++i)
+    {
+        for (size_t j = 0; j < blocks[i].second; ++j)
+            passed = passed && blocks[i].first[j] == (i & 0xff);
+    }
+
+    // big allocation, then the thread block is still used
+    void *big = allocator.Allocate(FrameAllocator::ThreadBlockSize * 2, 4096);
+    void *small = allocator.Allocate(16);
+    passed = passed && big != nullptr && IsAligned(big, 4096) &&
+             static_cast<unsigned char *>(small) > blocks.back().first &&
+             static_cast<unsigned char *>(small) < blocks.back().first + 256;
+
+    // every worker allocate at once, records are tagged and checked after all are done
+    {
+        ThreadPool pool;
+        pool.Create(4, Priority::Normal);
+        allocator.BeginFrame();
+        std::vector<Record *> records(AllocationCount);
+        ParallelFor(pool, uint32(0), AllocationCount, [&](uint32 i) {
+            Record *record = allocator.New<Record>();
+            record->frame = allocator.GetFrameIndex();
+            record->index = i;
+            records[i] = record;
+        });
+        pool.Destroy();
+        for (uint32 i = 0; i < AllocationCount; ++i)
+            passed = passed && records[i] != nullptr && records[i]->index == i &&
+                     IsAligned(records[i], alignof(Record));
+        passed = passed && allocator.GetUsedSize() >= AllocationCount * sizeof(Record);
+    }
+
+    // a frame is reset when it comes back, and reuse its memory
+    const uint32 frame = allocator.BeginFrame();
+    void        *first = allocator.Allocate(64);
+    passed = passed && allocator.GetUsedSize() == FrameAllocator::ThreadBlockSize &&
+             IsAligned(first, VirtualMemory::HugePageSize);
+    for (uint32 i = 0; i < allocator.GetFrameCount(); ++i)
+    {
+        allocator.BeginFrame();
+        passed = passed && allocator.GetUsedSize() == 0;
+    }
+    passed = passed && allocator.GetFrameIndex() == frame && allocator.Allocate(64) == first;
+
+    // full frame
+    allocator.BeginFrame();
+    passed = passed && allocator.Allocate(allocator.GetFrameCapacity() + 1) == nullptr &&
+             allocator.Allocate(16) == nullptr && allocator.GetUsedSize() == allocator.GetFrameCapacity();
+    allocator.BeginFrame();
+    passed = passed && allocator.Allocate(16) != nullptr;
+
+    // EASTL adapter
+    FrameAllocator      otherAllocator(FrameCapacity, 1);
+    FrameEastlAllocator eastlAllocator(allocator);
+    void               *offsetBlock = eastlAllocator.allocate(100, 64, 16);
+    void               *alignedBlock = eastlAllocator.allocate(100, 64, 0);
+    passed = passed && IsAligned(static_cast<char *>(offsetBlock) + 16, 64) && IsAligned(alignedBlock, 64) &&
+             eastlAllocator == FrameEastlAllocator(allocator) && eastlAllocator != FrameEastlAllocator(otherAllocator);
+    eastlAllocator.deallocate(alignedBlock, 100);
+
+    if (!passed)
+    {
+        Logger::error("FrameAllocator test failed");
+        return 1;
+    }
+    Logger::info("FrameAllocator test passed");
+    return 0;
+}
@@ -0,0 +1,140 @@
+// Hawl Future against std::future on the patterns of asset streaming: a
+// promise fulfilled by another thread, one async call, and a chain of three
+// stages (decode, upload, ready) for many assets in flight. std::async chain a
+// stage by blocking a thread on the previous future, Then does not block.
+#include "Logger.h"
+#include "Thread.h"
+#include "Thread/Future.h"
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <thread>
+#include <vector>
+
+using namespace Hawl;
+using Clock = std::chrono::high_resolution_clock;
+
+constexpr uint32 RoundTripCount = 100000;
+constexpr uint32 AsyncCount = 20000;
+constexpr uint32 AssetCount = 2000;
+
+static double Microseconds(Clock::time_point start, uint32 count)
+{
+    return std::chrono::duration<double, std::micro>(Clock::now() - start).count() / count;
+}
+
+static uint32 Decode(uint32 asset)
+{
+    return asset * 3 + 1;
+}
+
+static uint32 Upload(uint32 decoded)
+{
+    return decoded ^ 0x5a5a;
+}
+
+/// set then get on the same thread, the cost of the shared state alone
+void BenchRoundTrip()
+{
+    uint64 sum = 0;
+    auto   start = Clock::now();
+    for (uint32 i = 0; i < RoundTripCount; ++i)
+    {
+        std::promise<uint32> promise;
+        std::future<uint32>  future = promise.get_future();
+        promise.set_value(i);
+        sum += future.get();
+    }
+    const double stdTime = Microseconds(start, RoundTripCount);
+
+    start = Clock::now();
+    for (uint32 i = 0; i < RoundTripCount; ++i)
+    {
+        Promise<uint32> promise;
+        Future<uint32>  future = promise.GetFuture();
+        promise.SetValue(i);
+        sum += future.Get();
+    }
+    const double hawlTime = Microseconds(start, RoundTripCount);
+    Logger::info("promise round trip: std {:.3f} us, Hawl {:.3f} us (checksum {})", stdTime, hawlTime, sum);
+}
+
+void BenchAsync(ThreadPool &pool)
+{
+    uint64 sum = 0;
+    auto   start = Clock::now();
+    {
+        std::vector<std::future<uint32>> futures;
+        futures.reserve(AsyncCount);
+        for (uint32 i = 0; i < AsyncCount; ++i)
+            futures.push_back(std::async(std::launch::async, [i] { return Decode(i); }));
+        for (auto &future : futures)
+            sum += future.get();
+    }
+    const double stdTime = Microseconds(start, AsyncCount);
+
+    start = Clock::now();
+    {
+        std::vector<Future<uint32>> futures;
+        futures.reserve(AsyncCount);
+        for (uint32 i = 0; i < AsyncCount; ++i)
+            futures.push_back(Async(pool, [i] { return Decode(i); }));
+        for (auto &future : futures)
+            sum += future.Get(pool);
+    }
+    const double hawlTime = Microseconds(start, AsyncCount);
+    Logger::info("async call: std::async {:.3f} us, Hawl Async {:.3f} us (checksum {})", stdTime, hawlTime, sum);
+}
+
+void BenchChain(ThreadPool &pool)
+{
+    uint64 sum = 0;
+    auto   start = Clock::now();
+    {
+        // every stage is a thread blocked on the previous one
+        std::vector<std::future<uint32>> ready;
+        ready.reserve(AssetCount);
+        for (uint32 i = 0; i < AssetCount; ++i)
+        {
+            std::future<uint32> decoded = std::async(std::launch::async, [i] { return Decode(i); });
+            std::future<uint32> uploaded = std::async(std::launch::async, [previous = std::move(decoded)]() mutable {
+                return Upload(previous.get());
+            });
+            ready.push_back(std::async(std::launch::async, [previous = std::move(uploaded)]() mutable {
+                return previous.get() + 1;
+            }));
+        }
+        for (auto &future : ready)
+            sum += future.get();
+    }
+    const double stdTime = Microseconds(start, AssetCount);
+
+    start = Clock::now();
+    {
+        std::vector<Future<uint32>> ready;
+        ready.reserve(AssetCount);
+        for (uint32 i = 0; i < AssetCount; ++i)
+            ready.push_back(Async(pool, [i] { return Decode(i); })
+                                .Then(pool, [](uint32 decoded) { return Upload(decoded); })
+                                .Then(pool, [](uint32 uploaded) { return uploaded + 1; }));
+        std::vector<uint32> values = WhenAll(std::span<Future<uint32>>(ready)).Get(pool);
+        for (uint32 value : values)
+            sum += value;
+    }
+    const double hawlTime = Microseconds(start, AssetCount);
+    Logger::info("3 stage chain per asset: std::async {:.3f} us, Hawl Then {:.3f} us (checksum {})",
+                 stdTime,
+                 hawlTime,
+                 sum);
+}
+
+int main()
+{
+    ThreadPool pool;
+    pool.Create(std::max(1u, std::thread::hardware_concurrency()), Priority::Normal);
+    BenchRoundTrip();
+    BenchAsync(pool);
+    BenchChain(pool);
+    pool.Destroy();
+    return 0;
+}
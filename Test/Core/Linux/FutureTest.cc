@@ -0,0 +1,164 @@
+// Future and Promise semantic: values cross threads, Then chains run on the
+// pool whether the source is ready or not, exceptions and broken promises
+// travel down the chain, and WhenAll keep the span order. A stress of short
+// chains checks the lock free handoff, build it with -fsanitize=thread or
+// address to check the races and the release of the shared states.
+#include "Logger.h"
+#include "Thread.h"
+#include "Thread/Future.h"
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace Hawl;
+
+constexpr uint32 WhenAllCount = 100;
+constexpr uint32 ChainCount = 20000;
+
+bool TestPromise()
+{
+    Promise<std::unique_ptr<int>> promise;
+    Future<std::unique_ptr<int>>  future = promise.GetFuture();
+    std::thread producer([&] { promise.SetValue(std::make_unique<int>(42)); });
+    std::unique_ptr<int> value = future.Get();
+    producer.join();
+
+    Promise<void> ready;
+    Future<void>  readyFuture = ready.GetFuture();
+    ready.SetValue();
+    readyFuture.Get();
+    return value && *value == 42 && !future.IsValid() && !readyFuture.IsValid();
+}
+
+bool TestThen(ThreadPool &pool)
+{
+    // decode, upload then notify, no thread blocked between the stages
+    std::atomic<bool> notified{false};
+    Future<size_t>    chain = Async(pool, [] { return std::string(1000, 'x'); })
+                               .Then(pool, [](std::string decoded) { return decoded.size() * 2; })
+                               .Then(pool, [&](size_t uploaded) {
+                                   notified.store(true, std::memory_order_relaxed);
+                                   return uploaded;
+                               });
+    if (chain.Get(pool) != 2000 || !notified.load())
+        return false;
+
+    // continuation on a ready source, and on a void source
+    Promise<int> promise;
+    Future<int>  source = promise.GetFuture();
+    promise.SetValue(7);
+    Future<void> done = source.Then(pool, [](int value) {
+        if (value != 7)
+            throw std::runtime_error("wrong value");
+    });
+    Future<int> afterVoid = std::move(done).Then(pool, [] { return 3; }, Priority::High);
+    return afterVoid.Get(pool) == 3;
+}
+
+bool TestExceptions(ThreadPool &pool)
+{
+    std::atomic<bool> skipped{true};
+    Future<int>       failed = Async(pool, []() -> int { throw std::runtime_error("decode failed"); })
+                             .Then(pool, [&](int value) {
+                                 skipped.store(false);
+                                 return value + 1;
+                             });
+    bool thrown = false;
+    try
+    {
+        failed.Get(pool);
+    }
+    catch (const std::runtime_error &error)
+    {
+        thrown = std::string(error.what()) == "decode failed";
+    }
+
+    Future<int> broken;
+    {
+        Promise<int> promise;
+        broken = promise.GetFuture();
+    }
+    bool brokenThrown = false;
+    try
+    {
+        broken.Get();
+    }
+    catch (const std::future_error &error)
+    {
+        brokenThrown = error.code() == std::future_errc::broken_promise;
+    }
+
+    // a promise without Future must release its state
+    Promise<int> orphan;
+    orphan.SetValue(1);
+    return thrown && skipped.load() && brokenThrown;
+}
+
+bool TestWhenAll(ThreadPool &pool)
+{
+    std::vector<Future<uint32>> futures;
+    for (uint32 i = 0; i < WhenAllCount; ++i)
+        futures.push_back(Async(pool, [i] { return i * i; }));
+    std::vector<uint32> values = WhenAll(std::span<Future<uint32>>(futures)).Get(pool);
+    if (values.size() != WhenAllCount)
+        return false;
+    for (uint32 i = 0; i < WhenAllCount; ++i)
+    {
+        if (values[i] != i * i || futures[i].IsValid())
+            return false;
+    }
+
+    std::atomic<uint32>       count{0};
+    std::vector<Future<void>> voids;
+    for (uint32 i = 0; i < WhenAllCount; ++i)
+        voids.push_back(Async(pool, [&] { count.fetch_add(1, std::memory_order_relaxed); }));
+    WhenAll(std::span<Future<void>>(voids)).Get(pool);
+
+    std::vector<Future<int>> none;
+    return count.load() == WhenAllCount && WhenAll(std::span<Future<int>>(none)).Get().empty();
+}
+
+bool TestStress(ThreadPool &pool)
+{
+    // the producers race the Then registrations
+    std::vector<Promise<uint32>> promises(ChainCount);
+    std::vector<Future<uint32>>  sources;
+    std::vector<Future<uint32>>  results;
+    sources.reserve(ChainCount);
+    results.reserve(ChainCount);
+    for (auto &promise : promises)
+        sources.push_back(promise.GetFuture());
+
+    std::thread producer([&] {
+        for (uint32 i = 0; i < ChainCount; ++i)
+            promises[i].SetValue(i);
+    });
+    for (auto &source : sources)
+        results.push_back(source.Then(pool, [](uint32 value) { return value + 1; }));
+    producer.join();
+
+    uint64 sum = 0;
+    for (auto &result : results)
+        sum += result.Get(pool);
+    return sum == uint64(ChainCount) * (ChainCount + 1) / 2;
+}
+
+int main()
+{
+    ThreadPool pool;
+    pool.Create(std::max(2u, std::thread::hardware_concurrency()), Priority::Normal);
+    const bool passed =
+        TestPromise() && TestThen(pool) && TestExceptions(pool) && TestWhenAll(pool) && TestStress(pool);
+    pool.Destroy();
+
+    if (!passed)
+    {
+        Logger::error("Future test failed");
+        return 1;
+    }
+    Logger::info("Future test passed");
+    return 0;
+}
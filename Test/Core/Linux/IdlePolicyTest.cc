@@ -0,0 +1,100 @@
+// ThreadPool idle policies: under every policy, tasks added in bursts, one by
+// one with gaps long enough to park the workers, and from the workers
+// themselves all run, so no policy loses a wakeup while it learns its spin.
+#include "Logger.h"
+#include "Thread.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+using namespace Hawl;
+using namespace std::chrono_literals;
+
+constexpr uint32 BurstCount = 20;
+constexpr uint32 BurstSize = 200;
+constexpr uint32 SparseCount = 200;
+
+/// wait for the counter with a deadline, a lost wakeup hang the pool
+static bool WaitDone(const std::atomic<uint32> &done, uint32 expected)
+{
+    const auto deadline = std::chrono::steady_clock::now() + 10s;
+    while (done.load(std::memory_order_acquire) != expected)
+    {
+        if (std::chrono::steady_clock::now() > deadline)
+            return false;
+        std::this_thread::yield();
+    }
+    return true;
+}
+
+static bool RunPolicy(const IdlePolicy &policy, const char *name)
+{
+    ThreadPool pool;
+    pool.SetIdlePolicy(policy);
+    pool.Create(2, Priority::Normal);
+
+    std::atomic<uint32> done{0};
+    uint32              expected = 0;
+    bool                passed = pool.GetIdlePolicy().maxSpin == policy.maxSpin;
+
+    for (uint32 burst = 0; burst < BurstCount && passed; ++burst)
+    {
+        for (uint32 i = 0; i < BurstSize; ++i)
+            pool.Submit([&] { done.fetch_add(1, std::memory_order_release); });
+        expected += BurstSize;
+        passed = WaitDone(done, expected);
+        std::this_thread::sleep_for(1ms);
+    }
+
+    // the gaps move the learned spin budget down to minSpin
+    for (uint32 i = 0; i < SparseCount && passed; ++i)
+    {
+        pool.Submit([&] { done.fetch_add(1, std::memory_order_release); });
+        passed = WaitDone(done, ++expected);
+        std::this_thread::sleep_for(200us);
+    }
+
+    // a chain of tasks each adding the next, from the workers
+    struct Chain
+    {
+        ThreadPool          *pool;
+        std::atomic<uint32> *done;
+        uint32               remaining;
+
+        void operator()() const
+        {
+            done->fetch_add(1, std::memory_order_release);
+            if (remaining > 0)
+                pool->Submit(Chain{pool, done, remaining - 1});
+        }
+    };
+    if (passed)
+    {
+        pool.Submit(Chain{&pool, &done, 999});
+        expected += 1000;
+        passed = WaitDone(done, expected);
+    }
+
+    pool.Destroy();
+    if (!passed)
+        Logger::error("IdlePolicy {}: {} of {} tasks done", name, done.load(), expected);
+    return passed;
+}
+
+int main()
+{
+    IdlePolicy neverSpin;
+    neverSpin.minSpin = neverSpin.maxSpin = std::chrono::nanoseconds(0);
+    neverSpin.yieldCount = 0;
+    neverSpin.adaptive = false;
+
+    const bool passed = RunPolicy(IdlePolicy(), "default") && RunPolicy(IdlePolicy::LowLatency(), "LowLatency") &&
+                        RunPolicy(IdlePolicy::PowerSaving(), "PowerSaving") && RunPolicy(neverSpin, "never spin");
+    if (!passed)
+    {
+        Logger::error("IdlePolicy test failed");
+        return 1;
+    }
+    Logger::info("IdlePolicy test passed");
+    return 0;
+}
@@ -0,0 +1,139 @@
+// ThreadPool::Submit with small and big captures: every job run once, the
+// captures are destroyed after the run, and once the pools are reserved and warm
+// a million jobs submitted in waves, from outside the pool and from the
+// workers, do zero global allocations. The submission rate is logged.
+#include "AllocationCounter.h"
+#include "Logger.h"
+#include "Thread.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+using namespace Hawl;
+using Clock = std::chrono::high_resolution_clock;
+
+constexpr uint32 JobCount = 1000000;
+/// jobs submitted before waiting for them, bound the peak of task slots in use
+constexpr uint32 WaveSize = 10000;
+/// preallocated above the waves for the blocks kept in the thread caches
+constexpr uint32 ReservedTaskCount = WaveSize * 4;
+constexpr uint32 WarmUpCount = 2;
+
+/// help the pool until the counter reach the expected value
+void WaitFor(ThreadPool &pool, std::atomic<uint32> &counter, uint32 expected)
+{
+    while (counter.load(std::memory_order_acquire) != expected)
+    {
+        if (!pool.RunPendingTask())
+            CpuPause();
+    }
+}
+
+/// tiny jobs from this thread, return the submission rate in jobs per second
+double SubmitTiny(ThreadPool &pool, std::atomic<uint32> &done)
+{
+    done.store(0);
+    const auto start = Clock::now();
+    for (uint32 i = 0; i < JobCount; i++)
+    {
+        pool.Submit([&done] { done.fetch_add(1, std::memory_order_release); });
+        if ((i + 1) % WaveSize == 0)
+            WaitFor(pool, done, i + 1);
+    }
+    return JobCount / std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+/// jobs submitting jobs, pushed to the deques of the workers
+void SubmitNested(ThreadPool &pool, std::atomic<uint32> &done)
+{
+    constexpr uint32 Fanout = 100;
+    done.store(0);
+    for (uint32 i = 0; i < JobCount / Fanout; i++)
+    {
+        pool.Submit([&pool, &done] {
+            for (uint32 n = 0; n < Fanout; n++)
+                pool.Submit([&done] { done.fetch_add(1, std::memory_order_release); });
+        });
+        if ((i + 1) % (WaveSize / Fanout) == 0)
+            WaitFor(pool, done, (i + 1) * Fanout);
+    }
+}
+
+/// callable too big for the task, spilled to the PoolAllocator
+struct BigJob
+{
+    void operator()() const
+    {
+        sum->fetch_add(values[0] + values[31], std::memory_order_relaxed);
+        done->fetch_add(1, std::memory_order_release);
+    }
+
+    std::array<uint32, 32> values;
+    std::atomic<uint32>   *done;
+    std::atomic<uint64>   *sum;
+};
+
+void SubmitBig(ThreadPool &pool, std::atomic<uint32> &done, std::atomic<uint64> &sum)
+{
+    done.store(0);
+    for (uint32 i = 0; i < JobCount / 10; i++)
+    {
+        BigJob job{{}, &done, &sum};
+        job.values.fill(i);
+        pool.Submit(job);
+        if ((i + 1) % WaveSize == 0)
+            WaitFor(pool, done, i + 1);
+    }
+}
+
+int main()
+{
+    const uint32 threads = std::max(2u, std::thread::hardware_concurrency());
+    ThreadPool pool;
+    pool.Create(threads, Priority::Normal);
+    ThreadPool::Reserve(ReservedTaskCount);
+    PoolAllocator::Reserve(sizeof(BigJob), ReservedTaskCount);
+
+    // captures are destroyed once the job has run
+    auto shared = std::make_shared<uint32>(0);
+    std::atomic<uint32> done{0};
+    for (uint32 i = 0; i < 1000; i++)
+        pool.Submit([shared, &done] { done.fetch_add(1, std::memory_order_release); }, Priority::High);
+    WaitFor(pool, done, 1000);
+    // the last job may still be destroying its capture
+    while (shared.use_count() != 1)
+        std::this_thread::yield();
+
+    // the warm up grow the slabs and the deques to the peak of the waves
+    std::atomic<uint64> sum{0};
+    for (uint32 i = 0; i < WarmUpCount; i++)
+    {
+        SubmitTiny(pool, done);
+        SubmitNested(pool, done);
+        SubmitBig(pool, done, sum);
+    }
+    sum.store(0);
+
+    const uint64 before = gAllocCount.load();
+    const double rate = SubmitTiny(pool, done);
+    SubmitNested(pool, done);
+    SubmitBig(pool, done, sum);
+    const uint64 allocations = gAllocCount.load() - before;
+    pool.Destroy();
+
+    const uint64 expectedSum = uint64(JobCount / 10) * (JobCount / 10 - 1);
+    const uint64 jobs = JobCount * 2 + JobCount / 10;
+    Logger::info("{:.2f} M jobs/s submitted, {} global allocations for {} jobs once warm",
+                 rate / 1e6,
+                 allocations,
+                 jobs);
+    if (allocations != 0 || sum.load() != expectedSum)
+    {
+        Logger::error("InlineTask test failed");
+        return 1;
+    }
+    Logger::info("InlineTask test passed");
+    return 0;
+}
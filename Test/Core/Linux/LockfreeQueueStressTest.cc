@@ -0,0 +1,90 @@
+// Stress the LockFreeQueue with many producers and consumers, build it with
+// -fsanitize=address (or thread) so a node released too early is reported.
+#include "Algorithm/LockfreeQueue.h"
+#include "Logger.h"
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace Hawl;
+using namespace Hawl::Algorithm;
+
+constexpr uint32 ThreadCount = 16;
+constexpr uint64 ItemsPerThread = 100000;
+constexpr uint64 BulkSize = 16;
+
+int main()
+{
+    LockFreeQueue<uint64> queue;
+    const uint64 total = ThreadCount * ItemsPerThread;
+    std::unique_ptr<std::atomic<uint32>[]> seen(new std::atomic<uint32>[total]);
+    for (uint64 i = 0; i < total; ++i)
+        seen[i].store(0, std::memory_order_relaxed);
+
+    std::atomic<uint64> popped{0};
+    std::vector<std::thread> threads;
+
+    // every thread both produce and consume, so head and tail nodes are retired
+    // while other threads are still traversing them
+    for (uint32 t = 0; t < ThreadCount; ++t)
+        threads.emplace_back([&, t] {
+            uint64 value;
+            uint64 burst[BulkSize];
+            for (uint64 i = 0; i < ItemsPerThread;)
+            {
+                // odd thread push and pop in bulk, so bulk and single operations interleave
+                if (t % 2 == 1 && i + BulkSize <= ItemsPerThread)
+                {
+                    for (uint64 n = 0; n < BulkSize; ++n)
+                        burst[n] = t * ItemsPerThread + i + n;
+                    queue.EnQueueBulk(burst);
+                    i += BulkSize;
+
+                    size_t count = queue.DeQueueBulk(burst);
+                    for (size_t n = 0; n < count; ++n)
+                        seen[burst[n]].fetch_add(1, std::memory_order_relaxed);
+                    popped.fetch_add(count, std::memory_order_relaxed);
+                    continue;
+                }
+
+                queue.EnQueue(t * ItemsPerThread + i);
+                if (queue.DeQueue(value))
+                {
+                    seen[value].fetch_add(1, std::memory_order_relaxed);
+                    popped.fetch_add(1, std::memory_order_relaxed);
+                }
+                if (i % 64 == 0)
+                    queue.Peek(value);
+                ++i;
+            }
+            while (popped.load(std::memory_order_relaxed) < total)
+            {
+                if (queue.DeQueue(value))
+                {
+                    seen[value].fetch_add(1, std::memory_order_relaxed);
+                    popped.fetch_add(1, std::memory_order_relaxed);
+                }
+                else
+                    std::this_thread::yield();
+            }
+        });
+
+    for (auto &thread : threads)
+        thread.join();
+
+    for (uint64 i = 0; i < total; ++i)
+    {
+        if (seen[i].load() != 1)
+        {
+            Logger::error("LockFreeQueue stress test failed, item {} dequeued {} times", i, seen[i].load());
+            return 1;
+        }
+    }
+
+    Logger::info("LockFreeQueue stress test passed, {} items through {} threads, epoch {}",
+                 total,
+                 ThreadCount,
+                 EpochReclaimer::CurrentEpoch());
+    return 0;
+}
@@ -0,0 +1,160 @@
+// MemoryHeap: the stats of a tag follow its allocations and frees, from any
+// thread, blocks are aligned and Calloc zeroed, the EASTL allocator counts in
+// its heap, MemoryTracker counts the same blocks under the tag, and Destroy
+// frees the blocks of the calling thread at once and takes them out of both,
+// also when other threads freed some of them. A thread_local destructor
+// running after the heaps of its thread are gone still allocates, counted.
+#include "Logger.h"
+#include "Memory/MemoryHeap.h"
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+using namespace Hawl;
+
+constexpr uint32 BlockCount = 10000;
+
+/// allocate in its destructor, after the heaps of the thread were released
+struct LateAllocator
+{
+    ~LateAllocator()
+    {
+        block = MemoryHeap::Allocate(MemoryTag::Core, 128);
+    }
+
+    static inline void *block = nullptr;
+};
+
+thread_local LateAllocator tl_late;
+
+int main()
+{
+    bool passed = true;
+
+    // allocate and free on one thread, the other heaps do not move
+    {
+        const HeapStats before = MemoryHeap::GetStats(MemoryTag::Core);
+        std::vector<void *> blocks;
+        for (uint32 i = 0; i < BlockCount; ++i)
+            blocks.push_back(MemoryHeap::Allocate(MemoryTag::Core, 8 + i % 200));
+        const HeapStats live = MemoryHeap::GetStats(MemoryTag::Core);
+#if HAWL_MEMORY_TRACKING
+        const MemoryTagStats tracked = MemoryTracker::GetStats(MemoryTag::Core);
+        passed = passed && tracked.liveCount == live.liveCount && tracked.liveBytes == live.liveBytes;
+#endif
+        passed = passed && live.liveCount - before.liveCount == BlockCount &&
+                 live.liveBytes - before.liveBytes >= int64(BlockCount) * 8 &&
+                 live.allocationCount - before.allocationCount == BlockCount;
+        passed = passed && MemoryHeap::GetStats(MemoryTag::Renderer).liveCount == 0;
+        for (void *block : blocks)
+            MemoryHeap::Free(MemoryTag::Core, block);
+        const HeapStats after = MemoryHeap::GetStats(MemoryTag::Core);
+        passed = passed && after.liveCount == before.liveCount && after.liveBytes == before.liveBytes;
+        if (!passed)
+            Logger::error("MemoryHeap: stats failed");
+    }
+
+    // alignment, zeroing and the EASTL allocator
+    {
+        void *aligned = MemoryHeap::Allocate(MemoryTag::Renderer, 100, 256);
+        auto *zeroed = static_cast<unsigned char *>(MemoryHeap::Calloc(MemoryTag::Renderer, 64, 16, 64));
+        passed = passed && reinterpret_cast<uintptr_t>(aligned) % 256 == 0 &&
+                 reinterpret_cast<uintptr_t>(zeroed) % 64 == 0;
+        for (uint32 i = 0; i < 64 * 16; ++i)
+            passed = passed && zeroed[i] == 0;
+
+        AssetsEastlAllocator eastlAllocator;
+        void                *block = eastlAllocator.allocate(300, 64, 0);
+        passed = passed && reinterpret_cast<uintptr_t>(block) % 64 == 0 &&
+                 MemoryHeap::GetStats(MemoryTag::Assets).liveCount == 1 && eastlAllocator == AssetsEastlAllocator() &&
+                 std::strcmp(eastlAllocator.get_name(), "Assets") == 0;
+        eastlAllocator.deallocate(block, 300);
+        MemoryHeap::Free(MemoryTag::Renderer, aligned);
+        MemoryHeap::Free(MemoryTag::Renderer, zeroed);
+        passed = passed && MemoryHeap::GetStats(MemoryTag::Assets).liveCount == 0 &&
+                 MemoryHeap::GetStats(MemoryTag::Renderer).liveCount == 0;
+        if (!passed)
+            Logger::error("MemoryHeap: alignment failed");
+    }
+
+    // blocks of a thread freed by another
+    {
+        std::vector<void *> blocks(BlockCount);
+        std::thread([&] {
+            for (auto &block : blocks)
+                block = MemoryHeap::Allocate(MemoryTag::Logging, 64);
+        }).join();
+        passed = passed && MemoryHeap::GetStats(MemoryTag::Logging).liveCount == BlockCount;
+        for (void *block : blocks)
+            MemoryHeap::Free(MemoryTag::Logging, block);
+        passed = passed && MemoryHeap::GetStats(MemoryTag::Logging).liveCount == 0 &&
+                 MemoryHeap::GetStats(MemoryTag::Logging).liveBytes == 0;
+        if (!passed)
+            Logger::error("MemoryHeap: free from another thread failed");
+    }
+
+    // a loading thread destroys its heap instead of freeing the blocks, some were already freed by
+    // another thread, and aligned or zeroed blocks are mixed in
+    {
+        std::thread([&] {
+            for (uint32 round = 0; round < 3; ++round)
+            {
+                std::vector<void *> blocks(BlockCount);
+                for (uint32 i = 0; i < BlockCount; ++i)
+                {
+                    if (i % 3 == 0)
+                        blocks[i] = MemoryHeap::Allocate(MemoryTag::Assets, 16 + i % 1000, size_t(64) << (i % 4));
+                    else if (i % 3 == 1)
+                        blocks[i] = MemoryHeap::Calloc(MemoryTag::Assets, 1 + i % 100, 8, 32);
+                    else
+                        blocks[i] = MemoryHeap::Allocate(MemoryTag::Assets, 16 + i % 1000);
+                    std::memset(blocks[i], 0xAB, 8);
+                }
+                std::thread([&] {
+                    for (uint32 i = 0; i < BlockCount; i += 4)
+                        MemoryHeap::Free(MemoryTag::Assets, blocks[i]);
+                }).join();
+                passed = passed && MemoryHeap::GetStats(MemoryTag::Assets).liveCount == BlockCount - BlockCount / 4;
+                MemoryHeap::Destroy(MemoryTag::Assets);
+                const HeapStats stats = MemoryHeap::GetStats(MemoryTag::Assets);
+                passed = passed && stats.liveCount == 0 && stats.liveBytes == 0 && stats.destroyCount == round + 1;
+#if HAWL_MEMORY_TRACKING
+                const MemoryTagStats tracked = MemoryTracker::GetStats(MemoryTag::Assets);
+                passed = passed && tracked.liveCount == 0 && tracked.liveBytes == 0;
+#endif
+            }
+        }).join();
+        if (!passed)
+            Logger::error("MemoryHeap: destroy failed");
+    }
+
+    // the thread_local is constructed before the heaps, so destroyed after them
+    {
+        const HeapStats before = MemoryHeap::GetStats(MemoryTag::Core);
+        std::thread([] {
+            [[maybe_unused]] LateAllocator &late = tl_late;
+            MemoryHeap::Free(MemoryTag::Core, MemoryHeap::Allocate(MemoryTag::Core, 64));
+        }).join();
+        const HeapStats late = MemoryHeap::GetStats(MemoryTag::Core);
+        passed = passed && LateAllocator::block != nullptr && late.liveCount == before.liveCount + 1 &&
+                 late.allocationCount == before.allocationCount + 2;
+        MemoryHeap::Free(MemoryTag::Core, LateAllocator::block);
+        const HeapStats after = MemoryHeap::GetStats(MemoryTag::Core);
+        passed = passed && after.liveCount == before.liveCount && after.liveBytes == before.liveBytes;
+#if HAWL_MEMORY_TRACKING
+        passed = passed && MemoryTracker::GetStats(MemoryTag::Core).liveCount == after.liveCount;
+#endif
+        if (!passed)
+            Logger::error("MemoryHeap: allocation after thread exit failed");
+    }
+
+    MemoryHeap::LogStats();
+    if (!passed)
+    {
+        Logger::error("MemoryHeap test failed");
+        return 1;
+    }
+    Logger::info("MemoryHeap test passed");
+    return 0;
+}
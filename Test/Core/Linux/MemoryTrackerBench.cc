@@ -0,0 +1,122 @@
+// Cost of MemoryTracker on a small object churn over PoolAllocator: the plain
+// pool, the pool reporting every allocation and free to MemoryTracker, and
+// the pool counting in one shared atomic per tag for comparison, from 1
+// thread to all the hardware threads. Built with HAWL_MEMORY_LEAK_REPORT the
+// tracked column includes the allocation counts and the record of every block.
+#include "Logger.h"
+#include "Memory/MemoryTracker.h"
+#include "Memory/PoolAllocator.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace Hawl;
+using Clock = std::chrono::high_resolution_clock;
+
+constexpr uint32 OperationsPerThread = 2000000;
+constexpr uint32 Window = 1024;
+
+struct PoolFunctions
+{
+    static void *Allocate(size_t size)
+    {
+        return PoolAllocator::Allocate(size);
+    }
+
+    static void Free(void *block, size_t size)
+    {
+        PoolAllocator::Free(block, size);
+    }
+};
+
+struct TrackedFunctions
+{
+    static void *Allocate(size_t size)
+    {
+        void *block = PoolAllocator::Allocate(size);
+        MemoryTracker::OnAllocate(block, size);
+        return block;
+    }
+
+    static void Free(void *block, size_t size)
+    {
+        MemoryTracker::OnFree(block, size, MemoryTag::Core);
+        PoolAllocator::Free(block, size);
+    }
+};
+
+/// the obvious counters, one contended line for all the threads
+struct alignas(CacheLineSize) SharedCounters
+{
+    std::atomic<int64>  liveBytes{0};
+    std::atomic<uint64> allocationCount{0};
+};
+
+SharedCounters g_shared;
+
+struct SharedAtomicFunctions
+{
+    static void *Allocate(size_t size)
+    {
+        g_shared.liveBytes.fetch_add(static_cast<int64>(size), std::memory_order_relaxed);
+        g_shared.allocationCount.fetch_add(1, std::memory_order_relaxed);
+        return PoolAllocator::Allocate(size);
+    }
+
+    static void Free(void *block, size_t size)
+    {
+        g_shared.liveBytes.fetch_sub(static_cast<int64>(size), std::memory_order_relaxed);
+        PoolAllocator::Free(block, size);
+    }
+};
+
+/// \return million of allocate and free pairs per second
+template <typename Functions>
+double Run(uint32 threadCount)
+{
+    std::vector<std::thread> threads;
+    const auto               start = Clock::now();
+    for (uint32 t = 0; t < threadCount; ++t)
+        threads.emplace_back([t] {
+            MemoryTagScope scope(MemoryTag::Core);
+            void          *live[Window] = {};
+            size_t         sizes[Window] = {};
+            uint32         seed = t * 7919 + 1;
+            for (uint32 i = 0; i < OperationsPerThread; ++i)
+            {
+                seed = seed * 1103515245 + 12345;
+                const uint32 slot = (seed >> 8) % Window;
+                if (live[slot] != nullptr)
+                    Functions::Free(live[slot], sizes[slot]);
+                sizes[slot] = 16 + (seed >> 20) % 241;
+                live[slot] = Functions::Allocate(sizes[slot]);
+                *static_cast<uint32 *>(live[slot]) = i;
+            }
+            for (uint32 slot = 0; slot < Window; ++slot)
+                Functions::Free(live[slot], sizes[slot]);
+        });
+    for (auto &thread : threads)
+        thread.join();
+    const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    return double(OperationsPerThread) * threadCount / seconds / 1e6;
+}
+
+int main()
+{
+    Logger::info("HAWL_MEMORY_TRACKING {}, HAWL_MEMORY_LEAK_REPORT {}", HAWL_MEMORY_TRACKING, HAWL_MEMORY_LEAK_REPORT);
+    const uint32 maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    for (uint32 threads = 1;; threads = std::min(threads * 2, maxThreads))
+    {
+        Logger::info("{} threads: pool {:.1f} Mops/s, tracked {:.1f} Mops/s, shared atomic {:.1f} Mops/s",
+                     threads,
+                     Run<PoolFunctions>(threads),
+                     Run<TrackedFunctions>(threads),
+                     Run<SharedAtomicFunctions>(threads));
+        if (threads == maxThreads)
+            break;
+    }
+    MemoryTracker::LogStats();
+    return 0;
+}
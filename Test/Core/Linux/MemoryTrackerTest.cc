@@ -0,0 +1,209 @@
+// MemoryTracker: tag scopes nest and restore, the counters of a tag follow its
+// allocations from any number of threads, the peak holds after the frees and
+// catches a spike no sample saw, the rates come out of Update with the leak
+// report, the EASTL adapter counts under the tag of its scope, and ReportLeaks
+// finds what is not freed.
+#include "Logger.h"
+#include "Memory/MemoryTracker.h"
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+using namespace Hawl;
+
+constexpr uint32 ThreadCount = 4;
+constexpr uint32 BlockCount = 10000;
+
+/// EASTL shaped allocator over malloc
+class MallocAllocator
+{
+public:
+    explicit MallocAllocator(const char * = nullptr)
+    {
+    }
+
+    void *allocate(size_t n, int = 0)
+    {
+        return std::malloc(n);
+    }
+
+    void *allocate(size_t n, size_t, size_t, int = 0)
+    {
+        return std::malloc(n);
+    }
+
+    void deallocate(void *block, size_t)
+    {
+        std::free(block);
+    }
+
+    const char *get_name() const
+    {
+        return "MallocAllocator";
+    }
+
+    void set_name(const char *)
+    {
+    }
+};
+
+inline bool operator==(const MallocAllocator &, const MallocAllocator &)
+{
+    return true;
+}
+
+void *TrackedAllocate(size_t size)
+{
+    void *block = std::malloc(size);
+    MemoryTracker::OnAllocate(block, size);
+    return block;
+}
+
+int main()
+{
+#if HAWL_MEMORY_TRACKING
+    bool passed = true;
+
+    // scopes
+    {
+        passed = passed && MemoryTracker::GetCurrentTag() == MemoryTag::Untagged;
+        {
+            MemoryTagScope renderer(MemoryTag::Renderer);
+            {
+                MemoryTagScope assets(MemoryTag::Assets);
+                passed = passed && MemoryTracker::GetCurrentTag() == MemoryTag::Assets;
+            }
+            passed = passed && MemoryTracker::GetCurrentTag() == MemoryTag::Renderer;
+        }
+        passed = passed && MemoryTracker::GetCurrentTag() == MemoryTag::Untagged;
+        if (!passed)
+            Logger::error("MemoryTracker: scopes failed");
+    }
+
+    // live and peak, the peak stays after the frees
+    {
+        MemoryTracker::Update();
+        std::vector<void *> blocks;
+        {
+            MemoryTagScope scope(MemoryTag::Renderer);
+            for (uint32 i = 0; i < BlockCount; ++i)
+                blocks.push_back(TrackedAllocate(100));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        MemoryTracker::Update();
+        const MemoryTagStats live = MemoryTracker::GetStats(MemoryTag::Renderer);
+        passed = passed && live.liveBytes == 100 * BlockCount && live.liveCount == BlockCount;
+#if HAWL_MEMORY_LEAK_REPORT
+        passed = passed && live.allocationCount == BlockCount && live.allocationsPerSecond > 0.0 &&
+                 live.bytesPerSecond > live.allocationsPerSecond;
+#else
+        passed = passed && live.allocationCount == 0 && live.allocationsPerSecond == 0.0;
+#endif
+        passed = passed && MemoryTracker::GetStats(MemoryTag::Untagged).liveCount == 0;
+
+        for (void *block : blocks)
+        {
+            MemoryTracker::OnFree(block, 100, MemoryTag::Renderer);
+            std::free(block);
+        }
+        const MemoryTagStats freed = MemoryTracker::GetStats(MemoryTag::Renderer);
+        passed = passed && freed.liveBytes == 0 && freed.liveCount == 0 && freed.peakBytes == 100 * BlockCount;
+        if (!passed)
+            Logger::error("MemoryTracker: live and peak failed");
+    }
+
+    // a spike freed before any Update or GetStats still raises the peak, from several threads at once
+    {
+        const int64              before = MemoryTracker::GetStats(MemoryTag::Logging).peakBytes;
+        std::vector<std::thread> threads;
+        for (uint32 t = 0; t < ThreadCount; ++t)
+            threads.emplace_back([] {
+                std::vector<void *> blocks;
+                for (uint32 i = 0; i < BlockCount; ++i)
+                    blocks.push_back(TrackedAllocate(32));
+                for (void *block : blocks)
+                {
+                    MemoryTracker::OnFree(block, 32, MemoryTag::Untagged);
+                    std::free(block);
+                }
+            });
+        for (auto &thread : threads)
+            thread.join();
+        const MemoryTagStats untagged = MemoryTracker::GetStats(MemoryTag::Untagged);
+        passed = passed && untagged.liveBytes == 0 && untagged.peakBytes >= 32 * BlockCount &&
+                 untagged.peakBytes <= 32 * ThreadCount * BlockCount &&
+                 MemoryTracker::GetStats(MemoryTag::Logging).peakBytes == before;
+        if (!passed)
+            Logger::error("MemoryTracker: spike failed");
+    }
+
+    // threads allocating, the main thread freeing after they exited, twice to reuse their counters
+    for (uint32 round = 0; round < 2; ++round)
+    {
+        std::vector<std::vector<void *>> blocks(ThreadCount);
+        std::vector<std::thread>         threads;
+        for (uint32 t = 0; t < ThreadCount; ++t)
+            threads.emplace_back([&blocks, t] {
+                MemoryTagScope scope(MemoryTag::Assets);
+                for (uint32 i = 0; i < BlockCount; ++i)
+                    blocks[t].push_back(TrackedAllocate(16 + i % 64));
+            });
+        for (auto &thread : threads)
+            thread.join();
+
+        const MemoryTagStats live = MemoryTracker::GetStats(MemoryTag::Assets);
+        passed = passed && live.liveCount == ThreadCount * BlockCount;
+        for (uint32 t = 0; t < ThreadCount; ++t)
+            for (uint32 i = 0; i < BlockCount; ++i)
+            {
+                MemoryTracker::OnFree(blocks[t][i], 16 + i % 64, MemoryTag::Assets);
+                std::free(blocks[t][i]);
+            }
+        const MemoryTagStats freed = MemoryTracker::GetStats(MemoryTag::Assets);
+        passed = passed && freed.liveCount == 0 && freed.liveBytes == 0;
+#if HAWL_MEMORY_LEAK_REPORT
+        passed = passed && freed.allocationCount == (round + 1) * ThreadCount * BlockCount;
+#endif
+        if (!passed)
+            Logger::error("MemoryTracker: threads failed");
+    }
+
+    // the EASTL adapter take the tag of its scope
+    {
+        MemoryTagScope                         scope(MemoryTag::Logging);
+        TrackedEastlAllocator<MallocAllocator> allocator;
+        void                                  *block = allocator.allocate(64);
+        passed = passed && allocator.GetTag() == MemoryTag::Logging &&
+                 MemoryTracker::GetStats(MemoryTag::Logging).liveBytes == 64;
+        allocator.deallocate(block, 64);
+        passed = passed && MemoryTracker::GetStats(MemoryTag::Logging).liveBytes == 0;
+        if (!passed)
+            Logger::error("MemoryTracker: EASTL allocator failed");
+    }
+
+    // a leak is reported, then no more once freed
+    {
+        void *leaked = nullptr;
+        {
+            MemoryTagScope scope(MemoryTag::Core);
+            leaked = TrackedAllocate(48);
+        }
+        passed = passed && MemoryTracker::ReportLeaks() == 1;
+        MemoryTracker::OnFree(leaked, 48, MemoryTag::Core);
+        std::free(leaked);
+        passed = passed && MemoryTracker::ReportLeaks() == 0;
+        if (!passed)
+            Logger::error("MemoryTracker: leak report failed");
+    }
+
+    MemoryTracker::LogStats();
+    if (!passed)
+    {
+        Logger::error("MemoryTracker test failed");
+        return 1;
+    }
+#endif
+    Logger::info("MemoryTracker test passed");
+    return 0;
+}
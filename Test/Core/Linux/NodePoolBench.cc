@@ -0,0 +1,97 @@
+// Count the global allocator calls made by LockFreeQueue once it reach steady state,
+// with NodePool recycling the nodes it should report 0 call per operation.
+#include "AllocationCounter.h"
+#include "Algorithm/LockfreeQueue.h"
+#include "Logger.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace Hawl;
+using namespace Hawl::Algorithm;
+
+constexpr uint64 WarmUpCount = 100000;
+constexpr uint64 OperationCount = 4000000;
+
+/// items in the queue at the same time, keep the queue depth in a steady state
+constexpr uint64 MaxInFlight = 4096;
+
+/// producer and consumer threads share the queue
+void RunProducerConsumer(LockFreeQueue<uint64> &queue, uint32 threadPairs, uint64 operations)
+{
+    std::vector<std::thread> threads;
+    std::atomic<uint64> pushed{0};
+    std::atomic<uint64> popped{0};
+    const uint64 perThread = operations / threadPairs;
+    for (uint32 i = 0; i < threadPairs; ++i)
+    {
+        threads.emplace_back([&] {
+            for (uint64 n = 0; n < perThread; ++n)
+            {
+                while (pushed.load(std::memory_order_relaxed) - popped.load(std::memory_order_relaxed) > MaxInFlight)
+                    std::this_thread::yield();
+                queue.EnQueue(n);
+                pushed.fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+        threads.emplace_back([&] {
+            uint64 value;
+            while (popped.load(std::memory_order_relaxed) < perThread * threadPairs)
+            {
+                if (queue.DeQueue(value))
+                    popped.fetch_add(1, std::memory_order_relaxed);
+                else
+                    std::this_thread::yield();
+            }
+        });
+    }
+    for (auto &thread : threads)
+        thread.join();
+}
+
+int main()
+{
+    using Clock = std::chrono::high_resolution_clock;
+    LockFreeQueue<uint64> queue;
+
+    // single thread, enqueue then dequeue immediately
+    uint64 value;
+    for (uint64 i = 0; i < WarmUpCount; ++i)
+    {
+        queue.EnQueue(i);
+        queue.DeQueue(value);
+    }
+
+    uint64 allocBefore = gAllocCount.load();
+    auto   start = Clock::now();
+    for (uint64 i = 0; i < OperationCount; ++i)
+    {
+        queue.EnQueue(i);
+        queue.DeQueue(value);
+    }
+    auto end = Clock::now();
+    Logger::info("single thread: {} ops, {:.6f} allocator calls per op, {} ns per op",
+                 OperationCount * 2,
+                 double(gAllocCount.load() - allocBefore) / double(OperationCount * 2),
+                 std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / (OperationCount * 2));
+
+    // multi thread, warm up first so every thread cache and the global stack are filled,
+    // thread creation itself allocate, so count it separately
+    const uint32 pairs = 4;
+    RunProducerConsumer(queue, pairs, WarmUpCount * pairs);
+    allocBefore = gAllocCount.load();
+    start = Clock::now();
+    RunProducerConsumer(queue, pairs, OperationCount);
+    end = Clock::now();
+    Logger::info("{} producer {} consumer: {} ops, {:.6f} allocator calls per op, {} ns per op",
+                 pairs,
+                 pairs,
+                 OperationCount * 2,
+                 double(gAllocCount.load() - allocBefore) / double(OperationCount * 2),
+                 std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / (OperationCount * 2));
+
+    Logger::info("node pool slab allocations in total {}",
+                 LockFreeQueue<uint64>::GetNodeAllocationCount());
+    return 0;
+}
@@ -0,0 +1,193 @@
+// Random allocate and free trace on a 256 MiB range, OffsetAllocator against a
+// best fit allocator over std::map, the usual free list of a gpu heap. Reports
+// the time per operation, the allocations that did not fit and the
+// fragmentation of the free space at the end of the trace.
+#include "Logger.h"
+#include "Memory/OffsetAllocator.h"
+#include <chrono>
+#include <iterator>
+#include <map>
+#include <random>
+#include <vector>
+
+using namespace Hawl;
+using Clock = std::chrono::high_resolution_clock;
+
+constexpr uint32 HeapSize = 256u << 20;
+constexpr uint32 OperationCount = 2000000;
+
+/// best fit over the free ranges by size, merged through the free ranges by offset
+class MapAllocator
+{
+public:
+    struct Allocation
+    {
+        uint32 offset = OffsetAllocator::NoSpace;
+        uint32 size = 0;
+
+        bool IsValid() const
+        {
+            return offset != OffsetAllocator::NoSpace;
+        }
+    };
+
+    explicit MapAllocator(uint32 size)
+    {
+        Insert(0, size);
+    }
+
+    Allocation Allocate(uint32 size, uint32 alignment)
+    {
+        auto found = m_bySize.lower_bound(size + alignment - 1);
+        if (found == m_bySize.end())
+            return {};
+        const uint32 rangeOffset = found->second;
+        const uint32 rangeSize = found->first;
+        Erase(found);
+        const uint32 offset = static_cast<uint32>(RoundUp64(rangeOffset, alignment));
+        if (offset > rangeOffset)
+            Insert(rangeOffset, offset - rangeOffset);
+        if (rangeOffset + rangeSize > offset + size)
+            Insert(offset + size, rangeOffset + rangeSize - offset - size);
+        return {offset, size};
+    }
+
+    void Free(Allocation allocation)
+    {
+        uint32 offset = allocation.offset;
+        uint32 size = allocation.size;
+        auto   next = m_byOffset.lower_bound(offset);
+        if (next != m_byOffset.end() && next->first == offset + size)
+        {
+            size += next->second;
+            Erase(FindBySize(next->first, next->second));
+        }
+        next = m_byOffset.lower_bound(offset);
+        if (next != m_byOffset.begin())
+        {
+            auto previous = std::prev(next);
+            if (previous->first + previous->second == offset)
+            {
+                offset = previous->first;
+                size += previous->second;
+                Erase(FindBySize(previous->first, previous->second));
+            }
+        }
+        Insert(offset, size);
+    }
+
+    OffsetAllocatorStats GetStats() const
+    {
+        OffsetAllocatorStats stats;
+        for (const auto &[offset, size] : m_byOffset)
+            stats.totalFree += size;
+        stats.freeRegionCount = static_cast<uint32>(m_byOffset.size());
+        stats.largestFree = m_bySize.empty() ? 0 : std::prev(m_bySize.end())->first;
+        return stats;
+    }
+
+private:
+    using SizeMap = std::multimap<uint32, uint32>;
+
+    void Insert(uint32 offset, uint32 size)
+    {
+        m_byOffset.emplace(offset, size);
+        m_bySize.emplace(size, offset);
+    }
+
+    SizeMap::iterator FindBySize(uint32 offset, uint32 size)
+    {
+        auto range = m_bySize.equal_range(size);
+        for (auto i = range.first; i != range.second; ++i)
+            if (i->second == offset)
+                return i;
+        return m_bySize.end();
+    }
+
+    void Erase(SizeMap::iterator bySize)
+    {
+        m_byOffset.erase(bySize->second);
+        m_bySize.erase(bySize);
+    }
+
+    std::map<uint32, uint32> m_byOffset;
+    SizeMap                  m_bySize;
+};
+
+struct Operation
+{
+    bool   allocate;
+    uint32 sizeOrIndex;
+    uint32 alignment;
+};
+
+/// the same trace for both allocators, sizes of a few hundred bytes to a few MiB
+std::vector<Operation> MakeTrace()
+{
+    std::vector<Operation> trace;
+    trace.reserve(OperationCount);
+    std::mt19937 random(7);
+    uint32       live = 0;
+    for (uint32 i = 0; i < OperationCount; ++i)
+    {
+        if (live == 0 || random() % 100 < 52)
+        {
+            const uint32 size = 256 + random() % (random() % 16 == 0 ? (4u << 20) : (64u << 10));
+            trace.push_back({true, size, 1u << (8 + random() % 5)});
+            ++live;
+        }
+        else
+        {
+            trace.push_back({false, static_cast<uint32>(random()), 0});
+            --live;
+        }
+    }
+    return trace;
+}
+
+template <typename Allocator>
+void Run(const char *name, const std::vector<Operation> &trace)
+{
+    Allocator                                   allocator(HeapSize);
+    std::vector<typename Allocator::Allocation> live;
+    live.reserve(trace.size());
+    uint32 failed = 0;
+
+    const auto start = Clock::now();
+    for (const Operation &operation : trace)
+    {
+        if (operation.allocate)
+        {
+            const auto allocation = allocator.Allocate(operation.sizeOrIndex, operation.alignment);
+            if (allocation.IsValid())
+                live.push_back(allocation);
+            else
+                ++failed;
+        }
+        else if (!live.empty())
+        {
+            const uint32 index = operation.sizeOrIndex % live.size();
+            allocator.Free(live[index]);
+            live[index] = live.back();
+            live.pop_back();
+        }
+    }
+    const double nanoseconds = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+    const OffsetAllocatorStats stats = allocator.GetStats();
+    Logger::info("{:16} {:6.1f} ns/op, {} live, {} did not fit, {} free ranges, fragmentation {:.3f}",
+                 name,
+                 nanoseconds / trace.size(),
+                 live.size(),
+                 failed,
+                 stats.freeRegionCount,
+                 stats.GetFragmentation());
+}
+
+int main()
+{
+    const std::vector<Operation> trace = MakeTrace();
+    Run<OffsetAllocator>("OffsetAllocator", trace);
+    Run<MapAllocator>("std::map bestfit", trace);
+    return 0;
+}
@@ -0,0 +1,160 @@
+// OffsetAllocator: the whole range can be taken and no more, freeing in any
+// order coalesces back to one range, aligned offsets are aligned, and a long
+// random trace never hands out overlapping ranges while the stats stay equal
+// to the ones computed from a shadow map of the live allocations.
+#include "Logger.h"
+#include "Memory/OffsetAllocator.h"
+#include <algorithm>
+#include <map>
+#include <random>
+#include <vector>
+
+using namespace Hawl;
+
+constexpr uint32 HeapSize = 1 << 24;
+constexpr uint32 TraceLength = 200000;
+
+int main()
+{
+    bool passed = true;
+
+    // fill with equal blocks, then the next one fails
+    {
+        OffsetAllocator allocator(1024 * 16);
+        std::vector<OffsetAllocator::Allocation> allocations;
+        for (uint32 i = 0; i < 1024; ++i)
+        {
+            allocations.push_back(allocator.Allocate(16));
+            passed = passed && allocations.back().offset == i * 16;
+        }
+        passed = passed && !allocator.Allocate(1).IsValid() && allocator.GetStats().totalFree == 0;
+
+        // free every other block, a block of 32 does not fit anywhere
+        for (uint32 i = 0; i < 1024; i += 2)
+            allocator.Free(allocations[i]);
+        const OffsetAllocatorStats stats = allocator.GetStats();
+        passed = passed && stats.freeRegionCount == 512 && stats.largestFree == 16 && stats.totalFree == 512 * 16;
+        passed = passed && stats.GetFragmentation() > 0.99f && !allocator.Allocate(32).IsValid();
+
+        // free the rest, everything merges back
+        for (uint32 i = 1; i < 1024; i += 2)
+            allocator.Free(allocations[i]);
+        const OffsetAllocatorStats merged = allocator.GetStats();
+        passed = passed && merged.freeRegionCount == 1 && merged.largestFree == 1024 * 16 &&
+                 merged.allocationCount == 0 && merged.GetFragmentation() == 0.0f;
+        passed = passed && allocator.Allocate(1024 * 16).offset == 0;
+        if (!passed)
+            Logger::error("OffsetAllocator: fill and coalesce failed");
+    }
+
+    // alignment, the padding stays free
+    {
+        OffsetAllocator allocator(HeapSize);
+        const auto odd = allocator.Allocate(3);
+        const auto aligned = allocator.Allocate(100, 256);
+        passed = passed && odd.offset == 0 && aligned.offset == 256 && allocator.GetAllocationSize(aligned) == 100;
+        const auto small = allocator.Allocate(200);
+        passed = passed && small.IsValid() && small.offset + 200 <= 256 && small.offset >= 3;
+        allocator.Free(aligned);
+        allocator.Free(odd);
+        allocator.Free(small);
+        passed = passed && allocator.GetStats().freeRegionCount == 1;
+        if (!passed)
+            Logger::error("OffsetAllocator: alignment failed");
+    }
+
+    // the nodes bound the ranges, allocations plus free ranges, and Allocate keep two spare for the split
+    {
+        OffsetAllocator allocator(HeapSize, 64);
+        uint32 count = 0;
+        while (allocator.Allocate(1).IsValid())
+            ++count;
+        passed = passed && count == 62;
+        allocator.Reset();
+        passed = passed && allocator.GetStats().totalFree == HeapSize && allocator.Allocate(HeapSize).IsValid();
+        if (!passed)
+            Logger::error("OffsetAllocator: node exhaustion failed");
+    }
+
+    // random trace checked against a shadow map offset -> size
+    {
+        OffsetAllocator                          allocator(HeapSize);
+        std::vector<OffsetAllocator::Allocation> live;
+        std::map<uint32, uint32>                 shadow;
+        std::mt19937                             random(42);
+        uint32                                   failed = 0;
+        for (uint32 i = 0; i < TraceLength && passed; ++i)
+        {
+            if (live.empty() || random() % 100 < 55)
+            {
+                const uint32 size = 1 + random() % (random() % 8 == 0 ? 65536 : 512);
+                const uint32 alignment = 1u << (random() % 9);
+                const auto   allocation = allocator.Allocate(size, alignment);
+                if (!allocation.IsValid())
+                {
+                    ++failed;
+                    continue;
+                }
+                passed = passed && allocation.offset % alignment == 0 && allocation.offset + size <= HeapSize;
+                auto next = shadow.lower_bound(allocation.offset);
+                if (next != shadow.end())
+                    passed = passed && allocation.offset + size <= next->first;
+                if (next != shadow.begin())
+                {
+                    auto previous = std::prev(next);
+                    passed = passed && previous->first + previous->second <= allocation.offset;
+                }
+                shadow.emplace(allocation.offset, size);
+                live.push_back(allocation);
+            }
+            else
+            {
+                const uint32 index = random() % live.size();
+                shadow.erase(live[index].offset);
+                allocator.Free(live[index]);
+                live[index] = live.back();
+                live.pop_back();
+            }
+
+            if (i % 1000 == 0)
+            {
+                // the free ranges are the gaps between the live allocations
+                uint32 totalFree = 0, largestFree = 0, regions = 0, end = 0;
+                for (const auto &[offset, size] : shadow)
+                {
+                    if (offset > end)
+                    {
+                        totalFree += offset - end;
+                        largestFree = std::max(largestFree, offset - end);
+                        ++regions;
+                    }
+                    end = offset + size;
+                }
+                if (end < HeapSize)
+                {
+                    totalFree += HeapSize - end;
+                    largestFree = std::max(largestFree, HeapSize - end);
+                    ++regions;
+                }
+                const OffsetAllocatorStats stats = allocator.GetStats();
+                passed = passed && stats.totalFree == totalFree && stats.largestFree == largestFree &&
+                         stats.freeRegionCount == regions && stats.allocationCount == shadow.size();
+            }
+        }
+        for (const auto &allocation : live)
+            allocator.Free(allocation);
+        const OffsetAllocatorStats stats = allocator.GetStats();
+        passed = passed && stats.freeRegionCount == 1 && stats.totalFree == HeapSize;
+        Logger::info("OffsetAllocator: random trace of {} operations, {} allocations did not fit", TraceLength, failed);
+        if (!passed)
+            Logger::error("OffsetAllocator: random trace failed");
+    }
+
+    if (!passed)
+    {
+        Logger::error("OffsetAllocator test failed");
+        return 1;
+    }
+    Logger::info("OffsetAllocator test passed");
+    return 0;
+}
@@ -0,0 +1,176 @@
+// ParallelFor, ParallelReduce, ParallelScan and ParallelSort against their
+// serial result, with cheap and expensive items so the ranges are split, with
+// a reduction that check its parts are combined in the range order, a scan of
+// strings over several blocks, and a contiguous bool range sorted by comparison.
+#include "Logger.h"
+#include "Thread/Parallel.h"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace Hawl;
+
+/// a contiguous range, combining two of them is only valid in order
+struct Span
+{
+    int64 first = -1;
+    int64 last = -1;
+    bool  valid = true;
+};
+
+Span CombineSpans(Span left, Span right)
+{
+    if (left.first < 0)
+        return right;
+    if (right.first < 0)
+        return left;
+    return {left.first, right.last, left.valid && right.valid && left.last == right.first};
+}
+
+bool TestFor(ThreadPool &pool)
+{
+    for (uint32 count : {0u, 1u, 100u, 1000000u})
+    {
+        std::unique_ptr<std::atomic<uint32>[]> seen(new std::atomic<uint32>[count]());
+        ParallelFor(pool, 0u, count, [&](uint32 i) { seen[i].fetch_add(1, std::memory_order_relaxed); });
+        for (uint32 i = 0; i < count; i++)
+        {
+            if (seen[i].load() != 1)
+                return false;
+        }
+    }
+
+    // expensive items, the range must be split over the workers
+    std::vector<uint64> values(4096);
+    ParallelFor(pool, size_t(0), values.size(), [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; i++)
+        {
+            uint64 value = i;
+            for (uint32 n = 0; n < 2000; n++)
+                value = value * 6364136223846793005ull + 1442695040888963407ull;
+            values[i] = value;
+        }
+    });
+    for (size_t i = 0; i < values.size(); i++)
+    {
+        uint64 value = i;
+        for (uint32 n = 0; n < 2000; n++)
+            value = value * 6364136223846793005ull + 1442695040888963407ull;
+        if (values[i] != value)
+            return false;
+    }
+    return true;
+}
+
+bool TestReduce(ThreadPool &pool)
+{
+    const int64 count = 5000000;
+    const int64 sum = ParallelReduce(
+        pool, int64(0), count, int64(0),
+        [](int64 first, int64 last, int64 value) {
+            for (int64 i = first; i < last; i++)
+                value += i;
+            return value;
+        },
+        [](int64 left, int64 right) { return left + right; });
+    if (sum != count * (count - 1) / 2)
+        return false;
+
+    const Span span = ParallelReduce(
+        pool, int64(0), count, Span{},
+        [](int64 first, int64 last, Span value) { return CombineSpans(value, Span{first, last, true}); },
+        CombineSpans);
+    return span.valid && span.first == 0 && span.last == count;
+}
+
+bool TestScan(ThreadPool &pool)
+{
+    std::vector<uint64> input(3000000);
+    std::mt19937 random(7);
+    for (auto &value : input)
+        value = random() % 1000;
+
+    std::vector<uint64> expected(input.size()), output(input.size());
+    std::inclusive_scan(input.begin(), input.end(), expected.begin());
+    ParallelScan(pool, input.begin(), input.end(), output.begin(), uint64(0), std::plus<uint64>());
+    if (output != expected)
+        return false;
+
+    // in place
+    ParallelScan(pool, input.begin(), input.end(), input.begin(), uint64(0), std::plus<uint64>());
+    if (input != expected)
+        return false;
+
+    // a value left moved from shows as an empty string, the last 8 characters of a concatenation is associative
+    auto                     concatenate = [](std::string accumulated, const std::string &value) {
+        accumulated += value;
+        return accumulated.size() > 8 ? accumulated.substr(accumulated.size() - 8) : accumulated;
+    };
+    std::vector<std::string> letters(200000);
+    for (size_t i = 0; i < letters.size(); ++i)
+        letters[i] = std::string(1, char('a' + i % 26));
+    std::vector<std::string> expectedSuffixes(letters.size()), suffixes(letters.size());
+    std::string              running;
+    for (size_t i = 0; i < letters.size(); ++i)
+        expectedSuffixes[i] = running = concatenate(std::move(running), letters[i]);
+    ParallelScan(pool, letters.begin(), letters.end(), suffixes.begin(), std::string(), concatenate);
+    return suffixes == expectedSuffixes;
+}
+
+template <typename T>
+bool TestRadixSort(ThreadPool &pool, size_t count)
+{
+    std::vector<T> values(count);
+    std::mt19937_64 random(count);
+    for (auto &value : values)
+        value = static_cast<T>(random());
+    std::vector<T> expected = values;
+    std::sort(expected.begin(), expected.end());
+    ParallelSort(pool, values.begin(), values.end());
+    return values == expected;
+}
+
+bool TestSort(ThreadPool &pool)
+{
+    if (!TestRadixSort<uint32>(pool, 2000000) || !TestRadixSort<int32>(pool, 2000000) ||
+        !TestRadixSort<int64>(pool, 1000000) || !TestRadixSort<uint16>(pool, 100) ||
+        !TestRadixSort<uint8>(pool, 1000000))
+        return false;
+
+    // bool has no unsigned type, it is sorted by comparison
+    std::unique_ptr<bool[]> flags(new bool[100000]);
+    for (uint32 i = 0; i < 100000; i++)
+        flags[i] = i % 3 == 0;
+    ParallelSort(pool, flags.get(), flags.get() + 100000);
+    if (!std::is_sorted(flags.get(), flags.get() + 100000))
+        return false;
+
+    std::vector<double> values(2000000);
+    std::mt19937 random(3);
+    std::uniform_real_distribution<double> distribution(-1.0, 1.0);
+    for (auto &value : values)
+        value = distribution(random);
+    ParallelSort(pool, values.begin(), values.end(), std::greater<double>());
+    return std::is_sorted(values.begin(), values.end(), std::greater<double>());
+}
+
+int main()
+{
+    const uint32 threads = std::max(2u, std::thread::hardware_concurrency());
+    ThreadPool pool;
+    pool.Create(threads, Priority::Normal);
+    const bool passed = TestFor(pool) && TestReduce(pool) && TestScan(pool) && TestSort(pool);
+    pool.Destroy();
+    if (!passed)
+    {
+        Logger::error("Parallel test failed");
+        return 1;
+    }
+    Logger::info("Parallel test passed");
+    return 0;
+}
@@ -0,0 +1,111 @@
+// Small object churn, PoolAllocator against the global new and mi_malloc: every
+// thread keeps a window of live objects of 16 to 256 bytes and replaces one at
+// a time, from 1 thread to all the hardware threads. The mi_malloc column is
+// there when mimalloc.h is on the include path.
+#include "Logger.h"
+#include "Memory/PoolAllocator.h"
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#if __has_include(<mimalloc.h>)
+#include <mimalloc.h>
+#define HAWL_BENCH_MIMALLOC 1
+#endif
+
+using namespace Hawl;
+using Clock = std::chrono::high_resolution_clock;
+
+constexpr uint32 OperationsPerThread = 2000000;
+constexpr uint32 Window = 1024;
+
+struct PoolFunctions
+{
+    static void *Allocate(size_t size)
+    {
+        return PoolAllocator::Allocate(size);
+    }
+
+    static void Free(void *block, size_t size)
+    {
+        PoolAllocator::Free(block, size);
+    }
+};
+
+struct NewFunctions
+{
+    static void *Allocate(size_t size)
+    {
+        return ::operator new(size);
+    }
+
+    static void Free(void *block, size_t)
+    {
+        ::operator delete(block);
+    }
+};
+
+#if HAWL_BENCH_MIMALLOC
+struct MimallocFunctions
+{
+    static void *Allocate(size_t size)
+    {
+        return mi_malloc(size);
+    }
+
+    static void Free(void *block, size_t)
+    {
+        mi_free(block);
+    }
+};
+#endif
+
+/// \return million of allocate and free pairs per second
+template <typename Functions>
+double Run(uint32 threadCount)
+{
+    std::vector<std::thread> threads;
+    const auto               start = Clock::now();
+    for (uint32 t = 0; t < threadCount; ++t)
+        threads.emplace_back([t] {
+            void  *live[Window] = {};
+            size_t sizes[Window] = {};
+            uint32 seed = t * 7919 + 1;
+            for (uint32 i = 0; i < OperationsPerThread; ++i)
+            {
+                seed = seed * 1103515245 + 12345;
+                const uint32 slot = (seed >> 8) % Window;
+                if (live[slot] != nullptr)
+                    Functions::Free(live[slot], sizes[slot]);
+                sizes[slot] = 16 + (seed >> 20) % 241;
+                live[slot] = Functions::Allocate(sizes[slot]);
+                *static_cast<uint32 *>(live[slot]) = i;
+            }
+            for (uint32 slot = 0; slot < Window; ++slot)
+                Functions::Free(live[slot], sizes[slot]);
+        });
+    for (auto &thread : threads)
+        thread.join();
+    const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    return double(OperationsPerThread) * threadCount / seconds / 1e6;
+}
+
+int main()
+{
+    const uint32 maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    for (uint32 threads = 1;; threads = std::min(threads * 2, maxThreads))
+    {
+        std::string line = fmt::format("{} threads: PoolAllocator {:.1f} Mops/s, new {:.1f} Mops/s",
+                                       threads,
+                                       Run<PoolFunctions>(threads),
+                                       Run<NewFunctions>(threads));
+#if HAWL_BENCH_MIMALLOC
+        line += fmt::format(", mi_malloc {:.1f} Mops/s", Run<MimallocFunctions>(threads));
+#endif
+        Logger::info("{}", line);
+        if (threads == maxThreads)
+            break;
+    }
+    return 0;
+}
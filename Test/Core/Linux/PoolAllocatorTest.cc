@@ -0,0 +1,189 @@
+// PoolAllocator and ObjectPool: blocks are aligned and disjoint for every size
+// class, a freed block is reused first, objects freed by another thread are
+// recycled and counted in MemoryTracker under the tag of the pool, a throwing
+// constructor gives its block back, reserved blocks are allocated on one
+// thread and freed on another without system allocation, threads churning at
+// once never share a block, and with HAWL_POOL_POISON a freed block is filled
+// with the poison pattern.
+#include "Logger.h"
+#include "Memory/PoolAllocator.h"
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace Hawl;
+
+constexpr uint32 ThreadCount = 4;
+constexpr uint32 ChurnCount = 200000;
+
+struct Counted
+{
+    explicit Counted(uint32 InValue) : value{InValue}
+    {
+        constructed.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    ~Counted()
+    {
+        destroyed.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    uint32 value;
+    char   payload[44];
+
+    static inline std::atomic<uint32> constructed{0};
+    static inline std::atomic<uint32> destroyed{0};
+};
+
+struct Throwing
+{
+    Throwing()
+    {
+        throw std::runtime_error("Throwing");
+    }
+
+    char payload[40];
+};
+
+int main()
+{
+    bool passed = true;
+
+    // every size class, filled and checked after all are allocated
+    std::vector<std::pair<unsigned char *, size_t>> blocks;
+    for (size_t size = 1; size <= PoolAllocator::MaxPooledSize + 64; size += size < 512 ? 7 : size / 5)
+    {
+        for (uint32 i = 0; i < 100; ++i)
+        {
+            auto *block = static_cast<unsigned char *>(PoolAllocator::Allocate(size));
+            passed = passed && reinterpret_cast<uintptr_t>(block) % PoolAllocator::Granularity == 0;
+            std::memset(block, static_cast<int>(blocks.size() & 0xff), size);
+            blocks.emplace_back(block, size);
+        }
+    }
+    for (size_t i = 0; i < blocks.size(); ++i)
+    {
+        for (size_t j = 0; j < blocks[i].second; ++j)
+            passed = passed && blocks[i].first[j] == (i & 0xff);
+        PoolAllocator::Free(blocks[i].first, blocks[i].second);
+    }
+
+    // the last freed block of a class is the next allocated
+    void *block = PoolAllocator::Allocate(40);
+    PoolAllocator::Free(block, 40);
+    passed = passed && PoolAllocator::Allocate(48) == block;
+#if HAWL_POOL_POISON
+    PoolAllocator::Free(block, 48);
+    for (uint32 i = 0; i < 48; ++i)
+        passed = passed && static_cast<unsigned char *>(block)[i] == 0xDD;
+    passed = passed && PoolAllocator::Allocate(48) == block;
+#endif
+    PoolAllocator::Free(block, 48);
+
+    // ObjectPool, objects made on one thread and deleted on another
+    {
+        using CountedPool = ObjectPool<Counted, MemoryTag::Renderer>;
+        std::vector<Counted *> objects;
+        for (uint32 i = 0; i < 1000; ++i)
+            objects.push_back(CountedPool::New(i));
+#if HAWL_MEMORY_TRACKING
+        const MemoryTagStats live = MemoryTracker::GetStats(MemoryTag::Renderer);
+        passed = passed && live.liveCount == 1000 && live.liveBytes == 1000 * int64(sizeof(Counted));
+#endif
+        std::thread([&] {
+            for (uint32 i = 0; i < objects.size(); ++i)
+            {
+                passed = passed && objects[i]->value == i;
+                CountedPool::Delete(objects[i]);
+            }
+        }).join();
+        std::unique_ptr<Counted, CountedPool::Deleter> owned(CountedPool::New(7u));
+        passed = passed && owned->value == 7;
+    }
+#if HAWL_MEMORY_TRACKING
+    passed = passed && MemoryTracker::GetStats(MemoryTag::Renderer).liveCount == 0;
+#endif
+    passed = passed && Counted::constructed.load() == 1001 && Counted::destroyed.load() == 1001;
+
+    // the block of a throwing constructor is freed and not counted live
+    {
+        using ThrowingPool = ObjectPool<Throwing, MemoryTag::Renderer>;
+        void *probe = PoolAllocator::Allocate(sizeof(Throwing));
+        PoolAllocator::Free(probe, sizeof(Throwing));
+        bool thrown = false;
+        try
+        {
+            ThrowingPool::New();
+        }
+        catch (const std::runtime_error &)
+        {
+            thrown = true;
+        }
+        void *reused = PoolAllocator::Allocate(sizeof(Throwing));
+        PoolAllocator::Free(reused, sizeof(Throwing));
+        passed = passed && thrown && reused == probe;
+#if HAWL_MEMORY_TRACKING
+        passed = passed && MemoryTracker::GetStats(MemoryTag::Renderer).liveCount == 0;
+#endif
+    }
+
+    // reserved blocks, allocated here and freed by another thread
+    {
+        constexpr uint32 ReservedCount = 5000;
+        PoolAllocator::Reserve(1000, ReservedCount);
+        const uint64        reservedBefore = PoolAllocator::GetSystemAllocationCount();
+        std::vector<void *> reserved;
+        for (uint32 i = 0; i < ReservedCount; ++i)
+            reserved.push_back(PoolAllocator::Allocate(1000));
+        std::thread([&] {
+            for (void *reservedBlock : reserved)
+                PoolAllocator::Free(reservedBlock, 1000);
+        }).join();
+        passed = passed && PoolAllocator::GetSystemAllocationCount() == reservedBefore;
+    }
+
+    // every thread keep a window of live objects stamped with its id, a block
+    // handed to two threads at once would break a stamp
+    const uint64        allocationsBefore = PoolAllocator::GetSystemAllocationCount();
+    std::atomic<bool>   corrupted{false};
+    std::vector<std::thread> threads;
+    for (uint32 t = 0; t < ThreadCount; ++t)
+        threads.emplace_back([&, t] {
+            constexpr uint32 Window = 300;
+            uint64          *live[Window] = {};
+            size_t           sizes[Window] = {};
+            for (uint32 i = 0; i < ChurnCount; ++i)
+            {
+                const uint32 slot = i % Window;
+                if (live[slot] != nullptr)
+                {
+                    if (live[slot][0] != t || live[slot][1] != slot)
+                        corrupted.store(true);
+                    PoolAllocator::Free(live[slot], sizes[slot]);
+                }
+                sizes[slot] = 16 + (i * 37 % 15) * 16;
+                live[slot] = static_cast<uint64 *>(PoolAllocator::Allocate(sizes[slot]));
+                live[slot][0] = t;
+                live[slot][1] = slot;
+            }
+            for (uint32 slot = 0; slot < Window; ++slot)
+                PoolAllocator::Free(live[slot], sizes[slot]);
+        });
+    for (auto &thread : threads)
+        thread.join();
+    const uint64 systemAllocations = PoolAllocator::GetSystemAllocationCount() - allocationsBefore;
+    Logger::info("PoolAllocator: {} system allocations for {} threads churning", systemAllocations, ThreadCount);
+    passed = passed && !corrupted.load() && systemAllocations < 1000;
+
+    if (!passed)
+    {
+        Logger::error("PoolAllocator test failed");
+        return 1;
+    }
+    Logger::info("PoolAllocator test passed");
+    return 0;
+}
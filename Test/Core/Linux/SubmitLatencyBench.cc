@@ -0,0 +1,91 @@
+// Submit to start latency of the ThreadPool idle policies at different loads:
+// a probe task is added every interval, from back to back to far enough apart
+// for the workers to park, and records when a worker starts it. The cpu time
+// of the process over the wall time shows what the spinning costs.
+#include "Logger.h"
+#include "Thread.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <thread>
+#include <vector>
+
+using namespace Hawl;
+using Clock = std::chrono::steady_clock;
+
+constexpr uint32 ProbeCount = 2000;
+constexpr uint32 WorkerCount = 2;
+constexpr auto   SleepGranularity = std::chrono::microseconds(100);
+
+struct ProbeTask : Task
+{
+    void run() override
+    {
+        latency = Clock::now() - submitTime;
+        done.store(true, std::memory_order_release);
+    }
+
+    Clock::time_point submitTime;
+    Clock::duration   latency{};
+    std::atomic<bool> done{false};
+};
+
+void RunLoad(const IdlePolicy &policy, const char *name, std::chrono::microseconds interval)
+{
+    ThreadPool pool;
+    pool.SetIdlePolicy(policy);
+    pool.Create(WorkerCount, Priority::Normal);
+
+    std::vector<ProbeTask> probes(ProbeCount);
+    const std::clock_t     cpuStart = std::clock();
+    const auto             start = Clock::now();
+    auto                   next = start;
+    for (auto &probe : probes)
+    {
+        // sleep when the granularity of the sleep allow it, the cpu time is then the workers'
+        if (interval >= SleepGranularity)
+            std::this_thread::sleep_until(next);
+        while (Clock::now() < next)
+            std::this_thread::yield();
+        probe.submitTime = Clock::now();
+        pool.AddTask(&probe);
+        next = probe.submitTime + interval;
+    }
+    for (auto &probe : probes)
+    {
+        while (!probe.done.load(std::memory_order_acquire))
+            std::this_thread::yield();
+    }
+    const double wallTime = std::chrono::duration<double>(Clock::now() - start).count();
+    const double cpuTime = double(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+    pool.Destroy();
+
+    std::vector<double> latencies;
+    latencies.reserve(ProbeCount);
+    for (const auto &probe : probes)
+        latencies.push_back(std::chrono::duration<double, std::micro>(probe.latency).count());
+    std::sort(latencies.begin(), latencies.end());
+    Logger::info("{:>11} every {:>4} us: p50 {:7.1f} us, p99 {:7.1f} us, max {:8.1f} us, cpu {:.0f}% of wall",
+                 name,
+                 interval.count(),
+                 latencies[latencies.size() / 2],
+                 latencies[latencies.size() * 99 / 100],
+                 latencies.back(),
+                 cpuTime / wallTime * 100.0);
+}
+
+int main()
+{
+    const std::chrono::microseconds intervals[] = {std::chrono::microseconds(0),
+                                                   std::chrono::microseconds(10),
+                                                   std::chrono::microseconds(100),
+                                                   std::chrono::microseconds(1000)};
+    for (auto interval : intervals)
+    {
+        RunLoad(IdlePolicy(), "adaptive", interval);
+        RunLoad(IdlePolicy::LowLatency(), "LowLatency", interval);
+        RunLoad(IdlePolicy::PowerSaving(), "PowerSaving", interval);
+    }
+    return 0;
+}
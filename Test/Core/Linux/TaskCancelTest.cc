@@ -0,0 +1,333 @@
+// Lock free cancellation of queued tasks: a cancelled task never run and may be
+// destroyed at once, a run is Done once it returned even if the task deleted
+// itself, a handle goes stale when its run is over, and concurrent cancels race
+// the workers with every task run exactly once or cancelled. Then a streaming
+// like burst is cancelled at 90% to measure the cancel and skip cost. Build it
+// with -fsanitize=thread to check the races, -fsanitize=address to check that a
+// cancelled task is never read.
+#include "Logger.h"
+#include "Thread.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <new>
+#include <thread>
+#include <vector>
+
+using namespace Hawl;
+using Clock = std::chrono::steady_clock;
+
+constexpr uint32 TaskCount = 1000;
+constexpr uint32 RaceTaskCount = 200000;
+constexpr uint32 CancellerCount = 3;
+constexpr uint32 BurstTaskCount = 100000;
+
+/// hold the worker until released
+struct GateTask : Task
+{
+    void run() override
+    {
+        started.store(true, std::memory_order_release);
+        while (!open.load(std::memory_order_acquire))
+            std::this_thread::yield();
+    }
+
+    std::atomic<bool> started{false};
+    std::atomic<bool> open{false};
+};
+
+/// delete itself in run(), the pool must not touch it after
+struct SelfDeletingTask : Task
+{
+    void run() override
+    {
+        total->fetch_add(1, std::memory_order_release);
+        delete this;
+    }
+
+    std::atomic<uint32> *total = nullptr;
+};
+
+struct CountTask : Task
+{
+    void run() override
+    {
+        ran.fetch_add(1, std::memory_order_relaxed);
+        total->fetch_add(1, std::memory_order_release);
+    }
+
+    std::atomic<uint32>  ran{0};
+    std::atomic<uint32> *total = nullptr;
+};
+
+static void WaitUntil(ThreadPool &pool, const std::atomic<uint32> &counter, uint32 value)
+{
+    while (counter.load(std::memory_order_acquire) < value)
+    {
+        if (!pool.RunPendingTask())
+            std::this_thread::yield();
+    }
+}
+
+static void WaitDone(ThreadPool &pool, const TaskHandle &handle)
+{
+    while (ThreadPool::GetTaskState(handle) != TaskState::Done)
+    {
+        if (!pool.RunPendingTask())
+            std::this_thread::yield();
+    }
+}
+
+bool TestSemantic()
+{
+    ThreadPool pool;
+    pool.Create(1, Priority::Normal);
+
+    GateTask         gate;
+    const TaskHandle gateHandle = pool.AddTask(&gate);
+    while (!gate.started.load(std::memory_order_acquire))
+        std::this_thread::yield();
+    bool passed = ThreadPool::GetTaskState(gateHandle) == TaskState::Running;
+
+    std::atomic<uint32>                      total{0};
+    std::vector<std::unique_ptr<CountTask>> tasks(TaskCount);
+    std::vector<TaskHandle>                  handles(TaskCount);
+    for (uint32 i = 0; i < TaskCount; ++i)
+    {
+        tasks[i] = std::make_unique<CountTask>();
+        tasks[i]->total = &total;
+        handles[i] = pool.AddTask(tasks[i].get());
+    }
+
+    for (uint32 i = 0; i < TaskCount; i += 2)
+        passed &= ThreadPool::CancelTask(handles[i]) && ThreadPool::GetTaskState(handles[i]) == TaskState::Cancelled;
+    // a second cancel of the same run fail
+    passed &= !ThreadPool::CancelTask(handles[0]);
+
+    gate.open.store(true, std::memory_order_release);
+    WaitUntil(pool, total, TaskCount / 2);
+    for (uint32 i = 0; i < TaskCount; ++i)
+    {
+        WaitDone(pool, handles[i]);
+        passed &= tasks[i]->ran.load() == (i % 2 == 0 ? 0u : 1u);
+    }
+    // a run that returned is Done, not Running forever
+    WaitDone(pool, gateHandle);
+
+    // the handle of the cancelled run is stale once the task is added again
+    const TaskHandle again = pool.AddTask(tasks[0].get());
+    passed &= !ThreadPool::CancelTask(handles[0]);
+    WaitDone(pool, again);
+    passed &= tasks[0]->ran.load() == 1 && !ThreadPool::CancelTask(again);
+
+    // the legacy entry point cancel the current run, the first gate may still be returning
+    GateTask secondGate;
+    pool.AddTask(&secondGate);
+    while (!secondGate.started.load(std::memory_order_acquire))
+        std::this_thread::yield();
+    const TaskHandle retracted = pool.AddTask(tasks[1].get());
+    pool.RetractTask(tasks[1].get());
+    passed &= ThreadPool::GetTaskState(retracted) == TaskState::Cancelled;
+    secondGate.open.store(true, std::memory_order_release);
+    WaitDone(pool, retracted);
+    passed &= tasks[1]->ran.load() == 1;
+
+    pool.Destroy();
+    if (!passed)
+        Logger::error("cancel semantic broken");
+    return passed;
+}
+
+/// a cancelled task is destroyed before a worker pop it, a self deleting task is Done after its run
+bool TestLifetime()
+{
+    ThreadPool pool;
+    pool.Create(1, Priority::Normal);
+
+    GateTask gate;
+    pool.AddTask(&gate);
+    while (!gate.started.load(std::memory_order_acquire))
+        std::this_thread::yield();
+
+    std::atomic<uint32> total{0};
+    CountTask          *cancelledTask = new CountTask();
+    cancelledTask->total = &total;
+    const TaskHandle cancelled = pool.AddTask(cancelledTask);
+    bool             passed = ThreadPool::CancelTask(cancelled);
+    delete cancelledTask;
+
+    SelfDeletingTask *selfDeleting = new SelfDeletingTask();
+    selfDeleting->total = &total;
+    const TaskHandle selfDeleted = pool.AddTask(selfDeleting);
+
+    gate.open.store(true, std::memory_order_release);
+    WaitDone(pool, cancelled);
+    WaitDone(pool, selfDeleted);
+    passed &= total.load(std::memory_order_acquire) == 1;
+
+    pool.Destroy();
+    if (!passed)
+        Logger::error("task lifetime broken");
+    return passed;
+}
+
+/// a handle of a destroyed task must not cancel the task built in its storage
+bool TestStorageReuse()
+{
+    ThreadPool pool;
+    pool.Create(1, Priority::Normal);
+
+    std::atomic<uint32> total{0};
+    alignas(CountTask) unsigned char storage[sizeof(CountTask)];
+    CountTask *first = new (storage) CountTask();
+    first->total = &total;
+    const TaskHandle stale = pool.AddTask(first);
+    // the pool does not touch a task once it ran
+    WaitUntil(pool, total, 1);
+    first->~CountTask();
+
+    GateTask gate;
+    pool.AddTask(&gate);
+    while (!gate.started.load(std::memory_order_acquire))
+        std::this_thread::yield();
+
+    CountTask *second = new (storage) CountTask();
+    second->total = &total;
+    const TaskHandle handle = pool.AddTask(second);
+    const bool       cancelled = ThreadPool::CancelTask(stale);
+    gate.open.store(true, std::memory_order_release);
+    WaitDone(pool, handle);
+    const bool passed = !cancelled && second->ran.load() == 1;
+    second->~CountTask();
+
+    pool.Destroy();
+    if (!passed)
+        Logger::error("stale handle cancelled a task reusing the storage");
+    return passed;
+}
+
+bool TestRace()
+{
+    ThreadPool pool;
+    pool.Create(2, Priority::Normal);
+
+    std::atomic<uint32>                      total{0};
+    std::atomic<uint32>                      published{0};
+    std::vector<std::unique_ptr<CountTask>> tasks(RaceTaskCount);
+    std::vector<TaskHandle>                  handles(RaceTaskCount);
+    std::unique_ptr<std::atomic<bool>[]>     cancelled(new std::atomic<bool>[RaceTaskCount]);
+    for (uint32 i = 0; i < RaceTaskCount; ++i)
+    {
+        tasks[i] = std::make_unique<CountTask>();
+        tasks[i]->total = &total;
+        cancelled[i].store(false, std::memory_order_relaxed);
+    }
+
+    std::vector<std::thread> cancellers;
+    std::atomic<uint32>      cancelCount{0};
+    for (uint32 c = 0; c < CancellerCount; ++c)
+        cancellers.emplace_back([&, c] {
+            for (uint32 i = c; i < RaceTaskCount; i += CancellerCount)
+            {
+                while (published.load(std::memory_order_acquire) <= i)
+                    std::this_thread::yield();
+                if (i % 3 != 0 && ThreadPool::CancelTask(handles[i]))
+                {
+                    cancelled[i].store(true, std::memory_order_relaxed);
+                    cancelCount.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+        });
+
+    for (uint32 i = 0; i < RaceTaskCount; ++i)
+    {
+        handles[i] = pool.AddTask(tasks[i].get());
+        published.store(i + 1, std::memory_order_release);
+    }
+    for (auto &canceller : cancellers)
+        canceller.join();
+
+    WaitUntil(pool, total, RaceTaskCount - cancelCount.load());
+    bool passed = true;
+    for (uint32 i = 0; i < RaceTaskCount; ++i)
+    {
+        WaitDone(pool, handles[i]);
+        const uint32 ran = tasks[i]->ran.load();
+        if (ran != (cancelled[i].load() ? 0u : 1u))
+        {
+            Logger::error("task {} ran {} times, cancelled {}", i, ran, cancelled[i].load());
+            passed = false;
+            break;
+        }
+    }
+    pool.Destroy();
+    Logger::info("{} tasks, {} cancelled while racing the workers", RaceTaskCount, cancelCount.load());
+    return passed;
+}
+
+/// a burst of loads queued behind a busy worker then mostly invalidated, drain time against the uncancelled burst
+bool BenchBurst()
+{
+    double drainTime[2] = {};
+    double cancelNs = 0;
+    for (uint32 pass = 0; pass < 2; ++pass)
+    {
+        ThreadPool pool;
+        pool.Create(1, Priority::Normal);
+        GateTask gate;
+        pool.AddTask(&gate);
+        while (!gate.started.load(std::memory_order_acquire))
+            std::this_thread::yield();
+
+        std::atomic<uint32>     total{0};
+        std::vector<CountTask>  tasks(BurstTaskCount);
+        std::vector<TaskHandle> handles(BurstTaskCount);
+        for (uint32 i = 0; i < BurstTaskCount; ++i)
+        {
+            tasks[i].total = &total;
+            handles[i] = pool.AddTask(&tasks[i]);
+        }
+
+        uint32 kept = BurstTaskCount;
+        if (pass == 1)
+        {
+            const auto start = Clock::now();
+            for (uint32 i = 0; i < BurstTaskCount; ++i)
+            {
+                if (i % 10 != 0)
+                    kept -= ThreadPool::CancelTask(handles[i]) ? 1 : 0;
+            }
+            cancelNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() /
+                       (BurstTaskCount - BurstTaskCount / 10);
+        }
+
+        const auto start = Clock::now();
+        gate.open.store(true, std::memory_order_release);
+        WaitUntil(pool, total, kept);
+        // the cancelled ones are dropped in queue order, wait for the last
+        for (const TaskHandle &handle : handles)
+            WaitDone(pool, handle);
+        drainTime[pass] = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        pool.Destroy();
+        if (kept != BurstTaskCount / 10 && pass == 1)
+            return false;
+    }
+    Logger::info("{} queued tasks: drain {:.2f} ms, with 90% cancelled {:.2f} ms, cancel {:.0f} ns",
+                 BurstTaskCount,
+                 drainTime[0],
+                 drainTime[1],
+                 cancelNs);
+    return true;
+}
+
+int main()
+{
+    if (!TestSemantic() || !TestLifetime() || !TestStorageReuse() || !TestRace() || !BenchBurst())
+    {
+        Logger::error("TaskCancel test failed");
+        return 1;
+    }
+    Logger::info("TaskCancel test passed");
+    return 0;
+}
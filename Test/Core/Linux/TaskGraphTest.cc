@@ -0,0 +1,125 @@
+// A frame shaped TaskGraph (animation -> culling -> draw extraction -> command
+// recording) relaunched many times: every node must run once per launch after
+// all its predecessors. With the pool reserved, a relaunch never allocate once
+// warmed up, in the graph or in the pool.
+#include "AllocationCounter.h"
+#include "Logger.h"
+#include "Thread.h"
+#include "Thread/TaskGraph.h"
+#include <atomic>
+#include <vector>
+
+using namespace Hawl;
+
+constexpr uint32 LaunchCount = 2000;
+constexpr uint32 WarmUpCount = 1000;
+/// queue nodes and task slots preallocated, far above the tasks of a launch for the thread caches
+constexpr uint32 ReservedTaskCount = 16384;
+
+/// a cycle is refused
+bool TestCycle(ThreadPool &pool)
+{
+    TaskGraph graph(pool);
+    const auto a = graph.AddNode([] {});
+    const auto b = graph.AddNode([] {});
+    const auto c = graph.AddNode([] {});
+    graph.AddDependency(a, b);
+    graph.AddDependency(b, c);
+    graph.AddDependency(c, b);
+    return !graph.Launch();
+}
+
+bool TestFrame(ThreadPool &pool)
+{
+    TaskGraph                      graph(pool);
+    std::atomic<uint32>            clock{0};
+    std::vector<uint32>            stamps;
+    std::vector<uint32>            runs;
+    std::vector<std::vector<uint32>> predecessors;
+
+    auto addNode = [&](Priority priority) {
+        const uint32 index = static_cast<uint32>(stamps.size());
+        stamps.push_back(0);
+        runs.push_back(0);
+        predecessors.emplace_back();
+        return graph.AddNode(
+            [&, index] {
+                runs[index]++;
+                stamps[index] = clock.fetch_add(1, std::memory_order_relaxed) + 1;
+            },
+            priority);
+    };
+    auto depend = [&](TaskGraph::NodeHandle before, TaskGraph::NodeHandle after) {
+        graph.AddDependency(before, after);
+        predecessors[after].push_back(before);
+    };
+
+    std::vector<TaskGraph::NodeHandle> animation, culling, extraction;
+    for (uint32 i = 0; i < 8; i++)
+        animation.push_back(addNode(Priority::Normal));
+    for (uint32 i = 0; i < 4; i++)
+    {
+        culling.push_back(addNode(Priority::High));
+        depend(animation[i * 2], culling[i]);
+        depend(animation[i * 2 + 1], culling[i]);
+    }
+    for (uint32 i = 0; i < 2; i++)
+    {
+        extraction.push_back(addNode(Priority::Normal));
+        for (auto cull : culling)
+            depend(cull, extraction[i]);
+    }
+    const auto recording = addNode(Priority::Highest);
+    for (auto extract : extraction)
+        depend(extract, recording);
+
+    uint64 allocations = 0;
+    for (uint32 launch = 0; launch < LaunchCount; launch++)
+    {
+        if (launch == WarmUpCount)
+            allocations = gAllocCount.load();
+        if (!graph.Launch())
+            return false;
+        graph.Wait(culling[0]);
+        if (stamps[culling[0]] == 0)
+            return false;
+        graph.Wait();
+
+        for (uint32 node = 0; node < stamps.size(); node++)
+        {
+            if (runs[node] != launch + 1)
+            {
+                Logger::error("node {} run {} times in {} launches", node, runs[node], launch + 1);
+                return false;
+            }
+            for (uint32 before : predecessors[node])
+                if (stamps[before] > stamps[node])
+                {
+                    Logger::error("node {} run before its predecessor {}", node, before);
+                    return false;
+                }
+        }
+    }
+    allocations = gAllocCount.load() - allocations;
+    Logger::info("{} launches of {} nodes, {} allocations after warm up",
+                 LaunchCount,
+                 graph.GetNodeCount(),
+                 allocations);
+    return allocations == 0;
+}
+
+int main()
+{
+    ThreadPool pool;
+    pool.Create(4, Priority::Normal);
+    ThreadPool::Reserve(ReservedTaskCount);
+    const bool passed = TestCycle(pool) && TestFrame(pool);
+    pool.Destroy();
+    if (!passed)
+    {
+        Logger::error("TaskGraph test failed");
+        return 1;
+    }
+    Logger::info("TaskGraph test passed");
+    return 0;
+}
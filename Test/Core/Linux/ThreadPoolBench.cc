@@ -0,0 +1,156 @@
+// Scaling of the work stealing ThreadPool with fine grained recursive tasks,
+// fib and parallel quicksort, from 1 worker to all the hardware threads.
+#include "Logger.h"
+#include "Thread.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <vector>
+
+using namespace Hawl;
+using Clock = std::chrono::high_resolution_clock;
+
+/// help the pool until the counter drop to zero
+static void WaitCounter(ThreadPool &pool, std::atomic<uint32> &counter)
+{
+    while (counter.load(std::memory_order_acquire) != 0)
+    {
+        if (!pool.RunPendingTask())
+            CpuPause();
+    }
+}
+
+constexpr uint32 FibCutoff = 12;
+
+static uint64 SerialFib(uint32 n)
+{
+    return n < 2 ? n : SerialFib(n - 1) + SerialFib(n - 2);
+}
+
+struct FibTask : Task
+{
+    FibTask(ThreadPool &InPool, uint32 InN, uint64 *InResult, std::atomic<uint32> *InDone)
+        : pool{InPool}, n{InN}, result{InResult}, done{InDone}
+    {
+    }
+
+    void run() override
+    {
+        if (n < FibCutoff)
+            *result = SerialFib(n);
+        else
+        {
+            uint64              left, right;
+            std::atomic<uint32> pending{2};
+            FibTask             leftTask(pool, n - 1, &left, &pending);
+            FibTask             rightTask(pool, n - 2, &right, &pending);
+            pool.AddTask(&leftTask);
+            pool.AddTask(&rightTask);
+            WaitCounter(pool, pending);
+            *result = left + right;
+        }
+        done->fetch_sub(1, std::memory_order_release);
+    }
+
+    ThreadPool          &pool;
+    uint32               n;
+    uint64              *result;
+    std::atomic<uint32> *done;
+};
+
+constexpr size_t SortCutoff = 2048;
+
+struct SortTask : Task
+{
+    SortTask(ThreadPool &InPool, uint32 *InBegin, uint32 *InEnd, std::atomic<uint32> *InDone)
+        : pool{InPool}, begin{InBegin}, end{InEnd}, done{InDone}
+    {
+    }
+
+    void run() override
+    {
+        Sort(begin, end);
+        done->fetch_sub(1, std::memory_order_release);
+    }
+
+    void Sort(uint32 *first, uint32 *last)
+    {
+        while (static_cast<size_t>(last - first) > SortCutoff)
+        {
+            const uint32 pivot = first[(last - first) / 2];
+            uint32      *middle = std::partition(first, last, [pivot](uint32 v) { return v < pivot; });
+            uint32      *upper = std::partition(middle, last, [pivot](uint32 v) { return v == pivot; });
+
+            // sort the left part in a sub task, keep the right part on this thread
+            std::atomic<uint32> pending{1};
+            SortTask            leftTask(pool, first, middle, &pending);
+            pool.AddTask(&leftTask);
+            Sort(upper, last);
+            WaitCounter(pool, pending);
+            return;
+        }
+        std::sort(first, last);
+    }
+
+    ThreadPool          &pool;
+    uint32              *begin;
+    uint32              *end;
+    std::atomic<uint32> *done;
+};
+
+int main()
+{
+    const uint32 maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    const uint32 fibN = 32;
+    std::vector<uint32> source(1 << 22);
+    std::mt19937 random(42);
+    for (auto &value : source)
+        value = random();
+
+    double fibBase = 0, sortBase = 0;
+    std::vector<uint32> threadCounts;
+    for (uint32 threads = 1; threads < maxThreads; threads *= 2)
+        threadCounts.push_back(threads);
+    threadCounts.push_back(maxThreads);
+
+    for (uint32 threads : threadCounts)
+    {
+        ThreadPool pool;
+        pool.Create(threads, Priority::Normal);
+
+        uint64              fibResult = 0;
+        std::atomic<uint32> done{1};
+        FibTask             fibTask(pool, fibN, &fibResult, &done);
+        auto                start = Clock::now();
+        pool.AddTask(&fibTask);
+        WaitCounter(pool, done);
+        const double fibTime = std::chrono::duration<double>(Clock::now() - start).count();
+
+        std::vector<uint32> data = source;
+        done.store(1);
+        SortTask sortTask(pool, data.data(), data.data() + data.size(), &done);
+        start = Clock::now();
+        pool.AddTask(&sortTask);
+        WaitCounter(pool, done);
+        const double sortTime = std::chrono::duration<double>(Clock::now() - start).count();
+        pool.Destroy();
+
+        if (threads == 1)
+        {
+            fibBase = fibTime;
+            sortBase = sortTime;
+        }
+        Logger::info("{} workers: fib({}) = {} in {:.3f} s (x{:.2f}), quicksort {} items in {:.3f} s (x{:.2f}) {}",
+                     threads,
+                     fibN,
+                     fibResult,
+                     fibTime,
+                     fibBase / fibTime,
+                     data.size(),
+                     sortTime,
+                     sortBase / sortTime,
+                     std::is_sorted(data.begin(), data.end()) ? "sorted" : "NOT SORTED");
+    }
+    return 0;
+}
@@ -0,0 +1,113 @@
+// Tail latency of urgent tasks while the ThreadPool is saturated by a flood of
+// Lowest priority work. The probes are submitted as Highest, then as Lowest to
+// show the latency without priority dispatch, and the flood must still make
+// progress under the aging.
+#include "Logger.h"
+#include "Thread.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace Hawl;
+using Clock = std::chrono::steady_clock;
+
+constexpr uint32 ProbeCount = 500;
+constexpr auto   ProbeInterval = std::chrono::milliseconds(2);
+constexpr auto   FloodTaskTime = std::chrono::microseconds(50);
+
+/// burn the cpu for a while then add itself again, until stopped
+struct FloodTask : Task
+{
+    void run() override
+    {
+        const auto end = Clock::now() + FloodTaskTime;
+        while (Clock::now() < end)
+            CpuPause();
+        executed->fetch_add(1, std::memory_order_relaxed);
+
+        if (!stop->load(std::memory_order_acquire))
+            pool->AddTask(this);
+        else
+            running->fetch_sub(1, std::memory_order_release);
+    }
+
+    ThreadPool          *pool = nullptr;
+    std::atomic<bool>   *stop = nullptr;
+    std::atomic<uint32> *running = nullptr;
+    std::atomic<uint64> *executed = nullptr;
+};
+
+struct ProbeTask : Task
+{
+    void run() override
+    {
+        latency = Clock::now() - submitTime;
+        done.store(true, std::memory_order_release);
+    }
+
+    Clock::time_point submitTime;
+    Clock::duration   latency{};
+    std::atomic<bool> done{false};
+};
+
+void RunProbes(uint32 threads, Priority probePriority, const char *name)
+{
+    ThreadPool pool;
+    pool.Create(threads, Priority::Normal);
+
+    std::atomic<bool>   stop{false};
+    std::atomic<uint32> running{0};
+    std::atomic<uint64> executed{0};
+    std::vector<std::unique_ptr<FloodTask>> flood(threads * 8);
+    for (auto &task : flood)
+    {
+        task = std::make_unique<FloodTask>();
+        task->taskPriority = Priority::Lowest;
+        task->pool = &pool;
+        task->stop = &stop;
+        task->running = &running;
+        task->executed = &executed;
+        running.fetch_add(1, std::memory_order_relaxed);
+        pool.AddTask(task.get());
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    std::vector<double> latencies;
+    latencies.reserve(ProbeCount);
+    for (uint32 i = 0; i < ProbeCount; ++i)
+    {
+        ProbeTask probe;
+        probe.taskPriority = probePriority;
+        probe.submitTime = Clock::now();
+        pool.AddTask(&probe);
+        while (!probe.done.load(std::memory_order_acquire))
+            std::this_thread::yield();
+        latencies.push_back(std::chrono::duration<double, std::micro>(probe.latency).count());
+        std::this_thread::sleep_for(ProbeInterval);
+    }
+
+    stop.store(true, std::memory_order_release);
+    while (running.load(std::memory_order_acquire) != 0)
+        std::this_thread::yield();
+    pool.Destroy();
+
+    std::sort(latencies.begin(), latencies.end());
+    Logger::info("{} workers, {} probes: p50 {:.1f} us, p99 {:.1f} us, max {:.1f} us, {} flood tasks executed",
+                 threads,
+                 name,
+                 latencies[latencies.size() / 2],
+                 latencies[latencies.size() * 99 / 100],
+                 latencies.back(),
+                 executed.load());
+}
+
+int main()
+{
+    const uint32 threads = std::max(1u, std::thread::hardware_concurrency());
+    RunProbes(threads, Priority::Highest, "Highest");
+    RunProbes(threads, Priority::Lowest, "Lowest");
+    return 0;
+}
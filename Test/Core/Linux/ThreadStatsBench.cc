@@ -0,0 +1,87 @@
+// Cost of the ThreadPool counters on fine grained work: recursive fib tasks of
+// a few hundred nanoseconds and a flood of submitted jobs. Build it once with
+// the default HAWL_THREAD_STATS and once with -DHAWL_THREAD_STATS=0 for Core and
+// this file, the instrumented throughput should stay within 2%.
+#include "Logger.h"
+#include "Thread.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+using namespace Hawl;
+using Clock = std::chrono::high_resolution_clock;
+
+constexpr uint32 FibN = 30;
+constexpr uint32 FibCutoff = 10;
+constexpr uint32 JobCount = 1000000;
+constexpr uint32 RepeatCount = 5;
+
+static uint64 SerialFib(uint32 n)
+{
+    return n < 2 ? n : SerialFib(n - 1) + SerialFib(n - 2);
+}
+
+static uint64 Fib(ThreadPool &pool, uint32 n)
+{
+    if (n < FibCutoff)
+        return SerialFib(n);
+
+    uint64              left = 0;
+    std::atomic<uint32> pending{1};
+    pool.Submit([&] {
+        left = Fib(pool, n - 1);
+        pending.store(0, std::memory_order_release);
+    });
+    const uint64 right = Fib(pool, n - 2);
+    while (pending.load(std::memory_order_acquire) != 0)
+    {
+        if (!pool.RunPendingTask())
+            CpuPause();
+    }
+    return left + right;
+}
+
+int main()
+{
+    ThreadPool pool;
+    pool.Create(std::max(1u, std::thread::hardware_concurrency()), Priority::Normal);
+
+    // best of the repeats, the noise of the machine only add time
+    double fibTime = 1e9, jobTime = 1e9;
+    uint64 fib = 0;
+    for (uint32 repeat = 0; repeat < RepeatCount; ++repeat)
+    {
+        auto                start = Clock::now();
+        std::atomic<uint32> done{0};
+        pool.Submit([&] {
+            fib = Fib(pool, FibN);
+            done.store(1, std::memory_order_release);
+        });
+        while (done.load(std::memory_order_acquire) == 0)
+            std::this_thread::yield();
+        fibTime = std::min(fibTime, std::chrono::duration<double>(Clock::now() - start).count());
+
+        start = Clock::now();
+        std::atomic<uint32> jobs{0};
+        for (uint32 i = 0; i < JobCount; ++i)
+            pool.Submit([&] { jobs.fetch_add(1, std::memory_order_relaxed); });
+        while (jobs.load(std::memory_order_acquire) != JobCount)
+        {
+            if (!pool.RunPendingTask())
+                std::this_thread::yield();
+        }
+        jobTime = std::min(jobTime, std::chrono::duration<double>(Clock::now() - start).count());
+    }
+
+    Logger::info("HAWL_THREAD_STATS {}: fib({}) = {} in {:.3f} ms, {} jobs in {:.3f} ms",
+                 HAWL_THREAD_STATS,
+                 FibN,
+                 fib,
+                 fibTime * 1e3,
+                 JobCount,
+                 jobTime * 1e3);
+    pool.LogStats();
+    pool.Destroy();
+    return 0;
+}
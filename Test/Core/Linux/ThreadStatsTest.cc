@@ -0,0 +1,66 @@
+// ThreadPool counters: every task run by a worker is counted, the long task
+// set the longest task time, a fan out from a worker fill its deque and get
+// stolen, and a quiet pool accumulate idle time. The counters are only
+// checked when HAWL_THREAD_STATS is on, the snapshot is zero otherwise.
+#include "Logger.h"
+#include "Thread.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+using namespace Hawl;
+using namespace std::chrono_literals;
+
+constexpr uint32 TaskCount = 20000;
+constexpr uint32 FanOutCount = 1000;
+
+int main()
+{
+    ThreadPool pool;
+    pool.Create(2, Priority::Normal);
+
+    std::atomic<uint32> done{0};
+    for (uint32 i = 0; i < TaskCount; ++i)
+        pool.Submit([&] { done.fetch_add(1, std::memory_order_release); });
+
+    // spawned from a worker, they go to its deque where the peer steal them
+    pool.Submit([&] {
+        for (uint32 i = 0; i < FanOutCount; ++i)
+            pool.Submit([&] { done.fetch_add(1, std::memory_order_release); });
+        done.fetch_add(1, std::memory_order_release);
+    });
+    pool.Submit([&] {
+        std::this_thread::sleep_for(5ms);
+        done.fetch_add(1, std::memory_order_release);
+    });
+
+    uint32 expected = TaskCount + FanOutCount + 2;
+    while (done.load(std::memory_order_acquire) != expected)
+        std::this_thread::yield();
+
+    // a parked worker count its idle time when a task wake it
+    std::this_thread::sleep_for(50ms);
+    pool.Submit([&] { done.fetch_add(1, std::memory_order_release); });
+    ++expected;
+    while (done.load(std::memory_order_acquire) != expected)
+        std::this_thread::yield();
+
+    const ThreadPoolStats stats = pool.GetStats();
+    pool.LogStats();
+    pool.Destroy();
+
+    bool passed = stats.workers.size() == 2;
+#if HAWL_THREAD_STATS
+    const WorkerStats &total = stats.total;
+    passed = passed && total.tasksExecuted == expected && total.queueHighWater > 0 &&
+             total.longestTaskNanoseconds >= 5000000 && total.busyNanoseconds >= total.longestTaskNanoseconds &&
+             total.idleNanoseconds > 0 && total.stealsAttempted >= total.stealsSucceeded;
+#endif
+    if (!passed)
+    {
+        Logger::error("ThreadStats test failed");
+        return 1;
+    }
+    Logger::info("ThreadStats test passed");
+    return 0;
+}
@@ -0,0 +1,235 @@
+// TimerWheel semantic and scale: a delayed timer never fire early, a periodic
+// timer repeat until cancelled, from outside or from its own callback, and a
+// cancelled or stale handle is rejected. A timer cancelled once due but still
+// queued behind a busy worker never call back. Then 100k timers over a few seconds of
+// delays measure the insert and cancel cost and how late the timers fire.
+#include "Logger.h"
+#include "Thread.h"
+#include "Thread/TimerWheel.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace Hawl;
+using Clock = std::chrono::steady_clock;
+using namespace std::chrono_literals;
+
+constexpr uint32 ScaleTimerCount = 100000;
+
+static void WaitFor(const std::atomic<uint32> &counter, uint32 value)
+{
+    const auto deadline = Clock::now() + 10s;
+    while (counter.load(std::memory_order_acquire) < value && Clock::now() < deadline)
+        std::this_thread::sleep_for(1ms);
+}
+
+bool TestDelayed(TimerWheel &wheel)
+{
+    std::atomic<uint32> fired{0};
+    std::atomic<bool>   early{false};
+    const auto          delays = {1ms, 5ms, 20ms, 300ms};
+    for (auto delay : delays)
+    {
+        const auto due = Clock::now() + delay;
+        wheel.AddDelayed(delay, [&, due] {
+            if (Clock::now() < due)
+                early.store(true);
+            fired.fetch_add(1, std::memory_order_release);
+        });
+    }
+    WaitFor(fired, static_cast<uint32>(delays.size()));
+    if (fired.load() != delays.size() || early.load())
+    {
+        Logger::error("delayed timers fired {} of {}, early {}", fired.load(), delays.size(), early.load());
+        return false;
+    }
+    return true;
+}
+
+bool TestCancel(TimerWheel &wheel)
+{
+    std::atomic<uint32> fired{0};
+    TimerWheel::Handle  handle = wheel.AddDelayed(50ms, [&] { fired.fetch_add(1); });
+    if (!wheel.Cancel(handle) || wheel.Cancel(handle))
+        return false;
+
+    // a done timer, the slot may be reused by a new timer
+    TimerWheel::Handle done = wheel.AddDelayed(1ms, [&] { fired.fetch_add(1, std::memory_order_release); });
+    WaitFor(fired, 1);
+    std::this_thread::sleep_for(5ms);
+    TimerWheel::Handle reused = wheel.AddDelayed(1h, [] {});
+    if (wheel.Cancel(done) || !wheel.Cancel(reused))
+        return false;
+
+    std::this_thread::sleep_for(100ms);
+    return fired.load() == 1;
+}
+
+bool TestPeriodic(TimerWheel &wheel)
+{
+    std::atomic<uint32> outside{0};
+    TimerWheel::Handle  handle = wheel.AddPeriodic(2ms, [&] { outside.fetch_add(1, std::memory_order_release); });
+    WaitFor(outside, 10);
+    if (!wheel.Cancel(handle))
+        return false;
+    // a firing may be in flight at the cancel
+    std::this_thread::sleep_for(20ms);
+    const uint32 stopped = outside.load();
+    std::this_thread::sleep_for(50ms);
+    if (outside.load() != stopped)
+    {
+        Logger::error("periodic timer fired after its cancel");
+        return false;
+    }
+
+    std::atomic<uint32> inside{0};
+    std::atomic<uint32> finished{0};
+    std::atomic<bool>   published{false};
+    TimerWheel::Handle  self;
+    self = wheel.AddPeriodic(1ms, [&] {
+        while (!published.load(std::memory_order_acquire))
+            std::this_thread::yield();
+        if (inside.fetch_add(1, std::memory_order_relaxed) + 1 == 5)
+        {
+            if (!wheel.Cancel(self))
+                Logger::error("periodic timer failed to cancel itself");
+            finished.store(1, std::memory_order_release);
+        }
+    });
+    published.store(true, std::memory_order_release);
+    WaitFor(finished, 1);
+    std::this_thread::sleep_for(50ms);
+    return inside.load() == 5;
+}
+
+/// hold the worker until released
+struct GateTask : Task
+{
+    void run() override
+    {
+        started.store(true, std::memory_order_release);
+        while (!open.load(std::memory_order_acquire))
+            std::this_thread::yield();
+    }
+
+    std::atomic<bool> started{false};
+    std::atomic<bool> open{false};
+};
+
+bool TestQueuedCancel()
+{
+    ThreadPool pool;
+    pool.Create(1, Priority::Normal);
+    GateTask gate;
+    pool.AddTask(&gate);
+    while (!gate.started.load(std::memory_order_acquire))
+        std::this_thread::yield();
+
+    std::atomic<uint32> fired{0};
+    bool                cancelled;
+    {
+        TimerWheel         wheel(pool);
+        TimerWheel::Handle periodic = wheel.AddPeriodic(5ms, [&] { fired.fetch_add(1); });
+        TimerWheel::Handle delayed = wheel.AddDelayed(5ms, [&] { fired.fetch_add(1); });
+        // both are due and handed to the pool, queued behind the gate
+        const auto deadline = Clock::now() + 10s;
+        while (wheel.GetPendingCount() != 0 && Clock::now() < deadline)
+            std::this_thread::sleep_for(1ms);
+        cancelled = wheel.Cancel(periodic) && wheel.Cancel(delayed) && !wheel.Cancel(periodic);
+        gate.open.store(true, std::memory_order_release);
+    }
+    pool.Destroy();
+
+    if (!cancelled || fired.load() != 0)
+    {
+        Logger::error("queued timers cancelled {}, fired {} times after the cancel", cancelled, fired.load());
+        return false;
+    }
+    return true;
+}
+
+bool TestScale(TimerWheel &wheel)
+{
+    std::mt19937                           random(42);
+    std::uniform_int_distribution<uint32>  delayMs(1, 3000);
+    std::vector<Clock::time_point>         due(ScaleTimerCount);
+    std::unique_ptr<std::atomic<int64>[]>  lateness(new std::atomic<int64>[ScaleTimerCount]);
+    std::vector<TimerWheel::Handle>        handles(ScaleTimerCount);
+    std::atomic<uint32>                    fired{0};
+
+    auto start = Clock::now();
+    for (uint32 i = 0; i < ScaleTimerCount; ++i)
+    {
+        const auto delay = std::chrono::milliseconds(delayMs(random));
+        due[i] = Clock::now() + delay;
+        lateness[i].store(-1, std::memory_order_relaxed);
+        handles[i] = wheel.AddDelayed(delay, [&, i] {
+            lateness[i].store((Clock::now() - due[i]).count(), std::memory_order_relaxed);
+            fired.fetch_add(1, std::memory_order_release);
+        });
+    }
+    const double insertNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / ScaleTimerCount;
+
+    // cancel one timer out of four, the shortest ones may be gone already
+    std::vector<bool> cancelled(ScaleTimerCount);
+    uint32            cancelCount = 0;
+    start = Clock::now();
+    for (uint32 i = 0; i < ScaleTimerCount; i += 4)
+    {
+        cancelled[i] = wheel.Cancel(handles[i]);
+        cancelCount += cancelled[i] ? 1 : 0;
+    }
+    const double cancelNs =
+        std::chrono::duration<double, std::nano>(Clock::now() - start).count() / (ScaleTimerCount / 4);
+
+    WaitFor(fired, ScaleTimerCount - cancelCount);
+    std::this_thread::sleep_for(50ms);
+
+    std::vector<double> late;
+    for (uint32 i = 0; i < ScaleTimerCount; ++i)
+    {
+        const int64 value = lateness[i].load();
+        if ((value >= 0) == cancelled[i])
+        {
+            Logger::error("timer {} cancelled {} fired {}", i, bool(cancelled[i]), value >= 0);
+            return false;
+        }
+        if (value >= 0)
+            late.push_back(std::chrono::duration<double, std::milli>(Clock::duration(value)).count());
+    }
+    std::sort(late.begin(), late.end());
+    Logger::info("{} timers, {} cancelled: insert {:.0f} ns, cancel {:.0f} ns, lateness p50 {:.2f} ms, p99 {:.2f} ms, max {:.2f} ms",
+                 ScaleTimerCount,
+                 cancelCount,
+                 insertNs,
+                 cancelNs,
+                 late[late.size() / 2],
+                 late[late.size() * 99 / 100],
+                 late.back());
+    return wheel.GetPendingCount() == 0;
+}
+
+int main()
+{
+    ThreadPool pool;
+    pool.Create(std::max(2u, std::thread::hardware_concurrency()), Priority::Normal);
+    bool passed;
+    {
+        TimerWheel wheel(pool);
+        passed = TestDelayed(wheel) && TestCancel(wheel) && TestPeriodic(wheel) && TestScale(wheel);
+    }
+    pool.Destroy();
+    passed = passed && TestQueuedCancel();
+
+    if (!passed)
+    {
+        Logger::error("TimerWheel test failed");
+        return 1;
+    }
+    Logger::info("TimerWheel test passed");
+    return 0;
+}
@@ -0,0 +1,92 @@
+// Growth of an entity table element by element, std::vector against
+// VirtualArray with and without huge pages, at 1.5M, 6M and 24M elements of 32
+// bytes. std::vector stands for eastl::vector, both double their buffer and
+// move every element at each growth. Every case runs in its own process, the
+// peak resident size shows the copy the vector briefly holds on growth.
+#include "Logger.h"
+#include "Memory/VirtualArray.h"
+#include <chrono>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <type_traits>
+#include <unistd.h>
+#include <vector>
+
+using namespace Hawl;
+using Clock = std::chrono::high_resolution_clock;
+
+struct Entity
+{
+    uint64 id;
+    float  position[3];
+    uint32 flags;
+    uint64 component;
+};
+
+static_assert(sizeof(Entity) == 32);
+
+Entity MakeEntity(uint32 i)
+{
+    return Entity{i, {float(i), 0.0f, 0.0f}, i & 7, i * 31ull};
+}
+
+/// \return ns per element
+template <typename Array>
+double Fill(Array &array, uint32 count, uint64 &checksum)
+{
+    const auto start = Clock::now();
+    for (uint32 i = 0; i < count; ++i)
+    {
+        if constexpr (std::is_same_v<Array, std::vector<Entity>>)
+            array.push_back(MakeEntity(i));
+        else
+            array.PushBack(MakeEntity(i));
+    }
+    const double nanoseconds = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    for (const Entity &entity : array)
+        checksum += entity.component;
+    return nanoseconds / count;
+}
+
+void RunCase(const char *name, uint32 count, int kind)
+{
+    uint64 checksum = 0;
+    double perElement = 0.0;
+    if (kind == 0)
+    {
+        std::vector<Entity> entities;
+        perElement = Fill(entities, count, checksum);
+    }
+    else
+    {
+        VirtualArray<Entity> entities(count, kind == 2);
+        perElement = Fill(entities, count, checksum);
+    }
+
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    Logger::info("{:4.1f}M {:20} {:5.2f} ns/element, peak resident {:5} MiB, checksum {}",
+                 count / double(1 << 20),
+                 name,
+                 perElement,
+                 usage.ru_maxrss / 1024,
+                 checksum);
+}
+
+int main()
+{
+    const char *names[] = {"std::vector", "VirtualArray", "VirtualArray huge"};
+    for (uint32 count : {3u << 19, 3u << 21, 3u << 23})
+        for (int kind = 0; kind < 3; ++kind)
+        {
+            // a fresh process so the peak resident size is the one of this case
+            const pid_t child = fork();
+            if (child == 0)
+            {
+                RunCase(names[kind], count, kind);
+                _exit(0);
+            }
+            waitpid(child, nullptr, 0);
+        }
+    return 0;
+}
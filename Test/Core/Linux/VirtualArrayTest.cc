@@ -0,0 +1,124 @@
+// VirtualArray: element addresses do not move while the array grows to
+// millions of elements, pages are committed as needed and decommitted by
+// Resize and ShrinkToFit, the elements are constructed and destroyed once,
+// the maximum size fails cleanly, and with huge pages the data is aligned on
+// a huge page.
+#include "Logger.h"
+#include "Memory/VirtualArray.h"
+#include "Memory/VirtualMemory.h"
+#include <cstdint>
+#include <utility>
+
+using namespace Hawl;
+
+constexpr uint32 ElementCount = 2000000;
+
+struct Entity
+{
+    uint64 id;
+    float  position[3];
+    uint32 flags;
+};
+
+struct Counted
+{
+    Counted()
+    {
+        ++constructed;
+    }
+
+    ~Counted()
+    {
+        ++destroyed;
+    }
+
+    uint32 payload[4] = {};
+
+    static inline uint32 constructed = 0;
+    static inline uint32 destroyed = 0;
+};
+
+int main()
+{
+    bool passed = true;
+
+    // growth in place
+    {
+        VirtualArray<Entity> entities(ElementCount * 2);
+        passed = passed && entities.IsEmpty() && entities.GetCapacity() == 0 &&
+                 entities.GetMaxSize() >= ElementCount * 2;
+        const Entity *first = entities.EmplaceBack(Entity{0, {0.0f, 0.0f, 0.0f}, 0});
+        for (uint32 i = 1; i < ElementCount; ++i)
+            passed = passed && entities.EmplaceBack(Entity{i, {float(i), 0.0f, 0.0f}, i & 7}) != nullptr;
+        passed = passed && &entities[0] == first && entities.Size() == ElementCount &&
+                 entities.GetCapacity() >= ElementCount && entities.GetCapacity() < ElementCount + 8192;
+        uint64 sum = 0;
+        for (const Entity &entity : entities)
+            sum += entity.id;
+        passed = passed && sum == uint64(ElementCount) * (ElementCount - 1) / 2;
+
+        // shrinking decommits, growing again reads zeroes on the new pages
+        entities.Resize(1000);
+        passed = passed && entities.Size() == 1000 && entities.GetCapacity() < 8192 && entities[999].id == 999;
+        entities.Resize(ElementCount);
+        passed = passed && entities[ElementCount - 1].id == 0 && entities[999].id == 999;
+
+        // moving keeps the addresses
+        VirtualArray<Entity> moved(std::move(entities));
+        passed = passed && &moved[0] == first && moved.Size() == ElementCount && entities.Size() == 0;
+        if (!passed)
+            Logger::error("VirtualArray: growth failed");
+    }
+
+    // construction and destruction
+    {
+        {
+            VirtualArray<Counted> array(100000);
+            for (uint32 i = 0; i < 1000; ++i)
+                array.EmplaceBack();
+            array.PopBack();
+            array.Resize(500);
+            passed = passed && Counted::constructed == 1000 && Counted::destroyed == 500;
+            array.Resize(800);
+            const size_t capacity = array.GetCapacity();
+            array.Clear();
+            passed = passed && Counted::destroyed == 1300 && array.GetCapacity() == capacity;
+            array.ShrinkToFit();
+            passed = passed && array.GetCapacity() == 0;
+            array.Resize(10);
+        }
+        passed = passed && Counted::constructed == Counted::destroyed && Counted::constructed == 1310;
+        if (!passed)
+            Logger::error("VirtualArray: construction failed");
+    }
+
+    // the maximum size
+    {
+        VirtualArray<uint64> array(16);
+        for (uint32 i = 0; i < array.GetMaxSize(); ++i)
+            array.PushBack(i);
+        passed = passed && array.PushBack(0) == nullptr && !array.Resize(array.GetMaxSize() + 1) &&
+                 array.Size() == array.GetMaxSize();
+        if (!passed)
+            Logger::error("VirtualArray: maximum size failed");
+    }
+
+    // huge pages
+    {
+        VirtualArray<uint32> array(ElementCount, true);
+        array.Resize(ElementCount);
+        passed = passed && reinterpret_cast<uintptr_t>(array.Data()) % VirtualMemory::HugePageSize == 0 &&
+                 array.GetCapacity() % (VirtualMemory::HugePageSize / sizeof(uint32)) == 0 &&
+                 array[ElementCount - 1] == 0;
+        if (!passed)
+            Logger::error("VirtualArray: huge pages failed");
+    }
+
+    if (!passed)
+    {
+        Logger::error("VirtualArray test failed");
+        return 1;
+    }
+    Logger::info("VirtualArray test passed");
+    return 0;
+}
@@ -0,0 +1,90 @@
+// Throughput of WorkStealingDeque against LockFreeQueue for a scheduler like
+// pattern: every thread mostly push and pop its own work and only go to the
+// shared structure of other threads when its own is empty.
+#include "Algorithm/LockfreeQueue.h"
+#include "Algorithm/WorkStealingDeque.h"
+#include "Logger.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace Hawl;
+using namespace Hawl::Algorithm;
+using Clock = std::chrono::high_resolution_clock;
+
+constexpr uint64 OperationsPerThread = 2000000;
+
+/// every thread push then pop from its own deque and steal from a random peer when empty
+double RunDeque(uint32 threadCount)
+{
+    std::vector<std::unique_ptr<WorkStealingDeque<uint64>>> deques;
+    for (uint32 i = 0; i < threadCount; ++i)
+        deques.emplace_back(new WorkStealingDeque<uint64>());
+
+    std::vector<std::thread> threads;
+    auto start = Clock::now();
+    for (uint32 t = 0; t < threadCount; ++t)
+        threads.emplace_back([&, t] {
+            WorkStealingDeque<uint64> &own = *deques[t];
+            uint32 seed = t * 7919 + 1;
+            uint64 value;
+            for (uint64 i = 0; i < OperationsPerThread; ++i)
+            {
+                if (i % 4 != 3)
+                {
+                    own.Push(i);
+                    continue;
+                }
+                if (own.Pop(value))
+                    continue;
+                seed = seed * 1103515245 + 12345;
+                deques[(seed >> 16) % threadCount]->Steal(value);
+            }
+            while (own.Pop(value))
+            {
+            }
+        });
+    for (auto &thread : threads)
+        thread.join();
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+/// the same operation mix on one shared queue
+double RunQueue(uint32 threadCount)
+{
+    LockFreeQueue<uint64> queue;
+    std::vector<std::thread> threads;
+    auto start = Clock::now();
+    for (uint32 t = 0; t < threadCount; ++t)
+        threads.emplace_back([&] {
+            uint64 value;
+            for (uint64 i = 0; i < OperationsPerThread; ++i)
+            {
+                if (i % 4 != 3)
+                    queue.EnQueue(i);
+                else
+                    queue.DeQueue(value);
+            }
+        });
+    for (auto &thread : threads)
+        thread.join();
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+int main()
+{
+    const uint32 maxThreads = std::thread::hardware_concurrency() ? std::thread::hardware_concurrency() : 1;
+    for (uint32 threads = 1; threads <= maxThreads; threads *= 2)
+    {
+        const double dequeTime = RunDeque(threads);
+        const double queueTime = RunQueue(threads);
+        const double operations = double(OperationsPerThread) * threads;
+        Logger::info("{} threads: WorkStealingDeque {:.1f} Mops/s, LockFreeQueue {:.1f} Mops/s",
+                     threads,
+                     operations / dequeTime / 1e6,
+                     operations / queueTime / 1e6);
+    }
+    return 0;
+}
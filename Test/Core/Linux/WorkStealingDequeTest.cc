@@ -0,0 +1,106 @@
+// Linearizability stress for the Chase-Lev deque: the owner push and pop while
+// thieves steal, every pushed item must be taken exactly once. Build it with
+// -fsanitize=thread or address to check the buffer growth under concurrency.
+#include "Algorithm/WorkStealingDeque.h"
+#include "Logger.h"
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace Hawl;
+using namespace Hawl::Algorithm;
+
+constexpr uint32 ThiefCount = 7;
+constexpr uint64 ItemCount = 2000000;
+
+/// single thread semantic, LIFO for the owner and FIFO for the thief
+bool TestSequential()
+{
+    WorkStealingDeque<uint64> deque(2);
+    for (uint64 i = 0; i < 100; ++i)
+        deque.Push(i);
+
+    uint64 value;
+    if (!deque.Steal(value) || value != 0)
+        return false;
+    if (!deque.Pop(value) || value != 99)
+        return false;
+
+    uint64 count = 2;
+    while (deque.Pop(value))
+        ++count;
+    return count == 100 && deque.IsEmpty() && !deque.Steal(value);
+}
+
+bool TestConcurrent()
+{
+    WorkStealingDeque<uint64> deque(4);
+    std::unique_ptr<std::atomic<uint32>[]> seen(new std::atomic<uint32>[ItemCount]);
+    for (uint64 i = 0; i < ItemCount; ++i)
+        seen[i].store(0, std::memory_order_relaxed);
+
+    std::atomic<uint64> taken{0};
+    std::atomic<uint64> stolen{0};
+    std::vector<std::thread> thieves;
+    for (uint32 i = 0; i < ThiefCount; ++i)
+        thieves.emplace_back([&] {
+            uint64 value;
+            while (taken.load(std::memory_order_relaxed) < ItemCount)
+            {
+                if (deque.Steal(value))
+                {
+                    seen[value].fetch_add(1, std::memory_order_relaxed);
+                    taken.fetch_add(1, std::memory_order_relaxed);
+                    stolen.fetch_add(1, std::memory_order_relaxed);
+                }
+                else
+                    std::this_thread::yield();
+            }
+        });
+
+    // the owner push in bursts, so the buffer grow while thieves are reading it
+    uint64 value;
+    for (uint64 i = 0; i < ItemCount;)
+    {
+        const uint64 burst = (i / 7) % 300 + 1;
+        for (uint64 n = 0; n < burst && i < ItemCount; ++n)
+            deque.Push(i++);
+        for (uint64 n = 0; n < burst / 2; ++n)
+        {
+            if (!deque.Pop(value))
+                break;
+            seen[value].fetch_add(1, std::memory_order_relaxed);
+            taken.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    while (deque.Pop(value))
+    {
+        seen[value].fetch_add(1, std::memory_order_relaxed);
+        taken.fetch_add(1, std::memory_order_relaxed);
+    }
+    for (auto &thief : thieves)
+        thief.join();
+
+    for (uint64 i = 0; i < ItemCount; ++i)
+    {
+        if (seen[i].load() != 1)
+        {
+            Logger::error("item {} taken {} times", i, seen[i].load());
+            return false;
+        }
+    }
+    Logger::info("{} items, {} stolen by {} thieves", ItemCount, stolen.load(), ThiefCount);
+    return true;
+}
+
+int main()
+{
+    if (!TestSequential() || !TestConcurrent())
+    {
+        Logger::error("WorkStealingDeque test failed");
+        return 1;
+    }
+    Logger::info("WorkStealingDeque test passed");
+    return 0;
+}
@@ -0,0 +1,228 @@
+/*
+ *  Copyright 2020 juteman
+ *
+ *  This file is a part of Hawl
+ *  see(https://github.com/juteman/Hawl)
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+// The timing scenarios of parallel_for.cpp ported to Hawl::ParallelFor, and
+// larger loops, reductions, scans and sorts timed against TBB. Every case keep
+// the best of a few runs, TBB and the pool use the same number of threads.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <random>
+#include <thread>
+#include <vector>
+#include "tbb/tbb.h"
+#include "BaseType.h"
+#include "Logger.h"
+#include "Thread/Parallel.h"
+
+using namespace Hawl;
+using Clock = std::chrono::high_resolution_clock;
+
+constexpr uint32 RunCount = 5;
+
+/// best time of the runs in nanoseconds
+template <typename Function>
+double Best(Function &&function)
+{
+    double best = 1e300;
+    for (uint32 run = 0; run < RunCount; ++run)
+    {
+        const auto start = Clock::now();
+        function();
+        best = std::min(best, std::chrono::duration<double, std::nano>(Clock::now() - start).count());
+    }
+    return best;
+}
+
+/// the 100 items counting loop of parallel_for.cpp, under every partitioner
+void SmallLoop(ThreadPool &pool)
+{
+    std::atomic<uint64> count{0};
+    auto countRange = [&](const tbb::blocked_range<uint32> &r) {
+        count.fetch_add(r.end() - r.begin(), std::memory_order_relaxed);
+    };
+
+    Logger::info("100 items: tbb auto {:.0f} ns", Best([&] {
+        tbb::parallel_for(tbb::blocked_range<uint32>(0, 100), countRange);
+    }));
+    for (uint32 grain : {1u, 16u, 32u, 20000u})
+    {
+        Logger::info("100 items: tbb grain size {} {:.0f} ns", grain, Best([&] {
+            tbb::parallel_for(tbb::blocked_range<uint32>(0, 100, grain), countRange, tbb::simple_partitioner());
+        }));
+    }
+    tbb::affinity_partitioner affinityPartitioner;
+    Logger::info("100 items: tbb affinity {:.0f} ns", Best([&] {
+        tbb::parallel_for(tbb::blocked_range<uint32>(0, 100), countRange, affinityPartitioner);
+    }));
+    Logger::info("100 items: Hawl ParallelFor {:.0f} ns", Best([&] {
+        ParallelFor(pool, 0u, 100u, [&](uint32 first, uint32 last) {
+            count.fetch_add(last - first, std::memory_order_relaxed);
+        });
+    }));
+}
+
+/// many cheap items and few expensive ones, where a fixed grain size is wrong for one of them
+void LargeLoops(ThreadPool &pool)
+{
+    std::vector<float> values(1 << 24, 2.0f);
+    auto light = [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i)
+            values[i] = std::sqrt(values[i] * 1.0001f + 1.0f);
+    };
+    Logger::info("{} light items: tbb auto {:.2f} ms, Hawl ParallelFor {:.2f} ms",
+                 values.size(),
+                 Best([&] {
+                     tbb::parallel_for(tbb::blocked_range<size_t>(0, values.size()),
+                                       [&](const tbb::blocked_range<size_t> &r) { light(r.begin(), r.end()); });
+                 }) / 1e6,
+                 Best([&] { ParallelFor(pool, size_t(0), values.size(), light); }) / 1e6);
+
+    std::vector<uint64> results(16384);
+    auto heavy = [&](size_t i) {
+        uint64 value = i;
+        for (uint32 n = 0; n < 5000; ++n)
+            value = value * 6364136223846793005ull + 1442695040888963407ull;
+        results[i] = value;
+    };
+    Logger::info("{} heavy items: tbb auto {:.2f} ms, Hawl ParallelFor {:.2f} ms",
+                 results.size(),
+                 Best([&] { tbb::parallel_for(size_t(0), results.size(), heavy); }) / 1e6,
+                 Best([&] { ParallelFor(pool, size_t(0), results.size(), heavy); }) / 1e6);
+}
+
+void Reduce(ThreadPool &pool)
+{
+    const uint64 count = 1ull << 25;
+    uint64 tbbSum = 0, hawlSum = 0;
+    const double tbbTime = Best([&] {
+        tbbSum = tbb::parallel_reduce(
+            tbb::blocked_range<uint64>(0, count), uint64(0),
+            [](const tbb::blocked_range<uint64> &r, uint64 value) {
+                for (uint64 i = r.begin(); i < r.end(); ++i)
+                    value += i ^ (i >> 3);
+                return value;
+            },
+            std::plus<uint64>());
+    });
+    const double hawlTime = Best([&] {
+        hawlSum = ParallelReduce(
+            pool, uint64(0), count, uint64(0),
+            [](uint64 first, uint64 last, uint64 value) {
+                for (uint64 i = first; i < last; ++i)
+                    value += i ^ (i >> 3);
+                return value;
+            },
+            std::plus<uint64>());
+    });
+    Logger::info("reduce {} items: tbb {:.2f} ms, Hawl ParallelReduce {:.2f} ms {}",
+                 count,
+                 tbbTime / 1e6,
+                 hawlTime / 1e6,
+                 tbbSum == hawlSum ? "" : "MISMATCH");
+}
+
+void Scan(ThreadPool &pool)
+{
+    std::vector<uint64> input(1 << 24), output(input.size());
+    std::mt19937 random(1);
+    for (auto &value : input)
+        value = random() & 0xFF;
+
+    const double tbbTime = Best([&] {
+        tbb::parallel_scan(
+            tbb::blocked_range<size_t>(0, input.size()), uint64(0),
+            [&](const tbb::blocked_range<size_t> &r, uint64 sum, bool isFinal) {
+                for (size_t i = r.begin(); i < r.end(); ++i)
+                {
+                    sum += input[i];
+                    if (isFinal)
+                        output[i] = sum;
+                }
+                return sum;
+            },
+            std::plus<uint64>());
+    });
+    const uint64 tbbLast = output.back();
+    const double hawlTime = Best([&] {
+        ParallelScan(pool, input.begin(), input.end(), output.begin(), uint64(0), std::plus<uint64>());
+    });
+    Logger::info("scan {} items: tbb {:.2f} ms, Hawl ParallelScan {:.2f} ms {}",
+                 input.size(),
+                 tbbTime / 1e6,
+                 hawlTime / 1e6,
+                 tbbLast == output.back() ? "" : "MISMATCH");
+}
+
+/// sort copies of the source, the copy is part of the time of every contender
+template <typename T, typename Sort>
+double TimeSort(const std::vector<T> &source, Sort &&sort)
+{
+    std::vector<T> data;
+    const double time = Best([&] {
+        data = source;
+        sort(data);
+    });
+    return std::is_sorted(data.begin(), data.end()) ? time : -1.0;
+}
+
+void Sort(ThreadPool &pool)
+{
+    std::vector<uint32> keys(1 << 23);
+    std::mt19937 random(2);
+    for (auto &key : keys)
+        key = random();
+    Logger::info("sort {} uint32: std::sort {:.2f} ms, tbb {:.2f} ms, Hawl radix {:.2f} ms",
+                 keys.size(),
+                 TimeSort(keys, [](auto &data) { std::sort(data.begin(), data.end()); }) / 1e6,
+                 TimeSort(keys, [](auto &data) { tbb::parallel_sort(data.begin(), data.end()); }) / 1e6,
+                 TimeSort(keys, [&](auto &data) { ParallelSort(pool, data.begin(), data.end()); }) / 1e6);
+
+    std::vector<double> values(1 << 23);
+    std::uniform_real_distribution<double> distribution;
+    for (auto &value : values)
+        value = distribution(random);
+    Logger::info("sort {} double: std::sort {:.2f} ms, tbb {:.2f} ms, Hawl quicksort {:.2f} ms",
+                 values.size(),
+                 TimeSort(values, [](auto &data) { std::sort(data.begin(), data.end()); }) / 1e6,
+                 TimeSort(values, [](auto &data) { tbb::parallel_sort(data.begin(), data.end()); }) / 1e6,
+                 TimeSort(values, [&](auto &data) { ParallelSort(pool, data.begin(), data.end()); }) / 1e6);
+}
+
+int main()
+{
+    // the calling thread take part in both, give the pool one worker less
+    const uint32 threads = std::max(1u, std::thread::hardware_concurrency());
+    tbb::global_control control(tbb::global_control::max_allowed_parallelism, threads);
+    ThreadPool pool;
+    pool.Create(std::max(1u, threads - 1), Priority::Normal);
+
+    SmallLoop(pool);
+    LargeLoops(pool);
+    Reduce(pool);
+    Scan(pool);
+    Sort(pool);
+
+    pool.Destroy();
+    return 0;
+}